@@ -0,0 +1,22 @@
+#!/bin/bash
+# Bulk QUIC throughput per capacity profile on a lossy, delayed loopback path.
+# Usage: ./get_congestion_graph.sh [rtt_ms] [loss_pct] [bandwidth_mbit]
+set -e
+
+RTT=${1:-50}
+LOSS=${2:-1}
+BW=${3:-50}
+BINARY=../../out/Release/benchmark/taps_benchmark_congestion_client
+OUTPUT=../results/congestion_${RTT}ms_${LOSS}pct.jsonl
+
+./setup_network.sh setup lo "$BW" "127.0.0.1:${RTT}:0:${LOSS}"
+trap './setup_network.sh teardown lo' EXIT
+
+mkdir -p ../results
+: > "$OUTPUT"
+for profile in best-effort scavenger interactive capacity-seeking; do
+    "$BINARY" --profile "$profile" --json | tee -a "$OUTPUT"
+done
+for algorithm in newreno cubic bbr; do
+    "$BINARY" --algorithm "$algorithm" --json | tee -a "$OUTPUT"
+done
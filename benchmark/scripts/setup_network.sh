@@ -5,11 +5,12 @@
 set -e
 
 print_usage() {
-    echo "Usage: $0 {setup|teardown|status} [interface] [bandwidth_mbit] ip:rtt_ms:[jitter] ... "
+    echo "Usage: $0 {setup|teardown|status} [interface] [bandwidth_mbit] ip:rtt_ms:[jitter]:[loss_pct] ... "
     echo ""
     echo "Examples:"
     echo "  $0 setup lo 100 127.0.0.1:50         # 50ms RTT, 0ms jitter"
     echo "  $0 setup lo 100 127.0.0.1:50:7       # 50ms RTT, 7ms jitter"
+    echo "  $0 setup lo 100 127.0.0.1:50:0:1     # 50ms RTT, 0ms jitter, 1% loss"
     echo "  $0 teardown                      # Remove network emulation"
     echo "  $0 status                        # Show current settings"
     echo ""
@@ -51,11 +52,15 @@ setup_network_full() {
         local rtt=$(echo "$pair" | cut -d: -f2)
         local delay=$(( rtt / 2 ))
         local jitter=$(echo "$pair" | cut -s -d: -f3) # Empty if not provided
+        local loss=$(echo "$pair" | cut -s -d: -f4)   # Empty if not provided
 
         local netem_cmd="delay ${delay}ms"
         if [ -n "$jitter" ] && [ "$jitter" != "0" ]; then
             netem_cmd="$netem_cmd ${jitter}ms 25% distribution normal"
         fi
+        if [ -n "$loss" ] && [ "$loss" != "0" ]; then
+            netem_cmd="$netem_cmd loss ${loss}%"
+        fi
 
         sudo tc class add dev "$iface" parent 1: classid "1:$band" htb rate "${bw}mbit" ceil "${bw}mbit"
         sudo tc qdisc add dev "$iface" parent "1:$band" handle "${band}:" netem $netem_cmd
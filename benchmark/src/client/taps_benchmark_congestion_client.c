@@ -0,0 +1,298 @@
+/*
+ * Measures QUIC bulk transfer throughput for a capacity profile or an explicit congestion
+ * control algorithm.
+ *
+ * Client and listener run in the same process. The listener binds to --listen-port on
+ * 127.0.0.1, and the client connects to --connect-port, which defaults to the same port.
+ * Point --connect-port at udp_loss_proxy to inject loss without root, or shape the loopback
+ * interface with scripts/setup_network.sh.
+ *
+ * Usage: taps_benchmark_congestion_client [--profile NAME] [--algorithm NAME] [--bytes N]
+ *                                         [--listen-port P] [--connect-port P] [--json]
+ */
+#include "ctaps.h"
+#include "../common/protocol.h"
+#include "../common/timing.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_TRANSFER_BYTES (32 * 1024 * 1024)
+#define BULK_MESSAGE_SIZE (64 * 1024)
+#define BULK_MESSAGES_IN_FLIGHT 16
+
+typedef struct {
+    const char* name;
+    int value;
+} named_value_t;
+
+static const named_value_t capacity_profiles[] = {
+    {"best-effort", CT_CAPACITY_PROFILE_BEST_EFFORT},
+    {"scavenger", CT_CAPACITY_PROFILE_SCAVENGER},
+    {"interactive", CT_CAPACITY_PROFILE_LOW_LATENCY_INTERACTIVE},
+    {"non-interactive", CT_CAPACITY_PROFILE_LOW_LATENCY_NON_INTERACTIVE},
+    {"constant-rate", CT_CAPACITY_PROFILE_CONSTANT_RATE_STREAMING},
+    {"capacity-seeking", CT_CAPACITY_PROFILE_CAPACITY_SEEKING},
+};
+
+static const named_value_t congestion_algorithms[] = {
+    {"auto", CT_CONGESTION_ALGORITHM_AUTO},
+    {"newreno", CT_CONGESTION_ALGORITHM_NEWRENO},
+    {"cubic", CT_CONGESTION_ALGORITHM_CUBIC},
+    {"dcubic", CT_CONGESTION_ALGORITHM_DCUBIC},
+    {"bbr", CT_CONGESTION_ALGORITHM_BBR},
+};
+
+typedef struct {
+    size_t total_bytes;
+    size_t bytes_queued;
+    size_t bytes_received;
+    char* bulk_content;
+
+    ct_listener_t* listener;
+    ct_connection_t* client_connection;
+    timing_t transfer_time;
+    bool done;
+} congestion_benchmark_t;
+
+static int json_only_mode = 0;
+
+static int lookup(const named_value_t* values, size_t count, const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(values[i].name, name) == 0) {
+            return values[i].value;
+        }
+    }
+    return -1;
+}
+
+static void send_next_chunk(congestion_benchmark_t* ctx) {
+    if (ctx->bytes_queued >= ctx->total_bytes) {
+        return;
+    }
+    size_t length = ctx->total_bytes - ctx->bytes_queued;
+    if (length > BULK_MESSAGE_SIZE) {
+        length = BULK_MESSAGE_SIZE;
+    }
+    ctx->bytes_queued += length;
+
+    ct_message_t* message = ct_message_new_with_content(ctx->bulk_content, length);
+    int rc = ct_send_message(ctx->client_connection, message);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to send bulk message: %d\n", rc);
+    }
+    ct_message_free(message);
+}
+
+static void on_server_receive(ct_connection_t* connection, ct_message_t* message,
+                              ct_message_context_t* message_context) {
+    congestion_benchmark_t* ctx = ct_message_context_get_receive_context(message_context);
+    ctx->bytes_received += ct_message_get_length(message);
+
+    if (ctx->bytes_received >= ctx->total_bytes) {
+        timing_end(&ctx->transfer_time);
+        ctx->done = true;
+        ct_connection_close_group(ctx->client_connection);
+        ct_listener_close(ctx->listener);
+        return;
+    }
+
+    ct_receive_callbacks_t receive_callbacks = {
+        .receive_callback = on_server_receive,
+        .per_receive_context = ctx,
+    };
+    ct_receive_message(connection, &receive_callbacks);
+}
+
+static void on_listener_ready(ct_listener_t* listener) {
+    congestion_benchmark_t* ctx = ct_listener_get_callback_context(listener);
+    ctx->listener = listener;
+}
+
+static void on_connection_received(ct_listener_t* listener, ct_connection_t* connection) {
+    congestion_benchmark_t* ctx = ct_listener_get_callback_context(listener);
+    ct_receive_callbacks_t receive_callbacks = {
+        .receive_callback = on_server_receive,
+        .per_receive_context = ctx,
+    };
+    ct_receive_message(connection, &receive_callbacks);
+}
+
+static void on_client_ready(ct_connection_t* connection) {
+    congestion_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ctx->client_connection = connection;
+    timing_start(&ctx->transfer_time);
+    for (int i = 0; i < BULK_MESSAGES_IN_FLIGHT; i++) {
+        send_next_chunk(ctx);
+    }
+}
+
+static void on_client_sent(ct_connection_t* connection, ct_message_context_t* message_context) {
+    (void)message_context;
+    congestion_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    if (!ctx->done) {
+        send_next_chunk(ctx);
+    }
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+}
+
+static void free_on_close(ct_connection_t* connection) {
+    ct_connection_free(connection);
+}
+
+int main(int argc, char* argv[]) {
+    const char* profile_name = "best-effort";
+    const char* algorithm_name = "auto";
+    int listen_port = DEFAULT_PORT;
+    int connect_port = -1;
+    congestion_benchmark_t ctx = {0};
+    ctx.total_bytes = DEFAULT_TRANSFER_BYTES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_name = argv[++i];
+        } else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc) {
+            algorithm_name = argv[++i];
+        } else if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) {
+            ctx.total_bytes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--listen-port") == 0 && i + 1 < argc) {
+            listen_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--connect-port") == 0 && i + 1 < argc) {
+            connect_port = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (connect_port < 0) {
+        connect_port = listen_port;
+    }
+
+    int profile = lookup(capacity_profiles, sizeof(capacity_profiles) / sizeof(capacity_profiles[0]),
+                         profile_name);
+    int algorithm = lookup(congestion_algorithms,
+                           sizeof(congestion_algorithms) / sizeof(congestion_algorithms[0]),
+                           algorithm_name);
+    if (profile < 0 || algorithm < 0 || ctx.total_bytes == 0) {
+        fprintf(stderr, "Invalid profile, algorithm or transfer size\n");
+        return 1;
+    }
+
+    ctx.bulk_content = malloc(BULK_MESSAGE_SIZE);
+    if (!ctx.bulk_content) {
+        fprintf(stderr, "Failed to allocate benchmark buffer\n");
+        return 1;
+    }
+    memset(ctx.bulk_content, 'B', BULK_MESSAGE_SIZE);
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, REQUIRE); // force QUIC
+    ct_transport_properties_set_conn_capacity_profile(transport_properties,
+                                                      (ct_capacity_profile_enum_t)profile);
+    ct_transport_properties_set_congestion_algorithm(transport_properties,
+                                                     (ct_congestion_algorithm_enum_t)algorithm);
+
+    // --- Listener ---
+    ct_local_endpoint_t* listener_endpoint = ct_local_endpoint_new();
+    ct_local_endpoint_with_interface(listener_endpoint, "lo");
+    ct_local_endpoint_with_port(listener_endpoint, listen_port);
+
+    ct_remote_endpoint_t* any_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(any_remote, "127.0.0.1");
+
+    ct_security_parameters_t* server_security = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(server_security, "benchmark");
+    ct_security_parameters_add_server_certificate(server_security, RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    ct_preconnection_t* listener_precon = ct_preconnection_new(
+        (const ct_local_endpoint_t**)&listener_endpoint, 1,
+        (const ct_remote_endpoint_t**)&any_remote, 1, transport_properties, server_security);
+    ct_security_parameters_free(server_security);
+
+    ct_listener_callbacks_t listener_callbacks = {
+        .listener_ready = on_listener_ready,
+        .connection_received = on_connection_received,
+        .per_listener_context = &ctx,
+    };
+    ct_connection_callbacks_t server_connection_callbacks = {
+        .closed = free_on_close,
+        .per_connection_context = &ctx,
+    };
+    int rc = ct_preconnection_listen(listener_precon, &listener_callbacks,
+                                     &server_connection_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to start listener: %d\n", rc);
+        return 1;
+    }
+
+    // --- Client ---
+    ct_remote_endpoint_t* server_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(server_remote, "127.0.0.1");
+    ct_remote_endpoint_with_port(server_remote, connect_port);
+
+    ct_security_parameters_t* client_security = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(client_security, "benchmark");
+    ct_security_parameters_add_client_certificate(client_security, RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    ct_preconnection_t* client_precon = ct_preconnection_new(
+        NULL, 0, (const ct_remote_endpoint_t**)&server_remote, 1, transport_properties,
+        client_security);
+    ct_security_parameters_free(client_security);
+
+    ct_connection_callbacks_t client_callbacks = {
+        .ready = on_client_ready,
+        .establishment_error = on_establishment_error,
+        .sent = on_client_sent,
+        .closed = free_on_close,
+        .per_connection_context = &ctx,
+    };
+    rc = ct_preconnection_initiate(client_precon, &client_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection: %d\n", rc);
+        return 1;
+    }
+
+    ct_start_event_loop();
+
+    double duration_ms = timing_get_duration_ms(&ctx.transfer_time);
+    double throughput_mbit =
+        duration_ms > 0 ? ((double)ctx.bytes_received * 8.0) / (duration_ms * 1000.0) : 0.0;
+    if (json_only_mode) {
+        printf("{\"profile\": \"%s\", \"algorithm\": \"%s\", \"bytes\": %zu, "
+               "\"duration_ms\": %.3f, \"throughput_mbit\": %.3f}\n",
+               profile_name, algorithm_name, ctx.bytes_received, duration_ms, throughput_mbit);
+    } else {
+        printf("Capacity profile: %s\n", profile_name);
+        printf("Algorithm:        %s\n", algorithm_name);
+        printf("Bytes received:   %zu\n", ctx.bytes_received);
+        printf("Duration:         %.3f ms\n", duration_ms);
+        printf("Throughput:       %.3f Mbit/s\n", throughput_mbit);
+    }
+
+    ct_close();
+    ct_listener_free(ctx.listener);
+    ct_preconnection_free(client_precon);
+    ct_preconnection_free(listener_precon);
+    ct_remote_endpoint_free(server_remote);
+    ct_remote_endpoint_free(any_remote);
+    ct_local_endpoint_free(listener_endpoint);
+    ct_transport_properties_free(transport_properties);
+    free(ctx.bulk_content);
+    return ctx.done ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/*
+ * Measures time to connect to a hostname whose A and AAAA answers arrive at different times.
+ *
+ * Runs num_connects sequential connections to hostname, each of which resolves the name (the DNS
+ * cache is disabled), races the candidates and stops the clock once the connection is ready.
+ * Meant to run against dns_stub_server with a delayed AAAA answer, see its header for how to
+ * point the resolver at it. Racing starts once the A answer and the resolution delay are in,
+ * so the time to connect should stay well below the AAAA delay.
+ *
+ * Usage: taps_benchmark_dns_race_client [hostname] [port] [num_connects] [--json]
+ */
+#include "ctaps.h"
+#include "../common/protocol.h"
+#include "../common/timing.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_HOSTNAME "benchmark.test"
+#define DEFAULT_NUM_CONNECTS 20
+
+typedef struct {
+    ct_preconnection_t* preconnection;
+    ct_connection_callbacks_t connection_callbacks;
+
+    size_t num_connects;
+    size_t num_completed;
+    double* connect_ms;
+    timing_t current;
+    bool failed;
+} dns_race_benchmark_t;
+
+static int json_only_mode = 0;
+// establishment_error() gets no connection when racing fails
+static dns_race_benchmark_t* benchmark = NULL;
+
+static void start_next_connect(dns_race_benchmark_t* ctx);
+
+static void on_connection_ready(ct_connection_t* connection) {
+    dns_race_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    timing_end(&ctx->current);
+    ctx->connect_ms[ctx->num_completed++] = timing_get_duration_ms(&ctx->current);
+    ct_connection_close(connection);
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+    benchmark->failed = true;
+}
+
+static void on_closed(ct_connection_t* connection) {
+    dns_race_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ct_connection_free(connection);
+    if (ctx->failed || ctx->num_completed == ctx->num_connects) {
+        return;
+    }
+    start_next_connect(ctx);
+}
+
+static void start_next_connect(dns_race_benchmark_t* ctx) {
+    timing_start(&ctx->current);
+    int rc = ct_preconnection_initiate(ctx->preconnection, &ctx->connection_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection: %d\n", rc);
+        ctx->failed = true;
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+int main(int argc, char* argv[]) {
+    const char* hostname = DEFAULT_HOSTNAME;
+    int port = DEFAULT_PORT;
+    dns_race_benchmark_t ctx = {0};
+    ctx.num_connects = DEFAULT_NUM_CONNECTS;
+    benchmark = &ctx;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (positional == 0) {
+            hostname = argv[i];
+            positional++;
+        } else if (positional == 1) {
+            port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 2) {
+            ctx.num_connects = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (ctx.num_connects == 0) {
+        fprintf(stderr, "Need at least one connect\n");
+        return 1;
+    }
+    ctx.connect_ms = calloc(ctx.num_connects, sizeof(double));
+    if (!ctx.connect_ms) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+    // Every connect should go to the resolver
+    ct_set_dns_cache_ttl(0);
+
+    if (!json_only_mode) {
+        printf("TAPS DNS race client connecting to %s:%d, %zu connects\n", hostname, port,
+               ctx.num_connects);
+    }
+
+    // TCP only, the benchmark server does not speak QUIC
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, PROHIBIT);
+
+    ct_remote_endpoint_t* remote_endpoint = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(remote_endpoint, hostname);
+    ct_remote_endpoint_with_port(remote_endpoint, port);
+
+    ctx.preconnection = ct_preconnection_new(NULL, 0,
+                                             (const ct_remote_endpoint_t**)&remote_endpoint, 1,
+                                             transport_properties, NULL);
+    if (!ctx.preconnection) {
+        fprintf(stderr, "Failed to allocate preconnection\n");
+        return 1;
+    }
+
+    ct_connection_callbacks_t connection_callbacks = {
+        .ready = on_connection_ready,
+        .establishment_error = on_establishment_error,
+        .closed = on_closed,
+        .per_connection_context = &ctx,
+    };
+    ctx.connection_callbacks = connection_callbacks;
+
+    start_next_connect(&ctx);
+
+    ct_start_event_loop();
+
+    size_t num_measured = ctx.num_completed;
+    double mean = 0;
+    for (size_t i = 0; i < num_measured; i++) {
+        mean += ctx.connect_ms[i];
+    }
+    mean = num_measured > 0 ? mean / (double)num_measured : 0;
+    qsort(ctx.connect_ms, num_measured, sizeof(double), compare_doubles);
+    double median = num_measured > 0 ? ctx.connect_ms[num_measured / 2] : 0;
+    double p99 = num_measured > 0 ? ctx.connect_ms[(num_measured * 99) / 100] : 0;
+
+    if (json_only_mode) {
+        printf("{\"connects\": %zu, \"connect_mean_ms\": %.3f, \"connect_median_ms\": %.3f, "
+               "\"connect_p99_ms\": %.3f}\n",
+               num_measured, mean, median, p99);
+    } else {
+        printf("Measured connects:  %zu\n", num_measured);
+        printf("Connect mean:       %.3f ms\n", mean);
+        printf("Connect median:     %.3f ms\n", median);
+        printf("Connect p99:        %.3f ms\n", p99);
+    }
+
+    ct_close();
+    ct_preconnection_free(ctx.preconnection);
+    ct_transport_properties_free(transport_properties);
+    ct_remote_endpoint_free(remote_endpoint);
+    free(ctx.connect_ms);
+    return ctx.failed ? 1 : 0;
+}
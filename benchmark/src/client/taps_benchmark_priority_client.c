@@ -0,0 +1,312 @@
+/*
+ * Measures the latency of small messages on one QUIC stream while another stream of the
+ * same connection group saturates the connection with bulk data.
+ *
+ * Client and listener run in the same process on the loopback interface, so one clock
+ * timestamps both the send and the receive of every probe. Probes are sent one at a time:
+ * the next probe is sent when the previous one arrives at the listener.
+ *
+ * Usage: taps_benchmark_priority_client [port] [num_probes] [--no-priority] [--json]
+ */
+#include "ctaps.h"
+#include "../common/timing.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_PRIORITY_PORT 4434
+#define DEFAULT_NUM_PROBES 1000
+#define BULK_MESSAGE_SIZE (64 * 1024)
+#define BULK_MESSAGES_IN_FLIGHT 16
+#define PROBE_MARKER 'P'
+#define PROBE_SIZE (1 + sizeof(uint64_t))
+// Probes are more urgent than bulk data, which keeps the default message priority
+#define PROBE_MSG_PRIORITY 200
+
+typedef struct {
+    bool use_priority;
+    size_t num_probes;
+
+    ct_listener_t* listener;
+    ct_connection_t* bulk_connection;
+    ct_connection_t* probe_connection;
+    char* bulk_content;
+
+    uint64_t* latencies_us;
+    size_t num_latencies;
+    size_t bulk_bytes_received;
+    bool done;
+} priority_benchmark_t;
+
+static int json_only_mode = 0;
+
+static void send_probe(priority_benchmark_t* ctx) {
+    char content[PROBE_SIZE];
+    uint64_t now_us = timing_get_timestamp_us();
+    content[0] = PROBE_MARKER;
+    memcpy(content + 1, &now_us, sizeof(now_us));
+
+    ct_message_t* message = ct_message_new_with_content(content, sizeof(content));
+    ct_message_context_t* message_context = ct_message_context_new();
+    if (ctx->use_priority) {
+        ct_message_context_set_priority(message_context, PROBE_MSG_PRIORITY);
+    }
+    int rc = ct_send_message_full(ctx->probe_connection, message, message_context);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to send probe: %d\n", rc);
+    }
+    ct_message_free(message);
+    ct_message_context_free(message_context);
+}
+
+static void send_bulk(priority_benchmark_t* ctx) {
+    ct_message_t* message = ct_message_new_with_content(ctx->bulk_content, BULK_MESSAGE_SIZE);
+    int rc = ct_send_message(ctx->bulk_connection, message);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to send bulk message: %d\n", rc);
+    }
+    ct_message_free(message);
+}
+
+static void finish(priority_benchmark_t* ctx) {
+    if (ctx->done) {
+        return;
+    }
+    ctx->done = true;
+    ct_connection_close_group(ctx->bulk_connection);
+    ct_listener_close(ctx->listener);
+}
+
+static void on_server_receive(ct_connection_t* connection, ct_message_t* message,
+                              ct_message_context_t* message_context) {
+    priority_benchmark_t* ctx = ct_message_context_get_receive_context(message_context);
+    const char* content = ct_message_get_content(message);
+    size_t length = ct_message_get_length(message);
+
+    if (length == PROBE_SIZE && content[0] == PROBE_MARKER) {
+        uint64_t sent_us = 0;
+        memcpy(&sent_us, content + 1, sizeof(sent_us));
+        if (ctx->num_latencies < ctx->num_probes) {
+            ctx->latencies_us[ctx->num_latencies++] = timing_get_timestamp_us() - sent_us;
+        }
+        if (ctx->num_latencies == ctx->num_probes) {
+            finish(ctx);
+            return;
+        }
+        send_probe(ctx);
+    } else {
+        ctx->bulk_bytes_received += length;
+    }
+
+    if (!ctx->done) {
+        ct_receive_callbacks_t receive_callbacks = {
+            .receive_callback = on_server_receive,
+            .per_receive_context = ctx,
+        };
+        ct_receive_message(connection, &receive_callbacks);
+    }
+}
+
+static void on_listener_ready(ct_listener_t* listener) {
+    priority_benchmark_t* ctx = ct_listener_get_callback_context(listener);
+    ctx->listener = listener;
+}
+
+static void on_connection_received(ct_listener_t* listener, ct_connection_t* connection) {
+    priority_benchmark_t* ctx = ct_listener_get_callback_context(listener);
+    ct_receive_callbacks_t receive_callbacks = {
+        .receive_callback = on_server_receive,
+        .per_receive_context = ctx,
+    };
+    ct_receive_message(connection, &receive_callbacks);
+}
+
+static void on_client_ready(ct_connection_t* connection) {
+    priority_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    if (!ctx->bulk_connection) {
+        ctx->bulk_connection = connection;
+        for (int i = 0; i < BULK_MESSAGES_IN_FLIGHT; i++) {
+            send_bulk(ctx);
+        }
+        // The clone becomes the probe stream, and is passed to this callback when ready
+        ct_connection_clone(connection);
+        return;
+    }
+    ctx->probe_connection = connection;
+    send_probe(ctx);
+}
+
+static void on_client_sent(ct_connection_t* connection, ct_message_context_t* message_context) {
+    (void)message_context;
+    priority_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    if (connection == ctx->bulk_connection && !ctx->done) {
+        send_bulk(ctx);
+    }
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+}
+
+static void free_on_close(ct_connection_t* connection) {
+    ct_connection_free(connection);
+}
+
+static int compare_uint64(const void* a, const void* b) {
+    uint64_t lhs = *(const uint64_t*)a;
+    uint64_t rhs = *(const uint64_t*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint64_t percentile(const uint64_t* sorted, size_t count, double p) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(p * (double)(count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void print_results(const priority_benchmark_t* ctx) {
+    qsort(ctx->latencies_us, ctx->num_latencies, sizeof(uint64_t), compare_uint64);
+    uint64_t p50 = percentile(ctx->latencies_us, ctx->num_latencies, 0.50);
+    uint64_t p99 = percentile(ctx->latencies_us, ctx->num_latencies, 0.99);
+    uint64_t max = ctx->num_latencies ? ctx->latencies_us[ctx->num_latencies - 1] : 0;
+
+    if (json_only_mode) {
+        printf("{\"priority\": %s, \"probes\": %zu, \"bulk_bytes\": %zu, "
+               "\"p50_us\": %llu, \"p99_us\": %llu, \"max_us\": %llu}\n",
+               ctx->use_priority ? "true" : "false", ctx->num_latencies, ctx->bulk_bytes_received,
+               (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)max);
+        return;
+    }
+    printf("Probe priority:      %s\n", ctx->use_priority ? "urgent" : "default");
+    printf("Probes received:     %zu\n", ctx->num_latencies);
+    printf("Bulk bytes received: %zu\n", ctx->bulk_bytes_received);
+    printf("Probe latency p50:   %llu us\n", (unsigned long long)p50);
+    printf("Probe latency p99:   %llu us\n", (unsigned long long)p99);
+    printf("Probe latency max:   %llu us\n", (unsigned long long)max);
+}
+
+int main(int argc, char* argv[]) {
+    int port = DEFAULT_PRIORITY_PORT;
+    priority_benchmark_t ctx = {0};
+    ctx.use_priority = true;
+    ctx.num_probes = DEFAULT_NUM_PROBES;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (strcmp(argv[i], "--no-priority") == 0) {
+            ctx.use_priority = false;
+        } else if (positional == 0) {
+            port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            ctx.num_probes = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (ctx.num_probes == 0) {
+        fprintf(stderr, "Number of probes must be positive\n");
+        return 1;
+    }
+
+    ctx.latencies_us = calloc(ctx.num_probes, sizeof(uint64_t));
+    ctx.bulk_content = malloc(BULK_MESSAGE_SIZE);
+    if (!ctx.latencies_us || !ctx.bulk_content) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+    memset(ctx.bulk_content, 'B', BULK_MESSAGE_SIZE);
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, REQUIRE); // force QUIC
+
+    // --- Listener ---
+    ct_local_endpoint_t* listener_endpoint = ct_local_endpoint_new();
+    ct_local_endpoint_with_interface(listener_endpoint, "lo");
+    ct_local_endpoint_with_port(listener_endpoint, port);
+
+    ct_remote_endpoint_t* any_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(any_remote, "127.0.0.1");
+
+    ct_security_parameters_t* server_security = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(server_security, "benchmark");
+    ct_security_parameters_add_server_certificate(server_security, RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    ct_preconnection_t* listener_precon = ct_preconnection_new(
+        (const ct_local_endpoint_t**)&listener_endpoint, 1,
+        (const ct_remote_endpoint_t**)&any_remote, 1, transport_properties, server_security);
+    ct_security_parameters_free(server_security);
+
+    ct_listener_callbacks_t listener_callbacks = {
+        .listener_ready = on_listener_ready,
+        .connection_received = on_connection_received,
+        .per_listener_context = &ctx,
+    };
+    ct_connection_callbacks_t server_connection_callbacks = {
+        .closed = free_on_close,
+        .per_connection_context = &ctx,
+    };
+    int rc = ct_preconnection_listen(listener_precon, &listener_callbacks,
+                                     &server_connection_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to start listener: %d\n", rc);
+        return 1;
+    }
+
+    // --- Client ---
+    ct_remote_endpoint_t* server_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(server_remote, "127.0.0.1");
+    ct_remote_endpoint_with_port(server_remote, port);
+
+    ct_security_parameters_t* client_security = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(client_security, "benchmark");
+    ct_security_parameters_add_client_certificate(client_security, RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    ct_preconnection_t* client_precon = ct_preconnection_new(
+        NULL, 0, (const ct_remote_endpoint_t**)&server_remote, 1, transport_properties,
+        client_security);
+    ct_security_parameters_free(client_security);
+
+    ct_connection_callbacks_t client_callbacks = {
+        .ready = on_client_ready,
+        .establishment_error = on_establishment_error,
+        .sent = on_client_sent,
+        .closed = free_on_close,
+        .per_connection_context = &ctx,
+    };
+    rc = ct_preconnection_initiate(client_precon, &client_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection: %d\n", rc);
+        return 1;
+    }
+
+    ct_start_event_loop();
+
+    print_results(&ctx);
+
+    ct_close();
+    ct_listener_free(ctx.listener);
+    ct_preconnection_free(client_precon);
+    ct_preconnection_free(listener_precon);
+    ct_remote_endpoint_free(server_remote);
+    ct_remote_endpoint_free(any_remote);
+    ct_local_endpoint_free(listener_endpoint);
+    ct_transport_properties_free(transport_properties);
+    free(ctx.latencies_us);
+    free(ctx.bulk_content);
+    return 0;
+}
@@ -1,3 +1,13 @@
+/*
+ * Races QUIC and TCP to the benchmark server, then transfers a LARGE file followed by a SHORT
+ * file on a clone of the winning connection.
+ *
+ * A warm-up race to the same server runs first, so the measured race staggers its attempts by
+ * the connection attempt delay learned from that connection's RTT. --fixed-delay pins the delay
+ * to the RFC 8305 default of 250 ms instead, for comparison.
+ *
+ * Usage: taps_benchmark_racing_client [host] [port] [--json] [--fixed-delay]
+ */
 #include "ctaps.h"
 #include "../common/protocol.h"
 #include "../common/timing.h"
@@ -21,6 +31,10 @@ typedef struct {
     const char* host;
     int port;
 
+    ct_preconnection_t* preconnection;
+    ct_connection_callbacks_t* connection_callbacks;
+    int warming_up;
+
     transfer_progress_t state;
 
     transfer_stats_t* large_stats;
@@ -96,6 +110,11 @@ void on_msg_received(ct_connection_t* connection, ct_message_t* msg,
 
 void on_connection_ready(ct_connection_t* connection) {
     client_context_t* ctx = (client_context_t*)ct_connection_get_callback_context(connection);
+    if (ctx->warming_up) {
+        // Only there to measure the RTT, the measured race starts once it is closed
+        ct_connection_close(connection);
+        return;
+    }
     ct_message_t* message = NULL;
     ct_message_context_t* msg_ctx = ct_message_context_new();
     if (!msg_ctx) {
@@ -150,6 +169,22 @@ void on_connection_ready(ct_connection_t* connection) {
     ct_message_context_free(msg_ctx);
 }
 
+void on_connection_closed(ct_connection_t* connection) {
+    client_context_t* ctx = (client_context_t*)ct_connection_get_callback_context(connection);
+    if (!ctx->warming_up) {
+        return;
+    }
+    ct_connection_free(connection);
+    ctx->warming_up = 0;
+    if (!json_only_mode) {
+        printf("Warm-up connection closed, starting measured race\n");
+    }
+    timing_start(&ctx->large_stats->handshake_time);
+    if (ct_preconnection_initiate(ctx->preconnection, ctx->connection_callbacks) != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection\n");
+    }
+}
+
 void on_establishment_error(ct_connection_t* connection) {
     if (!json_only_mode)
         printf("Connection establishment error occurred\n");
@@ -164,14 +199,20 @@ int main(int argc, char* argv[]) {
     if (argc > arg_idx) { host = argv[arg_idx++]; }
     if (argc > arg_idx) { port = atoi(argv[arg_idx++]); }
 
-    /* Parse --json flag */
-    if (argc > arg_idx && strcmp(argv[arg_idx], "--json") == 0) {
-        json_only_mode = 1;
-        arg_idx++;
+    /* Parse --json and --fixed-delay flags */
+    int fixed_delay = 0;
+    for (; arg_idx < argc; arg_idx++) {
+        if (strcmp(argv[arg_idx], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (strcmp(argv[arg_idx], "--fixed-delay") == 0) {
+            fixed_delay = 1;
+        }
     }
 
     if (!json_only_mode) {
         printf("TAPS Racing Client connecting to %s:%d (prefer QUIC, allow TCP)\n", host, port);
+        printf("Connection attempt delay: %s\n",
+               fixed_delay ? "fixed at 250 ms" : "from RTT history");
     }
 
     client_context_t client_ctx = {0};
@@ -197,6 +238,9 @@ int main(int argc, char* argv[]) {
     }
 
     ct_set_log_level(CT_LOG_INFO);
+    if (fixed_delay) {
+        ct_set_connection_attempt_delay(250);
+    }
 
     /* Use a pre-parsed IPv4 address rather than a hostname so that no DNS
      * resolution is needed before candidates can be gathered. */
@@ -263,10 +307,12 @@ int main(int argc, char* argv[]) {
     ct_connection_callbacks_t connection_callbacks = {
         .ready                  = on_connection_ready,
         .establishment_error    = on_establishment_error,
+        .closed                 = on_connection_closed,
         .per_connection_context = &client_ctx,
     };
-
-    timing_start(&client_ctx.large_stats->handshake_time);
+    client_ctx.preconnection = preconnection;
+    client_ctx.connection_callbacks = &connection_callbacks;
+    client_ctx.warming_up = 1;
 
     int rc = ct_preconnection_initiate(preconnection, &connection_callbacks);
     if (rc != 0) {
@@ -0,0 +1,256 @@
+/*
+ * Measures how fast new QUIC streams can be opened in a single connection group.
+ *
+ * Client and listener run in the same process on the loopback interface. Once the first
+ * connection is ready, the client clones it num_streams - 1 times and sends one byte on every
+ * stream. Two rates are reported: how fast the client creates stream connections, and how
+ * fast the listener receives them, which includes creating a stream connection per peer
+ * initiated stream. Every stream is closed by the listener afterwards.
+ *
+ * Usage: taps_benchmark_stream_open_client [port] [num_streams] [--json]
+ */
+#include "ctaps.h"
+#include "../common/timing.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_STREAM_OPEN_PORT 4436
+#define DEFAULT_NUM_STREAMS 10000
+
+typedef struct {
+    size_t num_streams;
+
+    ct_listener_t* listener;
+    ct_connection_t** client_streams;
+    ct_connection_t** server_streams;
+    size_t num_server_streams;
+    size_t num_client_streams;
+    size_t num_client_closed;
+
+    timing_t clone_time;  // Client side, creating the stream connections
+    timing_t accept_time; // First clone until the listener has seen every stream
+    bool done;
+} stream_open_benchmark_t;
+
+static int json_only_mode = 0;
+
+static void send_one_byte(ct_connection_t* connection) {
+    ct_message_t* message = ct_message_new_with_content("x", 1);
+    int rc = ct_send_message(connection, message);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to send message: %d\n", rc);
+    }
+    ct_message_free(message);
+}
+
+static void on_server_receive(ct_connection_t* connection, ct_message_t* message,
+                              ct_message_context_t* message_context) {
+    (void)message;
+    stream_open_benchmark_t* ctx = ct_message_context_get_receive_context(message_context);
+    if (ctx->num_server_streams >= ctx->num_streams) {
+        return;
+    }
+    ctx->server_streams[ctx->num_server_streams++] = connection;
+    if (ctx->num_server_streams < ctx->num_streams) {
+        return;
+    }
+
+    timing_end(&ctx->accept_time);
+    for (size_t i = 0; i < ctx->num_server_streams; i++) {
+        ct_connection_close(ctx->server_streams[i]);
+    }
+}
+
+static void on_listener_ready(ct_listener_t* listener) {
+    stream_open_benchmark_t* ctx = ct_listener_get_callback_context(listener);
+    ctx->listener = listener;
+}
+
+static void on_connection_received(ct_listener_t* listener, ct_connection_t* connection) {
+    stream_open_benchmark_t* ctx = ct_listener_get_callback_context(listener);
+    ct_receive_callbacks_t receive_callbacks = {
+        .receive_callback = on_server_receive,
+        .per_receive_context = ctx,
+    };
+    ct_receive_message(connection, &receive_callbacks);
+}
+
+static void on_client_ready(ct_connection_t* connection) {
+    stream_open_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    if (ctx->num_client_streams >= ctx->num_streams) {
+        return;
+    }
+    // Clones are passed to this callback synchronously from ct_connection_clone()
+    ctx->client_streams[ctx->num_client_streams++] = connection;
+    if (ctx->num_client_streams > 1) {
+        return;
+    }
+
+    timing_start(&ctx->accept_time);
+    timing_start(&ctx->clone_time);
+    for (size_t i = 1; i < ctx->num_streams; i++) {
+        int rc = ct_connection_clone(connection);
+        if (rc != 0) {
+            fprintf(stderr, "Failed to clone connection: %d\n", rc);
+            break;
+        }
+    }
+    timing_end(&ctx->clone_time);
+
+    // Send only after cloning, so the clone timing covers connection creation alone
+    for (size_t i = 0; i < ctx->num_client_streams; i++) {
+        send_one_byte(ctx->client_streams[i]);
+    }
+}
+
+static void on_client_closed(ct_connection_t* connection) {
+    stream_open_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ct_connection_free(connection);
+    if (++ctx->num_client_closed == ctx->num_streams && !ctx->done) {
+        ctx->done = true;
+        ct_listener_close(ctx->listener);
+    }
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+}
+
+static void free_on_close(ct_connection_t* connection) {
+    ct_connection_free(connection);
+}
+
+int main(int argc, char* argv[]) {
+    int port = DEFAULT_STREAM_OPEN_PORT;
+    stream_open_benchmark_t ctx = {0};
+    ctx.num_streams = DEFAULT_NUM_STREAMS;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (positional == 0) {
+            port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            ctx.num_streams = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (ctx.num_streams == 0) {
+        fprintf(stderr, "Number of streams must be positive\n");
+        return 1;
+    }
+
+    ctx.client_streams = calloc(ctx.num_streams, sizeof(ct_connection_t*));
+    ctx.server_streams = calloc(ctx.num_streams, sizeof(ct_connection_t*));
+    if (!ctx.client_streams || !ctx.server_streams) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, REQUIRE); // force QUIC
+
+    // --- Listener ---
+    ct_local_endpoint_t* listener_endpoint = ct_local_endpoint_new();
+    ct_local_endpoint_with_interface(listener_endpoint, "lo");
+    ct_local_endpoint_with_port(listener_endpoint, port);
+
+    ct_remote_endpoint_t* any_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(any_remote, "127.0.0.1");
+
+    ct_security_parameters_t* server_security = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(server_security, "benchmark");
+    ct_security_parameters_add_server_certificate(server_security, RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    ct_preconnection_t* listener_precon = ct_preconnection_new(
+        (const ct_local_endpoint_t**)&listener_endpoint, 1,
+        (const ct_remote_endpoint_t**)&any_remote, 1, transport_properties, server_security);
+    ct_security_parameters_free(server_security);
+
+    ct_listener_callbacks_t listener_callbacks = {
+        .listener_ready = on_listener_ready,
+        .connection_received = on_connection_received,
+        .per_listener_context = &ctx,
+    };
+    ct_connection_callbacks_t server_connection_callbacks = {
+        .closed = free_on_close,
+        .per_connection_context = &ctx,
+    };
+    int rc = ct_preconnection_listen(listener_precon, &listener_callbacks,
+                                     &server_connection_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to start listener: %d\n", rc);
+        return 1;
+    }
+
+    // --- Client ---
+    ct_remote_endpoint_t* server_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(server_remote, "127.0.0.1");
+    ct_remote_endpoint_with_port(server_remote, port);
+
+    ct_security_parameters_t* client_security = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(client_security, "benchmark");
+    ct_security_parameters_add_client_certificate(client_security, RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    ct_preconnection_t* client_precon = ct_preconnection_new(
+        NULL, 0, (const ct_remote_endpoint_t**)&server_remote, 1, transport_properties,
+        client_security);
+    ct_security_parameters_free(client_security);
+
+    ct_connection_callbacks_t client_callbacks = {
+        .ready = on_client_ready,
+        .establishment_error = on_establishment_error,
+        .closed = on_client_closed,
+        .per_connection_context = &ctx,
+    };
+    rc = ct_preconnection_initiate(client_precon, &client_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection: %d\n", rc);
+        return 1;
+    }
+
+    ct_start_event_loop();
+
+    double clone_ms = timing_get_duration_ms(&ctx.clone_time);
+    double accept_ms = timing_get_duration_ms(&ctx.accept_time);
+    double clone_rate = clone_ms > 0 ? (double)ctx.num_client_streams * 1000.0 / clone_ms : 0;
+    double accept_rate = accept_ms > 0 ? (double)ctx.num_server_streams * 1000.0 / accept_ms : 0;
+    if (json_only_mode) {
+        printf("{\"streams\": %zu, \"received\": %zu, \"clone_ms\": %.3f, "
+               "\"clone_streams_per_sec\": %.0f, \"accept_ms\": %.3f, "
+               "\"accept_streams_per_sec\": %.0f}\n",
+               ctx.num_streams, ctx.num_server_streams, clone_ms, clone_rate, accept_ms,
+               accept_rate);
+    } else {
+        printf("Streams:                  %zu\n", ctx.num_streams);
+        printf("Streams received:         %zu\n", ctx.num_server_streams);
+        printf("Client clone duration:    %.3f ms (%.0f streams/s)\n", clone_ms, clone_rate);
+        printf("Listener accept duration: %.3f ms (%.0f streams/s)\n", accept_ms, accept_rate);
+    }
+
+    ct_close();
+    ct_listener_free(ctx.listener);
+    ct_preconnection_free(client_precon);
+    ct_preconnection_free(listener_precon);
+    ct_remote_endpoint_free(server_remote);
+    ct_remote_endpoint_free(any_remote);
+    ct_local_endpoint_free(listener_endpoint);
+    ct_transport_properties_free(transport_properties);
+    free(ctx.client_streams);
+    free(ctx.server_streams);
+    return ctx.done ? 0 : 1;
+}
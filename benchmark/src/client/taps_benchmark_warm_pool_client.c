@@ -0,0 +1,244 @@
+/*
+ * Measures time to first byte with and without a warm pool of pre-established connections.
+ *
+ * Runs num_requests sequential SHORT requests against the benchmark server. Each request
+ * initiates a connection, sends the request once it is ready and stops the clock at the first
+ * byte of the response, after which the connection is closed and the next request starts.
+ * Without --warm every request races and handshakes like taps_benchmark_handshake_client. With
+ * --warm the preconnection keeps WARM_POOL_SIZE connections idle, so requests find an established
+ * connection and only pay for the request round trip while the pool refills in the background.
+ *
+ * The first request is a warm-up and not included in the statistics, in warm mode the pool is
+ * filling up concurrently with it.
+ *
+ * Usage: taps_benchmark_warm_pool_client [host] [port] [num_requests] [--warm] [--json]
+ */
+#include "ctaps.h"
+#include "../common/protocol.h"
+#include "../common/timing.h"
+#include <arpa/inet.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_NUM_REQUESTS 50
+#define WARM_POOL_SIZE 2
+
+typedef struct {
+    ct_preconnection_t* preconnection;
+    ct_connection_callbacks_t connection_callbacks;
+    bool warm;
+
+    size_t num_requests;
+    size_t num_started;
+    size_t num_completed;
+    size_t num_warm_hits; // Requests that found an idle connection in the pool
+    double* ttfb_ms;
+    timing_t current;
+    bool current_received;
+    bool failed;
+} warm_pool_benchmark_t;
+
+static int json_only_mode = 0;
+// establishment_error() gets no connection when racing fails
+static warm_pool_benchmark_t* benchmark = NULL;
+
+static void start_next_request(warm_pool_benchmark_t* ctx);
+
+static void on_msg_received(ct_connection_t* connection, ct_message_t* message,
+                            ct_message_context_t* message_context) {
+    (void)message;
+    warm_pool_benchmark_t* ctx = ct_message_context_get_receive_context(message_context);
+    if (ctx->current_received) {
+        return;
+    }
+    timing_end(&ctx->current);
+    ctx->current_received = true;
+    ctx->ttfb_ms[ctx->num_completed++] = timing_get_duration_ms(&ctx->current);
+    ct_connection_close_group(connection);
+}
+
+static void on_connection_ready(ct_connection_t* connection) {
+    warm_pool_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ct_receive_callbacks_t receive_callbacks = {
+        .receive_callback = on_msg_received,
+        .per_receive_context = ctx,
+    };
+    ct_receive_message(connection, &receive_callbacks);
+
+    ct_message_context_t* msg_ctx = ct_message_context_new();
+    ct_message_context_set_final(msg_ctx, true);
+    ct_message_t* message = ct_message_new_with_content(REQUEST_SHORT, sizeof(REQUEST_SHORT));
+    int rc = ct_send_message_full(connection, message, msg_ctx);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to send request: %d\n", rc);
+    }
+    ct_message_free(message);
+    ct_message_context_free(msg_ctx);
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+    benchmark->failed = true;
+    ct_preconnection_set_warm_pool(benchmark->preconnection, 0, 0, 0);
+}
+
+static void on_closed(ct_connection_t* connection) {
+    warm_pool_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ct_connection_free(connection);
+    if (!ctx->current_received) {
+        fprintf(stderr, "Connection closed before a response was received\n");
+        ctx->failed = true;
+    }
+    if (ctx->failed || ctx->num_started == ctx->num_requests) {
+        // Closing the idle connections lets the event loop finish
+        ct_preconnection_set_warm_pool(ctx->preconnection, 0, 0, 0);
+        return;
+    }
+    start_next_request(ctx);
+}
+
+static void start_next_request(warm_pool_benchmark_t* ctx) {
+    if (ct_preconnection_get_num_warm_connections(ctx->preconnection) > 0 &&
+        ctx->num_started > 0) {
+        ctx->num_warm_hits++;
+    }
+    ctx->num_started++;
+    ctx->current_received = false;
+    timing_start(&ctx->current);
+    int rc = ct_preconnection_initiate(ctx->preconnection, &ctx->connection_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection: %d\n", rc);
+        ctx->failed = true;
+        ct_preconnection_set_warm_pool(ctx->preconnection, 0, 0, 0);
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    int port = DEFAULT_PORT;
+    warm_pool_benchmark_t ctx = {0};
+    ctx.num_requests = DEFAULT_NUM_REQUESTS;
+    benchmark = &ctx;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (strcmp(argv[i], "--warm") == 0) {
+            ctx.warm = true;
+        } else if (positional == 0) {
+            host = argv[i];
+            positional++;
+        } else if (positional == 1) {
+            port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 2) {
+            ctx.num_requests = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (ctx.num_requests < 2) {
+        fprintf(stderr, "Need at least two requests, the first one is a warm-up\n");
+        return 1;
+    }
+    ctx.ttfb_ms = calloc(ctx.num_requests, sizeof(double));
+    if (!ctx.ttfb_ms) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    if (!json_only_mode) {
+        printf("TAPS warm pool client connecting to %s:%d, %zu requests, %s\n", host, port,
+               ctx.num_requests, ctx.warm ? "warm pool" : "no warm pool");
+    }
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, PREFER);
+
+    ct_security_parameters_t* security_parameters = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(security_parameters, "benchmark");
+    ct_security_parameters_add_client_certificate(security_parameters,
+                                                  RESOURCE_FOLDER "/cert.pem",
+                                                  RESOURCE_FOLDER "/key.pem");
+
+    // Pre-parsed address, so that DNS resolution is not part of the measurement
+    ct_remote_endpoint_t* remote_endpoint = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_ipv4(remote_endpoint, inet_addr(host));
+    ct_remote_endpoint_with_port(remote_endpoint, port);
+
+    ctx.preconnection = ct_preconnection_new(NULL, 0,
+                                             (const ct_remote_endpoint_t**)&remote_endpoint, 1,
+                                             transport_properties, security_parameters);
+    ct_security_parameters_free(security_parameters);
+    if (!ctx.preconnection) {
+        fprintf(stderr, "Failed to allocate preconnection\n");
+        return 1;
+    }
+
+    ct_connection_callbacks_t connection_callbacks = {
+        .ready = on_connection_ready,
+        .establishment_error = on_establishment_error,
+        .closed = on_closed,
+        .per_connection_context = &ctx,
+    };
+    ctx.connection_callbacks = connection_callbacks;
+
+    if (ctx.warm) {
+        int rc = ct_preconnection_set_warm_pool(ctx.preconnection, WARM_POOL_SIZE, WARM_POOL_SIZE,
+                                                0);
+        if (rc != 0) {
+            fprintf(stderr, "ERROR: Failed to set warm pool: %d\n", rc);
+            return 1;
+        }
+    }
+    start_next_request(&ctx);
+
+    ct_start_event_loop();
+
+    // Skip the warm-up request
+    size_t num_measured = ctx.num_completed > 0 ? ctx.num_completed - 1 : 0;
+    double* measured = ctx.ttfb_ms + 1;
+    double mean = 0;
+    for (size_t i = 0; i < num_measured; i++) {
+        mean += measured[i];
+    }
+    mean = num_measured > 0 ? mean / (double)num_measured : 0;
+    qsort(measured, num_measured, sizeof(double), compare_doubles);
+    double median = num_measured > 0 ? measured[num_measured / 2] : 0;
+    double p99 = num_measured > 0 ? measured[(num_measured * 99) / 100] : 0;
+
+    if (json_only_mode) {
+        printf("{\"warm_pool\": %s, \"requests\": %zu, \"warm_hits\": %zu, "
+               "\"ttfb_mean_ms\": %.3f, \"ttfb_median_ms\": %.3f, \"ttfb_p99_ms\": %.3f}\n",
+               ctx.warm ? "true" : "false", num_measured, ctx.num_warm_hits, mean, median, p99);
+    } else {
+        printf("Measured requests:  %zu\n", num_measured);
+        printf("Warm pool hits:     %zu\n", ctx.num_warm_hits);
+        printf("TTFB mean:          %.3f ms\n", mean);
+        printf("TTFB median:        %.3f ms\n", median);
+        printf("TTFB p99:           %.3f ms\n", p99);
+    }
+
+    ct_close();
+    ct_preconnection_free(ctx.preconnection);
+    ct_transport_properties_free(transport_properties);
+    ct_remote_endpoint_free(remote_endpoint);
+    free(ctx.ttfb_ms);
+    return ctx.failed ? 1 : 0;
+}
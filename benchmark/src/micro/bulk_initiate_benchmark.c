@@ -0,0 +1,236 @@
+/*
+ * Measures the time until num_connections connections are established, once by calling
+ * ct_preconnection_initiate() in a loop and once with a single ct_preconnection_initiate_many().
+ *
+ * Every connection is a TCP connection to a loopback socket this benchmark listens on. The loop
+ * gathers candidates and races for each connection on its own, the bulk initiate gathers once
+ * and spreads the races over ramp_ms.
+ *
+ * Usage: bulk_initiate_benchmark [num_connections] [ramp_ms] [--json]
+ */
+#include "ctaps.h"
+#include "../common/timing.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_CONNECTIONS 256
+#define DEFAULT_RAMP_MS 0
+
+typedef enum {
+    PHASE_LOOP,
+    PHASE_BULK,
+    PHASE_DONE,
+} bulk_benchmark_phase_t;
+
+typedef struct {
+    ct_preconnection_t* preconnection;
+    ct_connection_callbacks_t connection_callbacks;
+    int listen_fd;
+
+    size_t num_connections;
+    ct_connection_t** connections;
+    size_t num_ready;
+    size_t num_closed;
+    bulk_benchmark_phase_t phase;
+
+    timing_t current;
+    double initiate_us[PHASE_DONE];
+    double established_ms[PHASE_DONE];
+    bool failed;
+} bulk_benchmark_t;
+
+// establishment_error() gets no connection when racing fails
+static bulk_benchmark_t* benchmark = NULL;
+
+static void start_phase(bulk_benchmark_t* ctx);
+
+static void accept_pending(bulk_benchmark_t* ctx) {
+    // Nothing is read from the accepted connections
+    int fd;
+    while ((fd = accept(ctx->listen_fd, NULL, NULL)) >= 0) {
+        close(fd);
+    }
+}
+
+static void on_connection_ready(ct_connection_t* connection) {
+    bulk_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ctx->connections[ctx->num_ready++] = connection;
+    if (ctx->num_ready < ctx->num_connections) {
+        return;
+    }
+    timing_end(&ctx->current);
+    ctx->established_ms[ctx->phase] = timing_get_duration_ms(&ctx->current);
+    for (size_t i = 0; i < ctx->num_connections; i++) {
+        ct_connection_close(ctx->connections[i]);
+    }
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+    benchmark->failed = true;
+}
+
+static void on_closed(ct_connection_t* connection) {
+    bulk_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ct_connection_free(connection);
+    accept_pending(ctx);
+    if (++ctx->num_closed < ctx->num_connections || ctx->failed) {
+        return;
+    }
+    ctx->phase++;
+    start_phase(ctx);
+}
+
+static void start_phase(bulk_benchmark_t* ctx) {
+    if (ctx->phase == PHASE_DONE) {
+        return;
+    }
+    ctx->num_ready = 0;
+    ctx->num_closed = 0;
+    timing_t initiate;
+    timing_start(&ctx->current);
+    timing_start(&initiate);
+    int rc = 0;
+    if (ctx->phase == PHASE_LOOP) {
+        for (size_t i = 0; i < ctx->num_connections && rc == 0; i++) {
+            rc = ct_preconnection_initiate(ctx->preconnection, &ctx->connection_callbacks);
+        }
+    } else {
+        rc = ct_preconnection_initiate_many(ctx->preconnection, ctx->num_connections,
+                                            &ctx->connection_callbacks);
+    }
+    timing_end(&initiate);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate connections: %d\n", rc);
+        ctx->failed = true;
+        return;
+    }
+    ctx->initiate_us[ctx->phase] = timing_get_duration_us(&initiate);
+}
+
+static int listen_on_loopback(uint16_t* port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    socklen_t address_len = sizeof(address);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0 ||
+        getsockname(fd, (struct sockaddr*)&address, &address_len) != 0 ||
+        fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(address.sin_port);
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t ramp_ms = DEFAULT_RAMP_MS;
+    int json_only_mode = 0;
+    bulk_benchmark_t ctx = {0};
+    ctx.num_connections = DEFAULT_NUM_CONNECTIONS;
+    benchmark = &ctx;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (positional == 0) {
+            ctx.num_connections = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            ramp_ms = (uint64_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (ctx.num_connections == 0) {
+        fprintf(stderr, "Need at least one connection\n");
+        return 1;
+    }
+    ctx.connections = calloc(ctx.num_connections, sizeof(ct_connection_t*));
+    if (!ctx.connections) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+
+    uint16_t port = 0;
+    ctx.listen_fd = listen_on_loopback(&port);
+    if (ctx.listen_fd < 0) {
+        fprintf(stderr, "Failed to listen on loopback\n");
+        return 1;
+    }
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    // TCP only, nothing answers QUIC on the loopback port
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, PROHIBIT);
+
+    ct_remote_endpoint_t* remote_endpoint = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_ipv4(remote_endpoint, inet_addr("127.0.0.1"));
+    ct_remote_endpoint_with_port(remote_endpoint, port);
+    ctx.preconnection =
+        ct_preconnection_new(NULL, 0, (const ct_remote_endpoint_t**)&remote_endpoint, 1,
+                             transport_properties, NULL);
+    if (!ctx.preconnection) {
+        fprintf(stderr, "Failed to allocate preconnection\n");
+        return 1;
+    }
+    ct_preconnection_set_initiate_ramp(ctx.preconnection, ramp_ms);
+
+    ct_connection_callbacks_t connection_callbacks = {
+        .ready = on_connection_ready,
+        .establishment_error = on_establishment_error,
+        .closed = on_closed,
+        .per_connection_context = &ctx,
+    };
+    ctx.connection_callbacks = connection_callbacks;
+
+    ctx.phase = PHASE_LOOP;
+    start_phase(&ctx);
+
+    ct_start_event_loop();
+
+    if (json_only_mode) {
+        printf("{\"connections\": %zu, \"ramp_ms\": %lu, \"loop_initiate_us\": %.3f, "
+               "\"loop_established_ms\": %.3f, \"bulk_initiate_us\": %.3f, "
+               "\"bulk_established_ms\": %.3f}\n",
+               ctx.num_connections, ramp_ms, ctx.initiate_us[PHASE_LOOP],
+               ctx.established_ms[PHASE_LOOP], ctx.initiate_us[PHASE_BULK],
+               ctx.established_ms[PHASE_BULK]);
+    } else {
+        printf("Connections:              %zu\n", ctx.num_connections);
+        printf("Ramp:                     %lu ms\n", ramp_ms);
+        printf("Loop initiate:            %.3f us\n", ctx.initiate_us[PHASE_LOOP]);
+        printf("Loop time to established: %.3f ms\n", ctx.established_ms[PHASE_LOOP]);
+        printf("Bulk initiate:            %.3f us\n", ctx.initiate_us[PHASE_BULK]);
+        printf("Bulk time to established: %.3f ms\n", ctx.established_ms[PHASE_BULK]);
+    }
+
+    ct_preconnection_free(ctx.preconnection);
+    ct_remote_endpoint_free(remote_endpoint);
+    ct_transport_properties_free(transport_properties);
+    ct_close();
+    close(ctx.listen_fd);
+    free(ctx.connections);
+    return ctx.failed ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Measures the latency and heap allocations of one candidate gathering run.
+ *
+ * Gathers candidates for a preconnection with num_alpns ALPNs and num_endpoints IPv4 literal
+ * remote endpoints, which resolve synchronously, so each iteration is one complete gathering
+ * from local endpoint resolution to the sorted candidate array. The candidate plan is disabled
+ * through a DNS cache TTL of 0, so every iteration gathers from scratch.
+ *
+ * Allocations are counted by interposing malloc, calloc and realloc in front of glibc, so those
+ * GLib and libc make on behalf of CTaps are included. Freeing the candidates is not measured.
+ *
+ * Links against the internal CTaps objects, since candidate gathering is not exported.
+ *
+ * Usage: candidate_gathering_benchmark [num_alpns] [num_endpoints] [iterations] [--json]
+ */
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include "candidate_gathering/candidate_arena.h"
+#include "candidate_gathering/candidate_gathering.h"
+#include "../common/timing.h"
+#include <arpa/inet.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_NUM_ALPNS 8
+#define DEFAULT_NUM_ENDPOINTS 8
+#define DEFAULT_ITERATIONS 1000
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t num, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static bool counting = false;
+static size_t num_allocations = 0;
+
+void* malloc(size_t size) {
+    num_allocations += counting;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+    num_allocations += counting;
+    return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    num_allocations += counting;
+    return __libc_realloc(ptr, size);
+}
+
+static void capture_candidate_array(GArray* candidate_array, void* context) {
+    *(GArray**)context = candidate_array;
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_alpns = DEFAULT_NUM_ALPNS;
+    size_t num_endpoints = DEFAULT_NUM_ENDPOINTS;
+    size_t iterations = DEFAULT_ITERATIONS;
+    int json_only_mode = 0;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (positional == 0) {
+            num_alpns = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            num_endpoints = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 2) {
+            iterations = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (num_endpoints == 0 || iterations == 0) {
+        fprintf(stderr, "Need at least one endpoint and one iteration\n");
+        return 1;
+    }
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+    ct_set_dns_cache_ttl(0);
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_security_parameters_t* security_parameters = ct_security_parameters_new();
+    for (size_t i = 0; i < num_alpns; i++) {
+        char alpn[32];
+        snprintf(alpn, sizeof(alpn), "alpn-%zu", i);
+        ct_security_parameters_add_alpn(security_parameters, alpn);
+    }
+    ct_remote_endpoint_t** remote_endpoints = calloc(num_endpoints, sizeof(ct_remote_endpoint_t*));
+    if (!remote_endpoints) {
+        fprintf(stderr, "Failed to allocate remote endpoints\n");
+        return 1;
+    }
+    for (size_t i = 0; i < num_endpoints; i++) {
+        char address[INET_ADDRSTRLEN];
+        snprintf(address, sizeof(address), "192.0.2.%zu", i % 254 + 1);
+        remote_endpoints[i] = ct_remote_endpoint_new();
+        ct_remote_endpoint_with_ipv4(remote_endpoints[i], inet_addr(address));
+        ct_remote_endpoint_with_port(remote_endpoints[i], 443);
+    }
+    ct_preconnection_t* preconnection =
+        ct_preconnection_new(NULL, 0, (const ct_remote_endpoint_t**)remote_endpoints,
+                             num_endpoints, transport_properties, security_parameters);
+    if (!preconnection) {
+        fprintf(stderr, "Failed to allocate preconnection\n");
+        return 1;
+    }
+
+    ct_candidate_gathering_callbacks_t callbacks = {
+        .candidate_node_array_ready_cb = capture_candidate_array,
+    };
+    double total_us = 0;
+    size_t total_allocations = 0;
+    size_t num_candidates = 0;
+    size_t num_arena_blocks = 0;
+    timing_t timing;
+    for (size_t it = 0; it < iterations; it++) {
+        GArray* candidates = NULL;
+        callbacks.context = &candidates;
+        num_allocations = 0;
+        counting = true;
+        timing_start(&timing);
+        int rc = ct_get_ordered_candidate_nodes(preconnection, callbacks);
+        timing_end(&timing);
+        counting = false;
+        if (rc != 0 || !candidates) {
+            fprintf(stderr, "Candidate gathering failed: %d\n", rc);
+            return 1;
+        }
+        total_us += timing_get_duration_us(&timing);
+        total_allocations += num_allocations;
+        num_candidates = candidates->len;
+        if (candidates->len > 0) {
+            ct_candidate_arena_t* arena = g_array_index(candidates, ct_candidate_node_t, 0).arena;
+            num_arena_blocks = arena ? ct_candidate_arena_num_blocks(arena) : 0;
+        }
+        free_candidate_array(candidates);
+    }
+
+    double num_runs = (double)iterations;
+    if (json_only_mode) {
+        printf("{\"candidates\": %zu, \"gather_us\": %.3f, \"allocations\": %.1f, "
+               "\"arena_blocks\": %zu}\n",
+               num_candidates, total_us / num_runs, (double)total_allocations / num_runs,
+               num_arena_blocks);
+    } else {
+        printf("Candidates:           %zu (%zu ALPNs, %zu endpoints)\n", num_candidates,
+               num_alpns, num_endpoints);
+        printf("Gathering:            %.3f us\n", total_us / num_runs);
+        printf("Allocations:          %.1f per gathering\n",
+               (double)total_allocations / num_runs);
+        printf("Arena blocks:         %zu\n", num_arena_blocks);
+    }
+
+    ct_preconnection_free(preconnection);
+    for (size_t i = 0; i < num_endpoints; i++) {
+        ct_remote_endpoint_free(remote_endpoints[i]);
+    }
+    free(remote_endpoints);
+    ct_security_parameters_free(security_parameters);
+    ct_transport_properties_free(transport_properties);
+    ct_close();
+    return 0;
+}
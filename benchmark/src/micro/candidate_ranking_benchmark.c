@@ -0,0 +1,257 @@
+/*
+ * Measures how long pruning and ranking take for candidate sets with many protocols and ALPNs.
+ *
+ * Builds num_protocols protocol implementations, derived from the registered ones with a few
+ * selection properties changed, and one candidate per protocol, ALPN and remote endpoint. Each
+ * iteration checks every candidate for compatibility with the preconnection and sorts the
+ * candidates, once with the compiled selection masks used by candidate gathering and once by
+ * walking ct_selection_properties_t::list as a reference.
+ *
+ * Links against the internal CTaps objects, since candidate gathering is not exported.
+ *
+ * Usage: candidate_ranking_benchmark [num_protocols] [num_alpns] [num_endpoints] [iterations]
+ *                                    [--json]
+ */
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include "candidate_gathering/candidate_gathering.h"
+#include "transport_property/selection_properties/selection_properties.h"
+#include "../common/timing.h"
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_NUM_PROTOCOLS 32
+#define DEFAULT_NUM_ALPNS 16
+#define DEFAULT_NUM_ENDPOINTS 4
+#define DEFAULT_ITERATIONS 200
+
+static const ct_selection_property_enum_t varied_properties[] = {
+    PRESERVE_MSG_BOUNDARIES, PER_MSG_RELIABILITY, ZERO_RTT_MSG, MULTISTREAMING, KEEP_ALIVE,
+    SOFT_ERROR_NOTIFY,
+};
+static const ct_selection_preference_enum_t capability_values[] = {PROHIBIT, NO_PREFERENCE,
+                                                                   REQUIRE};
+
+static bool list_walk_compatible(const ct_protocol_impl_t* protocol,
+                                 const ct_selection_properties_t* selection_properties) {
+    for (int i = 0; i < SELECTION_PROPERTY_END; i++) {
+        ct_selection_property_t desired_value = selection_properties->list[i];
+        ct_selection_property_t protocol_value = protocol->selection_properties.list[i];
+        if (desired_value.type != TYPE_PREFERENCE) {
+            continue;
+        }
+        if (desired_value.value.simple_preference == REQUIRE &&
+            protocol_value.value.simple_preference == PROHIBIT) {
+            return false;
+        }
+        if (desired_value.value.simple_preference == PROHIBIT &&
+            protocol_value.value.simple_preference == REQUIRE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static gint list_walk_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const ct_selection_properties_t* selection_properties = user_data;
+    const ct_protocol_impl_t* a_impl =
+        ((const ct_candidate_node_t*)a)->protocol_candidate->protocol_impl;
+    const ct_protocol_impl_t* b_impl =
+        ((const ct_candidate_node_t*)b)->protocol_candidate->protocol_impl;
+    int prefer_score = 0;
+    int avoid_score = 0;
+    for (int i = 0; i < SELECTION_PROPERTY_END; i++) {
+        if (selection_properties->list[i].type != TYPE_PREFERENCE) {
+            continue;
+        }
+        ct_selection_preference_enum_t desired =
+            selection_properties->list[i].value.simple_preference;
+        ct_selection_preference_enum_t a_value =
+            a_impl->selection_properties.list[i].value.simple_preference;
+        ct_selection_preference_enum_t b_value =
+            b_impl->selection_properties.list[i].value.simple_preference;
+        if (desired == PREFER) {
+            prefer_score += (a_value != PROHIBIT) - (b_value != PROHIBIT);
+        } else if (desired == AVOID) {
+            avoid_score += (a_value != REQUIRE) - (b_value != REQUIRE);
+        }
+    }
+    return prefer_score != 0 ? -prefer_score : -avoid_score;
+}
+
+typedef struct {
+    double prune_us;
+    double sort_us;
+    size_t num_compatible;
+} ranking_result_t;
+
+static ranking_result_t run_masks(const GArray* candidates, GArray* scratch,
+                                  const ct_selection_masks_t* desired, size_t iterations) {
+    ranking_result_t result = {0};
+    timing_t timing;
+    for (size_t it = 0; it < iterations; it++) {
+        timing_start(&timing);
+        size_t num_compatible = 0;
+        for (guint i = 0; i < candidates->len; i++) {
+            const ct_candidate_node_t* node = &g_array_index(candidates, ct_candidate_node_t, i);
+            num_compatible +=
+                ct_selection_masks_compatible(desired, &node->protocol_candidate->capabilities);
+        }
+        timing_end(&timing);
+        result.prune_us += timing_get_duration_us(&timing);
+        result.num_compatible = num_compatible;
+
+        g_array_set_size(scratch, 0);
+        g_array_append_vals(scratch, candidates->data, candidates->len);
+        timing_start(&timing);
+        g_array_sort_with_data(scratch, compare_prefer_and_avoid_preferences, (gpointer)desired);
+        timing_end(&timing);
+        result.sort_us += timing_get_duration_us(&timing);
+    }
+    return result;
+}
+
+static ranking_result_t run_list_walk(const GArray* candidates, GArray* scratch,
+                                      const ct_selection_properties_t* desired,
+                                      size_t iterations) {
+    ranking_result_t result = {0};
+    timing_t timing;
+    for (size_t it = 0; it < iterations; it++) {
+        timing_start(&timing);
+        size_t num_compatible = 0;
+        for (guint i = 0; i < candidates->len; i++) {
+            const ct_candidate_node_t* node = &g_array_index(candidates, ct_candidate_node_t, i);
+            num_compatible +=
+                list_walk_compatible(node->protocol_candidate->protocol_impl, desired);
+        }
+        timing_end(&timing);
+        result.prune_us += timing_get_duration_us(&timing);
+        result.num_compatible = num_compatible;
+
+        g_array_set_size(scratch, 0);
+        g_array_append_vals(scratch, candidates->data, candidates->len);
+        timing_start(&timing);
+        g_array_sort_with_data(scratch, list_walk_compare, (gpointer)desired);
+        timing_end(&timing);
+        result.sort_us += timing_get_duration_us(&timing);
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_protocols = DEFAULT_NUM_PROTOCOLS;
+    size_t num_alpns = DEFAULT_NUM_ALPNS;
+    size_t num_endpoints = DEFAULT_NUM_ENDPOINTS;
+    size_t iterations = DEFAULT_ITERATIONS;
+    int json_only_mode = 0;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (positional == 0) {
+            num_protocols = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            num_alpns = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 2) {
+            num_endpoints = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 3) {
+            iterations = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (num_protocols == 0 || num_alpns == 0 || num_endpoints == 0 || iterations == 0) {
+        fprintf(stderr, "All counts must be positive\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    // Fixed seed, so runs are comparable
+    srand(42);
+    ct_protocol_impl_t* protocols = calloc(num_protocols, sizeof(ct_protocol_impl_t));
+    if (!protocols) {
+        fprintf(stderr, "Failed to allocate protocols\n");
+        return 1;
+    }
+    size_t num_varied = sizeof(varied_properties) / sizeof(varied_properties[0]);
+    for (size_t i = 0; i < num_protocols; i++) {
+        protocols[i] = *ct_supported_protocols[i % ct_num_protocols];
+        for (size_t j = 0; j < num_varied; j++) {
+            protocols[i].selection_properties.list[varied_properties[j]].value.simple_preference =
+                capability_values[rand() % 3];
+        }
+    }
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_preserve_msg_boundaries(transport_properties, PREFER);
+    ct_transport_properties_set_multistreaming(transport_properties, PREFER);
+    ct_transport_properties_set_keep_alive(transport_properties, PREFER);
+    ct_transport_properties_set_zero_rtt_msg(transport_properties, AVOID);
+    ct_transport_properties_set_soft_error_notify(transport_properties, AVOID);
+    ct_selection_masks_t desired_masks;
+    ct_selection_masks_compile(&transport_properties->selection_properties, &desired_masks);
+
+    // The comparators only look at protocol candidates, endpoints repeat the protocol set
+    GArray* candidates = g_array_new(false, false, sizeof(ct_candidate_node_t));
+    for (size_t e = 0; e < num_endpoints; e++) {
+        for (size_t p = 0; p < num_protocols; p++) {
+            for (size_t a = 0; a < num_alpns; a++) {
+                char alpn[32];
+                snprintf(alpn, sizeof(alpn), "alpn-%zu", a);
+                ct_candidate_node_t node = {
+                    .type = NODE_TYPE_ENDPOINT,
+                    .protocol_candidate = ct_protocol_candidate_new(&protocols[p], alpn),
+                    .transport_properties = transport_properties,
+                };
+                if (!node.protocol_candidate) {
+                    fprintf(stderr, "Failed to allocate protocol candidate\n");
+                    return 1;
+                }
+                g_array_append_val(candidates, node);
+            }
+        }
+    }
+    GArray* scratch = g_array_sized_new(false, false, sizeof(ct_candidate_node_t), candidates->len);
+
+    ranking_result_t masks = run_masks(candidates, scratch, &desired_masks, iterations);
+    ranking_result_t list_walk = run_list_walk(
+        candidates, scratch, &transport_properties->selection_properties, iterations);
+    if (masks.num_compatible != list_walk.num_compatible) {
+        fprintf(stderr, "Masks found %zu compatible candidates, list walk %zu\n",
+                masks.num_compatible, list_walk.num_compatible);
+    }
+
+    double num_runs = (double)iterations;
+    if (json_only_mode) {
+        printf("{\"candidates\": %u, \"compatible\": %zu, \"masks_prune_us\": %.3f, "
+               "\"masks_sort_us\": %.3f, \"list_walk_prune_us\": %.3f, "
+               "\"list_walk_sort_us\": %.3f}\n",
+               candidates->len, masks.num_compatible, masks.prune_us / num_runs,
+               masks.sort_us / num_runs, list_walk.prune_us / num_runs,
+               list_walk.sort_us / num_runs);
+    } else {
+        printf("Candidates:           %u (%zu protocols x %zu ALPNs x %zu endpoints)\n",
+               candidates->len, num_protocols, num_alpns, num_endpoints);
+        printf("Compatible:           %zu\n", masks.num_compatible);
+        printf("Masks prune:          %.3f us\n", masks.prune_us / num_runs);
+        printf("Masks sort:           %.3f us\n", masks.sort_us / num_runs);
+        printf("List walk prune:      %.3f us\n", list_walk.prune_us / num_runs);
+        printf("List walk sort:       %.3f us\n", list_walk.sort_us / num_runs);
+    }
+
+    g_array_free(scratch, true);
+    for (guint i = 0; i < candidates->len; i++) {
+        ct_protocol_candidate_free(
+            g_array_index(candidates, ct_candidate_node_t, i).protocol_candidate);
+    }
+    g_array_free(candidates, true);
+    ct_transport_properties_free(transport_properties);
+    free(protocols);
+    return masks.num_compatible == list_walk.num_compatible ? 0 : 1;
+}
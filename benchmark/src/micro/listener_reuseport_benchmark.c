@@ -0,0 +1,301 @@
+/*
+ * Measures how many TCP connections per second CTaps listeners sharing a port accept.
+ *
+ * num_processes server processes each listen on the same loopback port with listenerReusePort,
+ * so the kernel spreads incoming connections over the SO_REUSEPORT sockets of all processes.
+ * Each process runs its own event loop, which is how accepting scales over cores. The listener
+ * closes every connection it receives right away.
+ *
+ * num_threads client threads connect in a loop for duration_s seconds. A connection counts once
+ * the client has seen the listener close it, so it was accepted and handled.
+ *
+ * --cpu-affinity pins server process i to CPU i modulo the online CPUs and sets
+ * listenerCpuAffinity, so each socket prefers the flows received on its process's CPU.
+ *
+ * Usage: listener_reuseport_benchmark [port] [num_processes] [duration_s] [num_threads]
+ *                                     [--cpu-affinity] [--json]
+ */
+#include "ctaps.h"
+#include "../common/timing.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_REUSEPORT_PORT 4437
+#define DEFAULT_NUM_PROCESSES 4
+#define DEFAULT_DURATION_S 5
+#define DEFAULT_NUM_THREADS 8
+#define LISTENER_STARTUP_TIMEOUT_MS 5000
+
+typedef struct {
+    uint16_t port;
+    volatile bool* stop;
+    uint64_t num_connections;
+    uint64_t num_errors;
+} client_thread_t;
+
+static void on_connection_received(ct_listener_t* listener, ct_connection_t* connection) {
+    (void)listener;
+    ct_connection_close(connection);
+}
+
+static void free_on_close(ct_connection_t* connection) {
+    ct_connection_free(connection);
+}
+
+static void on_listener_error(ct_listener_t* listener, int error_code) {
+    (void)listener;
+    fprintf(stderr, "ERROR: Listener failed: %d\n", error_code);
+    exit(1);
+}
+
+static void pin_to_cpu(size_t server_index) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus <= 0) {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(server_index % (size_t)num_cpus, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        perror("sched_setaffinity");
+    }
+}
+
+// Runs in a forked server process until the parent kills it
+static void run_server(uint16_t port, size_t server_index, bool cpu_affinity) {
+    if (cpu_affinity) {
+        pin_to_cpu(server_index);
+    }
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        exit(1);
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, PROHIBIT);
+    ct_transport_properties_set_listener_reuse_port(transport_properties, true);
+    ct_transport_properties_set_listener_cpu_affinity(transport_properties, cpu_affinity);
+
+    ct_local_endpoint_t* listener_endpoint = ct_local_endpoint_new();
+    ct_local_endpoint_with_ipv4(listener_endpoint, inet_addr("127.0.0.1"));
+    ct_local_endpoint_with_port(listener_endpoint, port);
+
+    ct_remote_endpoint_t* any_remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(any_remote, "127.0.0.1");
+
+    ct_preconnection_t* preconnection =
+        ct_preconnection_new((const ct_local_endpoint_t**)&listener_endpoint, 1,
+                             (const ct_remote_endpoint_t**)&any_remote, 1, transport_properties,
+                             NULL);
+    if (!preconnection) {
+        fprintf(stderr, "ERROR: Failed to allocate preconnection\n");
+        exit(1);
+    }
+
+    ct_listener_callbacks_t listener_callbacks = {
+        .connection_received = on_connection_received,
+        .establishment_error = on_listener_error,
+    };
+    ct_connection_callbacks_t connection_callbacks = {
+        .closed = free_on_close,
+    };
+    int rc = ct_preconnection_listen(preconnection, &listener_callbacks, &connection_callbacks);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to start listener: %d\n", rc);
+        exit(1);
+    }
+
+    ct_start_event_loop();
+    exit(0);
+}
+
+static int connect_to_port(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = htons(port),
+    };
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Wait until the listener closes the connection, which it does once it accepted it
+static bool wait_for_close(int fd) {
+    char byte;
+    ssize_t nread;
+    while ((nread = read(fd, &byte, sizeof(byte))) > 0) {
+    }
+    return nread == 0;
+}
+
+static bool wait_for_listener(uint16_t port) {
+    uint64_t deadline = timing_get_timestamp_us() + LISTENER_STARTUP_TIMEOUT_MS * 1000ULL;
+    while (timing_get_timestamp_us() < deadline) {
+        int fd = connect_to_port(port);
+        if (fd >= 0) {
+            wait_for_close(fd);
+            close(fd);
+            return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+static void* run_client(void* arg) {
+    client_thread_t* thread = arg;
+    while (!*thread->stop) {
+        int fd = connect_to_port(thread->port);
+        if (fd < 0) {
+            thread->num_errors++;
+            continue;
+        }
+        if (wait_for_close(fd)) {
+            thread->num_connections++;
+        } else {
+            thread->num_errors++;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+static void stop_servers(const pid_t* servers, size_t num_servers) {
+    for (size_t i = 0; i < num_servers; i++) {
+        kill(servers[i], SIGTERM);
+    }
+    for (size_t i = 0; i < num_servers; i++) {
+        waitpid(servers[i], NULL, 0);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int port = DEFAULT_REUSEPORT_PORT;
+    size_t num_processes = DEFAULT_NUM_PROCESSES;
+    int duration_s = DEFAULT_DURATION_S;
+    size_t num_threads = DEFAULT_NUM_THREADS;
+    bool cpu_affinity = false;
+    int json_only_mode = 0;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (strcmp(argv[i], "--cpu-affinity") == 0) {
+            cpu_affinity = true;
+        } else if (positional == 0) {
+            port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            num_processes = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 2) {
+            duration_s = atoi(argv[i]);
+            positional++;
+        } else if (positional == 3) {
+            num_threads = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (num_processes == 0 || num_threads == 0 || duration_s <= 0) {
+        fprintf(stderr, "Processes, duration and threads must all be positive\n");
+        return 1;
+    }
+
+    pid_t* servers = calloc(num_processes, sizeof(pid_t));
+    client_thread_t* threads = calloc(num_threads, sizeof(client_thread_t));
+    pthread_t* thread_ids = calloc(num_threads, sizeof(pthread_t));
+    if (!servers || !threads || !thread_ids) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+
+    size_t num_servers = 0;
+    for (; num_servers < num_processes; num_servers++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            stop_servers(servers, num_servers);
+            return 1;
+        }
+        if (pid == 0) {
+            run_server((uint16_t)port, num_servers, cpu_affinity);
+        }
+        servers[num_servers] = pid;
+    }
+
+    if (!wait_for_listener((uint16_t)port)) {
+        fprintf(stderr, "ERROR: Listener did not come up on port %d\n", port);
+        stop_servers(servers, num_servers);
+        return 1;
+    }
+
+    volatile bool stop = false;
+    timing_t run_time;
+    timing_start(&run_time);
+    for (size_t i = 0; i < num_threads; i++) {
+        threads[i].port = (uint16_t)port;
+        threads[i].stop = &stop;
+        if (pthread_create(&thread_ids[i], NULL, run_client, &threads[i]) != 0) {
+            fprintf(stderr, "ERROR: Failed to start client thread\n");
+            stop = true;
+            num_threads = i;
+            break;
+        }
+    }
+    sleep((unsigned int)duration_s);
+    stop = true;
+    uint64_t num_connections = 0;
+    uint64_t num_errors = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        pthread_join(thread_ids[i], NULL);
+        num_connections += threads[i].num_connections;
+        num_errors += threads[i].num_errors;
+    }
+    timing_end(&run_time);
+    stop_servers(servers, num_servers);
+
+    double elapsed_s = timing_get_duration_ms(&run_time) / 1000.0;
+    double connections_per_s = elapsed_s > 0 ? (double)num_connections / elapsed_s : 0;
+    if (json_only_mode) {
+        printf("{\"processes\": %zu, \"threads\": %zu, \"cpu_affinity\": %s, "
+               "\"duration_s\": %.3f, \"connections\": %lu, \"errors\": %lu, "
+               "\"connections_per_s\": %.1f}\n",
+               num_processes, num_threads, cpu_affinity ? "true" : "false", elapsed_s,
+               num_connections, num_errors, connections_per_s);
+    } else {
+        printf("Server processes:   %zu\n", num_processes);
+        printf("Client threads:     %zu\n", num_threads);
+        printf("CPU affinity:       %s\n", cpu_affinity ? "on" : "off");
+        printf("Duration:           %.3f s\n", elapsed_s);
+        printf("Connections:        %lu\n", num_connections);
+        printf("Errors:             %lu\n", num_errors);
+        printf("Connections/s:      %.1f\n", connections_per_s);
+    }
+
+    free(servers);
+    free(threads);
+    free(thread_ids);
+    return 0;
+}
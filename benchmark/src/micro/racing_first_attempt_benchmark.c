@@ -0,0 +1,236 @@
+/*
+ * Measures the time from initiating a preconnection to its first connection attempt starting.
+ *
+ * Races num_endpoints IPv4 loopback literals (127.0.0.1, 127.0.0.2, ...), which resolve
+ * synchronously, so ct_preconnection_initiate() returns once the candidates are ranked and the
+ * first attempt is started. The number of candidates is the number of endpoints times the number
+ * of local interfaces. Every endpoint reaches a TCP socket this benchmark listens on, so the first
+ * attempt succeeds and the remaining ones are canceled before the next iteration.
+ *
+ * Usage: racing_first_attempt_benchmark [num_endpoints] [iterations] [--json]
+ */
+#include "ctaps.h"
+#include "../common/timing.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_ENDPOINTS 256
+#define DEFAULT_ITERATIONS 100
+
+typedef struct {
+    ct_preconnection_t* preconnection;
+    ct_connection_callbacks_t connection_callbacks;
+    int listen_fd;
+
+    size_t iterations;
+    size_t num_completed;
+    double* first_attempt_us;
+    double* connect_ms;
+    timing_t current;
+    bool failed;
+} racing_benchmark_t;
+
+// establishment_error() gets no connection when racing fails
+static racing_benchmark_t* benchmark = NULL;
+
+static void start_next_race(racing_benchmark_t* ctx);
+
+static void on_connection_ready(ct_connection_t* connection) {
+    racing_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    timing_end(&ctx->current);
+    ctx->connect_ms[ctx->num_completed++] = timing_get_duration_ms(&ctx->current);
+    ct_connection_close(connection);
+}
+
+static void on_establishment_error(ct_connection_t* connection) {
+    fprintf(stderr, "Connection establishment error occurred\n");
+    ct_connection_free(connection);
+    benchmark->failed = true;
+}
+
+static void on_closed(ct_connection_t* connection) {
+    racing_benchmark_t* ctx = ct_connection_get_callback_context(connection);
+    ct_connection_free(connection);
+    // Nothing is read from the accepted connections
+    int fd;
+    while ((fd = accept(ctx->listen_fd, NULL, NULL)) >= 0) {
+        close(fd);
+    }
+    if (ctx->failed || ctx->num_completed == ctx->iterations) {
+        return;
+    }
+    start_next_race(ctx);
+}
+
+static void start_next_race(racing_benchmark_t* ctx) {
+    timing_t initiate;
+    timing_start(&ctx->current);
+    timing_start(&initiate);
+    int rc = ct_preconnection_initiate(ctx->preconnection, &ctx->connection_callbacks);
+    timing_end(&initiate);
+    if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to initiate preconnection: %d\n", rc);
+        ctx->failed = true;
+        return;
+    }
+    ctx->first_attempt_us[ctx->num_completed] = timing_get_duration_us(&initiate);
+}
+
+static int listen_on_loopback(uint16_t* port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = 0,
+    };
+    socklen_t address_len = sizeof(address);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0 ||
+        getsockname(fd, (struct sockaddr*)&address, &address_len) != 0 ||
+        fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(address.sin_port);
+    return fd;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double mean_of(const double* values, size_t num_values) {
+    double sum = 0;
+    for (size_t i = 0; i < num_values; i++) {
+        sum += values[i];
+    }
+    return num_values > 0 ? sum / (double)num_values : 0;
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_endpoints = DEFAULT_NUM_ENDPOINTS;
+    int json_only_mode = 0;
+    racing_benchmark_t ctx = {0};
+    ctx.iterations = DEFAULT_ITERATIONS;
+    benchmark = &ctx;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json_only_mode = 1;
+        } else if (positional == 0) {
+            num_endpoints = (size_t)atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            ctx.iterations = (size_t)atoi(argv[i]);
+            positional++;
+        }
+    }
+    if (num_endpoints == 0 || num_endpoints > 254 * 254 || ctx.iterations == 0) {
+        fprintf(stderr, "Need 1 to %d endpoints and at least one iteration\n", 254 * 254);
+        return 1;
+    }
+    ctx.first_attempt_us = calloc(ctx.iterations, sizeof(double));
+    ctx.connect_ms = calloc(ctx.iterations, sizeof(double));
+    if (!ctx.first_attempt_us || !ctx.connect_ms) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return 1;
+    }
+
+    uint16_t port = 0;
+    ctx.listen_fd = listen_on_loopback(&port);
+    if (ctx.listen_fd < 0) {
+        fprintf(stderr, "Failed to listen on loopback\n");
+        return 1;
+    }
+
+    if (ct_initialize() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize CTaps\n");
+        return 1;
+    }
+    ct_set_log_level(CT_LOG_WARN);
+
+    // TCP only, nothing answers QUIC on the loopback port
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_reliability(transport_properties, REQUIRE);
+    ct_transport_properties_set_multistreaming(transport_properties, PROHIBIT);
+
+    ct_remote_endpoint_t** remote_endpoints = calloc(num_endpoints, sizeof(ct_remote_endpoint_t*));
+    if (!remote_endpoints) {
+        fprintf(stderr, "Failed to allocate remote endpoints\n");
+        return 1;
+    }
+    for (size_t i = 0; i < num_endpoints; i++) {
+        char address[INET_ADDRSTRLEN];
+        snprintf(address, sizeof(address), "127.0.%zu.%zu", i / 254, i % 254 + 1);
+        remote_endpoints[i] = ct_remote_endpoint_new();
+        ct_remote_endpoint_with_ipv4(remote_endpoints[i], inet_addr(address));
+        ct_remote_endpoint_with_port(remote_endpoints[i], port);
+    }
+    ctx.preconnection =
+        ct_preconnection_new(NULL, 0, (const ct_remote_endpoint_t**)remote_endpoints,
+                             num_endpoints, transport_properties, NULL);
+    if (!ctx.preconnection) {
+        fprintf(stderr, "Failed to allocate preconnection\n");
+        return 1;
+    }
+
+    ct_connection_callbacks_t connection_callbacks = {
+        .ready = on_connection_ready,
+        .establishment_error = on_establishment_error,
+        .closed = on_closed,
+        .per_connection_context = &ctx,
+    };
+    ctx.connection_callbacks = connection_callbacks;
+
+    start_next_race(&ctx);
+
+    ct_start_event_loop();
+
+    size_t num_measured = ctx.num_completed;
+    double first_attempt_mean = mean_of(ctx.first_attempt_us, num_measured);
+    double connect_mean = mean_of(ctx.connect_ms, num_measured);
+    qsort(ctx.first_attempt_us, num_measured, sizeof(double), compare_doubles);
+    double first_attempt_median = num_measured > 0 ? ctx.first_attempt_us[num_measured / 2] : 0;
+    double first_attempt_p99 =
+        num_measured > 0 ? ctx.first_attempt_us[(num_measured * 99) / 100] : 0;
+
+    if (json_only_mode) {
+        printf("{\"endpoints\": %zu, \"races\": %zu, \"first_attempt_mean_us\": %.3f, "
+               "\"first_attempt_median_us\": %.3f, \"first_attempt_p99_us\": %.3f, "
+               "\"connect_mean_ms\": %.3f}\n",
+               num_endpoints, num_measured, first_attempt_mean, first_attempt_median,
+               first_attempt_p99, connect_mean);
+    } else {
+        printf("Remote endpoints:     %zu\n", num_endpoints);
+        printf("Races:                %zu\n", num_measured);
+        printf("First attempt mean:   %.3f us\n", first_attempt_mean);
+        printf("First attempt median: %.3f us\n", first_attempt_median);
+        printf("First attempt p99:    %.3f us\n", first_attempt_p99);
+        printf("Connect mean:         %.3f ms\n", connect_mean);
+    }
+
+    ct_preconnection_free(ctx.preconnection);
+    for (size_t i = 0; i < num_endpoints; i++) {
+        ct_remote_endpoint_free(remote_endpoints[i]);
+    }
+    free(remote_endpoints);
+    ct_transport_properties_free(transport_properties);
+    ct_close();
+    close(ctx.listen_fd);
+    free(ctx.first_attempt_us);
+    free(ctx.connect_ms);
+    return ctx.failed ? 1 : 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Minimal DNS stub resolver with separately delayed A and AAAA answers.
+ *
+ * Answers every A query with --a-address and every AAAA query with --aaaa-address, after
+ * --a-delay-ms and --aaaa-delay-ms respectively. Other query types get an empty answer. The
+ * default AAAA answer is the IPv4-mapped loopback address, so attempts over IPv6 sockets reach
+ * the IPv4-only benchmark servers.
+ *
+ * getaddrinfo() only asks the nameservers in /etc/resolv.conf on port 53, so run this together
+ * with the client in a namespace of its own, for example:
+ *
+ *   unshare --map-root-user --net --mount sh -c '
+ *       ip link set lo up
+ *       echo "nameserver 127.0.0.1" > /tmp/resolv.conf
+ *       mount --bind /tmp/resolv.conf /etc/resolv.conf
+ *       ./dns_stub_server --aaaa-delay-ms 300 & ./tcp_benchmark_server &
+ *       sleep 1; ./taps_benchmark_dns_race_client benchmark.test'
+ *
+ * Usage: dns_stub_server [--port port] [--a-delay-ms ms] [--aaaa-delay-ms ms]
+ *                        [--a-address addr] [--aaaa-address addr]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DNS_PORT 53
+#define BUF_SIZE 512
+#define MAX_DELAYED_ANSWERS 256
+#define DNS_HEADER_SIZE 12
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+#define DNS_CLASS_IN 1
+
+typedef struct {
+    uint64_t due_ms;
+    struct sockaddr_in destination;
+    uint8_t answer[BUF_SIZE];
+    size_t answer_length;
+} delayed_answer_t;
+
+static volatile sig_atomic_t keep_running = 1;
+
+static delayed_answer_t delayed_answers[MAX_DELAYED_ANSWERS];
+static size_t num_delayed_answers = 0;
+
+static void handle_sigint(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static void put_u16(uint8_t* buf, uint16_t value) {
+    buf[0] = (uint8_t)(value >> 8);
+    buf[1] = (uint8_t)(value & 0xff);
+}
+
+static uint16_t get_u16(const uint8_t* buf) {
+    return (uint16_t)((buf[0] << 8) | buf[1]);
+}
+
+/*
+ * Builds the answer to a single question query in place, returns its length or 0 if the query
+ * should be ignored. Sets *qtype to the type that was asked for.
+ */
+static size_t build_answer(uint8_t* buf, size_t length, const struct in_addr* a_address,
+                           const struct in6_addr* aaaa_address, uint16_t* qtype) {
+    if (length < DNS_HEADER_SIZE || get_u16(buf + 4) != 1 || (buf[2] & 0x80)) {
+        return 0;
+    }
+    size_t offset = DNS_HEADER_SIZE;
+    while (offset < length && buf[offset] != 0) {
+        if (buf[offset] & 0xc0) {
+            return 0; // No compression in questions
+        }
+        offset += buf[offset] + 1;
+    }
+    offset++; // Terminating zero label
+    if (offset + 4 > length) {
+        return 0;
+    }
+    *qtype = get_u16(buf + offset);
+    uint16_t qclass = get_u16(buf + offset + 2);
+    offset += 4;
+
+    size_t rdata_length = 0;
+    const void* rdata = NULL;
+    if (qclass == DNS_CLASS_IN && *qtype == DNS_TYPE_A) {
+        rdata_length = sizeof(*a_address);
+        rdata = a_address;
+    } else if (qclass == DNS_CLASS_IN && *qtype == DNS_TYPE_AAAA) {
+        rdata_length = sizeof(*aaaa_address);
+        rdata = aaaa_address;
+    }
+
+    // Response, recursion desired and available, no error
+    buf[2] = 0x81;
+    buf[3] = 0x80;
+    put_u16(buf + 6, rdata ? 1 : 0); // ANCOUNT
+    put_u16(buf + 8, 0);             // NSCOUNT
+    put_u16(buf + 10, 0);            // ARCOUNT
+    if (!rdata) {
+        return offset;
+    }
+    if (offset + 12 + rdata_length > BUF_SIZE) {
+        return 0;
+    }
+    uint8_t* answer = buf + offset;
+    put_u16(answer, 0xc000 | DNS_HEADER_SIZE); // Name points at the question
+    put_u16(answer + 2, *qtype);
+    put_u16(answer + 4, DNS_CLASS_IN);
+    memset(answer + 6, 0, 4); // TTL 0, the client decides how long to cache
+    put_u16(answer + 10, (uint16_t)rdata_length);
+    memcpy(answer + 12, rdata, rdata_length);
+    return offset + 12 + rdata_length;
+}
+
+static void send_due_answers(int sock) {
+    uint64_t now = now_ms();
+    size_t kept = 0;
+    for (size_t i = 0; i < num_delayed_answers; i++) {
+        delayed_answer_t* delayed = &delayed_answers[i];
+        if (delayed->due_ms > now) {
+            delayed_answers[kept++] = *delayed;
+            continue;
+        }
+        if (sendto(sock, delayed->answer, delayed->answer_length, 0,
+                   (struct sockaddr*)&delayed->destination, sizeof(delayed->destination)) < 0) {
+            perror("sendto");
+        }
+    }
+    num_delayed_answers = kept;
+}
+
+static int next_poll_timeout_ms(void) {
+    if (num_delayed_answers == 0) {
+        return -1;
+    }
+    uint64_t now = now_ms();
+    uint64_t next_due = delayed_answers[0].due_ms;
+    for (size_t i = 1; i < num_delayed_answers; i++) {
+        if (delayed_answers[i].due_ms < next_due) {
+            next_due = delayed_answers[i].due_ms;
+        }
+    }
+    return next_due > now ? (int)(next_due - now) : 0;
+}
+
+int main(int argc, char* argv[]) {
+    int port = DNS_PORT;
+    int a_delay_ms = 0;
+    int aaaa_delay_ms = 0;
+    const char* a_address_str = "127.0.0.1";
+    const char* aaaa_address_str = "::ffff:127.0.0.1";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--a-delay-ms") == 0 && i + 1 < argc) {
+            a_delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--aaaa-delay-ms") == 0 && i + 1 < argc) {
+            aaaa_delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--a-address") == 0 && i + 1 < argc) {
+            a_address_str = argv[++i];
+        } else if (strcmp(argv[i], "--aaaa-address") == 0 && i + 1 < argc) {
+            aaaa_address_str = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    struct in_addr a_address;
+    struct in6_addr aaaa_address;
+    if (inet_pton(AF_INET, a_address_str, &a_address) != 1 ||
+        inet_pton(AF_INET6, aaaa_address_str, &aaaa_address) != 1) {
+        fprintf(stderr, "Invalid answer address\n");
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(sock);
+        return 1;
+    }
+
+    signal(SIGINT, handle_sigint);
+    printf("DNS stub listening on 127.0.0.1:%d, A after %d ms, AAAA after %d ms\n", port,
+           a_delay_ms, aaaa_delay_ms);
+    fflush(stdout);
+
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    while (keep_running) {
+        int ready = poll(&pfd, 1, next_poll_timeout_ms());
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        send_due_answers(sock);
+        if (ready == 0 || !(pfd.revents & POLLIN)) {
+            continue;
+        }
+
+        delayed_answer_t delayed;
+        socklen_t srclen = sizeof(delayed.destination);
+        ssize_t r = recvfrom(sock, delayed.answer, sizeof(delayed.answer), 0,
+                             (struct sockaddr*)&delayed.destination, &srclen);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("recvfrom");
+            break;
+        }
+        uint16_t qtype = 0;
+        delayed.answer_length =
+            build_answer(delayed.answer, (size_t)r, &a_address, &aaaa_address, &qtype);
+        if (delayed.answer_length == 0) {
+            continue;
+        }
+        int delay_ms = qtype == DNS_TYPE_AAAA ? aaaa_delay_ms : qtype == DNS_TYPE_A ? a_delay_ms : 0;
+        if (num_delayed_answers == MAX_DELAYED_ANSWERS) {
+            fprintf(stderr, "Too many delayed answers, dropping query\n");
+            continue;
+        }
+        delayed.due_ms = now_ms() + (uint64_t)delay_ms;
+        delayed_answers[num_delayed_answers++] = delayed;
+        send_due_answers(sock);
+    }
+
+    close(sock);
+    return 0;
+}
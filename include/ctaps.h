@@ -21,6 +21,9 @@
 
 #define CT_CONNECTION_DEFAULT_PRIORITY 100
 
+// Higher values are higher priority, unlike connection priority (RFC 9622)
+#define CT_MESSAGE_DEFAULT_PRIORITY 100
+
 /**
  * @ingroup connection
  * @struct ct_connection_t
@@ -164,6 +167,34 @@ CT_EXTERN void ct_set_log_level(ct_log_level_enum_t level);
  */
 CT_EXTERN int ct_add_log_file(const char* file_path, ct_log_level_enum_t min_level);
 
+/**
+ * @brief Set how long resolved hostnames and service ports are cached.
+ *
+ * Initiating a connection to a hostname resolves it through the system resolver on the libuv
+ * thread pool. Answers are cached for ttl_ms per hostname, service and address family, and
+ * concurrent lookups of the same name share a single query. Failed lookups are not cached.
+ * The system resolver does not report record TTLs, so ttl_ms is used for every entry.
+ * Defaults to 30 seconds.
+ *
+ * @param[in] ttl_ms Lifetime of cached answers, 0 to bypass the cache and clear it
+ *
+ * @note This can be called before ct_initialize() or at any time during execution
+ */
+CT_EXTERN void ct_set_dns_cache_ttl(uint32_t ttl_ms);
+
+/**
+ * @brief Fix how long racing waits for a connection attempt before starting the next one.
+ *
+ * By default the delay is derived from the RTTs of earlier connections to the same remote
+ * address (SRTT + 4 * RTTVAR, between 10 ms and 2 seconds as RFC 8305 allows), and is 250 ms
+ * for addresses without recent history.
+ *
+ * @param[in] delay_ms Delay between connection attempts, 0 to derive it from RTT history again
+ *
+ * @note This can be called before ct_initialize() or at any time during execution
+ */
+CT_EXTERN void ct_set_connection_attempt_delay(uint32_t delay_ms);
+
 // =============================================================================
 // Selection Properties - Transport property preferences for protocol selection
 // =============================================================================
@@ -305,6 +336,21 @@ typedef enum {
     CT_CAPACITY_PROFILE_CAPACITY_SEEKING             ///< Throughput-seeking traffic
 } ct_capacity_profile_enum_t;
 
+/**
+ * @ingroup connection_properties
+ * @brief Congestion control algorithm, for protocols where it can be chosen.
+ *
+ * Not part of RFC 9622. With CT_CONGESTION_ALGORITHM_AUTO the algorithm is derived from the
+ * connection's capacity profile.
+ */
+typedef enum {
+    CT_CONGESTION_ALGORITHM_AUTO = 0, ///< Derived from connCapacityProfile
+    CT_CONGESTION_ALGORITHM_NEWRENO,  ///< Loss based, NewReno
+    CT_CONGESTION_ALGORITHM_CUBIC,    ///< Loss based, CUBIC
+    CT_CONGESTION_ALGORITHM_DCUBIC,   ///< Delay sensitive CUBIC, yields to competing traffic
+    CT_CONGESTION_ALGORITHM_BBR       ///< Model based and paced, BBR
+} ct_congestion_algorithm_enum_t;
+
 /**
  * @ingroup connection_properties
  * @brief Policies for multipath traffic distribution.
@@ -315,6 +361,8 @@ typedef enum {
     CT_MULTIPATH_POLICY_AGGREGATE     ///< Use all paths for maximum throughput
 } ct_multipath_policy_enum_t;
 
+// listenerReusePort is only supported by TCP and UDP listeners, QUIC listeners reject it since
+// packets are not steered to the process owning their connection ID
 // clang-format off
 #define get_writable_connection_property_list(f)                                                                                   \
 f(RECV_CHECKSUM_LEN,     "recvChecksumLen",     uint32_t,                       recv_checksum_len,     CT_CONN_CHECKSUM_FULL_COVERAGE,           TYPE_UINT32) \
@@ -329,7 +377,10 @@ f(MIN_RECV_RATE,         "minRecvRate",         uint64_t,
 f(MAX_SEND_RATE,         "maxSendRate",         uint64_t,                       max_send_rate,         CT_CONN_RATE_UNLIMITED,                   TYPE_UINT64) \
 f(MAX_RECV_RATE,         "maxRecvRate",         uint64_t,                       max_recv_rate,         CT_CONN_RATE_UNLIMITED,                   TYPE_UINT64) \
 f(GROUP_CONN_LIMIT,      "groupConnLimit",      uint64_t,                       group_conn_limit,      CT_CONN_RATE_UNLIMITED,                   TYPE_UINT64) \
-f(ISOLATE_SESSION,       "isolateSession",      bool,                           isolate_session,       false,                                 TYPE_BOOL)
+f(ISOLATE_SESSION,       "isolateSession",      bool,                           isolate_session,       false,                                 TYPE_BOOL) \
+f(LISTENER_REUSE_PORT,   "listenerReusePort",   bool,                           listener_reuse_port,   false,                                 TYPE_BOOL) \
+f(LISTENER_CPU_AFFINITY, "listenerCpuAffinity", bool,                           listener_cpu_affinity, false,                                 TYPE_BOOL) \
+f(CONGESTION_ALGORITHM,  "congestionAlgorithm", ct_congestion_algorithm_enum_t, congestion_algorithm,  CT_CONGESTION_ALGORITHM_AUTO,          TYPE_ENUM)
 
 #define get_read_only_connection_properties(f)                                                                                          \
 f(SINGULAR_TRANSMISSION_MSG_MAX_LEN, "singularTransmissionMsgMaxLen", uint64_t,                   singular_transmission_msg_max_len, 0,     TYPE_UINT64) \
@@ -438,7 +489,7 @@ typedef struct ct_message_properties_s ct_message_properties_t;
 // clang-format off
 #define get_message_property_list(f)                                                                                                    \
 f(MSG_LIFETIME,          "msgLifetime",         uint64_t,                   lifetime,          0,                             TYPE_UINT64) \
-f(MSG_PRIORITY,          "msgPriority",         uint32_t,                   priority,          100,                           TYPE_UINT32) \
+f(MSG_PRIORITY,          "msgPriority",         uint32_t,                   priority,          CT_MESSAGE_DEFAULT_PRIORITY,   TYPE_UINT32) \
 f(MSG_ORDERED,           "msgOrdered",          bool,                       ordered,           true,                          TYPE_BOOL)   \
 f(MSG_SAFELY_REPLAYABLE, "msgSafelyReplayable", bool,                       safely_replayable, false,                         TYPE_BOOL)   \
 f(FINAL,                 "final",               bool,                       final,             false,                         TYPE_BOOL)   \
@@ -495,16 +546,19 @@ CT_EXTERN void ct_message_properties_free(ct_message_properties_t* message_prope
  * ### Passing to Preconnections and Connections
  * When you pass security parameters to ct_preconnection_new() or similar functions:
  * - **You retain ownership** of your original security_parameters
- * - CTaps makes a **deep copy** internally
+ * - CTaps makes one **immutable copy** internally, later modifications of yours do not affect it
  * - **You can free your security_parameters** after the function returns
  * - Multiple preconnections can share the same source security_parameters safely
  *
+ * Listeners and connections created from a preconnection share its immutable copy by
+ * reference instead of copying it again.
+ *
  * ### Lifecycle
  * - Create with ct_security_parameters_new()
  * - Pass to preconnection/connection functions
- *   - This makes a deep copy internally
+ *   - This makes an immutable copy internally
  * - Free your copy with ct_security_parameters_free() when done
- * - CTaps-owned copies are freed automatically
+ * - CTaps-owned copies are freed automatically with their last user
  */
 typedef struct ct_security_parameters_s ct_security_parameters_t;
 
@@ -1370,6 +1424,69 @@ CT_EXTERN void ct_preconnection_free(ct_preconnection_t* preconnection);
 CT_EXTERN int ct_preconnection_set_framer(ct_preconnection_t* preconnection,
                                            const ct_framer_impl_t* framer_impl);
 
+/**
+ * @ingroup preconnection
+ * @brief Coalesce connections initiated from the preconnection into established QUIC groups.
+ *
+ * When enabled, a QUIC connection group established by ct_preconnection_initiate() is pooled
+ * under its remote endpoints, ALPNs, server name and client certificates. Later initiates with
+ * the same configuration, from any preconnection with coalescing enabled, open a new stream
+ * in that group instead of gathering candidates, racing and performing a handshake. The new
+ * connection is passed to the ready() callback before the initiate call returns.
+ *
+ * A group is only reused while it has fewer open connections than its groupConnLimit.
+ * Preconnections with local endpoints are never coalesced. Disabled by default.
+ *
+ * @param[in,out] preconnection Preconnection to modify
+ * @param[in] enabled Whether to coalesce connections
+ *
+ * @return 0 on success, -EINVAL if preconnection is NULL
+ */
+CT_EXTERN int ct_preconnection_set_connection_coalescing(ct_preconnection_t* preconnection,
+                                                         bool enabled);
+
+/**
+ * @ingroup preconnection
+ * @brief Keep connections established ahead of demand for the preconnection.
+ *
+ * The preconnection races and establishes connections in the background and keeps them idle.
+ * ct_preconnection_initiate() and ct_preconnection_initiate_with_send() hand out an idle
+ * connection instead of racing, passing it to the ready() callback before they return, and a
+ * replacement is established in the background. When no connection is idle the call races as
+ * usual.
+ *
+ * The pool aims to keep min_connections idle. Every initiate that finds the pool empty raises
+ * that target by one, up to max_connections idle and establishing connections. Connections
+ * idle for longer than idle_timeout_ms are closed and the target lowered again, but never
+ * below min_connections.
+ *
+ * Must be called after ct_initialize(). Idle connections keep the event loop running until
+ * the pool is disabled or the preconnection is freed. Calling this again replaces the pool
+ * and closes its idle connections. Passing 0 for both counts disables the pool.
+ *
+ * @param[in,out] preconnection Preconnection to modify
+ * @param[in] min_connections Connections to keep idle without demand
+ * @param[in] max_connections Upper bound on idle and establishing connections, 0 to disable
+ * @param[in] idle_timeout_ms Close connections beyond min_connections after this long idle,
+ *            0 to keep them until they are used
+ *
+ * @return 0 on success, -EINVAL if preconnection is NULL, has no remote endpoints or
+ *         min_connections exceeds max_connections, -ENOMEM on allocation failure
+ */
+CT_EXTERN int ct_preconnection_set_warm_pool(ct_preconnection_t* preconnection,
+                                             size_t min_connections, size_t max_connections,
+                                             uint64_t idle_timeout_ms);
+
+/**
+ * @ingroup preconnection
+ * @brief Get the number of idle connections in the preconnection's warm pool.
+ *
+ * @param[in] preconnection Preconnection to query
+ *
+ * @return Number of established connections waiting to be handed out, 0 without a warm pool
+ */
+CT_EXTERN size_t ct_preconnection_get_num_warm_connections(const ct_preconnection_t* preconnection);
+
 /**
  * @ingroup preconnection
  * @brief Initiate a connection
@@ -1394,6 +1511,70 @@ CT_EXTERN int ct_preconnection_set_framer(ct_preconnection_t* preconnection,
 CT_EXTERN int ct_preconnection_initiate(const ct_preconnection_t* preconnection,
                                         const ct_connection_callbacks_t* connection_callbacks);
 
+/**
+ * @ingroup preconnection
+ * @brief Listen on every compatible protocol instead of only the most preferred one.
+ *
+ * When enabled, ct_preconnection_listen() binds every protocol left after applying the
+ * selection properties, e.g. QUIC on UDP port 443 and TCP on TCP port 443, under a single
+ * listener. Clients racing these protocols then complete on whichever wins. Protocols
+ * needing the same kind of socket, such as QUIC and UDP, cannot share the port, only the
+ * more preferred of them is bound. Protocols failing to bind are skipped, listener_ready() is
+ * called once at least one protocol listens. The local endpoint needs a port: on an ephemeral
+ * port each protocol would get a different one, so establishment_error() is called with
+ * -EINVAL instead. Disabled by default.
+ *
+ * @param[in,out] preconnection Preconnection to modify
+ * @param[in] enabled Whether to listen on every compatible protocol
+ *
+ * @return 0 on success, -EINVAL if preconnection is NULL
+ */
+CT_EXTERN int ct_preconnection_set_listen_all_protocols(ct_preconnection_t* preconnection,
+                                                        bool enabled);
+
+/**
+ * @ingroup preconnection
+ * @brief Spread the races of ct_preconnection_initiate_many() over a ramp.
+ *
+ * Starting every handshake at once can overwhelm the remote endpoint and the local event
+ * loop. With a ramp, the races are started evenly spread over ramp_ms instead. Defaults to 0,
+ * which starts all of them at once.
+ *
+ * @param[in,out] preconnection Preconnection to modify
+ * @param[in] ramp_ms Time between starting the first and the last race
+ *
+ * @return 0 on success, -EINVAL if preconnection is NULL
+ */
+CT_EXTERN int ct_preconnection_set_initiate_ramp(ct_preconnection_t* preconnection,
+                                                 uint64_t ramp_ms);
+
+/**
+ * @ingroup preconnection
+ * @brief Initiate many connections from a single candidate gathering pass.
+ *
+ * Like calling ct_preconnection_initiate() num_connections times, except that candidates are
+ * gathered and DNS is resolved once, or taken from the preconnection's candidate plan, and
+ * shared by every race. The races are spread over the ramp set with
+ * ct_preconnection_set_initiate_ramp(). Each connection is passed to the ready() callback,
+ * each failed race calls establishment_error() with a NULL connection. The warm pool and
+ * connection coalescing are not used, every connection gets its own handshake.
+ *
+ * CTaps does not take ownership of the passed pointers, so they can be safely freed after
+ * return.
+ *
+ * @param[in] preconnection Preconnection containing the connection configuration
+ * @param[in] num_connections Number of connections to initiate
+ * @param[in] connection_callbacks Callbacks for every connection
+ *
+ * @return 0 on success, -EINVAL on invalid arguments or without remote endpoints, -ENOMEM on
+ *         allocation failure
+ *
+ * @note Asynchronous errors are reported via the establishment_error callback
+ */
+CT_EXTERN int ct_preconnection_initiate_many(const ct_preconnection_t* preconnection,
+                                             size_t num_connections,
+                                             const ct_connection_callbacks_t* connection_callbacks);
+
 /**
  * @ingroup preconnection
  * @brief Initiate a connection and send a message immediately upon establishment.
@@ -1511,6 +1692,22 @@ CT_EXTERN uint8_t ct_connection_get_priority(const ct_connection_t* connection);
  */
 CT_EXTERN int ct_connection_set_priority(ct_connection_t* connection, uint8_t priority);
 
+/**
+ * @ingroup connection
+ * @brief Change minSendRate and maxSendRate of a connection group at runtime.
+ *
+ * Rates are in bits per second and apply to each connection in the group. TCP is paced by
+ * the kernel (SO_MAX_PACING_RATE), other protocols hold messages back until the rate allows.
+ * minSendRate is a floor on the pacing rate, not a guarantee.
+ *
+ * @param[in] connection Any connection in the group
+ * @param[in] min_send_rate Minimum send rate, or CT_CONN_RATE_UNLIMITED for none
+ * @param[in] max_send_rate Maximum send rate, or CT_CONN_RATE_UNLIMITED for none
+ * @return 0 on success, -EINVAL if connection is NULL or min_send_rate exceeds max_send_rate
+ */
+CT_EXTERN int ct_connection_set_send_rate(ct_connection_t* connection, uint64_t min_send_rate,
+                                          uint64_t max_send_rate);
+
 /**
  * @ingroup connection
  * @brief Get the connection's callback context.
@@ -0,0 +1,116 @@
+#include "candidate_arena.h"
+
+#include <logging/log.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Enough for every type stored in candidates, including struct sockaddr_storage
+#define CT_CANDIDATE_ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size)                                                                          \
+    (((size) + CT_CANDIDATE_ARENA_ALIGNMENT - 1) & ~(size_t)(CT_CANDIDATE_ARENA_ALIGNMENT - 1))
+
+typedef struct ct_candidate_arena_block_s {
+    struct ct_candidate_arena_block_s* next;
+    size_t size; // Usable bytes after the header
+    size_t used;
+} ct_candidate_arena_block_t;
+
+struct ct_candidate_arena_s {
+    size_t ref_count;
+    size_t num_blocks;
+    ct_candidate_arena_block_t* blocks; // Newest first, allocations come from the head
+};
+
+static unsigned char* block_data(ct_candidate_arena_block_t* block) {
+    return (unsigned char*)block + ARENA_ALIGN(sizeof(ct_candidate_arena_block_t));
+}
+
+ct_candidate_arena_t* ct_candidate_arena_new(void) {
+    // The arena and its first block share one allocation
+    size_t header_size = ARENA_ALIGN(sizeof(ct_candidate_arena_t));
+    unsigned char* memory = malloc(header_size + ARENA_ALIGN(sizeof(ct_candidate_arena_block_t)) +
+                                   CT_CANDIDATE_ARENA_BLOCK_SIZE);
+    if (!memory) {
+        log_error("Could not allocate memory for candidate arena");
+        return NULL;
+    }
+    ct_candidate_arena_t* arena = (ct_candidate_arena_t*)memory;
+    ct_candidate_arena_block_t* block = (ct_candidate_arena_block_t*)(memory + header_size);
+    block->next = NULL;
+    block->size = CT_CANDIDATE_ARENA_BLOCK_SIZE;
+    block->used = 0;
+    arena->ref_count = 1;
+    arena->num_blocks = 1;
+    arena->blocks = block;
+    return arena;
+}
+
+ct_candidate_arena_t* ct_candidate_arena_ref(ct_candidate_arena_t* arena) {
+    arena->ref_count++;
+    return arena;
+}
+
+void ct_candidate_arena_unref(ct_candidate_arena_t* arena) {
+    if (!arena || --arena->ref_count > 0) {
+        return;
+    }
+    // The first block is part of the arena allocation
+    ct_candidate_arena_block_t* first_block =
+        (ct_candidate_arena_block_t*)((unsigned char*)arena + ARENA_ALIGN(sizeof(*arena)));
+    ct_candidate_arena_block_t* block = arena->blocks;
+    while (block) {
+        ct_candidate_arena_block_t* next = block->next;
+        if (block != first_block) {
+            free(block);
+        }
+        block = next;
+    }
+    free(arena);
+}
+
+void* ct_candidate_arena_alloc(ct_candidate_arena_t* arena, size_t size) {
+    size = ARENA_ALIGN(size);
+    ct_candidate_arena_block_t* block = arena->blocks;
+    if (block->size - block->used < size) {
+        bool oversized = size > CT_CANDIDATE_ARENA_BLOCK_SIZE;
+        size_t block_size = oversized ? size : CT_CANDIDATE_ARENA_BLOCK_SIZE;
+        block = malloc(ARENA_ALIGN(sizeof(ct_candidate_arena_block_t)) + block_size);
+        if (!block) {
+            log_error("Could not allocate memory for candidate arena block");
+            return NULL;
+        }
+        block->size = block_size;
+        block->used = 0;
+        if (oversized) {
+            // Full right away, so later allocations keep filling the current block
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        } else {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+        arena->num_blocks++;
+    }
+    void* memory = block_data(block) + block->used;
+    block->used += size;
+    memset(memory, 0, size);
+    return memory;
+}
+
+char* ct_candidate_arena_strdup(ct_candidate_arena_t* arena, const char* string) {
+    if (!string) {
+        return NULL;
+    }
+    size_t length = strlen(string) + 1;
+    char* copy = ct_candidate_arena_alloc(arena, length);
+    if (copy) {
+        memcpy(copy, string, length);
+    }
+    return copy;
+}
+
+size_t ct_candidate_arena_num_blocks(const ct_candidate_arena_t* arena) {
+    return arena->num_blocks;
+}
@@ -0,0 +1,48 @@
+#ifndef CT_CANDIDATE_ARENA_H
+#define CT_CANDIDATE_ARENA_H
+
+#include <stddef.h>
+
+/**
+  * @brief Bump allocator holding everything the candidates of one gathering run point to.
+  *
+  * Memory is handed out from large blocks and only released all at once, when the last
+  * reference is dropped. Allocations never move, so candidate nodes can point into it.
+  */
+typedef struct ct_candidate_arena_s ct_candidate_arena_t;
+
+// Size of the block allocated together with the arena, larger runs chain further blocks
+#define CT_CANDIDATE_ARENA_BLOCK_SIZE 16384
+
+/**
+  * @brief Create an arena with a reference count of one.
+  */
+ct_candidate_arena_t* ct_candidate_arena_new(void);
+
+ct_candidate_arena_t* ct_candidate_arena_ref(ct_candidate_arena_t* arena);
+
+/**
+  * @brief Drop a reference, freeing every allocation of the arena with the last one.
+  */
+void ct_candidate_arena_unref(ct_candidate_arena_t* arena);
+
+/**
+  * @brief Zeroed, suitably aligned memory which lives as long as the arena.
+  *
+  * @return The memory, or NULL if a new block could not be allocated
+  */
+void* ct_candidate_arena_alloc(ct_candidate_arena_t* arena, size_t size);
+
+/**
+  * @brief Copy a string into the arena.
+  *
+  * @return The copy, or NULL if string is NULL or allocation failed
+  */
+char* ct_candidate_arena_strdup(ct_candidate_arena_t* arena, const char* string);
+
+/**
+  * @brief Number of heap allocations backing the arena.
+  */
+size_t ct_candidate_arena_num_blocks(const ct_candidate_arena_t* arena);
+
+#endif // CT_CANDIDATE_ARENA_H
@@ -1,13 +1,16 @@
 #include "candidate_gathering.h"
 
+#include "candidate_gathering/candidate_plan.h"
 #include "connection/preconnection.h"
 #include "ctaps.h"
 #include "ctaps_internal.h"
+#include "endpoint/dns_cache.h"
 #include "endpoint/local_endpoint.h"
 #include "endpoint/remote_endpoint.h"
 #include "endpoint/util.h"
 #include "protocol/common/socket_utils.h"
-#include <assert.h>
+#include "transport_property/selection_properties/selection_properties.h"
+#include <errno.h>
 #include <glib.h>
 #include <logging/log.h>
 #include <stdbool.h>
@@ -15,27 +18,17 @@
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct ct_node_pruning_data_t {
-    ct_selection_properties_t selection_properties;
-    GList* undesirable_nodes;
-} ct_node_pruning_data_t;
-
 typedef struct ct_protocol_impl_array_s {
     const ct_protocol_impl_t* const* protocols;
     size_t num_protocols;
 } ct_protocol_impl_array_t;
 
-typedef struct ct_leaf_gathering_context_s {
-    ct_gather_context_t* gather_context;
-    GArray* leaf_nodes;
-} ct_leaf_gathering_context_t;
-
 /**
   * Represents all protocol options for candidate gathering.
   *
-  * branch_by_protocol function will use this to expand PATH nodes into PROTOCOL nodes.
-  * Creating a PROTOCOL node for each combination, where appropriate. Add future options
-  * as members in this struct and modify branch_by_protocol accordingly.
+  * add_candidate_protocols will use this to expand each path into protocol candidates.
+  * Creating a protocol candidate for each combination, where appropriate. Add future options
+  * as members in this struct and modify add_candidate_protocols accordingly.
   */
 typedef struct ct_protocol_options_s {
     ct_protocol_impl_array_t protocol_arr; // List of supported protocol implementations
@@ -43,30 +36,21 @@ typedef struct ct_protocol_options_s {
 } ct_protocol_options_t;
 
 ct_remote_resolve_call_context_t*
-ct_remote_resolve_call_context_new(GNode* root_node, ct_gather_context_t* gather_context);
+ct_remote_resolve_call_context_new(size_t protocol_index, ct_gather_context_t* gather_context);
 void ct_remote_resolve_call_context_free(ct_remote_resolve_call_context_t* context);
 
 ct_protocol_options_t* ct_protocol_options_new(const ct_preconnection_t* precon);
 
-ct_protocol_candidate_t* ct_protocol_candidate_new(const ct_protocol_impl_t* protocol_impl,
-                                                   const char* alpn);
-
 ct_protocol_candidate_t*
 ct_protocol_candidate_copy(const ct_protocol_candidate_t* protocol_candidate);
 
-ct_candidate_node_t* ct_candidate_node_copy(const ct_candidate_node_t* candidate_node);
-
 void ct_protocol_options_free(ct_protocol_options_t* protocol_options);
 
-ct_protocol_impl_array_t* ct_protocol_impl_array_new(void);
+void candidate_gathering_is_complete_cb(ct_gather_context_t* gather_context);
+static void schedule_candidate_batch(ct_gather_context_t* gather_context);
+static void gather_context_free(ct_gather_context_t* gather_context);
 
-void build_candidate_tree_is_complete_cb(ct_gather_context_t* gather_context);
-
-int ct_build_candidate_tree(ct_gather_context_t* gather_context);
-int ct_branch_by_path(GNode* parent, const ct_local_endpoint_t* local_ep);
-int branch_by_protocol_options(GNode* parent, ct_protocol_options_t* protocol_options);
-int ct_branch_by_remote(GNode* parent, const ct_remote_endpoint_t* remote_ep,
-                     ct_remote_resolve_call_context_t* resolve_call_context);
+int ct_build_candidate_tables(ct_gather_context_t* gather_context);
 
 ct_protocol_options_t* ct_protocol_options_new(const ct_preconnection_t* precon) {
     ct_protocol_options_t* options = malloc(sizeof(ct_protocol_options_t));
@@ -85,20 +69,6 @@ ct_protocol_options_t* ct_protocol_options_new(const ct_preconnection_t* precon)
     return options;
 }
 
-gboolean free_data_in_tree_node_and_children(GNode* node, gpointer user_data) {
-    (void)user_data;
-    const ct_candidate_node_t* candidate_node = (ct_candidate_node_t*)node->data;
-    if (candidate_node->local_endpoint) {
-        ct_local_endpoint_free(candidate_node->local_endpoint);
-    }
-    if (candidate_node->remote_endpoint) {
-        ct_remote_endpoint_free(candidate_node->remote_endpoint);
-    }
-    ct_protocol_candidate_free(candidate_node->protocol_candidate);
-    free(node->data);
-    return false;
-}
-
 const char* get_generic_interface_type(const char* system_interface_name) {
     log_debug("Getting generic interface type for system interface name: %s",
               system_interface_name);
@@ -117,30 +87,6 @@ const char* get_generic_interface_type(const char* system_interface_name) {
     return NULL;
 }
 
-bool protocol_implementation_supports_selection_properties(
-    const ct_protocol_impl_t* protocol, const ct_selection_properties_t* selection_properties) {
-    for (int i = 0; i < SELECTION_PROPERTY_END; i++) {
-        ct_selection_property_t desired_value = selection_properties->list[i];
-        ct_selection_property_t protocol_value = protocol->selection_properties.list[i];
-
-        if (desired_value.type == TYPE_PREFERENCE) {
-            if (desired_value.value.simple_preference == REQUIRE &&
-                protocol_value.value.simple_preference == PROHIBIT) {
-                log_trace("Protocol %s does not support required property: %s", protocol->name,
-                          desired_value.name);
-                return false;
-            }
-            if (desired_value.value.simple_preference == PROHIBIT &&
-                protocol_value.value.simple_preference == REQUIRE) {
-                log_trace("Protocol %s requires prohibited property: %s", protocol->name,
-                          desired_value.name);
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
 bool interface_is_compatible(const char* interface_name,
                              const ct_transport_properties_t* transport_properties) {
     log_trace("Checking if interface %s is compatible with transport properties", interface_name);
@@ -185,195 +131,23 @@ bool interface_is_compatible(const char* interface_name,
     return true;
 }
 
-gboolean gather_incompatible_path_nodes(GNode* node, gpointer user_data) {
-    log_trace("Traversing candidate tree to gather incompatible path nodes");
-    struct ct_candidate_node_t* node_data = (struct ct_candidate_node_t*)node->data;
-    if (node_data->type == NODE_TYPE_ROOT) {
-        return false;
-    }
-    if (node_data->type != NODE_TYPE_PATH) {
-        // No need to traverse further down
-        return true;
-    }
-    struct ct_node_pruning_data_t* pruning_data = (struct ct_node_pruning_data_t*)user_data;
-    char* interface_name = "any";
-
-    if (ct_local_endpoint_get_interface_name(node_data->local_endpoint) != NULL) {
-        interface_name = ct_local_endpoint_get_interface_name(node_data->local_endpoint);
-    }
-    if (!interface_is_compatible(interface_name, node_data->transport_properties)) {
-        log_trace("Found incompatible path node with interface %s", interface_name);
-        pruning_data->undesirable_nodes = g_list_append(pruning_data->undesirable_nodes, node);
-    } else {
-        log_trace("Path node with interface %s is compatible", interface_name);
-    }
-    return false;
-}
-
-gboolean gather_incompatible_endpoint_nodes(GNode* node, gpointer user_data) {
-    log_trace("Traversing candidate tree to gather incompatible endpoint nodes where local family != remote family");
-    const struct ct_candidate_node_t* node_data = (struct ct_candidate_node_t*)node->data;
-    if (node_data->type == NODE_TYPE_ROOT || node_data->type == NODE_TYPE_PATH || node_data->type == NODE_TYPE_PROTOCOL) {
-        log_trace("Skipping node since it is not a protocol node");
-        return false;
-    }
-    struct ct_node_pruning_data_t* pruning_data = (struct ct_node_pruning_data_t*)user_data;
-
-    if (!ct_address_families_match(node_data->local_endpoint, node_data->remote_endpoint)
-        || !(ct_address_is_wildcard(&node_data->local_endpoint->resolved_address) || ct_address_scope_match(node_data->local_endpoint, node_data->remote_endpoint))) {
-
-        pruning_data->undesirable_nodes = g_list_append(pruning_data->undesirable_nodes, node);
-    }
-    return false;
-}
-
-gboolean gather_incompatible_protocol_nodes(GNode* node, gpointer user_data) {
-    log_trace("Traversing candidate tree to gather incompatible protocol nodes");
-    const struct ct_candidate_node_t* node_data = (struct ct_candidate_node_t*)node->data;
-    if (node_data->type == NODE_TYPE_ROOT || node_data->type == NODE_TYPE_PATH) {
-        log_trace("Skipping node since it is not a protocol node");
-        return false;
-    }
-    if (node_data->type == NODE_TYPE_ENDPOINT) {
-        log_trace("Done traversing tree for finding incompatible protocol nodes");
-        // No need to traverse further down
-        return true;
-    }
-
-    log_trace("Checking protocol node with protocol %s",
-              node_data->protocol_candidate->protocol_impl->name);
-    ct_node_pruning_data_t* pruning_data = (ct_node_pruning_data_t*)user_data;
-    if (!protocol_implementation_supports_selection_properties(
-            node_data->protocol_candidate->protocol_impl,
-            &node_data->transport_properties->selection_properties)) {
-        log_trace("Found incompatible protocol node with protocol %s",
-                  node_data->protocol_candidate->protocol_impl->name);
-        pruning_data->undesirable_nodes = g_list_append(pruning_data->undesirable_nodes, node);
-    } else {
-        log_trace("Protocol node with protocol %s is compatible",
-                  node_data->protocol_candidate->protocol_impl->name);
-    }
-    return false;
-}
-
-/*
- * @brief Remove and free each node and its children from the tree they belong to
- *
- * @param undesirable_nodes A list of GNode* that should be removed from the tree.
- *
- * @return the number of nodes removed from the tree (including children of removed nodes)
- */
-size_t remove_nodes_from_tree(GList* undesirable_nodes) {
-    if (!undesirable_nodes) {
-        return 0;
-    }
-    size_t num_removed = 0;
-    for (GList* current_node_list = undesirable_nodes; current_node_list != NULL;
-         current_node_list = current_node_list->next) {
-        GNode* node_to_remove = (GNode*)current_node_list->data;
-        num_removed += g_node_n_nodes(node_to_remove, G_TRAVERSE_ALL);
-
-        g_node_traverse(node_to_remove, G_IN_ORDER, G_TRAVERSE_ALL, -1,
-                        free_data_in_tree_node_and_children, NULL);
-        // First remove it from the tree, to avoid trying to free it twice, when later freeing a parent
-        g_node_unlink(node_to_remove);
-        g_node_destroy(node_to_remove);
-    }
-    return num_removed;
-}
-
-/**
- * @brief Prunes the candidate tree by removing nodes that are incompatible with the selection properties.
- *
- * @param root The root of the candidate tree to prune.
- * @param selection_properties The selection properties to use for pruning.
- *
- * @return the number of candidates remaining after pruning
- */
-void prune_candidate_tree(GNode* root, ct_selection_properties_t selection_properties) {
-    if (!root) {
-        log_error("Cannot prune candidate tree: root is NULL");
-        return;
-    }
-    log_debug("Pruning candidate tree based on selection properties");
-
-    ct_node_pruning_data_t pruning_data = {
-        .selection_properties = selection_properties,
-        .undesirable_nodes = NULL // This is fince since g_list_append handles initialization
-    };
-
-    log_trace("About to gather incompatible remote nodes");
-    g_node_traverse(root, G_LEVEL_ORDER, G_TRAVERSE_ALL, -1,
-                    gather_incompatible_endpoint_nodes, &pruning_data);
-
-    // Prune from the bottom up, otherwise we may remove a parent first, then try to remove the child
-    log_trace("About to gather incompatible protocol nodes");
-    g_node_traverse(root, G_LEVEL_ORDER, G_TRAVERSE_ALL, -1,
-                    gather_incompatible_protocol_nodes, &pruning_data);
-
-    log_trace("About to gather incompatible path nodes");
-    g_node_traverse(root, G_LEVEL_ORDER, G_TRAVERSE_NON_LEAVES, -1, gather_incompatible_path_nodes,
-                    &pruning_data);
-
-    log_trace("Total nodes in tree before pruning: %d", g_node_n_nodes(root, G_TRAVERSE_ALL));
-    remove_nodes_from_tree(pruning_data.undesirable_nodes);
-    g_list_free(pruning_data.undesirable_nodes);
-}
-
 gint compare_prefer_and_avoid_preferences(gconstpointer a, gconstpointer b,
-                                          gpointer desired_selection_properties) {
-    const ct_candidate_node_t* candidate_a = (const ct_candidate_node_t*)a;
-    const ct_candidate_node_t* candidate_b = (const ct_candidate_node_t*)b;
-    const ct_selection_properties_t* selection_properties =
-        (const ct_selection_properties_t*)desired_selection_properties;
-
-    log_trace("In candidate sorting - comparing two candidate nodes with protocol %s and %s based on prefer and avoid "
-              "selection properties", candidate_a->protocol_candidate->protocol_impl->name, candidate_b->protocol_candidate->protocol_impl->name);
-
+                                          gpointer selection_masks) {
+    const ct_selection_masks_t* desired = (const ct_selection_masks_t*)selection_masks;
+    const ct_selection_masks_t* a_capabilities =
+        &((const ct_candidate_node_t*)a)->protocol_candidate->capabilities;
+    const ct_selection_masks_t* b_capabilities =
+        &((const ct_candidate_node_t*)b)->protocol_candidate->capabilities;
 
     // order the branches according to the preferred Properties and use any avoided Properties as a tiebreaker
-    int a_prefer_score = 0;
-    int a_avoid_score = 0;
-    for (int i = 0; i < SELECTION_PROPERTY_END; i++) {
-        if (selection_properties->list[i].type == TYPE_PREFERENCE) {
-            if (selection_properties->list[i].value.simple_preference == PREFER) {
-                log_trace("Found PREFER property: %s", selection_properties->list[i].name);
-                // If A can provide this property then bump its score
-                if (candidate_a->protocol_candidate->protocol_impl->selection_properties.list[i]
-                        .value.simple_preference != PROHIBIT) {
-                    log_trace("%s can fulfill PREFER preference for property: %s", candidate_a->protocol_candidate->protocol_impl->name, selection_properties->list[i].name);
-                    a_prefer_score++;
-                }
-                // But if B can provide it too, then do not bump it after all
-                // If A cannot provide but B can, then A's score should decrease
-                if (candidate_b->protocol_candidate->protocol_impl->selection_properties.list[i]
-                        .value.simple_preference != PROHIBIT) {
-                    log_trace("%s can fulfill PREFER preference for property: %s", candidate_b->protocol_candidate->protocol_impl->name, selection_properties->list[i].name);
-                    a_prefer_score--;
-                }
-            } else if (selection_properties->list[i].value.simple_preference == AVOID) {
-                log_trace("Found AVOID property: %s", selection_properties->list[i].name);
-
-                if (candidate_a->protocol_candidate->protocol_impl->selection_properties.list[i]
-                        .value.simple_preference != REQUIRE) {
-                    log_trace("%s can fulfill AVOID preference for property: %s", candidate_a->protocol_candidate->protocol_impl->name, selection_properties->list[i].name);
-                    a_avoid_score++;
-                }
-                if (candidate_b->protocol_candidate->protocol_impl->selection_properties.list[i]
-                        .value.simple_preference != REQUIRE) {
-                    log_trace("%s can fulfill AVOID preference for property: %s", candidate_b->protocol_candidate->protocol_impl->name, selection_properties->list[i].name);
-                    a_avoid_score--;
-                }
-            }
-        }
-    }
+    int prefer_difference = ct_selection_masks_prefer_score(desired, a_capabilities) -
+                            ct_selection_masks_prefer_score(desired, b_capabilities);
     //  "The function should return a negative integer if the first value comes before the second"
-    if (a_prefer_score != 0) {
-        log_trace("Prefer score difference: %d", a_prefer_score);
-        return -a_prefer_score;
+    if (prefer_difference != 0) {
+        return -prefer_difference;
     }
-    log_trace("No prefer score difference, using avoid score difference: %d", a_avoid_score);
-    return -a_avoid_score;
+    return -(ct_selection_masks_avoid_score(desired, a_capabilities) -
+             ct_selection_masks_avoid_score(desired, b_capabilities));
 }
 
 /**
@@ -423,74 +197,17 @@ struct ct_candidate_node_t* candidate_node_new(ct_node_type_enum_t type,
     return node;
 }
 
-gboolean get_deep_copy_leaf_nodes(GNode* node, gpointer user_data) {
-    log_trace("Iterating candidate tree for getting candidate leaf nodes");
-    ct_leaf_gathering_context_t* context = (ct_leaf_gathering_context_t*)user_data;
-    GArray* node_array = context->leaf_nodes;
-
-    /*
-    If the tree looks like this, we only want the leaf nodes from the *bottom*
-    layer, but the type of that layer depends on whether we are in local-only mode or not.
-    So filter based on that here
-              h
-             / \
-            d   l
-           / \   \
-          b   f   n   <- Undesirable leaf nodes (wrong type)
-         / \   \
-        a   c   g <- Desirable leaf nodes 
-    */
-
-    if (context->gather_context->local_only) {
-        if (((ct_candidate_node_t*)node->data)->type != NODE_TYPE_PROTOCOL) {
-            log_trace("Skipping non-PROTOCOL node in local-only gather: node type %d",
-                      ((ct_candidate_node_t*)node->data)->type);
-            return false;
-        }
-    }
-    else {
-        if (((ct_candidate_node_t*)node->data)->type != NODE_TYPE_ENDPOINT) {
-            log_trace("Skipping non-ENDPOINT node in normal gather: node type %d",
-                      ((ct_candidate_node_t*)node->data)->type);
-            return false;
-        }
-    }
-    ct_candidate_node_t* candidate_node = ct_candidate_node_copy(node->data);
-    log_trace("Found leaf candidate node of type %d, adding to output array",
-              ((ct_candidate_node_t*)node->data)->type);
-    g_array_append_val(node_array, *candidate_node);
-    free(candidate_node);
-
-    return false;
-}
-
-static gboolean collect_leaves(GNode* node, gpointer user_data) {
-    GList** leaves = (GList**)user_data;
-    if (G_NODE_IS_LEAF(node)) {
-        *leaves = g_list_append(*leaves, node);
-    }
-    return false;
-}
-
-int ct_build_candidate_tree(ct_gather_context_t* gather_context) {
+/**
+ * @brief Resolve the local endpoints and add those on compatible interfaces as paths.
+ *
+ * @param num_resolved Set to the number of local endpoints found, including incompatible ones
+ * @return 0 on success, negative error code otherwise
+ */
+static int add_candidate_paths(ct_gather_context_t* gather_context, size_t* num_resolved) {
     const ct_preconnection_t* precon = gather_context->preconnection;
-    struct ct_candidate_node_t* root = candidate_node_new(
-        NODE_TYPE_ROOT, NULL, NULL, NULL, ct_preconnection_get_transport_properties(precon));
-
-    if (!root) {
-        log_error("Could not create root candidate node data");
-        return -ENOMEM;
-    }
-
-    GNode* root_node = g_node_new(root);
-
-    if (!root_node) {
-        log_error("Could not create root GNode for candidate tree");
-        free(root);
-        return -ENOMEM;
-    }
-
-    gather_context->root_node = root_node;
+    const ct_transport_properties_t* transport_properties =
+        ct_preconnection_get_transport_properties(precon);
+    ct_candidate_arena_t* arena = gather_context->arena;
 
     size_t num_local_eps = 0;
     const ct_local_endpoint_t* local_eps =
@@ -498,312 +215,546 @@ int ct_build_candidate_tree(ct_gather_context_t* gather_context) {
     ct_local_endpoint_t* ephemeral_local_ep = NULL;
     if (num_local_eps == 0) {
         log_debug("No local endpoints specified in preconnection, using ephemeral local endpoint "
-                  "for candidate tree building");
+                  "for candidate gathering");
         ephemeral_local_ep = ct_local_endpoint_new();
+        if (!ephemeral_local_ep) {
+            log_error("Could not create ephemeral local endpoint for candidate gathering");
+            return -ENOMEM;
+        }
         num_local_eps = 1;
         local_eps = ephemeral_local_ep;
     } else {
-        log_debug("Found %zu local endpoints in preconnection for candidate tree building",
+        log_debug("Found %zu local endpoints in preconnection for candidate gathering",
                   num_local_eps);
     }
 
-    log_debug("Branching candidate tree by path for %zu local endpoints", num_local_eps);
-    for (size_t i = 0; i < num_local_eps; i++) {
-        int rc = ct_branch_by_path(root_node, &local_eps[i]);
-        if (rc != 0) {
-            log_error("Error branching by path for local endpoint at index %zu: %d", i, rc);
-            if (ephemeral_local_ep) {
-                ct_local_endpoint_free(ephemeral_local_ep);
+    GArray* paths = g_array_new(false, false, sizeof(ct_local_endpoint_t));
+    *num_resolved = 0;
+    int rc = 0;
+    for (size_t i = 0; i < num_local_eps && rc == 0; i++) {
+        // Resolve the local endpoint. The `ct_local_endpoint_resolve` function
+        // will find all available interfaces when the interface is not specified.
+        size_t num_found_local = 0;
+        ct_local_endpoint_t* local_endpoint_list =
+            ct_local_endpoint_resolve(&local_eps[i], &num_found_local);
+        log_debug("Found %zu local endpoints for local endpoint at index %zu", num_found_local, i);
+        *num_resolved += num_found_local;
+
+        for (size_t j = 0; j < num_found_local; j++) {
+            const ct_local_endpoint_t* found = &local_endpoint_list[j];
+            const char* interface_name = "any";
+            if (ct_local_endpoint_get_interface_name(found) != NULL) {
+                interface_name = ct_local_endpoint_get_interface_name(found);
+            }
+            if (!interface_is_compatible(interface_name, transport_properties)) {
+                log_trace("Skipping local endpoint on incompatible interface %s", interface_name);
+                continue;
+            }
+            ct_local_endpoint_t path = *found;
+            path.interface_name = ct_candidate_arena_strdup(arena, found->interface_name);
+            path.service = ct_candidate_arena_strdup(arena, found->service);
+            if ((found->interface_name && !path.interface_name) ||
+                (found->service && !path.service)) {
+                log_error("Could not copy local endpoint into candidate arena");
+                rc = -ENOMEM;
+                break;
             }
-            g_node_traverse(root_node, G_IN_ORDER, G_TRAVERSE_ALL, -1,
-                            free_data_in_tree_node_and_children, NULL);
-            g_node_destroy(root_node);
-            return rc;
+            g_array_append_val(paths, path);
         }
+        ct_local_endpoints_free(local_endpoint_list, num_found_local);
     }
     if (ephemeral_local_ep) {
         ct_local_endpoint_free(ephemeral_local_ep);
     }
 
-    GList* leaves = NULL;
-    g_node_traverse(root_node, G_IN_ORDER, G_TRAVERSE_LEAVES, -1, collect_leaves, &leaves);
+    if (rc == 0 && paths->len > 0) {
+        gather_context->paths =
+            ct_candidate_arena_alloc(arena, paths->len * sizeof(ct_local_endpoint_t));
+        if (gather_context->paths) {
+            memcpy(gather_context->paths, paths->data, paths->len * sizeof(ct_local_endpoint_t));
+            gather_context->num_paths = paths->len;
+        } else {
+            rc = -ENOMEM;
+        }
+    }
+    g_array_free(paths, true);
+    return rc;
+}
 
+/**
+ * @brief Add a protocol candidate for each compatible protocol and ALPN on every path.
+ *
+ * Protocols conflicting with the selection properties never become candidates, so no lookups
+ * are started for them.
+ */
+static int add_candidate_protocols(ct_gather_context_t* gather_context) {
+    const ct_preconnection_t* precon = gather_context->preconnection;
+    ct_candidate_arena_t* arena = gather_context->arena;
     ct_protocol_options_t* protocol_options = ct_protocol_options_new(precon);
     if (!protocol_options) {
-        log_error("Could not create protocol options for branching by protocol options");
-        g_node_traverse(root_node, G_IN_ORDER, G_TRAVERSE_ALL, -1,
-                        free_data_in_tree_node_and_children, NULL);
-        g_node_destroy(root_node);
+        log_error("Could not create protocol options for candidate gathering");
+        return -ENOMEM;
+    }
+    const ct_protocol_impl_array_t* protocol_arr = &protocol_options->protocol_arr;
+    const ct_string_array_t* alpns = &protocol_options->alpns;
+
+    ct_selection_masks_t* capabilities =
+        ct_candidate_arena_alloc(arena, protocol_arr->num_protocols * sizeof(ct_selection_masks_t));
+    if (!capabilities) {
+        ct_protocol_options_free(protocol_options);
+        return -ENOMEM;
+    }
+    size_t num_per_path = 0;
+    for (size_t i = 0; i < protocol_arr->num_protocols; i++) {
+        const ct_protocol_impl_t* protocol_impl = protocol_arr->protocols[i];
+        ct_selection_masks_compile(&protocol_impl->selection_properties, &capabilities[i]);
+        if (!ct_selection_masks_compatible(&precon->selection_masks, &capabilities[i])) {
+            log_trace("Protocol %s is incompatible with the selection properties",
+                      protocol_impl->name);
+            continue;
+        }
+        num_per_path += ct_protocol_supports_alpn(protocol_impl) && alpns->num_strings > 0
+                            ? alpns->num_strings
+                            : 1;
+    }
+
+    size_t num_protocols = num_per_path * gather_context->num_paths;
+    if (num_protocols == 0) {
+        ct_protocol_options_free(protocol_options);
+        return 0;
+    }
+    gather_context->protocols =
+        ct_candidate_arena_alloc(arena, num_protocols * sizeof(ct_candidate_protocol_t));
+    if (!gather_context->protocols) {
+        ct_protocol_options_free(protocol_options);
         return -ENOMEM;
     }
-    log_debug("Branching by protocol options when building candidate tree");
-    for (GList* iter = leaves; iter != NULL; iter = iter->next) {
-        GNode* leaf_node = (GNode*)iter->data;
-        branch_by_protocol_options(leaf_node, protocol_options);
+
+    size_t protocol_ix = 0;
+    for (size_t path_ix = 0; path_ix < gather_context->num_paths; path_ix++) {
+        for (size_t i = 0; i < protocol_arr->num_protocols; i++) {
+            const ct_protocol_impl_t* protocol_impl = protocol_arr->protocols[i];
+            if (!ct_selection_masks_compatible(&precon->selection_masks, &capabilities[i])) {
+                continue;
+            }
+            // If the current protocol supports ALPN, create a candidate for each ALPN value
+            // Picoquic does support passing multiple ALPNs as a single connection attempt,
+            // but not if we want to support 0-rtt because then the alpn has to be passed to
+            // the picoquic_create invocation, which only takes a single value.
+            // It was therefore decided to create separate
+            // candidates for each ALPN value, as the added overhead is assumed to not be too high
+            bool per_alpn = ct_protocol_supports_alpn(protocol_impl) && alpns->num_strings > 0;
+            size_t num_alpn_candidates = per_alpn ? alpns->num_strings : 1;
+            for (size_t j = 0; j < num_alpn_candidates; j++) {
+                ct_candidate_protocol_t* protocol = &gather_context->protocols[protocol_ix++];
+                protocol->path_index = path_ix;
+                protocol->protocol_candidate.protocol_impl = protocol_impl;
+                protocol->protocol_candidate.capabilities = capabilities[i];
+                if (per_alpn) {
+                    protocol->protocol_candidate.alpn =
+                        ct_candidate_arena_strdup(arena, alpns->strings[j]);
+                    if (!protocol->protocol_candidate.alpn) {
+                        log_error("Could not copy ALPN %s into candidate arena",
+                                  alpns->strings[j]);
+                        ct_protocol_options_free(protocol_options);
+                        return -ENOMEM;
+                    }
+                }
+            }
+        }
     }
+    gather_context->num_protocols = num_protocols;
     ct_protocol_options_free(protocol_options);
+    return 0;
+}
 
-    g_list_free(leaves);
-    leaves = NULL;
+int ct_build_candidate_tables(ct_gather_context_t* gather_context) {
+    const ct_preconnection_t* precon = gather_context->preconnection;
+    gather_context->arena = ct_candidate_arena_new();
+    if (!gather_context->arena) {
+        return -ENOMEM;
+    }
+
+    size_t num_resolved_local = 0;
+    int rc = add_candidate_paths(gather_context, &num_resolved_local);
+    if (rc != 0) {
+        log_error("Error adding candidate paths: %d", rc);
+        return rc;
+    }
+    rc = add_candidate_protocols(gather_context);
+    if (rc != 0) {
+        log_error("Error adding candidate protocols: %d", rc);
+        return rc;
+    }
+    log_debug("Candidate tables hold %zu compatible paths and %zu protocol candidates",
+              gather_context->num_paths, gather_context->num_protocols);
 
-    g_node_traverse(root_node, G_IN_ORDER, G_TRAVERSE_LEAVES, -1, collect_leaves, &leaves);
     // For listeners we do not need remote endpoints: stop here and treat
-    // PROTOCOL nodes as the final candidates.
+    // protocol candidates as the final candidates.
     if (gather_context->local_only) {
-        log_debug("local_only mode: skipping remote endpoint branching, PROTOCOL nodes are leaves");
-        g_list_free(leaves);
-        build_candidate_tree_is_complete_cb(gather_context);
+        log_debug("local_only mode: skipping remote endpoint resolution, protocols are the "
+                  "candidates");
+        candidate_gathering_is_complete_cb(gather_context);
         return 0;
     }
 
     size_t num_remote_endpoints = 0;
-    const ct_remote_endpoint_t* remote_endpoints = ct_preconnection_get_remote_endpoints(precon, &num_remote_endpoints);
+    const ct_remote_endpoint_t* remote_endpoints =
+        ct_preconnection_get_remote_endpoints(precon, &num_remote_endpoints);
 
     // If we have gotten here then we are *not* happy with a local-only, so we need
-    // to check if we actually have any remote endpoints to branch by, if not we are
+    // to check if we actually have any endpoints to build candidates from, if not we are
     // in a failure state.
-    if (leaves == NULL || num_remote_endpoints == 0) {
-        log_debug("No candidate leaf nodes found after branching by protocol options, finishing "
-                  "candidate tree building");
+    if (num_resolved_local == 0 || num_remote_endpoints == 0) {
+        log_debug("No local or remote endpoints to build candidates from, finishing candidate "
+                  "gathering");
         gather_context->failed = true;
-        build_candidate_tree_is_complete_cb(gather_context);
-        if (leaves) {
-            g_list_free(leaves);
-        }
+        candidate_gathering_is_complete_cb(gather_context);
         return 0;
     }
 
-    log_debug("Branching by remote endpoints for %zu leaf nodes and %zu remote endpoints per node",
-              g_list_length(leaves), num_remote_endpoints);
-    gather_context->pending_resolutions = g_list_length(leaves) * num_remote_endpoints;
-    for (GList* iter = leaves; iter != NULL; iter = iter->next) {
-        GNode* leaf_node = (GNode*)iter->data;
+    gather_context->endpoints =
+        g_array_sized_new(false, false, sizeof(ct_candidate_endpoint_t),
+                          gather_context->num_protocols * num_remote_endpoints);
+    log_debug("Resolving %zu remote endpoints for %zu protocol candidates", num_remote_endpoints,
+              gather_context->num_protocols);
+    // One extra pending resolution until every lookup is started, so that lookups answered
+    // synchronously cannot complete the gathering while we are still starting lookups
+    gather_context->pending_resolutions = gather_context->num_protocols * num_remote_endpoints + 1;
+    gather_context->building = true;
+    for (size_t protocol_ix = 0;
+         protocol_ix < gather_context->num_protocols && !gather_context->failed; protocol_ix++) {
         for (size_t remote_ix = 0; remote_ix < num_remote_endpoints; remote_ix++) {
             ct_remote_resolve_call_context_t* context =
-                ct_remote_resolve_call_context_new(leaf_node, gather_context);
+                ct_remote_resolve_call_context_new(protocol_ix, gather_context);
             if (!context) {
                 log_error("Could not create context for remote endpoint resolution");
                 gather_context->failed = true;
-                gather_context->pending_resolutions = gather_context->num_in_flight;
-                if (gather_context->pending_resolutions == 0) {
-                    build_candidate_tree_is_complete_cb(gather_context);
-                }
-
-                g_list_free(leaves);
-                return -ENOMEM;
+                break;
             }
             gather_context->num_in_flight++;
-            int rc = ct_branch_by_remote(leaf_node, &remote_endpoints[remote_ix], context);
+            rc = ct_remote_endpoint_resolve(&remote_endpoints[remote_ix], context);
             if (rc != 0) {
                 gather_context->num_in_flight--;
-                log_error("Error branching by remote endpoint: %d", rc);
+                log_error("Error resolving remote endpoint: %d", rc);
                 gather_context->failed = true;
-                gather_context->pending_resolutions = gather_context->num_in_flight;
-                if (gather_context->pending_resolutions == 0) {
-                    build_candidate_tree_is_complete_cb(gather_context);
-                }
                 ct_remote_resolve_call_context_free(context);
-                g_list_free(leaves);
-
-                return rc;
+                break;
             }
         }
     }
-    g_list_free(leaves);
-
-    return 0;
-}
+    if (gather_context->failed) {
+        // Lookups already started still answer, the last one reports the failure
+        gather_context->pending_resolutions = gather_context->num_in_flight + 1;
+    }
 
-int ct_branch_by_path(GNode* parent, const ct_local_endpoint_t* local_ep) {
-    struct ct_candidate_node_t* parent_data = (struct ct_candidate_node_t*)parent->data;
-    assert(parent_data->type == NODE_TYPE_ROOT);
-
-    // Resolve the local endpoint. The `ct_local_endpoint_resolve` function
-    // will find all available interfaces when the interface is not specified.
-    size_t num_found_local = 0;
-    ct_local_endpoint_t* local_endpoint_list =
-        ct_local_endpoint_resolve(local_ep, &num_found_local);
-    log_debug("Found %zu local endpoints, adding as children to ROOT node", num_found_local);
-
-    for (size_t i = 0; i < num_found_local; i++) {
-        // Create a child node for each local endpoint found.
-        struct ct_candidate_node_t* path_node_data =
-            candidate_node_new(NODE_TYPE_PATH, &local_endpoint_list[i], NULL,
-                               NULL, // Protocol not yet specified
-                               parent_data->transport_properties);
-        if (!path_node_data) {
-            log_error("Could not create PATH node data");
-            ct_local_endpoints_free(local_endpoint_list, num_found_local);
-            return -ENOMEM;
-        }
-        g_node_append_data(parent, path_node_data);
+    gather_context->building = false;
+    gather_context->pending_resolutions--;
+    if (gather_context->pending_resolutions == 0) {
+        candidate_gathering_is_complete_cb(gather_context);
+    } else {
+        schedule_candidate_batch(gather_context);
     }
-    ct_local_endpoints_free(local_endpoint_list, num_found_local);
     return 0;
 }
 
-int branch_by_protocol_options(GNode* parent, ct_protocol_options_t* protocol_options) {
-    struct ct_candidate_node_t* parent_data = (struct ct_candidate_node_t*)parent->data;
-    assert(parent_data->type == NODE_TYPE_PATH);
-
-    log_trace("Expanding node of type PATH to PROTOCOL nodes");
-
-    for (size_t i = 0; i < protocol_options->protocol_arr.num_protocols; i++) {
-        if (ct_protocol_supports_alpn(protocol_options->protocol_arr.protocols[i]) &&
-            protocol_options->alpns.num_strings > 0) {
-            // If the current protocol supports ALPN, create a candidate for each ALPN value
-            // Picoquic does support passing multiple ALPNs as a single connection attempt,
-            // but not if we want to support 0-rtt because then the alpn has to be passed to
-            // the picoquic_create invocation, which only takes a single value.
-            // It was therefore decided to create separate
-            // candidates for each ALPN value, as the added overhead is assumed to not be too high
-            for (size_t j = 0; j < protocol_options->alpns.num_strings; j++) {
-                log_trace("Checking QUIC protocol against selection properties");
-                ct_protocol_candidate_t* candidate =
-                    ct_protocol_candidate_new(protocol_options->protocol_arr.protocols[i],
-                                              protocol_options->alpns.strings[j]);
-                if (!candidate) {
-                    log_error("Could not create protocol candidate for protocol %s with ALPN %s",
-                              protocol_options->protocol_arr.protocols[i]->name,
-                              protocol_options->alpns.strings[j]);
-                    return -1;
-                }
-
-                // Create a child node for each supported protocol.
-                ct_candidate_node_t* candidate_node = candidate_node_new(NODE_TYPE_PROTOCOL,
-                                                                         parent_data->local_endpoint,
-                                                                         NULL,
-                                                                         candidate,
-                                                                         parent_data->transport_properties);
-                ct_protocol_candidate_free(candidate); // candidate_node_new copies it
-                if (!candidate_node) {
-                    log_error("Could not create PROTOCOL node data");
-                    return -1;
-                }
-                g_node_append_data(parent, candidate_node);
-            }
-        } else {
-            log_trace("Protocol %s does not support ALPN or no ALPN values provided, creating single candidate without ALPN",
-                      protocol_options->protocol_arr.protocols[i]->name);
-            // If the current protocol does not support ALPN, just create a single candidate without any alpn
-            ct_protocol_candidate_t* candidate =
-                ct_protocol_candidate_new(protocol_options->protocol_arr.protocols[i], NULL);
-            if (!candidate) {
-                log_error("Could not create protocol candidate for protocol %s without ALPN",
-                          protocol_options->protocol_arr.protocols[i]->name);
-                return -1;
-            }
-
-            ct_candidate_node_t* candidate_node =
-                candidate_node_new(NODE_TYPE_PROTOCOL, parent_data->local_endpoint, NULL, candidate,
-                                   parent_data->transport_properties);
-            ct_protocol_candidate_free(candidate); // candidate_node_new copies it
-
-            if (!candidate_node) {
-                log_error("Could not create PROTOCOL node data");
-                return -1;
-            }
-            g_node_append_data(parent, candidate_node);
+/**
+ * @brief Add the resolved addresses reachable from the path of a protocol candidate.
+ *
+ * @return The number of endpoints added
+ */
+static size_t add_candidate_endpoints(ct_gather_context_t* gather_context, size_t protocol_index,
+                                      const ct_remote_endpoint_t* resolved, size_t num_resolved) {
+    const ct_local_endpoint_t* path =
+        &gather_context->paths[gather_context->protocols[protocol_index].path_index];
+    size_t num_added = 0;
+    for (size_t i = 0; i < num_resolved; i++) {
+        if (!ct_address_families_match(path, &resolved[i]) ||
+            !(ct_address_is_wildcard(&path->resolved_address) ||
+              ct_address_scope_match(path, &resolved[i]))) {
+            log_trace("Skipping resolved address unreachable from local endpoint");
+            continue;
         }
-    }
-    return 0;
+        ct_remote_endpoint_t* remote_endpoint =
+            ct_candidate_arena_alloc(gather_context->arena, sizeof(ct_remote_endpoint_t));
+        if (!remote_endpoint) {
+            gather_context->failed = true;
+            break;
+        }
+        *remote_endpoint = resolved[i];
+        remote_endpoint->service =
+            ct_candidate_arena_strdup(gather_context->arena, resolved[i].service);
+        remote_endpoint->hostname =
+            ct_candidate_arena_strdup(gather_context->arena, resolved[i].hostname);
+        if ((resolved[i].service && !remote_endpoint->service) ||
+            (resolved[i].hostname && !remote_endpoint->hostname)) {
+            log_error("Could not copy remote endpoint into candidate arena");
+            gather_context->failed = true;
+            break;
+        }
+        ct_candidate_endpoint_t endpoint = {
+            .protocol_index = protocol_index,
+            .remote_endpoint = remote_endpoint,
+        };
+        g_array_append_val(gather_context->endpoints, endpoint);
+        num_added++;
+    }
+    return num_added;
 }
 
 void ct_remote_endpoint_resolve_cb(ct_remote_endpoint_t* remote_endpoint, size_t out_count,
                                    ct_remote_resolve_call_context_t* context) {
     log_debug("Received resolved remote endpoint with %zu addresses", out_count);
-    GNode* parent = context->parent_node;
-    ct_candidate_node_t* parent_data = (ct_candidate_node_t*)parent->data;
+    ct_gather_context_t* gather_context = context->gather_context;
 
-    for (size_t i = 0; i < out_count; i++) {
-        // Create a leaf node for each resolved IP address.
-        ct_candidate_node_t* leaf_node_data =
-            candidate_node_new(NODE_TYPE_ENDPOINT, parent_data->local_endpoint, &remote_endpoint[i],
-                               parent_data->protocol_candidate, parent_data->transport_properties);
-        g_node_append_data(parent, leaf_node_data);
+    size_t num_added = 0;
+    if (!gather_context->failed) {
+        num_added = add_candidate_endpoints(gather_context, context->protocol_index,
+                                            remote_endpoint, out_count);
     }
 
     // Clean up the allocated memory for the list of remote endpoints.
     if (remote_endpoint) {
-        log_trace("Freeing list of remote endpoints after building leaf nodes");
+        log_trace("Freeing list of remote endpoints after adding candidate endpoints");
         free(remote_endpoint);
     }
 
-    context->gather_context->num_in_flight--;
-    context->gather_context->pending_resolutions--;
-    if (context->gather_context->pending_resolutions == 0) {
+    if (num_added > 0) {
+        gather_context->has_undelivered = true;
+    }
+    if (context->family == AF_INET6) {
+        gather_context->num_aaaa_in_flight--;
+    }
+    if (context->family != AF_INET && out_count > 0) {
+        gather_context->flush_without_delay = true;
+    }
+    gather_context->num_in_flight--;
+    gather_context->pending_resolutions--;
+    if (gather_context->pending_resolutions == 0) {
         log_trace("All remote endpoint resolutions complete");
-        build_candidate_tree_is_complete_cb(context->gather_context);
+        candidate_gathering_is_complete_cb(gather_context);
+    } else {
+        schedule_candidate_batch(gather_context);
     }
     free(context);
 }
 
-int ct_branch_by_remote(GNode* parent, const ct_remote_endpoint_t* remote_ep,
-                     ct_remote_resolve_call_context_t* context) {
-    struct ct_candidate_node_t* parent_data = (struct ct_candidate_node_t*)parent->data;
-    ASSERT_IS(parent_data->type, NODE_TYPE_PROTOCOL);
-    log_trace("Expanding node of type PROTOCOL to ENDPOINT nodes");
+static ct_candidate_node_t arena_candidate_node(ct_gather_context_t* gather_context,
+                                                ct_node_type_enum_t type,
+                                                const ct_candidate_protocol_t* protocol,
+                                                ct_remote_endpoint_t* remote_endpoint) {
+    ct_candidate_node_t node = {
+        .type = type,
+        .local_endpoint = &gather_context->paths[protocol->path_index],
+        .remote_endpoint = remote_endpoint,
+        .protocol_candidate = (ct_protocol_candidate_t*)&protocol->protocol_candidate,
+        .transport_properties =
+            ct_preconnection_get_transport_properties(gather_context->preconnection),
+        .arena = ct_candidate_arena_ref(gather_context->arena),
+    };
+    return node;
+}
 
-    // Resolve the remote endpoint (hostname to IP address).
-    int rc = ct_remote_endpoint_resolve(remote_ep, context);
-    if (rc != 0) {
-        log_error("Error resolving remote endpoint");
-        return rc;
+/**
+ * @brief Candidates for listeners, one PROTOCOL node per protocol candidate.
+ */
+static GArray* take_local_candidates(ct_gather_context_t* gather_context) {
+    GArray* candidates = g_array_sized_new(false, false, sizeof(ct_candidate_node_t),
+                                           gather_context->num_protocols);
+    for (size_t i = 0; i < gather_context->num_protocols; i++) {
+        ct_candidate_node_t node = arena_candidate_node(gather_context, NODE_TYPE_PROTOCOL,
+                                                        &gather_context->protocols[i], NULL);
+        g_array_append_val(candidates, node);
+    }
+    return candidates;
+}
+
+/**
+ * @brief Candidates for the endpoints added since the last call.
+ *
+ * Candidates are grouped by protocol candidate, and so by path, keeping the order answers
+ * arrived in within a group. Ties in the stable sort that follows keep this order.
+ *
+ * @return The candidates, or NULL if memory ran out
+ */
+static GArray* take_undelivered_candidates(ct_gather_context_t* gather_context) {
+    GArray* endpoints = gather_context->endpoints;
+    size_t num_undelivered = endpoints ? endpoints->len - gather_context->num_delivered : 0;
+    GArray* candidates =
+        g_array_sized_new(false, false, sizeof(ct_candidate_node_t), num_undelivered);
+    if (num_undelivered == 0) {
+        return candidates;
+    }
+
+    // Counting sort on the protocol index, the offset of the first candidate of each protocol
+    size_t* offsets = calloc(gather_context->num_protocols + 1, sizeof(size_t));
+    if (!offsets) {
+        log_error("Could not allocate memory for ordering candidates");
+        g_array_free(candidates, true);
+        return NULL;
+    }
+    for (size_t i = gather_context->num_delivered; i < endpoints->len; i++) {
+        offsets[g_array_index(endpoints, ct_candidate_endpoint_t, i).protocol_index + 1]++;
+    }
+    for (size_t i = 1; i <= gather_context->num_protocols; i++) {
+        offsets[i] += offsets[i - 1];
     }
 
-    return 0;
+    g_array_set_size(candidates, num_undelivered);
+    for (size_t i = gather_context->num_delivered; i < endpoints->len; i++) {
+        const ct_candidate_endpoint_t* endpoint =
+            &g_array_index(endpoints, ct_candidate_endpoint_t, i);
+        g_array_index(candidates, ct_candidate_node_t, offsets[endpoint->protocol_index]++) =
+            arena_candidate_node(gather_context, NODE_TYPE_ENDPOINT,
+                                 &gather_context->protocols[endpoint->protocol_index],
+                                 endpoint->remote_endpoint);
+    }
+    free(offsets);
+    gather_context->num_delivered = endpoints->len;
+    return candidates;
 }
 
-void build_candidate_tree_is_complete_cb(ct_gather_context_t* gather_context) {
-    if (gather_context->failed) {
-        log_error("Candidate tree building failed, not proceeding to pruning and callback");
-        gather_context->gathering_callbacks.candidate_node_array_ready_cb(
-            NULL, gather_context->gathering_callbacks.context);
-        free(gather_context);
+/**
+ * @brief Deliver the candidates resolved since the last batch while lookups are in flight.
+ *
+ * Delivered endpoints are not handed out again, so the final batch only holds later answers.
+ */
+static void deliver_candidate_batch(ct_gather_context_t* gather_context) {
+    const ct_selection_masks_t* selection_masks = &gather_context->preconnection->selection_masks;
+    GArray* batch = take_undelivered_candidates(gather_context);
+    gather_context->has_undelivered = false;
+    if (!batch) {
+        // Left for the final batch
         return;
     }
-    GNode* root_node = gather_context->root_node;
-    const ct_preconnection_t* precon = gather_context->preconnection;
-    prune_candidate_tree(root_node,
-                         ct_preconnection_get_transport_properties(precon)->selection_properties);
+    if (batch->len == 0) {
+        g_array_free(batch, true);
+        return;
+    }
+    g_array_sort_with_data(batch, compare_prefer_and_avoid_preferences,
+                           (gpointer)selection_masks);
+    gather_context->batch_delivered = true;
+    if (gather_context->plan_nodes) {
+        ct_candidate_array_append_copies(gather_context->plan_nodes, batch);
+    }
+    log_debug("Delivering batch of %u candidates with %zu lookups still pending", batch->len,
+              gather_context->pending_resolutions);
+    gather_context->gathering_callbacks.candidate_node_batch_cb(
+        batch, false, gather_context->gathering_callbacks.context);
+}
 
-    log_info("Candidate tree has been pruned, extracting leaf nodes");
+static void on_candidate_batch_timer(uv_timer_t* handle) {
+    deliver_candidate_batch((ct_gather_context_t*)handle->data);
+}
 
-    GArray* root_array = g_array_new(false, false, sizeof(ct_candidate_node_t));
+/**
+ * @brief Decide when answers received so far are delivered, following RFC 8305 section 3.
+ *
+ * AAAA answers go out right away, while A answers wait up to CT_RESOLUTION_DELAY_MS for the
+ * AAAA answers. Once racing has started every later answer goes out right away.
+ */
+static void schedule_candidate_batch(ct_gather_context_t* gather_context) {
+    if (!gather_context->gathering_callbacks.candidate_node_batch_cb ||
+        gather_context->building || gather_context->failed || !gather_context->has_undelivered) {
+        return;
+    }
+    if (!gather_context->batch_timer) {
+        gather_context->batch_timer = malloc(sizeof(uv_timer_t));
+        if (!gather_context->batch_timer) {
+            log_error("Could not allocate candidate batch timer, waiting for all lookups");
+            return;
+        }
+        uv_timer_init(event_loop, gather_context->batch_timer);
+        gather_context->batch_timer->data = gather_context;
+    }
 
-    log_trace("Fetching leaf nodes from candidate tree");
+    if (gather_context->batch_delivered || gather_context->flush_without_delay ||
+        gather_context->num_aaaa_in_flight == 0) {
+        // Zero timeout, so that every answer delivered in this loop iteration shares a batch
+        uv_timer_start(gather_context->batch_timer, on_candidate_batch_timer, 0, 0);
+    } else if (!uv_is_active((uv_handle_t*)gather_context->batch_timer)) {
+        log_debug("Received A answers first, waiting up to %d ms for AAAA answers",
+                  CT_RESOLUTION_DELAY_MS);
+        uv_timer_start(gather_context->batch_timer, on_candidate_batch_timer,
+                       CT_RESOLUTION_DELAY_MS, 0);
+    }
+}
 
-    ct_leaf_gathering_context_t leaf_context = {
-        .gather_context = gather_context,
-        .leaf_nodes = root_array,
-    };
-    // Get deep copy of leaf candidate nodes and insert them in array
-    g_node_traverse(root_node, G_IN_ORDER, G_TRAVERSE_LEAVES, -1, get_deep_copy_leaf_nodes,
-                    &leaf_context);
+static void on_batch_timer_close_free_gather_context(uv_handle_t* handle) {
+    free(handle->data);
+    free(handle);
+}
 
-    log_trace("Freeing undesirable nodes from candidate tree");
+static void gather_context_free(ct_gather_context_t* gather_context) {
+    if (gather_context->plan_nodes) {
+        free_candidate_array(gather_context->plan_nodes);
+        gather_context->plan_nodes = NULL;
+    }
+    if (gather_context->endpoints) {
+        g_array_free(gather_context->endpoints, true);
+        gather_context->endpoints = NULL;
+    }
+    // Delivered candidates hold their own references
+    ct_candidate_arena_unref(gather_context->arena);
+    gather_context->arena = NULL;
+    if (gather_context->batch_timer) {
+        uv_timer_stop(gather_context->batch_timer);
+        uv_close((uv_handle_t*)gather_context->batch_timer,
+                 on_batch_timer_close_free_gather_context);
+        return;
+    }
+    free(gather_context);
+}
 
-    // Free data owned by tree (all non-leaf nodes)
-    g_node_traverse(root_node, G_IN_ORDER, G_TRAVERSE_ALL, -1, free_data_in_tree_node_and_children,
-                    NULL);
+static void deliver_candidate_array(ct_gather_context_t* gather_context, GArray* candidate_array) {
+    ct_candidate_gathering_callbacks_t* callbacks = &gather_context->gathering_callbacks;
+    if (callbacks->candidate_node_batch_cb) {
+        callbacks->candidate_node_batch_cb(candidate_array, true, callbacks->context);
+    } else {
+        callbacks->candidate_node_array_ready_cb(candidate_array, callbacks->context);
+    }
+}
 
-    g_node_destroy(root_node);
+void candidate_gathering_is_complete_cb(ct_gather_context_t* gather_context) {
+    if (gather_context->failed) {
+        log_error("Candidate gathering failed, not proceeding to sorting and callback");
+        deliver_candidate_array(gather_context, NULL);
+        gather_context_free(gather_context);
+        return;
+    }
+    const ct_preconnection_t* precon = gather_context->preconnection;
+
+    log_info("Candidate gathering complete, building candidate nodes");
+    GArray* candidate_array = gather_context->local_only
+                                  ? take_local_candidates(gather_context)
+                                  : take_undelivered_candidates(gather_context);
+    if (!candidate_array) {
+        deliver_candidate_array(gather_context, NULL);
+        gather_context_free(gather_context);
+        return;
+    }
 
     log_trace("Sorting candidates based in desirability");
-    g_array_sort_with_data(
-        root_array, compare_prefer_and_avoid_preferences,
-        (gpointer)&ct_preconnection_get_transport_properties(precon)->selection_properties);
+    g_array_sort_with_data(candidate_array, compare_prefer_and_avoid_preferences,
+                           (gpointer)&precon->selection_masks);
 
-    if (root_array->len > 0) {
+    if (candidate_array->len > 0) {
         log_trace("Most desirable candidate protocol is: %s",
-                  (g_array_index(root_array, ct_candidate_node_t, 0))
+                  (g_array_index(candidate_array, ct_candidate_node_t, 0))
                       .protocol_candidate->protocol_impl->name);
     } else {
         log_warn("No candidate nodes found after pruning");
     }
-    gather_context->gathering_callbacks.candidate_node_array_ready_cb(
-        root_array, gather_context->gathering_callbacks.context);
-    free(gather_context);
+    if (gather_context->plan_nodes) {
+        // Earlier batches were sorted on their own, the plan is sorted as a whole
+        ct_candidate_array_append_copies(gather_context->plan_nodes, candidate_array);
+        g_array_sort_with_data(gather_context->plan_nodes, compare_prefer_and_avoid_preferences,
+                               (gpointer)&precon->selection_masks);
+        ct_candidate_plan_compile(precon->candidate_plan, gather_context->plan_nodes);
+        gather_context->plan_nodes = NULL;
+    }
+    deliver_candidate_array(gather_context, candidate_array);
+    gather_context_free(gather_context);
 }
 
 int ct_get_ordered_candidate_nodes(const ct_preconnection_t* precon,
@@ -819,15 +770,17 @@ int ct_get_ordered_candidate_nodes(const ct_preconnection_t* precon,
     gather_context->gathering_callbacks = callbacks;
     gather_context->pending_resolutions = 0;
     gather_context->num_in_flight = 0;
-    gather_context->root_node = NULL;
     gather_context->preconnection = precon;
     gather_context->local_only = false;
+    if (precon->candidate_plan && ct_dns_cache_get_ttl() > 0) {
+        gather_context->plan_nodes = g_array_new(false, false, sizeof(ct_candidate_node_t));
+    }
 
     // This is async and calls the ready function on completion or failure
-    int rc = ct_build_candidate_tree(gather_context);
+    int rc = ct_build_candidate_tables(gather_context);
     if (rc != 0) {
-        free(gather_context);
-        log_error("Could not build candidate tree");
+        gather_context_free(gather_context);
+        log_error("Could not build candidate tables");
         return rc;
     }
     return 0;
@@ -847,16 +800,15 @@ int ct_get_ordered_local_candidate_nodes(const ct_preconnection_t* precon,
     gather_context->gathering_callbacks = callbacks;
     gather_context->pending_resolutions = 0;
     gather_context->num_in_flight = 0;
-    gather_context->root_node = NULL;
     gather_context->preconnection = precon;
     gather_context->local_only = true;
 
     // Synchronous in the local-only case (no DNS resolution), but we go through
-    // the same tree-building path for consistency.
-    int rc = ct_build_candidate_tree(gather_context);
+    // the same table-building path for consistency.
+    int rc = ct_build_candidate_tables(gather_context);
     if (rc != 0) {
-        free(gather_context);
-        log_error("Could not build local candidate tree");
+        gather_context_free(gather_context);
+        log_error("Could not build local candidate tables");
         return rc;
     }
     return 0;
@@ -864,17 +816,24 @@ int ct_get_ordered_local_candidate_nodes(const ct_preconnection_t* precon,
 
 void free_candidate_array(GArray* candidate_array) {
     for (guint i = 0; i < candidate_array->len; i++) {
-        const ct_candidate_node_t candidate_node =
-            g_array_index(candidate_array, ct_candidate_node_t, i);
-        ct_local_endpoint_free(candidate_node.local_endpoint);
-        if (candidate_node.remote_endpoint) {
-            ct_remote_endpoint_free(candidate_node.remote_endpoint);
-        }
-        ct_protocol_candidate_free(candidate_node.protocol_candidate);
+        ct_candidate_node_free_content(&g_array_index(candidate_array, ct_candidate_node_t, i));
     }
     g_array_free(candidate_array, true);
 }
 
+void ct_candidate_node_free_content(ct_candidate_node_t* candidate_node) {
+    if (candidate_node->arena) {
+        // The endpoints and protocol candidate belong to the arena
+        ct_candidate_arena_unref(candidate_node->arena);
+        return;
+    }
+    ct_local_endpoint_free(candidate_node->local_endpoint);
+    if (candidate_node->remote_endpoint) {
+        ct_remote_endpoint_free(candidate_node->remote_endpoint);
+    }
+    ct_protocol_candidate_free(candidate_node->protocol_candidate);
+}
+
 ct_protocol_candidate_t* ct_protocol_candidate_new(const ct_protocol_impl_t* protocol_impl,
                                                    const char* alpn) {
     ct_protocol_candidate_t* protocol_candidate = malloc(sizeof(ct_protocol_candidate_t));
@@ -890,6 +849,8 @@ ct_protocol_candidate_t* ct_protocol_candidate_new(const ct_protocol_impl_t* pro
     }
 
     protocol_candidate->protocol_impl = protocol_impl;
+    ct_selection_masks_compile(&protocol_impl->selection_properties,
+                               &protocol_candidate->capabilities);
     if (alpn) {
         protocol_candidate->alpn = strdup(alpn);
         if (!protocol_candidate->alpn) {
@@ -928,24 +889,77 @@ ct_candidate_node_t* ct_candidate_node_copy(const ct_candidate_node_t* candidate
     if (!candidate_node) {
         return NULL;
     }
+    if (candidate_node->arena) {
+        // Shares what the node points to by taking another reference to the arena
+        ct_candidate_node_t* copy = malloc(sizeof(ct_candidate_node_t));
+        if (!copy) {
+            log_error("Could not allocate memory for ct_candidate_node_t");
+            return NULL;
+        }
+        *copy = *candidate_node;
+        ct_candidate_arena_ref(copy->arena);
+        return copy;
+    }
     return candidate_node_new(candidate_node->type, candidate_node->local_endpoint,
                               candidate_node->remote_endpoint, candidate_node->protocol_candidate,
                               candidate_node->transport_properties);
 }
 
+int ct_candidate_array_append_copies(GArray* destination, const GArray* source) {
+    for (guint i = 0; i < source->len; i++) {
+        const ct_candidate_node_t* candidate_node =
+            &g_array_index(source, ct_candidate_node_t, i);
+        if (candidate_node->arena) {
+            ct_candidate_node_t copy = *candidate_node;
+            ct_candidate_arena_ref(copy.arena);
+            g_array_append_val(destination, copy);
+            continue;
+        }
+        ct_candidate_node_t* copy = ct_candidate_node_copy(candidate_node);
+        if (!copy) {
+            log_error("Could not copy candidate node");
+            return -ENOMEM;
+        }
+        g_array_append_val(destination, *copy);
+        free(copy);
+    }
+    return 0;
+}
+
 void ct_remote_resolve_call_context_free(ct_remote_resolve_call_context_t* context) {
     free(context);
 }
 
 ct_remote_resolve_call_context_t*
-ct_remote_resolve_call_context_new(GNode* root_node, ct_gather_context_t* gather_context) {
+ct_remote_resolve_call_context_split(ct_remote_resolve_call_context_t* context) {
+    ct_gather_context_t* gather_context = context->gather_context;
+    // Separate queries only pay off when the candidates are raced as they arrive
+    if (!gather_context || !gather_context->gathering_callbacks.candidate_node_batch_cb) {
+        return NULL;
+    }
+    ct_remote_resolve_call_context_t* aaaa_context =
+        ct_remote_resolve_call_context_new(context->protocol_index, gather_context);
+    if (!aaaa_context) {
+        return NULL;
+    }
+    aaaa_context->assigned_port = context->assigned_port;
+    aaaa_context->family = AF_INET6;
+    context->family = AF_INET;
+    gather_context->pending_resolutions++;
+    gather_context->num_in_flight++;
+    gather_context->num_aaaa_in_flight++;
+    return aaaa_context;
+}
+
+ct_remote_resolve_call_context_t*
+ct_remote_resolve_call_context_new(size_t protocol_index, ct_gather_context_t* gather_context) {
     ct_remote_resolve_call_context_t* context = malloc(sizeof(ct_remote_resolve_call_context_t));
     if (!context) {
         log_error("Could not allocate memory for ct_remote_resolve_call_context_t");
         return NULL;
     }
     memset(context, 0, sizeof(ct_remote_resolve_call_context_t));
-    context->parent_node = root_node;
+    context->protocol_index = protocol_index;
     context->gather_context = gather_context;
     return context;
 }
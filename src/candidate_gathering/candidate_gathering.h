@@ -2,7 +2,9 @@
 #define CANDIDATE_GATHERING_H
 
 #include <glib.h>
+#include <uv.h>
 
+#include "candidate_gathering/candidate_arena.h"
 #include "ctaps.h"
 #include "ctaps_internal.h"
 
@@ -17,11 +19,12 @@ typedef enum {
 /**
   * @brief A single combination of options from the ct_protocol_options_t struct
   *
-  * A single PROTOCOL node contains a single one of these.
+  * A single PROTOCOL candidate contains a single one of these.
   */
 typedef struct ct_protocol_candidate_s {
     const ct_protocol_impl_t* protocol_impl;
     char* alpn;
+    ct_selection_masks_t capabilities; // protocol_impl->selection_properties, compiled
 } ct_protocol_candidate_t;
 
 typedef struct ct_candidate_node_t {
@@ -34,34 +37,91 @@ typedef struct ct_candidate_node_t {
     ct_protocol_candidate_t* protocol_candidate;
 
     const ct_transport_properties_t* transport_properties;
+
+    // Holds a reference when the pointers above point into a gathering run's arena, NULL when
+    // the node owns them
+    ct_candidate_arena_t* arena;
 } ct_candidate_node_t;
 
+/**
+  * @brief A protocol on a local endpoint, the PROTOCOL level of the candidates.
+  */
+typedef struct ct_candidate_protocol_s {
+    size_t path_index; // Into ct_gather_context_t::paths
+    ct_protocol_candidate_t protocol_candidate;
+} ct_candidate_protocol_t;
+
+/**
+  * @brief A resolved remote endpoint for a protocol candidate, the ENDPOINT level.
+  */
+typedef struct ct_candidate_endpoint_s {
+    size_t protocol_index;                 // Into ct_gather_context_t::protocols
+    ct_remote_endpoint_t* remote_endpoint; // In the arena
+} ct_candidate_endpoint_t;
+
+// How long answers from A queries wait for the AAAA answers of the same lookup (RFC 8305)
+#define CT_RESOLUTION_DELAY_MS 50
+
 typedef struct ct_candidate_gathering_callbacks_s {
     void (*candidate_node_array_ready_cb)(GArray* candidate_array, void* context);
+    // Optional, replaces candidate_node_array_ready_cb. Candidates are delivered in batches as
+    // lookups complete instead of once all are done, is_last is set on the final batch.
+    void (*candidate_node_batch_cb)(GArray* candidate_array, bool is_last, void* context);
     void* context;
 } ct_candidate_gathering_callbacks_t;
 
 typedef struct ct_gather_context_s {
-    GNode* root_node;
     const ct_preconnection_t* preconnection;
+
+    // Flat candidate tables, incompatible local endpoints and protocols never make it in
+    ct_candidate_arena_t* arena;          // Owns everything the tables point to
+    ct_local_endpoint_t* paths;           // In the arena
+    size_t num_paths;
+    ct_candidate_protocol_t* protocols;   // In the arena, grouped by path
+    size_t num_protocols;
+    GArray* endpoints;                    // ct_candidate_endpoint_t, in the order answers arrived
+    size_t num_delivered;                 // Endpoints before this index went out in a batch
+
     size_t pending_resolutions;
     size_t num_in_flight;
     ct_candidate_gathering_callbacks_t gathering_callbacks;
     bool failed;
     bool local_only; // Set to true for preconnection_listen with no remote endpoints
+
+    // Batched delivery, only used with candidate_node_batch_cb
+    bool building;              // Lookups are still being started, batches wait for them
+    bool batch_delivered;       // Later answers are delivered without waiting
+    bool flush_without_delay;   // An answer arrived which should not wait for AAAA answers
+    bool has_undelivered;       // Endpoints were added since the last batch
+    size_t num_aaaa_in_flight;  // AAAA halves of split lookups which have not answered
+    uv_timer_t* batch_timer;    // Created on first use
+
+    GArray* plan_nodes; // Copies of every delivered candidate for the candidate plan, or NULL
 } ct_gather_context_t;
 
 typedef struct ct_remote_resolve_call_context_s {
-    GNode* parent_node;
+    size_t protocol_index; // The protocol candidate resolved addresses are added for
     ct_gather_context_t* gather_context;
     int32_t assigned_port;
+    int family; // AF_UNSPEC unless this is one half of a split A/AAAA lookup
 } ct_remote_resolve_call_context_t;
 
 void ct_remote_endpoint_resolve_cb(ct_remote_endpoint_t* remote_endpoint, size_t out_count,
                                    ct_remote_resolve_call_context_t* context);
 
 /**
-  * @brief Main entry point for candidate gathering. Builds the candidate tree and returns an ordered array of candidate nodes through the callback.
+  * @brief Split a hostname resolution into separate AAAA and A lookups.
+  *
+  * Sets the family of the given context to AF_INET and returns a new context for the AF_INET6
+  * lookup, both of which must be passed to ct_remote_endpoint_resolve_cb() once answered.
+  *
+  * @return The AAAA context, or NULL if the lookup should not be split
+  */
+ct_remote_resolve_call_context_t*
+ct_remote_resolve_call_context_split(ct_remote_resolve_call_context_t* context);
+
+/**
+  * @brief Main entry point for candidate gathering. Builds the candidate tables and returns an ordered array of candidate nodes through the callback.
   *
   * @param precon The preconnection containing all necessary information for candidate gathering.
   * @param callback The callback to be called when the candidate array is ready.
@@ -73,7 +133,7 @@ int ct_get_ordered_candidate_nodes(const ct_preconnection_t* precon,
 /**
   * @brief Candidate gathering for listeners, which have no remote endpoints.
   *
-  * Builds the candidate tree through PATH and PROTOCOL nodes only (no remote
+  * Builds the candidate tables through local endpoints and protocols only (no remote
   * endpoint resolution). Leaf nodes in the returned array will be of type
   * NODE_TYPE_PROTOCOL with remote_endpoint == NULL. Suitable for ranking
   * local interfaces and protocols before calling Listen.
@@ -87,6 +147,33 @@ int ct_get_ordered_local_candidate_nodes(const ct_preconnection_t* precon,
 
 void free_candidate_array(GArray* candidate_array);
 
+/**
+  * @brief Release what a candidate node holds, its arena reference or its own copies.
+  */
+void ct_candidate_node_free_content(ct_candidate_node_t* candidate_node);
+
+/**
+  * @brief Append a copy of every candidate node in source to destination.
+  *
+  * Nodes in an arena are copied by taking another reference to it, other nodes deep copied.
+  *
+  * @return 0 on success, -ENOMEM if a node could not be copied
+  */
+int ct_candidate_array_append_copies(GArray* destination, const GArray* source);
+
+/**
+  * @brief GCompareDataFunc ordering candidate nodes by their PREFER and then AVOID score.
+  *
+  * @param selection_masks The ct_selection_masks_t of the preconnection.
+  */
+gint compare_prefer_and_avoid_preferences(gconstpointer a, gconstpointer b,
+                                          gpointer selection_masks);
+
+ct_protocol_candidate_t* ct_protocol_candidate_new(const ct_protocol_impl_t* protocol_impl,
+                                                   const char* alpn);
+
+ct_candidate_node_t* ct_candidate_node_copy(const ct_candidate_node_t* candidate_node);
+
 void ct_protocol_candidate_free(ct_protocol_candidate_t* protocol_candidate);
 
 #endif //CANDIDATE_GATHERING_H
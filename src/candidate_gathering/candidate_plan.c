@@ -0,0 +1,82 @@
+#include "candidate_plan.h"
+
+#include "candidate_gathering/candidate_gathering.h"
+#include "endpoint/dns_cache.h"
+#include "endpoint/interface_cache.h"
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+struct ct_candidate_plan_s {
+    GArray* candidate_nodes; // NULL until compiled
+    uint64_t expires_at_ms;
+    uint64_t interface_generation; // Of the interface addresses the candidates were built from
+};
+
+// Does not need the event loop, plans are also compiled by gathering without one
+static uint64_t plan_now_ms(void) {
+    return uv_hrtime() / 1000000;
+}
+
+ct_candidate_plan_t* ct_candidate_plan_new(void) {
+    ct_candidate_plan_t* plan = calloc(1, sizeof(ct_candidate_plan_t));
+    if (!plan) {
+        log_error("Could not allocate memory for candidate plan");
+    }
+    return plan;
+}
+
+void ct_candidate_plan_invalidate(ct_candidate_plan_t* plan) {
+    if (!plan || !plan->candidate_nodes) {
+        return;
+    }
+    log_debug("Invalidating candidate plan with %u candidates", plan->candidate_nodes->len);
+    free_candidate_array(plan->candidate_nodes);
+    plan->candidate_nodes = NULL;
+}
+
+void ct_candidate_plan_free(ct_candidate_plan_t* plan) {
+    ct_candidate_plan_invalidate(plan);
+    free(plan);
+}
+
+void ct_candidate_plan_compile(ct_candidate_plan_t* plan, GArray* candidate_nodes) {
+    uint32_t ttl_ms = ct_dns_cache_get_ttl();
+    if (!plan || ttl_ms == 0 || candidate_nodes->len == 0) {
+        free_candidate_array(candidate_nodes);
+        return;
+    }
+    ct_candidate_plan_invalidate(plan);
+    plan->candidate_nodes = candidate_nodes;
+    plan->expires_at_ms = plan_now_ms() + ttl_ms;
+    plan->interface_generation = ct_interface_cache_generation();
+    log_debug("Compiled candidate plan with %u candidates", candidate_nodes->len);
+}
+
+GArray* ct_candidate_plan_instantiate(ct_candidate_plan_t* plan) {
+    if (!plan || !plan->candidate_nodes) {
+        return NULL;
+    }
+    if (plan_now_ms() >= plan->expires_at_ms || ct_dns_cache_get_ttl() == 0) {
+        log_debug("Candidate plan expired");
+        ct_candidate_plan_invalidate(plan);
+        return NULL;
+    }
+    if (ct_interface_cache_generation() != plan->interface_generation) {
+        log_debug("Interface addresses changed since the candidate plan was compiled");
+        ct_candidate_plan_invalidate(plan);
+        return NULL;
+    }
+
+    GArray* candidate_nodes =
+        g_array_sized_new(false, false, sizeof(ct_candidate_node_t), plan->candidate_nodes->len);
+    if (ct_candidate_array_append_copies(candidate_nodes, plan->candidate_nodes) != 0) {
+        log_error("Could not copy candidate nodes from candidate plan");
+        free_candidate_array(candidate_nodes);
+        return NULL;
+    }
+    return candidate_nodes;
+}
@@ -0,0 +1,40 @@
+#ifndef CT_CANDIDATE_PLAN_H
+#define CT_CANDIDATE_PLAN_H
+
+#include <glib.h>
+#include <stdint.h>
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+
+/**
+ * @brief The pruned and sorted candidates of a preconnection, reused across initiates.
+ *
+ * Transport properties and endpoints of a preconnection cannot change after creation, so a
+ * compiled plan stays valid until its resolved addresses expire with the DNS cache TTL or the
+ * interface addresses of the host change.
+ */
+typedef struct ct_candidate_plan_s ct_candidate_plan_t;
+
+ct_candidate_plan_t* ct_candidate_plan_new(void);
+
+void ct_candidate_plan_free(ct_candidate_plan_t* plan);
+
+/**
+ * @brief Replace the compiled candidates.
+ *
+ * @param[in] candidate_nodes Sorted ct_candidate_node_t array, the plan takes ownership of it
+ */
+void ct_candidate_plan_compile(ct_candidate_plan_t* plan, GArray* candidate_nodes);
+
+/**
+ * @brief Get a deep copy of the compiled candidates for a single race.
+ *
+ * @return Candidate array owned by the caller, or NULL if there is no valid plan
+ */
+GArray* ct_candidate_plan_instantiate(ct_candidate_plan_t* plan);
+
+// Forget the compiled candidates, the next initiate gathers them again
+void ct_candidate_plan_invalidate(ct_candidate_plan_t* plan);
+
+#endif // CT_CANDIDATE_PLAN_H
@@ -1,7 +1,9 @@
 #include "candidate_racing.h"
 
 #include "candidate_gathering/candidate_gathering.h"
+#include "candidate_gathering/candidate_plan.h"
 #include "connection/connection.h"
+#include "connection/connection_pool.h"
 #include "ctaps.h"
 #include "protocol/common/socket_utils.h"
 #include <endpoint/local_endpoint.h>
@@ -21,6 +23,7 @@ static void racing_on_attempt_ready(struct ct_connection_s* connection);
 static void on_attempt_establishment_error(ct_connection_t* connection);
 static void cancel_all_other_attempts(ct_racing_context_t* context, size_t winning_index);
 static int start_connection_attempt(ct_racing_context_t* context, ct_racing_attempt_t* attempt);
+void racing_context_index_endpoints(ct_racing_context_t* context, size_t first_attempt);
 void handle_concluded_attempt(ct_racing_context_t* context);
 
 void register_failed_attempt(ct_racing_context_t* context, ct_racing_attempt_t* attempt) {
@@ -88,11 +91,7 @@ static void on_timer_close_free_context(uv_handle_t* handle) {
         if (context->attempts != NULL) {
             for (size_t i = 0; i < context->num_attempts; i++) {
                 ct_racing_attempt_t* attempt = &context->attempts[i];
-                ct_protocol_candidate_free(attempt->candidate.protocol_candidate);
-
-                // Free candidate endpoints (they were copied)
-                ct_local_endpoint_free(attempt->candidate.local_endpoint);
-                ct_remote_endpoint_free(attempt->candidate.remote_endpoint);
+                ct_candidate_node_free_content(&attempt->candidate);
 
                 if (attempt->state != ATTEMPT_STATE_SUCCEEDED && attempt->connection) {
                     ct_connection_free(attempt->connection);
@@ -100,6 +99,16 @@ static void on_timer_close_free_context(uv_handle_t* handle) {
             }
             free(context->attempts);
         }
+        // Connections of started attempts hold their own references
+        ct_connection_shared_data_unref(context->endpoints);
+        if (context->local_endpoint_indices) {
+            g_hash_table_destroy(context->local_endpoint_indices);
+        }
+        if (context->remote_endpoint_indices) {
+            g_hash_table_destroy(context->remote_endpoint_indices);
+        }
+        free(context->pool_key);
+        free(context->destination_key);
         free(context);
     }
 }
@@ -113,17 +122,33 @@ void initiate_context_close(ct_racing_context_t* context) {
     uv_close((uv_handle_t*)context->stagger_timer, on_timer_close_free_context);
 }
 
-void handle_all_attempts_failed(ct_racing_context_t* context) {
-    log_error("All connection attempts have failed");
-    context->race_complete = true;
+static void notify_race_failed(ct_racing_context_t* context) {
     if (context->user_callbacks.establishment_error) {
         log_debug("Notifying user of establishment error via establishment_error callback");
         context->user_callbacks.establishment_error(NULL);
+    } else {
+        log_debug("No establishment_error callback provided by user");
+    }
+    // The plan may hold addresses which stopped working, gather again next time
+    ct_candidate_plan_invalidate(context->preconnection->candidate_plan);
+    if (context->race_failed_cb) {
+        context->race_failed_cb(context->race_failed_context);
     }
+}
+
+void handle_all_attempts_failed(ct_racing_context_t* context) {
+    log_error("All connection attempts have failed");
+    context->race_complete = true;
+    notify_race_failed(context);
     initiate_context_close(context);
 }
 
 void handle_concluded_attempt(ct_racing_context_t* context) {
+    if (!context->gathering_complete) {
+        // Candidates may still be added, the gathering callback calls this again when done
+        log_debug("Candidate gathering still in progress, not concluding the race yet");
+        return;
+    }
     if (all_attempts_failed(context)) {
         handle_all_attempts_failed(context);
     } else if (all_attempts_concluded(context)) {
@@ -131,8 +156,35 @@ void handle_concluded_attempt(ct_racing_context_t* context) {
     }
 }
 
+/**
+ * @brief Put candidates like the last winner to this destination first (RFC 9623 section 4.2.2).
+ *
+ * When the exact winner is first, it gets twice its last handshake time before the fallback
+ * starts instead of the usual connection attempt delay.
+ */
+static void racing_context_apply_destination_cache(ct_racing_context_t* context,
+                                                   GArray* candidate_nodes) {
+    ct_destination_winner_t winner;
+    if (!ct_destination_cache_lookup(context->destination_key, &winner)) {
+        return;
+    }
+    if (!ct_destination_cache_promote(&winner, candidate_nodes)) {
+        log_debug("Last winner is not among the candidates, racing similar candidates first");
+        return;
+    }
+    uint64_t fallback_ms = 2 * winner.handshake_ms;
+    if (fallback_ms < CT_MIN_CONNECTION_ATTEMPT_DELAY_MS) {
+        fallback_ms = CT_MIN_CONNECTION_ATTEMPT_DELAY_MS;
+    } else if (fallback_ms > CT_MAX_CONNECTION_ATTEMPT_DELAY_MS) {
+        fallback_ms = CT_MAX_CONNECTION_ATTEMPT_DELAY_MS;
+    }
+    context->winner_fallback_ms = fallback_ms;
+    log_debug("Starting with the last winner, falling back after %lu ms", fallback_ms);
+}
+
 static void racing_context_initialize_attempt_array(ct_racing_context_t* context,
                                                     GArray* candidate_nodes) {
+    racing_context_apply_destination_cache(context, candidate_nodes);
     context->num_attempts = candidate_nodes->len;
     // Allocate attempts array
     context->attempts = calloc(context->num_attempts, sizeof(ct_racing_attempt_t));
@@ -151,6 +203,7 @@ static void racing_context_initialize_attempt_array(ct_racing_context_t* context
         context->attempts[i].connection = NULL;
         context->attempts[i].context = context;
     }
+    racing_context_index_endpoints(context, 0);
 }
 
 /**
@@ -179,6 +232,10 @@ static ct_racing_context_t* racing_context_create(ct_connection_callbacks_t user
     context->initial_message = initial_message;
     context->initial_message_context = initial_message_context;
     context->should_try_early_data = should_try_early_data;
+    if (preconnection->coalesce_connections) {
+        context->pool_key = ct_connection_pool_key_new(preconnection);
+    }
+    context->destination_key = ct_destination_cache_key_new(preconnection);
 
     context->completed_attempts = 0;
 
@@ -187,6 +244,8 @@ static ct_racing_context_t* racing_context_create(ct_connection_callbacks_t user
     if (!context->stagger_timer) {
         log_error("Failed to allocate stagger timer");
         free(context->attempts);
+        free(context->pool_key);
+        free(context->destination_key);
         free(context);
         return NULL;
     }
@@ -238,6 +297,137 @@ static gboolean sockaddr_storage_equal(gconstpointer a, gconstpointer b) {
     return memcmp(a, b, sizeof(struct sockaddr_storage)) == 0;
 }
 
+static size_t endpoint_index(GHashTable* indices, const struct sockaddr_storage* address,
+                             size_t num_existing, GPtrArray* added, const void* endpoint) {
+    gpointer index = NULL;
+    if (g_hash_table_lookup_extended(indices, address, NULL, &index)) {
+        return GPOINTER_TO_SIZE(index);
+    }
+    size_t new_index = num_existing + added->len;
+    g_hash_table_insert(indices, (gpointer)address, GSIZE_TO_POINTER(new_index));
+    g_ptr_array_add(added, (gpointer)endpoint);
+    return new_index;
+}
+
+static ct_connection_shared_data_t* extend_endpoints(const ct_connection_shared_data_t* current,
+                                                     const GPtrArray* new_local,
+                                                     const GPtrArray* new_remote,
+                                                     const ct_framer_impl_t* framer_impl) {
+    size_t num_old_local = current ? current->num_local_endpoints : 0;
+    size_t num_old_remote = current ? current->num_remote_endpoints : 0;
+    size_t num_local = num_old_local + new_local->len;
+    size_t num_remote = num_old_remote + new_remote->len;
+    ct_local_endpoint_t* local_endpoints = calloc(num_local, sizeof(ct_local_endpoint_t));
+    ct_remote_endpoint_t* remote_endpoints = calloc(num_remote, sizeof(ct_remote_endpoint_t));
+    size_t num_local_copied = 0;
+    size_t num_remote_copied = 0;
+    int rc = local_endpoints && remote_endpoints ? 0 : -ENOMEM;
+
+    while (rc == 0 && num_local_copied < num_local) {
+        const ct_local_endpoint_t* source =
+            num_local_copied < num_old_local
+                ? &current->all_local_endpoints[num_local_copied]
+                : g_ptr_array_index(new_local, num_local_copied - num_old_local);
+        rc = ct_local_endpoint_copy_content(source, &local_endpoints[num_local_copied]);
+        num_local_copied += rc == 0;
+    }
+    while (rc == 0 && num_remote_copied < num_remote) {
+        const ct_remote_endpoint_t* source =
+            num_remote_copied < num_old_remote
+                ? &current->all_remote_endpoints[num_remote_copied]
+                : g_ptr_array_index(new_remote, num_remote_copied - num_old_remote);
+        rc = ct_remote_endpoint_copy_content(source, &remote_endpoints[num_remote_copied]);
+        num_remote_copied += rc == 0;
+    }
+
+    ct_connection_shared_data_t* endpoints = NULL;
+    if (rc == 0) {
+        endpoints = ct_connection_shared_data_new(local_endpoints, num_local, remote_endpoints,
+                                                  num_remote, framer_impl);
+    }
+    if (!endpoints) {
+        if (local_endpoints) {
+            ct_local_endpoints_free(local_endpoints, num_local_copied);
+        }
+        if (remote_endpoints) {
+            ct_remote_endpoints_free(remote_endpoints, num_remote_copied);
+        }
+    }
+    return endpoints;
+}
+
+/**
+ * @brief Give attempts from first_attempt on indices into the endpoint lists of the race.
+ *
+ * Candidates repeat the same endpoints for every protocol, so each distinct resolved address
+ * is copied once per race instead of once per attempt. Connections keep the block they were
+ * created with, so endpoints not seen before go into a new block starting with the old entries.
+ */
+void racing_context_index_endpoints(ct_racing_context_t* context, size_t first_attempt) {
+    if (!context->local_endpoint_indices) {
+        context->local_endpoint_indices =
+            g_hash_table_new(sockaddr_storage_hash, sockaddr_storage_equal);
+        context->remote_endpoint_indices =
+            g_hash_table_new(sockaddr_storage_hash, sockaddr_storage_equal);
+    }
+    ct_connection_shared_data_t* current = context->endpoints;
+    size_t num_local = current ? current->num_local_endpoints : 0;
+    size_t num_remote = current ? current->num_remote_endpoints : 0;
+    GPtrArray* new_local = g_ptr_array_new();
+    GPtrArray* new_remote = g_ptr_array_new();
+
+    // The keys point into the candidates, which live as long as the attempts
+    for (size_t i = first_attempt; i < context->num_attempts; i++) {
+        ct_racing_attempt_t* attempt = &context->attempts[i];
+        attempt->local_endpoint_index = endpoint_index(
+            context->local_endpoint_indices, &attempt->candidate.local_endpoint->resolved_address,
+            num_local, new_local, attempt->candidate.local_endpoint);
+        attempt->remote_endpoint_index = endpoint_index(
+            context->remote_endpoint_indices,
+            &attempt->candidate.remote_endpoint->resolved_address, num_remote, new_remote,
+            attempt->candidate.remote_endpoint);
+    }
+    log_debug("Racing %zu attempts over %zu local and %zu remote endpoints",
+              context->num_attempts, num_local + new_local->len, num_remote + new_remote->len);
+
+    if (current && new_local->len == 0 && new_remote->len == 0) {
+        g_ptr_array_free(new_local, true);
+        g_ptr_array_free(new_remote, true);
+        return;
+    }
+    ct_connection_shared_data_t* endpoints =
+        extend_endpoints(current, new_local, new_remote, context->preconnection->framer_impl);
+    if (endpoints) {
+        ct_connection_shared_data_unref(current);
+        context->endpoints = endpoints;
+    } else {
+        // These attempts fail when they are started
+        log_error("Failed to copy endpoints for %zu connection attempts",
+                  context->num_attempts - first_attempt);
+        for (guint i = 0; i < new_local->len; i++) {
+            const ct_local_endpoint_t* local_endpoint = g_ptr_array_index(new_local, i);
+            g_hash_table_remove(context->local_endpoint_indices,
+                                &local_endpoint->resolved_address);
+        }
+        for (guint i = 0; i < new_remote->len; i++) {
+            const ct_remote_endpoint_t* remote_endpoint = g_ptr_array_index(new_remote, i);
+            g_hash_table_remove(context->remote_endpoint_indices,
+                                &remote_endpoint->resolved_address);
+        }
+        for (size_t i = first_attempt; i < context->num_attempts; i++) {
+            ct_racing_attempt_t* attempt = &context->attempts[i];
+            if (attempt->local_endpoint_index >= num_local) {
+                attempt->local_endpoint_index = CT_RACING_NO_ENDPOINT;
+            }
+            if (attempt->remote_endpoint_index >= num_remote) {
+                attempt->remote_endpoint_index = CT_RACING_NO_ENDPOINT;
+            }
+        }
+    }
+    g_ptr_array_free(new_local, true);
+    g_ptr_array_free(new_remote, true);
+}
+
 /**
  * @brief Starts a single connection attempt.
  */
@@ -255,145 +445,50 @@ static int start_connection_attempt(ct_racing_context_t* context, ct_racing_atte
         .per_connection_context = attempt,
     };
 
-    log_debug("Removing duplicate remote endpoints for connection attempt");
-    // Because we get many duplicates of endpoints in our candidates
-    // e.g. separete candidates built like this {endpoint 1, protocol 1} and {endpoint 1, protocol 2}
-    // we remove duplicates of remote and local endpoints through this hashing mechanism. This is a bit
-    // of a hack which I threw together: Should really be replaced with some candidate gathering functionality
-    // to only gather unique endpoints or something.
-    ct_remote_endpoint_t* remote_endpoints = NULL;
-    size_t remote_counter = 0;
-    GHashTable* remote_hash = g_hash_table_new(sockaddr_storage_hash, sockaddr_storage_equal);
-    for (size_t i = 0; i < context->num_attempts; i++) {
-        if (!g_hash_table_contains(
-                remote_hash,
-                &context->attempts[i].candidate.remote_endpoint->resolved_address)) {
-            ct_remote_endpoint_t* tmp =
-                realloc(remote_endpoints, sizeof(ct_remote_endpoint_t) * (remote_counter + 1));
-            if (!tmp) {
-                log_error("Failed to allocate remote endpoints array for connection attempt");
-                for (size_t j = 0; j < remote_counter; j++) {
-                    ct_remote_endpoint_free_content(&remote_endpoints[j]);
-                }
-                free(remote_endpoints);
-                g_hash_table_destroy(remote_hash);
-                return -ENOMEM;
-            }
-            remote_endpoints = tmp;
-            g_hash_table_add(
-                remote_hash,
-                &context->attempts[i].candidate.remote_endpoint->resolved_address);
-            int rc = ct_remote_endpoint_copy_content(context->attempts[i].candidate.remote_endpoint,
-                                                     &remote_endpoints[remote_counter]);
-            if (rc != 0) {
-                log_error("Failed to copy remote endpoint for attempt %zu: %s", i, strerror(-rc));
-                for (size_t j = 0; j < remote_counter; j++) {
-                    ct_remote_endpoint_free_content(&remote_endpoints[j]);
-                }
-                free(remote_endpoints);
-                g_hash_table_destroy(remote_hash);
-                return rc;
-            }
-            remote_counter++;
-        }
-    }
-    g_hash_table_destroy(remote_hash);
-
-    log_debug("Removing duplicate local endpoints for connection attempt");
-    ct_local_endpoint_t* local_endpoints = NULL;
-    size_t local_endpoint_counter = 0;
-    GHashTable* local_hash = g_hash_table_new(sockaddr_storage_hash, sockaddr_storage_equal);
-    for (size_t i = 0; i < context->num_attempts; i++) {
-        if (!g_hash_table_contains(
-                local_hash,
-                &context->attempts[i].candidate.local_endpoint->resolved_address)) {
-            ct_local_endpoint_t* tmp = realloc(local_endpoints, sizeof(ct_local_endpoint_t) *
-                                                                    (local_endpoint_counter + 1));
-            if (!tmp) {
-                log_error("Failed to allocate local endpoints array for connection attempt");
-                for (size_t j = 0; j < local_endpoint_counter; j++) {
-                    ct_local_endpoint_free_content(&local_endpoints[j]);
-                }
-                free(local_endpoints);
-                g_hash_table_destroy(local_hash);
-                return -ENOMEM;
-            }
-            local_endpoints = tmp;
-            log_trace(
-                "Adding local endpoint for attempt %zu to hash table and local endpoints array", i);
-            g_hash_table_add(local_hash,
-                             &context->attempts[i].candidate.local_endpoint->resolved_address);
-            int rc = ct_local_endpoint_copy_content(context->attempts[i].candidate.local_endpoint,
-                                                    &local_endpoints[local_endpoint_counter]);
-            if (rc != 0) {
-                log_error("Failed to copy local endpoint for attempt %zu: %s", i, strerror(-rc));
-                for (size_t j = 0; j < local_endpoint_counter; j++) {
-                    ct_local_endpoint_free_content(&local_endpoints[j]);
-                }
-                free(local_endpoints);
-                g_hash_table_destroy(local_hash);
-                return rc;
-            }
-            local_endpoint_counter++;
-        }
-    }
-    g_hash_table_destroy(local_hash);
-    size_t active_remote_index = 0;
-    for (size_t i = 0; i < remote_counter; i++) {
-        if (memcmp(&remote_endpoints[i].resolved_address,
-                   &attempt->candidate.remote_endpoint->resolved_address,
-                   sizeof(struct sockaddr_storage)) == 0) {
-            active_remote_index = i;
-            break;
-        }
-    }
-
-    size_t active_local_index = 0;
-    for (size_t i = 0; i < local_endpoint_counter; i++) {
-        if (memcmp(&local_endpoints[i].resolved_address,
-                   &attempt->candidate.local_endpoint->resolved_address,
-                   sizeof(struct sockaddr_storage)) == 0) {
-            active_local_index = i;
-            break;
-        }
+    ct_connection_shared_data_t* endpoints = context->endpoints;
+    if (!endpoints || attempt->local_endpoint_index >= endpoints->num_local_endpoints ||
+        attempt->remote_endpoint_index >= endpoints->num_remote_endpoints) {
+        log_error("Endpoints of connection attempt %zu are missing from the race",
+                  attempt->attempt_index);
+        return -ENOMEM;
     }
-    log_debug("Initiating from active remote index: %zu", active_remote_index);
+    log_debug("Initiating from active remote index: %zu", attempt->remote_endpoint_index);
 
     char from_ip[INET6_ADDRSTRLEN];
     uint16_t from_port;
-
-    
-    ct_get_addr_string(&remote_endpoints[active_remote_index].resolved_address, from_ip, sizeof(from_ip), &from_port);
+    ct_get_addr_string(
+        &endpoints->all_remote_endpoints[attempt->remote_endpoint_index].resolved_address,
+        from_ip, sizeof(from_ip), &from_port);
     log_debug("Initiating connection attempt from %s:%d", from_ip, from_port);
 
+    // When branching we assign a single ALPN to each node (if the protocol supports ALPN)
+    // However the security parameters contain all the original ALPNs from the preconnection
+    // So to make sure that this connection attempt uses the ALPN from the candidate node
+    // it gets its own immutable parameters offering only that ALPN.
+    ct_security_parameters_t* attempt_security_parameters = NULL;
+    if (context->preconnection->security_parameters) {
+        attempt_security_parameters =
+            ct_security_parameters_with_alpn(context->preconnection->security_parameters,
+                                             attempt->candidate.protocol_candidate->alpn);
+        if (!attempt_security_parameters) {
+            log_error("Failed to create security parameters for connection attempt");
+            return -ENOMEM;
+        }
+    }
+
     // Allocate connection for this attempt
     attempt->connection = ct_connection_create_client(
-        candidate->protocol_candidate->protocol_impl, local_endpoints, local_endpoint_counter,
-        active_local_index, remote_endpoints, remote_counter, active_remote_index,
-        &context->preconnection->transport_properties,
-        context->preconnection->security_parameters, &attempt_callbacks,
-        context->preconnection->framer_impl);
+        candidate->protocol_candidate->protocol_impl, endpoints, attempt->local_endpoint_index,
+        attempt->remote_endpoint_index, &context->preconnection->transport_properties,
+        attempt_security_parameters, &attempt_callbacks);
+    // The connection holds its own reference
+    ct_security_parameters_free(attempt_security_parameters);
 
     if (!attempt->connection) {
         log_error("Failed to allocate connection for connection attempt");
-        ct_local_endpoints_free(local_endpoints, local_endpoint_counter);
-        ct_remote_endpoints_free(remote_endpoints, remote_counter);
         return -ENOMEM;
     }
 
-    if (context->preconnection->security_parameters) {
-        // When branching we assign a single ALPN to each node (if the protocol supports ALPN)
-        // However the security parameters contain all the original ALPNs from the preconnection
-        // So to make sure that this connection attempt uses the ALPN from the candidate node
-        // we just overwrite this (deeply copied) ALPN value
-        // The old ALPN value is freed in the setter.
-        ct_security_parameters_clear_alpn(attempt->connection->security_parameters);
-        if (attempt->candidate.protocol_candidate->alpn) {
-            ct_security_parameters_add_alpn(attempt->connection->security_parameters,
-                                            attempt->candidate.protocol_candidate->alpn);
-        }
-    }
-
     int rc = 0;
     if (context->should_try_early_data) {
         log_debug("Initiating racing connection attempt with early data");
@@ -422,6 +517,13 @@ void racing_on_attempt_ready(ct_connection_t* connection) {
     log_info("ct_connection_t attempt %zu succeeded with protocol %s", attempt->attempt_index,
              attempt->candidate.protocol_candidate->protocol_impl->name);
 
+    // Losing attempts which completed anyway measured the path just as well
+    const ct_protocol_impl_t* protocol_impl = connection->socket_manager->protocol_impl;
+    uint64_t rtt_us = 0;
+    if (protocol_impl->get_rtt && protocol_impl->get_rtt(connection, &rtt_us) == 0) {
+        ct_rtt_history_add_sample(&attempt->candidate.remote_endpoint->resolved_address, rtt_us);
+    }
+
     // Check if race is already complete (another attempt won)
     if (context->race_complete) {
         // If we reach this, we have already called ct_connection_close on this succesfull
@@ -432,12 +534,20 @@ void racing_on_attempt_ready(ct_connection_t* connection) {
 
     // Mark the race as complete
     register_succesful_attempt(context, attempt);
+    ct_destination_cache_record(context->destination_key, &attempt->candidate,
+                                uv_now(event_loop) - attempt->started_ms);
 
     cancel_all_other_attempts(context, attempt->attempt_index);
 
     // Restore the user's original callbacks (connection has the wrapped racing callbacks)
     connection->connection_callbacks = context->user_callbacks;
 
+    // Later initiates with the same pool key open streams in this group instead of racing
+    if (context->pool_key &&
+        connection->socket_manager->protocol_impl->protocol_enum == CT_PROTOCOL_QUIC) {
+        ct_connection_pool_add(context->pool_key, connection->connection_group);
+    }
+
     // If we didn't send the initial message as early data, send it now
     if (!context->should_try_early_data && context->initial_message) {
         log_debug("Sending initial message on winning connection");
@@ -479,6 +589,11 @@ static void on_attempt_establishment_error(ct_connection_t* connection) {
 
     log_info("ct_connection_t attempt %zu failed", attempt->attempt_index);
 
+    if (attempt->attempt_index == 0 && context->winner_fallback_ms > 0) {
+        log_debug("Last winner failed, forgetting it");
+        ct_destination_cache_remove(context->destination_key);
+    }
+
     // Check if race is already complete (another attempt won)
     if (context->race_complete) {
         log_debug("Race already complete, ignoring this failure");
@@ -555,14 +670,23 @@ static void initiate_next_attempt(ct_racing_context_t* context) {
              context->attempts[context->next_attempt_index].candidate.remote_endpoint->port);
 
     ct_racing_attempt_t* attempt = &context->attempts[context->next_attempt_index];
+    context->last_attempt_started_ms = uv_now(event_loop);
+    attempt->started_ms = context->last_attempt_started_ms;
+    // The next attempt waits about as long as this one should take to complete
+    if (attempt->attempt_index == 0 && context->winner_fallback_ms > 0) {
+        context->connection_attempt_delay_ms = context->winner_fallback_ms;
+    } else {
+        context->connection_attempt_delay_ms =
+            ct_rtt_history_attempt_delay_ms(&attempt->candidate.remote_endpoint->resolved_address);
+    }
 
     int rc = start_connection_attempt(context, attempt);
     if (rc != 0) {
         log_warn("Failed to start attempt %zu/%zu, error code: %d", context->next_attempt_index + 1,
                  context->num_attempts, rc);
         register_failed_attempt(context, attempt);
-        if (all_attempts_failed(context)) {
-            handle_all_attempts_failed(context);
+        if (context->race_complete) {
+            // That was the last attempt, and the context is closing
             return;
         }
     }
@@ -580,25 +704,18 @@ static void initiate_next_attempt(ct_racing_context_t* context) {
 
 void start_candidate_racing_on_nodes_ready(GArray* candidate_nodes, void* context) {
     ct_racing_context_t* racing_context = (ct_racing_context_t*)context;
-    ct_connection_callbacks_t connection_callbacks = racing_context->user_callbacks;
+    racing_context->gathering_complete = true;
 
     if (!candidate_nodes) {
         log_error("Could not allocate memory for candidate nodes");
-        if (connection_callbacks.establishment_error) {
-            connection_callbacks.establishment_error(NULL);
-        }
+        notify_race_failed(racing_context);
         racing_context_free(racing_context);
         return;
     }
     if (candidate_nodes->len == 0) {
         log_error("No compatible candidates found for racing");
         free_candidate_array(candidate_nodes);
-        if (connection_callbacks.establishment_error) {
-            log_debug("Notifying user of establishment error via establishment_error callback");
-            connection_callbacks.establishment_error(NULL);
-        } else {
-            log_debug("No establishment_error callback provided by user");
-        }
+        notify_race_failed(racing_context);
         racing_context_free(racing_context);
         return;
     }
@@ -616,14 +733,96 @@ void start_candidate_racing_on_nodes_ready(GArray* candidate_nodes, void* contex
     g_array_free(candidate_nodes, true);
 }
 
+/**
+ * @brief Appends candidates resolved after racing started to the attempts array.
+ *
+ * New attempts start where the stagger left off, following RFC 8305 section 4.
+ */
+static void racing_context_add_candidates(ct_racing_context_t* context, GArray* candidate_nodes) {
+    if (!candidate_nodes) {
+        return;
+    }
+    if (context->race_complete || candidate_nodes->len == 0) {
+        free_candidate_array(candidate_nodes);
+        return;
+    }
+    ct_racing_attempt_t* attempts =
+        realloc(context->attempts,
+                (context->num_attempts + candidate_nodes->len) * sizeof(ct_racing_attempt_t));
+    if (!attempts) {
+        log_error("Failed to grow attempts array, dropping %u candidates", candidate_nodes->len);
+        free_candidate_array(candidate_nodes);
+        return;
+    }
+    if (attempts != context->attempts) {
+        // Started attempts find themselves through their connection
+        for (size_t i = 0; i < context->num_attempts; i++) {
+            if (attempts[i].connection) {
+                attempts[i].connection->connection_callbacks.per_connection_context = &attempts[i];
+            }
+        }
+    }
+    context->attempts = attempts;
+
+    for (guint i = 0; i < candidate_nodes->len; i++) {
+        ct_racing_attempt_t* attempt = &context->attempts[context->num_attempts + i];
+        memset(attempt, 0, sizeof(ct_racing_attempt_t));
+        attempt->candidate = g_array_index(candidate_nodes, ct_candidate_node_t, i);
+        attempt->state = ATTEMPT_STATE_PENDING;
+        attempt->attempt_index = context->num_attempts + i;
+        attempt->context = context;
+    }
+    size_t first_new_attempt = context->num_attempts;
+    context->num_attempts += candidate_nodes->len;
+    racing_context_index_endpoints(context, first_new_attempt);
+    log_info("Added %u candidates to the race, %zu in total", candidate_nodes->len,
+             context->num_attempts);
+    g_array_free(candidate_nodes, true);
+
+    if (!uv_is_active((uv_handle_t*)context->stagger_timer)) {
+        uint64_t next_attempt_ms =
+            context->last_attempt_started_ms + context->connection_attempt_delay_ms;
+        uint64_t now = uv_now(event_loop);
+        uv_timer_start(context->stagger_timer, on_stagger_timer,
+                       next_attempt_ms > now ? next_attempt_ms - now : 0, 0);
+    }
+}
+
+/**
+ * @brief Races candidates as they are resolved instead of waiting for every lookup.
+ */
+static void racing_on_candidate_batch(GArray* candidate_nodes, bool is_last, void* context) {
+    ct_racing_context_t* racing_context = (ct_racing_context_t*)context;
+
+    if (!racing_context->attempts) {
+        if (is_last) {
+            start_candidate_racing_on_nodes_ready(candidate_nodes, context);
+            return;
+        }
+        racing_context_initialize_attempt_array(racing_context, candidate_nodes);
+        log_info("Racing with %d candidates while lookups are in flight", candidate_nodes->len);
+        initiate_next_attempt(racing_context);
+        g_array_free(candidate_nodes, true);
+        return;
+    }
+
+    racing_context_add_candidates(racing_context, candidate_nodes);
+    if (is_last) {
+        racing_context->gathering_complete = true;
+        handle_concluded_attempt(racing_context);
+    }
+}
+
 /**
  * @brief Main entry point for initiating connection with racing.
  */
-int start_candidate_racing(const ct_preconnection_t* preconnection,
-                           ct_connection_callbacks_t connection_callbacks,
-                           ct_message_t* initial_message,
-                           ct_message_context_t* initial_message_context,
-                           bool should_try_early_data) {
+static int start_candidate_racing_with_failure_cb(const ct_preconnection_t* preconnection,
+                                                  ct_connection_callbacks_t connection_callbacks,
+                                                  ct_message_t* initial_message,
+                                                  ct_message_context_t* initial_message_context,
+                                                  bool should_try_early_data,
+                                                  void (*race_failed_cb)(void* context),
+                                                  void* race_failed_context) {
 
     ct_racing_context_t* context =
         racing_context_create(connection_callbacks, preconnection, initial_message,
@@ -633,9 +832,20 @@ int start_candidate_racing(const ct_preconnection_t* preconnection,
         log_error("Failed to create racing context");
         return -ENOMEM;
     }
+    context->race_failed_cb = race_failed_cb;
+    context->race_failed_context = race_failed_context;
+
+    // Initiates of a preconnection with a compiled plan go straight to racing
+    GArray* planned_candidates = ct_candidate_plan_instantiate(preconnection->candidate_plan);
+    if (planned_candidates) {
+        log_debug("Racing %u candidates from the candidate plan", planned_candidates->len);
+        start_candidate_racing_on_nodes_ready(planned_candidates, context);
+        return 0;
+    }
 
     ct_candidate_gathering_callbacks_t gathering_callbacks = {
         .candidate_node_array_ready_cb = start_candidate_racing_on_nodes_ready,
+        .candidate_node_batch_cb = racing_on_candidate_batch,
         .context = context,
     };
 
@@ -648,6 +858,16 @@ int start_candidate_racing(const ct_preconnection_t* preconnection,
     return 0;
 }
 
+int start_candidate_racing(const ct_preconnection_t* preconnection,
+                           ct_connection_callbacks_t connection_callbacks,
+                           ct_message_t* initial_message,
+                           ct_message_context_t* initial_message_context,
+                           bool should_try_early_data) {
+    return start_candidate_racing_with_failure_cb(preconnection, connection_callbacks,
+                                                  initial_message, initial_message_context,
+                                                  should_try_early_data, NULL, NULL);
+}
+
 int preconnection_race_with_early_data(const ct_preconnection_t* preconnection,
                                        ct_connection_callbacks_t connection_callbacks,
                                        ct_message_t* initial_message,
@@ -669,6 +889,32 @@ int preconnection_race(const ct_preconnection_t* preconnection,
     return start_candidate_racing(preconnection, connection_callbacks, NULL, NULL, false);
 }
 
+int preconnection_race_with_failure_cb(const ct_preconnection_t* preconnection,
+                                       ct_connection_callbacks_t connection_callbacks,
+                                       void (*race_failed_cb)(void* context),
+                                       void* race_failed_context) {
+    return start_candidate_racing_with_failure_cb(preconnection, connection_callbacks, NULL, NULL,
+                                                  false, race_failed_cb, race_failed_context);
+}
+
+int preconnection_race_candidates_with_failure_cb(const ct_preconnection_t* preconnection,
+                                                  ct_connection_callbacks_t connection_callbacks,
+                                                  GArray* candidate_nodes,
+                                                  void (*race_failed_cb)(void* context),
+                                                  void* race_failed_context) {
+    ct_racing_context_t* context =
+        racing_context_create(connection_callbacks, preconnection, NULL, NULL, false);
+    if (!context) {
+        log_error("Failed to create racing context");
+        free_candidate_array(candidate_nodes);
+        return -ENOMEM;
+    }
+    context->race_failed_cb = race_failed_cb;
+    context->race_failed_context = race_failed_context;
+    start_candidate_racing_on_nodes_ready(candidate_nodes, context);
+    return 0;
+}
+
 /**
  * @brief Frees a racing context and all associated resources.
  *
@@ -7,9 +7,8 @@
 #include "ctaps.h"
 #include "ctaps_internal.h"
 #include "candidate_gathering.h"
-
-// Default connection attempt delay in milliseconds (per Happy Eyeballs RFC 8305)
-#define DEFAULT_CONNECTION_ATTEMPT_DELAY_MS 250
+#include "candidate_gathering/destination_cache.h"
+#include "candidate_gathering/rtt_history.h"
 
 // Represents the state of a single racing attempt
 typedef enum {
@@ -31,8 +30,15 @@ typedef struct ct_racing_attempt_t {
     ct_attempt_state_enum_t state;
     size_t attempt_index;
     ct_racing_context_t* context; // Back-pointer to parent racing context
+    // Into the endpoint lists of ct_racing_context_t::endpoints, CT_RACING_NO_ENDPOINT if the
+    // endpoint could not be added
+    size_t local_endpoint_index;
+    size_t remote_endpoint_index;
+    uint64_t started_ms;
 } ct_racing_attempt_t;
 
+#define CT_RACING_NO_ENDPOINT SIZE_MAX
+
 // Context for managing the racing process
 struct ct_racing_context_t {
     // Array of all racing attempts
@@ -50,14 +56,36 @@ struct ct_racing_context_t {
     // Racing state
     bool race_complete;
     int winning_attempt_index;
+    // Cleared while lookups are in flight, the race is only decided once no attempts can be added
+    bool gathering_complete;
 
     // Timer for staggered initiation
     uv_timer_t* stagger_timer;
-    uint64_t connection_attempt_delay_ms;
+    uint64_t connection_attempt_delay_ms; // For the last started attempt, from its RTT history
+    uint64_t last_attempt_started_ms;
+
+    // Remembers the winner for later races to the same destination, NULL without remote endpoints
+    char* destination_key;
+    // Set when the first attempt is the last winner, how long it gets before the fallback starts
+    uint64_t winner_fallback_ms;
 
     // ct_preconnection_t reference (for cleanup)
     const ct_preconnection_t* preconnection;
 
+    // Distinct local and remote endpoints of all attempts, shared by their connections.
+    // Replaced by a larger block when later candidates add endpoints, earlier entries keep
+    // their index.
+    ct_connection_shared_data_t* endpoints;
+    GHashTable* local_endpoint_indices;  // Resolved address -> index into endpoints
+    GHashTable* remote_endpoint_indices; // Resolved address -> index into endpoints
+
+    // Connection pool key the winning QUIC group is added under, NULL without coalescing
+    char* pool_key;
+
+    // Called after establishment_error(NULL) when the whole race failed, NULL if unused
+    void (*race_failed_cb)(void* context);
+    void* race_failed_context;
+
     // Count of attempts that have completed (success or failure)
     size_t completed_attempts;
 };
@@ -87,6 +115,29 @@ int preconnection_race_with_send_after_ready(const ct_preconnection_t* preconnec
 int preconnection_race(const ct_preconnection_t* preconnection,
                        ct_connection_callbacks_t connection_callbacks);
 
+/**
+ * @brief Race like preconnection_race(), and call race_failed_cb if no attempt succeeds.
+ *
+ * establishment_error() is called with a NULL connection when a race fails, so internal
+ * callers racing on behalf of some object use race_failed_context to find it again.
+ */
+int preconnection_race_with_failure_cb(const ct_preconnection_t* preconnection,
+                                       ct_connection_callbacks_t connection_callbacks,
+                                       void (*race_failed_cb)(void* context),
+                                       void* race_failed_context);
+
+/**
+ * @brief Race already gathered candidates, skipping gathering and the candidate plan.
+ *
+ * @param[in] candidate_nodes Sorted ct_candidate_node_t array, the race takes ownership of it
+ *            even when starting fails
+ */
+int preconnection_race_candidates_with_failure_cb(const ct_preconnection_t* preconnection,
+                                                  ct_connection_callbacks_t connection_callbacks,
+                                                  GArray* candidate_nodes,
+                                                  void (*race_failed_cb)(void* context),
+                                                  void* race_failed_context);
+
 /*
  * Callback for when a candidate node array is ready.
  */
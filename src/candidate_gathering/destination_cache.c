@@ -0,0 +1,180 @@
+#include "destination_cache.h"
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <endpoint/remote_endpoint.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <logging/log.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+typedef struct ct_destination_cache_entry_s {
+    ct_destination_winner_t winner;
+    uint64_t expires_at_ms;
+} ct_destination_cache_entry_t;
+
+// "remote=...|selection=..." -> ct_destination_cache_entry_t*
+static GHashTable* destination_cache = NULL;
+
+char* ct_destination_cache_key_new(const ct_preconnection_t* preconnection) {
+    if (!preconnection || preconnection->num_remote_endpoints == 0) {
+        return NULL;
+    }
+    GString* key = g_string_new("remote=");
+    for (size_t i = 0; i < preconnection->num_remote_endpoints; i++) {
+        ct_remote_endpoint_append_key(key, &preconnection->remote_endpoints[i]);
+    }
+    const ct_selection_masks_t* masks = &preconnection->selection_masks;
+    g_string_append_printf(key, "|selection=%" PRIx64 ",%" PRIx64 ",%" PRIx64 ",%" PRIx64,
+                           masks->require, masks->prohibit, masks->prefer, masks->avoid);
+
+    char* destination_key = strdup(key->str);
+    g_string_free(key, TRUE);
+    if (!destination_key) {
+        log_error("Failed to allocate memory for destination cache key");
+    }
+    return destination_key;
+}
+
+static void address_without_port(const struct sockaddr_storage* address,
+                                 struct sockaddr_storage* out) {
+    memset(out, 0, sizeof(*out));
+    out->ss_family = address->ss_family;
+    if (address->ss_family == AF_INET) {
+        ((struct sockaddr_in*)out)->sin_addr = ((const struct sockaddr_in*)address)->sin_addr;
+    } else if (address->ss_family == AF_INET6) {
+        ((struct sockaddr_in6*)out)->sin6_addr =
+            ((const struct sockaddr_in6*)address)->sin6_addr;
+        ((struct sockaddr_in6*)out)->sin6_scope_id =
+            ((const struct sockaddr_in6*)address)->sin6_scope_id;
+    }
+}
+
+static void destination_cache_evict_expired(uint64_t now) {
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, destination_cache);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        const ct_destination_cache_entry_t* entry = value;
+        if (now >= entry->expires_at_ms) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+void ct_destination_cache_record(const char* key, const ct_candidate_node_t* winner,
+                                 uint64_t handshake_ms) {
+    if (!key || !winner || !winner->protocol_candidate || !winner->remote_endpoint) {
+        return;
+    }
+    if (!destination_cache) {
+        destination_cache = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+    }
+    uint64_t now = uv_now(event_loop);
+    ct_destination_cache_entry_t* entry = g_hash_table_lookup(destination_cache, key);
+    if (!entry) {
+        if (g_hash_table_size(destination_cache) >= CT_DESTINATION_CACHE_MAX_ENTRIES) {
+            destination_cache_evict_expired(now);
+        }
+        if (g_hash_table_size(destination_cache) >= CT_DESTINATION_CACHE_MAX_ENTRIES) {
+            log_debug("Destination cache is full, not caching winner for %s", key);
+            return;
+        }
+        char* owned_key = strdup(key);
+        entry = calloc(1, sizeof(ct_destination_cache_entry_t));
+        if (!owned_key || !entry) {
+            log_error("Could not allocate memory for destination cache entry");
+            free(owned_key);
+            free(entry);
+            return;
+        }
+        g_hash_table_insert(destination_cache, owned_key, entry);
+    }
+    entry->winner.protocol = winner->protocol_candidate->protocol_impl->protocol_enum;
+    entry->winner.family = winner->remote_endpoint->resolved_address.ss_family;
+    if (winner->local_endpoint) {
+        address_without_port(&winner->local_endpoint->resolved_address,
+                             &entry->winner.local_address);
+    } else {
+        memset(&entry->winner.local_address, 0, sizeof(entry->winner.local_address));
+    }
+    entry->winner.handshake_ms = handshake_ms;
+    entry->expires_at_ms = now + CT_DESTINATION_CACHE_TTL_MS;
+    log_debug("Cached %s winner for %s, handshake took %lu ms",
+              winner->protocol_candidate->protocol_impl->name, key, handshake_ms);
+}
+
+bool ct_destination_cache_lookup(const char* key, ct_destination_winner_t* winner) {
+    if (!key || !destination_cache) {
+        return false;
+    }
+    const ct_destination_cache_entry_t* entry = g_hash_table_lookup(destination_cache, key);
+    if (!entry) {
+        return false;
+    }
+    if (uv_now(event_loop) >= entry->expires_at_ms) {
+        log_debug("Destination cache entry for %s expired", key);
+        g_hash_table_remove(destination_cache, key);
+        return false;
+    }
+    *winner = entry->winner;
+    return true;
+}
+
+void ct_destination_cache_remove(const char* key) {
+    if (key && destination_cache) {
+        g_hash_table_remove(destination_cache, key);
+    }
+}
+
+static int winner_match(const ct_destination_winner_t* winner,
+                        const ct_candidate_node_t* candidate_node) {
+    if (!candidate_node->protocol_candidate || !candidate_node->remote_endpoint ||
+        candidate_node->protocol_candidate->protocol_impl->protocol_enum != winner->protocol ||
+        candidate_node->remote_endpoint->resolved_address.ss_family != winner->family) {
+        return 0;
+    }
+    if (!candidate_node->local_endpoint) {
+        return 1;
+    }
+    struct sockaddr_storage local_address;
+    address_without_port(&candidate_node->local_endpoint->resolved_address, &local_address);
+    return memcmp(&local_address, &winner->local_address, sizeof(local_address)) == 0 ? 2 : 1;
+}
+
+bool ct_destination_cache_promote(const ct_destination_winner_t* winner,
+                                  GArray* candidate_nodes) {
+    if (!winner || !candidate_nodes || candidate_nodes->len == 0) {
+        return false;
+    }
+    // Stable partition into exact matches, partial matches and the rest
+    GArray* reordered = g_array_sized_new(FALSE, FALSE, sizeof(ct_candidate_node_t),
+                                          candidate_nodes->len);
+    for (int match = 2; match >= 0; match--) {
+        for (guint i = 0; i < candidate_nodes->len; i++) {
+            const ct_candidate_node_t* candidate_node =
+                &g_array_index(candidate_nodes, ct_candidate_node_t, i);
+            if (winner_match(winner, candidate_node) == match) {
+                g_array_append_vals(reordered, candidate_node, 1);
+            }
+        }
+    }
+    memcpy(candidate_nodes->data, reordered->data,
+           (size_t)candidate_nodes->len * sizeof(ct_candidate_node_t));
+    g_array_free(reordered, TRUE);
+    return winner_match(winner, &g_array_index(candidate_nodes, ct_candidate_node_t, 0)) == 2;
+}
+
+size_t ct_destination_cache_size(void) {
+    return destination_cache ? g_hash_table_size(destination_cache) : 0;
+}
+
+void ct_destination_cache_clear(void) {
+    if (destination_cache) {
+        g_hash_table_destroy(destination_cache);
+        destination_cache = NULL;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef DESTINATION_CACHE_H
+#define DESTINATION_CACHE_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "candidate_gathering/candidate_gathering.h"
+#include "ctaps.h"
+#include "ctaps_internal.h"
+
+// How long the winner of a race is remembered, RFC 9623 section 4.2.2
+#define CT_DESTINATION_CACHE_TTL_MS 600000
+#define CT_DESTINATION_CACHE_MAX_ENTRIES 256
+
+/**
+ * @brief The candidate which won the last race to a destination.
+ */
+typedef struct ct_destination_winner_s {
+    ct_protocol_enum_t protocol;
+    sa_family_t family;                     // Of the remote address
+    struct sockaddr_storage local_address;  // Without port, identifies the local interface
+    uint64_t handshake_ms;                  // From starting the attempt until it was ready
+} ct_destination_winner_t;
+
+/**
+ * @brief Key the races of a preconnection are cached under.
+ *
+ * Made of the remote endpoints and the selection properties, as those decide which candidates
+ * take part in a race.
+ *
+ * @return Newly allocated key, free with free(), or NULL without remote endpoints
+ */
+char* ct_destination_cache_key_new(const ct_preconnection_t* preconnection);
+
+/**
+ * @brief Remember the candidate which won a race.
+ *
+ * @param[in] key Key from ct_destination_cache_key_new(), copied
+ */
+void ct_destination_cache_record(const char* key, const ct_candidate_node_t* winner,
+                                 uint64_t handshake_ms);
+
+/**
+ * @brief Get the last winner for a destination, if it is recent enough.
+ *
+ * @return true if winner was filled in
+ */
+bool ct_destination_cache_lookup(const char* key, ct_destination_winner_t* winner);
+
+// Forget a destination, e.g. because its last winner failed
+void ct_destination_cache_remove(const char* key);
+
+/**
+ * @brief Move candidates like the last winner to the front, keeping the order otherwise.
+ *
+ * Candidates matching protocol, address family and local address come first, followed by
+ * those matching only protocol and address family.
+ *
+ * @param[in,out] candidate_nodes ct_candidate_node_t array to reorder
+ * @return true if the first candidate now matches the winner exactly
+ */
+bool ct_destination_cache_promote(const ct_destination_winner_t* winner, GArray* candidate_nodes);
+
+size_t ct_destination_cache_size(void);
+
+// Forget every destination
+void ct_destination_cache_clear(void);
+
+#endif // DESTINATION_CACHE_H
@@ -0,0 +1,141 @@
+#include "rtt_history.h"
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include "protocol/common/socket_utils.h"
+#include <arpa/inet.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+typedef struct ct_rtt_history_entry_s {
+    uint64_t srtt_us;
+    uint64_t rttvar_us;
+    uint64_t updated_at_ms;
+} ct_rtt_history_entry_t;
+
+// 0 when the delay is computed from the history
+static uint32_t fixed_attempt_delay_ms = 0;
+
+// Remote address without port -> ct_rtt_history_entry_t*
+static GHashTable* rtt_history = NULL;
+
+void ct_set_connection_attempt_delay(uint32_t delay_ms) {
+    log_debug("Setting connection attempt delay to %u ms", delay_ms);
+    fixed_attempt_delay_ms = delay_ms;
+}
+
+static bool rtt_history_key(const struct sockaddr_storage* remote_address, char* buffer,
+                            size_t buffer_len) {
+    if (remote_address->ss_family != AF_INET && remote_address->ss_family != AF_INET6) {
+        return false;
+    }
+    uint16_t port = 0;
+    ct_get_addr_string(remote_address, buffer, buffer_len, &port);
+    return true;
+}
+
+static bool rtt_history_entry_is_fresh(const ct_rtt_history_entry_t* entry, uint64_t now) {
+    return now < entry->updated_at_ms + CT_RTT_HISTORY_MAX_AGE_MS;
+}
+
+/**
+ * @brief Make room for one more destination, dropping stale ones or else the least recent.
+ */
+static void rtt_history_evict(uint64_t now) {
+    GHashTableIter iter;
+    gpointer key = NULL;
+    gpointer value = NULL;
+    gpointer oldest_key = NULL;
+    uint64_t oldest_update_ms = UINT64_MAX;
+    g_hash_table_iter_init(&iter, rtt_history);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const ct_rtt_history_entry_t* entry = value;
+        if (!rtt_history_entry_is_fresh(entry, now)) {
+            g_hash_table_iter_remove(&iter);
+        } else if (entry->updated_at_ms < oldest_update_ms) {
+            oldest_update_ms = entry->updated_at_ms;
+            oldest_key = key;
+        }
+    }
+    if (g_hash_table_size(rtt_history) >= CT_RTT_HISTORY_MAX_ENTRIES && oldest_key) {
+        g_hash_table_remove(rtt_history, oldest_key);
+    }
+}
+
+void ct_rtt_history_add_sample(const struct sockaddr_storage* remote_address, uint64_t rtt_us) {
+    char key[INET6_ADDRSTRLEN];
+    if (!rtt_history_key(remote_address, key, sizeof(key))) {
+        return;
+    }
+    if (!rtt_history) {
+        rtt_history = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+    }
+    uint64_t now = uv_now(event_loop);
+    ct_rtt_history_entry_t* entry = g_hash_table_lookup(rtt_history, key);
+    if (entry && rtt_history_entry_is_fresh(entry, now)) {
+        // RFC 6298 section 2.3
+        uint64_t deviation =
+            entry->srtt_us > rtt_us ? entry->srtt_us - rtt_us : rtt_us - entry->srtt_us;
+        entry->rttvar_us = (3 * entry->rttvar_us + deviation) / 4;
+        entry->srtt_us = (7 * entry->srtt_us + rtt_us) / 8;
+        entry->updated_at_ms = now;
+        log_trace("RTT of %s is now %lu us (+- %lu us)", key, entry->srtt_us, entry->rttvar_us);
+        return;
+    }
+    if (!entry) {
+        if (g_hash_table_size(rtt_history) >= CT_RTT_HISTORY_MAX_ENTRIES) {
+            rtt_history_evict(now);
+        }
+        char* owned_key = strdup(key);
+        entry = malloc(sizeof(ct_rtt_history_entry_t));
+        if (!owned_key || !entry) {
+            log_error("Could not allocate memory for RTT history entry");
+            free(owned_key);
+            free(entry);
+            return;
+        }
+        g_hash_table_insert(rtt_history, owned_key, entry);
+    }
+    // RFC 6298 section 2.2, a stale entry starts over as well
+    entry->srtt_us = rtt_us;
+    entry->rttvar_us = rtt_us / 2;
+    entry->updated_at_ms = now;
+    log_trace("First RTT sample of %s is %lu us", key, rtt_us);
+}
+
+uint64_t ct_rtt_history_attempt_delay_ms(const struct sockaddr_storage* remote_address) {
+    if (fixed_attempt_delay_ms > 0) {
+        return fixed_attempt_delay_ms;
+    }
+    char key[INET6_ADDRSTRLEN];
+    if (!rtt_history || !rtt_history_key(remote_address, key, sizeof(key))) {
+        return DEFAULT_CONNECTION_ATTEMPT_DELAY_MS;
+    }
+    const ct_rtt_history_entry_t* entry = g_hash_table_lookup(rtt_history, key);
+    if (!entry || !rtt_history_entry_is_fresh(entry, uv_now(event_loop))) {
+        return DEFAULT_CONNECTION_ATTEMPT_DELAY_MS;
+    }
+    // Round up, a handshake taking one RTO has not completed after RTO - 1 ms
+    uint64_t delay_ms = (entry->srtt_us + 4 * entry->rttvar_us + 999) / 1000;
+    if (delay_ms < CT_MIN_CONNECTION_ATTEMPT_DELAY_MS) {
+        return CT_MIN_CONNECTION_ATTEMPT_DELAY_MS;
+    }
+    if (delay_ms > CT_MAX_CONNECTION_ATTEMPT_DELAY_MS) {
+        return CT_MAX_CONNECTION_ATTEMPT_DELAY_MS;
+    }
+    return delay_ms;
+}
+
+size_t ct_rtt_history_size(void) {
+    return rtt_history ? g_hash_table_size(rtt_history) : 0;
+}
+
+void ct_rtt_history_clear(void) {
+    if (rtt_history) {
+        g_hash_table_destroy(rtt_history);
+        rtt_history = NULL;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef RTT_HISTORY_H
+#define RTT_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+// Connection attempt delay for destinations without RTT history (RFC 8305 section 5)
+#define DEFAULT_CONNECTION_ATTEMPT_DELAY_MS 250
+// Bounds of the delay computed from history, RFC 8305 section 5 forbids going below 10 ms and
+// advises against going above 2 seconds
+#define CT_MIN_CONNECTION_ATTEMPT_DELAY_MS 10
+#define CT_MAX_CONNECTION_ATTEMPT_DELAY_MS 2000
+
+// Samples older than this no longer say much about the path
+#define CT_RTT_HISTORY_MAX_AGE_MS 600000
+#define CT_RTT_HISTORY_MAX_ENTRIES 256
+
+/**
+ * @brief Add an RTT measured on an established connection to the history of its destination.
+ *
+ * Destinations are remote addresses without the port. Samples are smoothed as in RFC 6298.
+ *
+ * @param[in] remote_address Address the connection was established to
+ * @param[in] rtt_us Smoothed RTT reported by the protocol, in microseconds
+ */
+void ct_rtt_history_add_sample(const struct sockaddr_storage* remote_address, uint64_t rtt_us);
+
+/**
+ * @brief How long a race waits for an attempt to this destination before starting the next.
+ *
+ * The RTO computed from the history (SRTT + 4 * RTTVAR) clamped to the RFC 8305 bounds, or
+ * DEFAULT_CONNECTION_ATTEMPT_DELAY_MS without recent history. A delay set with
+ * ct_set_connection_attempt_delay() takes precedence.
+ */
+uint64_t ct_rtt_history_attempt_delay_ms(const struct sockaddr_storage* remote_address);
+
+size_t ct_rtt_history_size(void);
+
+// Forget every destination
+void ct_rtt_history_clear(void);
+
+#endif // RTT_HISTORY_H
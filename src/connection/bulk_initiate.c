@@ -0,0 +1,197 @@
+#include "bulk_initiate.h"
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <candidate_gathering/candidate_gathering.h>
+#include <candidate_gathering/candidate_racing.h>
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+struct ct_bulk_initiate_s {
+    // Private copy, races may outlive the user's preconnection
+    ct_preconnection_t* preconnection;
+    ct_connection_callbacks_t user_callbacks;
+    GArray* candidate_nodes; // Copied into every race, NULL until gathered
+
+    size_t num_connections;
+    size_t num_started;
+    size_t num_concluded; // Races which handed out a connection or failed
+    bool starting;        // Inside bulk_initiate_start_due_races()
+
+    uint64_t ramp_ms;
+    uint64_t ramp_started_ms;
+    uv_timer_t* ramp_timer;
+};
+
+static void on_ramp_timer_close_free_bulk(uv_handle_t* handle) {
+    ct_bulk_initiate_t* bulk = handle->data;
+    free(handle);
+    if (bulk->candidate_nodes) {
+        free_candidate_array(bulk->candidate_nodes);
+    }
+    ct_preconnection_free(bulk->preconnection);
+    free(bulk);
+}
+
+static void bulk_initiate_free(ct_bulk_initiate_t* bulk) {
+    log_debug("Freeing bulk initiate of %zu connections", bulk->num_connections);
+    uv_timer_stop(bulk->ramp_timer);
+    uv_close((uv_handle_t*)bulk->ramp_timer, on_ramp_timer_close_free_bulk);
+}
+
+static void bulk_initiate_conclude_race(ct_bulk_initiate_t* bulk) {
+    bulk->num_concluded++;
+    if (bulk->num_concluded == bulk->num_connections && !bulk->starting) {
+        bulk_initiate_free(bulk);
+    }
+}
+
+static void bulk_initiate_on_ready(ct_connection_t* connection) {
+    ct_bulk_initiate_t* bulk = connection->connection_callbacks.per_connection_context;
+    connection->connection_callbacks = bulk->user_callbacks;
+    if (connection->connection_callbacks.ready) {
+        connection->connection_callbacks.ready(connection);
+    }
+    bulk_initiate_conclude_race(bulk);
+}
+
+static void bulk_initiate_on_race_failed(void* context) {
+    bulk_initiate_conclude_race((ct_bulk_initiate_t*)context);
+}
+
+static void bulk_initiate_fail_race(ct_bulk_initiate_t* bulk) {
+    if (bulk->user_callbacks.establishment_error) {
+        bulk->user_callbacks.establishment_error(NULL);
+    }
+    bulk_initiate_conclude_race(bulk);
+}
+
+static void bulk_initiate_start_race(ct_bulk_initiate_t* bulk) {
+    bulk->num_started++;
+    GArray* candidate_nodes = g_array_sized_new(false, false, sizeof(ct_candidate_node_t),
+                                                bulk->candidate_nodes->len);
+    if (ct_candidate_array_append_copies(candidate_nodes, bulk->candidate_nodes) != 0) {
+        log_error("Failed to copy candidates for race %zu", bulk->num_started);
+        free_candidate_array(candidate_nodes);
+        bulk_initiate_fail_race(bulk);
+        return;
+    }
+    // Racing copies these onto the winner, ready() puts back the user's callbacks
+    ct_connection_callbacks_t callbacks = bulk->user_callbacks;
+    callbacks.ready = bulk_initiate_on_ready;
+    callbacks.per_connection_context = bulk;
+    int rc = preconnection_race_candidates_with_failure_cb(
+        bulk->preconnection, callbacks, candidate_nodes, bulk_initiate_on_race_failed, bulk);
+    if (rc != 0) {
+        log_error("Failed to start race %zu: %d", bulk->num_started, rc);
+        bulk_initiate_fail_race(bulk);
+    }
+}
+
+/**
+ * @brief Start every race whose turn on the ramp has come.
+ *
+ * Race i is due i * ramp_ms / num_connections after the first one.
+ */
+static void bulk_initiate_start_due_races(ct_bulk_initiate_t* bulk) {
+    size_t num_due = bulk->num_connections;
+    if (bulk->ramp_ms > 0) {
+        uint64_t elapsed_ms = uv_now(event_loop) - bulk->ramp_started_ms;
+        num_due = (size_t)(elapsed_ms * bulk->num_connections / bulk->ramp_ms) + 1;
+        if (num_due > bulk->num_connections) {
+            num_due = bulk->num_connections;
+        }
+    }
+    bulk->starting = true;
+    while (bulk->num_started < num_due) {
+        bulk_initiate_start_race(bulk);
+    }
+    bulk->starting = false;
+
+    if (bulk->num_started == bulk->num_connections) {
+        uv_timer_stop(bulk->ramp_timer);
+        if (bulk->num_concluded == bulk->num_connections) {
+            bulk_initiate_free(bulk);
+        }
+    }
+}
+
+static void on_ramp_timer(uv_timer_t* handle) {
+    bulk_initiate_start_due_races((ct_bulk_initiate_t*)handle->data);
+}
+
+static void bulk_initiate_on_candidates_ready(GArray* candidate_nodes, void* context) {
+    ct_bulk_initiate_t* bulk = context;
+    if (!candidate_nodes || candidate_nodes->len == 0) {
+        log_error("No candidates for bulk initiate, failing all %zu connections",
+                  bulk->num_connections);
+        if (candidate_nodes) {
+            free_candidate_array(candidate_nodes);
+        }
+        bulk->starting = true;
+        while (bulk->num_started < bulk->num_connections) {
+            bulk->num_started++;
+            bulk_initiate_fail_race(bulk);
+        }
+        bulk->starting = false;
+        bulk_initiate_free(bulk);
+        return;
+    }
+    log_info("Racing %zu connections over %u shared candidates", bulk->num_connections,
+             candidate_nodes->len);
+    bulk->candidate_nodes = candidate_nodes;
+    bulk->ramp_started_ms = uv_now(event_loop);
+    if (bulk->ramp_ms > 0 && bulk->num_connections > 1) {
+        uint64_t interval_ms = bulk->ramp_ms / bulk->num_connections;
+        if (interval_ms == 0) {
+            interval_ms = 1;
+        }
+        uv_timer_start(bulk->ramp_timer, on_ramp_timer, interval_ms, interval_ms);
+    }
+    bulk_initiate_start_due_races(bulk);
+}
+
+int ct_bulk_initiate_start(ct_preconnection_t* preconnection, GArray* candidate_nodes,
+                           size_t num_connections, uint64_t ramp_ms,
+                           const ct_connection_callbacks_t* connection_callbacks) {
+    ct_bulk_initiate_t* bulk = calloc(1, sizeof(ct_bulk_initiate_t));
+    uv_timer_t* ramp_timer = malloc(sizeof(uv_timer_t));
+    if (!bulk || !ramp_timer) {
+        log_error("Failed to allocate bulk initiate");
+        free(bulk);
+        free(ramp_timer);
+        if (candidate_nodes) {
+            free_candidate_array(candidate_nodes);
+        }
+        ct_preconnection_free(preconnection);
+        return -ENOMEM;
+    }
+    bulk->preconnection = preconnection;
+    bulk->user_callbacks = *connection_callbacks;
+    bulk->num_connections = num_connections;
+    bulk->ramp_ms = ramp_ms;
+    bulk->ramp_timer = ramp_timer;
+    uv_timer_init(event_loop, bulk->ramp_timer);
+    bulk->ramp_timer->data = bulk;
+
+    if (candidate_nodes) {
+        log_debug("Bulk initiate uses %u candidates from the candidate plan", candidate_nodes->len);
+        bulk_initiate_on_candidates_ready(candidate_nodes, bulk);
+        return 0;
+    }
+    ct_candidate_gathering_callbacks_t gathering_callbacks = {
+        .candidate_node_array_ready_cb = bulk_initiate_on_candidates_ready,
+        .context = bulk,
+    };
+    int rc = ct_get_ordered_candidate_nodes(bulk->preconnection, gathering_callbacks);
+    if (rc != 0) {
+        log_error("Synchronous error in getting ordered candidate nodes: %d", rc);
+        bulk_initiate_free(bulk);
+        return rc;
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef CT_BULK_INITIATE_H
+#define CT_BULK_INITIATE_H
+
+#include <glib.h>
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+
+/**
+ * @brief Many connections initiated from a single gathering pass.
+ *
+ * Candidates are gathered once, or taken from the preconnection's candidate plan, and every
+ * connection races its own copy of them. Races are started evenly spread over a ramp, so the
+ * handshakes do not all hit the remote at once.
+ */
+typedef struct ct_bulk_initiate_s ct_bulk_initiate_t;
+
+/**
+ * @brief Start initiating num_connections connections.
+ *
+ * Each connection is passed to the ready() callback, each failed race calls
+ * establishment_error() with a NULL connection. The bulk initiate frees itself once every
+ * race has concluded.
+ *
+ * @param[in] preconnection Private copy to race with, taken over even on failure
+ * @param[in] candidate_nodes Candidates from the user's candidate plan, taken over, or NULL to
+ *            gather them
+ * @param[in] ramp_ms Races are started evenly spread over this long, 0 to start all at once
+ * @return 0 on success, negative errno on synchronous failure in which case no callback is
+ *         called
+ */
+int ct_bulk_initiate_start(ct_preconnection_t* preconnection, GArray* candidate_nodes,
+                           size_t num_connections, uint64_t ramp_ms,
+                           const ct_connection_callbacks_t* connection_callbacks);
+
+#endif // CT_BULK_INITIATE_H
@@ -2,6 +2,7 @@
 #include "connection/connection.h"
 
 #include "connection/connection_group.h"
+#include "connection/send_pacer.h"
 #include "connection/socket_manager/socket_manager.h"
 #include "ctaps.h"
 #include "ctaps_internal.h"
@@ -13,6 +14,7 @@
 #include "protocol/common/socket_utils.h"
 #include "util/uuid_util.h"
 #include <assert.h>
+#include <errno.h>
 #include <glib.h>
 #include <logging/log.h>
 #include <security_parameter/security_parameters.h>
@@ -31,12 +33,150 @@ ct_connection_t* ct_connection_create_empty_with_uuid(void) {
     memset(connection, 0, sizeof(ct_connection_t));
     generate_uuid_string(connection->uuid);
 
-    connection->received_callbacks = g_queue_new();
-    connection->received_messages = g_queue_new();
+    g_queue_init(&connection->received_callbacks);
+    g_queue_init(&connection->received_messages);
     connection->properties.priority = CT_CONNECTION_DEFAULT_PRIORITY; // Default priority
+    connection->send_rate = CT_CONN_RATE_UNLIMITED;
     return connection;
 }
 
+void ct_connection_shared_data_unref(ct_connection_shared_data_t* shared_data) {
+    if (!shared_data) {
+        return;
+    }
+    assert(shared_data->ref_count > 0);
+    if (--shared_data->ref_count > 0) {
+        return;
+    }
+    if (shared_data->all_local_endpoints) {
+        ct_local_endpoints_free(shared_data->all_local_endpoints, shared_data->num_local_endpoints);
+    }
+    if (shared_data->all_remote_endpoints) {
+        ct_remote_endpoints_free(shared_data->all_remote_endpoints,
+                                 shared_data->num_remote_endpoints);
+    }
+    ct_framer_impl_free(shared_data->framer_impl);
+    free(shared_data);
+}
+
+ct_connection_shared_data_t* ct_connection_shared_data_new(ct_local_endpoint_t* local_endpoints,
+                                                           size_t num_local_endpoints,
+                                                           ct_remote_endpoint_t* remote_endpoints,
+                                                           size_t num_remote_endpoints,
+                                                           const ct_framer_impl_t* framer_impl) {
+    ct_connection_shared_data_t* shared_data = malloc(sizeof(ct_connection_shared_data_t));
+    if (!shared_data) {
+        log_error("Failed to allocate shared connection data");
+        return NULL;
+    }
+    memset(shared_data, 0, sizeof(ct_connection_shared_data_t));
+    if (framer_impl) {
+        shared_data->framer_impl = ct_framer_impl_deep_copy(framer_impl);
+        if (!shared_data->framer_impl) {
+            free(shared_data);
+            return NULL;
+        }
+    }
+    shared_data->all_local_endpoints = local_endpoints;
+    shared_data->num_local_endpoints = num_local_endpoints;
+    shared_data->all_remote_endpoints = remote_endpoints;
+    shared_data->num_remote_endpoints = num_remote_endpoints;
+    shared_data->ref_count = 1; // Held by the caller
+    return shared_data;
+}
+
+// Copy the connection's fields into a block that its clones can reference.
+// The connection keeps its own copies, so its memory layout never changes under a caller.
+static ct_connection_shared_data_t* connection_get_shared_data(ct_connection_t* connection) {
+    if (connection->shared_data) {
+        return connection->shared_data;
+    }
+    ct_connection_shared_data_t* shared_data = malloc(sizeof(ct_connection_shared_data_t));
+    if (!shared_data) {
+        log_error("Failed to allocate shared data for connection %s", connection->uuid);
+        return NULL;
+    }
+    memset(shared_data, 0, sizeof(ct_connection_shared_data_t));
+    shared_data->ref_count = 1; // Held by the connection itself
+
+    if (connection->all_local_endpoints && connection->num_local_endpoints > 0) {
+        shared_data->all_local_endpoints = ct_local_endpoints_deep_copy(
+            connection->all_local_endpoints, connection->num_local_endpoints);
+        if (!shared_data->all_local_endpoints) {
+            goto fail;
+        }
+        shared_data->num_local_endpoints = connection->num_local_endpoints;
+    }
+    if (connection->all_remote_endpoints && connection->num_remote_endpoints > 0) {
+        shared_data->all_remote_endpoints = ct_remote_endpoints_deep_copy(
+            connection->all_remote_endpoints, connection->num_remote_endpoints);
+        if (!shared_data->all_remote_endpoints) {
+            goto fail;
+        }
+        shared_data->num_remote_endpoints = connection->num_remote_endpoints;
+    }
+    if (connection->framer_impl) {
+        shared_data->framer_impl = ct_framer_impl_deep_copy(connection->framer_impl);
+        if (!shared_data->framer_impl) {
+            goto fail;
+        }
+    }
+
+    connection->shared_data = shared_data;
+    return shared_data;
+
+fail:
+    log_error("Failed to copy shared data for connection %s", connection->uuid);
+    ct_connection_shared_data_unref(shared_data);
+    return NULL;
+}
+
+int ct_connection_detach_shared_data(ct_connection_t* connection) {
+    ct_connection_shared_data_t* shared_data = connection->shared_data;
+    if (!shared_data) {
+        return 0;
+    }
+    log_trace("Detaching connection %s from shared data", connection->uuid);
+
+    // Copy everything first, so a failed allocation leaves the connection untouched
+    ct_local_endpoint_t* local_endpoints = connection->all_local_endpoints;
+    ct_remote_endpoint_t* remote_endpoints = connection->all_remote_endpoints;
+    ct_framer_impl_t* framer_impl = connection->framer_impl;
+    if (local_endpoints && local_endpoints == shared_data->all_local_endpoints) {
+        local_endpoints =
+            ct_local_endpoints_deep_copy(local_endpoints, connection->num_local_endpoints);
+    }
+    if (remote_endpoints && remote_endpoints == shared_data->all_remote_endpoints) {
+        remote_endpoints =
+            ct_remote_endpoints_deep_copy(remote_endpoints, connection->num_remote_endpoints);
+    }
+    if (framer_impl && framer_impl == shared_data->framer_impl) {
+        framer_impl = ct_framer_impl_deep_copy(framer_impl);
+    }
+    if ((connection->all_local_endpoints && !local_endpoints) ||
+        (connection->all_remote_endpoints && !remote_endpoints) ||
+        (connection->framer_impl && !framer_impl)) {
+        log_error("Failed to copy shared data for connection %s", connection->uuid);
+        if (local_endpoints && local_endpoints != connection->all_local_endpoints) {
+            ct_local_endpoints_free(local_endpoints, connection->num_local_endpoints);
+        }
+        if (remote_endpoints && remote_endpoints != connection->all_remote_endpoints) {
+            ct_remote_endpoints_free(remote_endpoints, connection->num_remote_endpoints);
+        }
+        if (framer_impl != connection->framer_impl) {
+            ct_framer_impl_free(framer_impl);
+        }
+        return -ENOMEM;
+    }
+
+    connection->all_local_endpoints = local_endpoints;
+    connection->all_remote_endpoints = remote_endpoints;
+    connection->framer_impl = framer_impl;
+    connection->shared_data = NULL;
+    ct_connection_shared_data_unref(shared_data);
+    return 0;
+}
+
 ct_connection_t* ct_connection_create_server_connection(
     ct_socket_manager_t* socket_manager, const ct_remote_endpoint_t* remote_endpoint,
     const ct_local_endpoint_t* local_endpoint, 
@@ -81,7 +221,7 @@ ct_connection_t* ct_connection_create_server_connection(
 
     connection->role = CT_CONNECTION_ROLE_SERVER;
 
-    connection->security_parameters = ct_security_parameters_deep_copy(security_parameters);
+    connection->security_parameters = ct_security_parameters_share(security_parameters);
     if (framer_impl) {
         connection->framer_impl = ct_framer_impl_deep_copy(framer_impl);
         if (!connection->framer_impl) {
@@ -104,12 +244,11 @@ ct_connection_t* ct_connection_create_server_connection(
 }
 
 ct_connection_t* ct_connection_create_client(
-    const ct_protocol_impl_t* protocol_impl, ct_local_endpoint_t* local_endpoints,
-    size_t num_local_endpoints, size_t local_endpoint_index, ct_remote_endpoint_t* remote_endpoints,
-    size_t num_remote_endpoints, size_t remote_endpoint_index,
+    const ct_protocol_impl_t* protocol_impl, ct_connection_shared_data_t* shared_data,
+    size_t local_endpoint_index, size_t remote_endpoint_index,
     const ct_transport_properties_t* transport_properties,
     const ct_security_parameters_t* security_parameters,
-    const ct_connection_callbacks_t* connection_callbacks, const ct_framer_impl_t* framer_impl) {
+    const ct_connection_callbacks_t* connection_callbacks) {
     log_debug("Creating client connection to remote endpoint");
     ct_connection_t* connection = ct_connection_create_empty_with_uuid();
     if (!connection) {
@@ -117,13 +256,17 @@ ct_connection_t* ct_connection_create_client(
         return NULL;
     }
 
-    connection->all_local_endpoints = local_endpoints;
+    // Endpoints and framer are taken by reference, see ct_connection_detach_shared_data()
+    shared_data->ref_count++;
+    connection->shared_data = shared_data;
+    connection->all_local_endpoints = shared_data->all_local_endpoints;
     connection->active_local_endpoint = local_endpoint_index;
-    connection->num_local_endpoints = num_local_endpoints;
+    connection->num_local_endpoints = shared_data->num_local_endpoints;
 
-    connection->all_remote_endpoints = remote_endpoints;
+    connection->all_remote_endpoints = shared_data->all_remote_endpoints;
     connection->active_remote_endpoint = remote_endpoint_index;
-    connection->num_remote_endpoints = num_remote_endpoints;
+    connection->num_remote_endpoints = shared_data->num_remote_endpoints;
+    connection->framer_impl = shared_data->framer_impl;
 
     ct_remote_endpoint_t* active_remote_endpoint =
         &connection->all_remote_endpoints[connection->active_remote_endpoint];
@@ -165,20 +308,12 @@ ct_connection_t* ct_connection_create_client(
         return NULL;
     }
 
-    connection->security_parameters = ct_security_parameters_deep_copy(security_parameters);
+    connection->security_parameters = ct_security_parameters_share(security_parameters);
     if (connection_callbacks) {
         connection->connection_callbacks = *connection_callbacks;
     } else {
         log_debug("No connection callbacks provided for client connection, using empty callbacks");
     }
-    if (framer_impl) {
-        connection->framer_impl = ct_framer_impl_deep_copy(framer_impl);
-        if (!connection->framer_impl) {
-            log_error("Failed to copy framer implementation for connection");
-            ct_connection_free(connection);
-            return NULL;
-        }
-    }
 
     return connection;
 }
@@ -187,6 +322,16 @@ ct_connection_t* ct_connection_create_clone(const ct_connection_t* source_connec
                                             ct_socket_manager_t* socket_manager,
                                             const ct_framer_impl_t* framer_impl,
                                             void* internal_connection_state) {
+    bool inherits_framer = !framer_impl || framer_impl == source_connection->framer_impl;
+    ct_connection_shared_data_t* shared_data = NULL;
+    if (inherits_framer) {
+        // Attaching shared data leaves the content of the source unchanged
+        shared_data = connection_get_shared_data((ct_connection_t*)source_connection);
+        if (!shared_data) {
+            return NULL;
+        }
+    }
+
     ct_connection_t* clone = ct_connection_create_empty_with_uuid();
     if (!clone) {
         log_error("Failed to create empty connection for clone");
@@ -194,40 +339,48 @@ ct_connection_t* ct_connection_create_clone(const ct_connection_t* source_connec
     }
 
     clone->properties.state = CT_CONN_STATE_ESTABLISHING;
-    clone->security_parameters =
-        ct_security_parameters_deep_copy(source_connection->security_parameters);
-
-    clone->all_remote_endpoints = ct_remote_endpoints_deep_copy(
-        source_connection->all_remote_endpoints, source_connection->num_remote_endpoints);
+    clone->security_parameters = ct_security_parameters_share(source_connection->security_parameters);
     clone->num_remote_endpoints = source_connection->num_remote_endpoints;
     clone->active_remote_endpoint = source_connection->active_remote_endpoint;
-
-    clone->all_local_endpoints = ct_local_endpoints_deep_copy(
-        source_connection->all_local_endpoints, source_connection->num_local_endpoints);
     clone->num_local_endpoints = source_connection->num_local_endpoints;
     clone->active_local_endpoint = source_connection->active_local_endpoint;
-    // In the cases where a socket manager isn't provided, the protocol will insert
-    // a custom one to the new connection after cloning
-    if (socket_manager) {
-        ct_socket_manager_add_connection(socket_manager, clone);
-    }
-
-    clone->role = source_connection->role;
-    if (framer_impl) {
-        clone->framer_impl = ct_framer_impl_deep_copy(framer_impl);
-        if (!clone->framer_impl) {
-            log_error("Failed to copy framer implementation for connection clone");
+    // Clones share the socket of their source, so they are bound to the same address
+    if (source_connection->has_bound_local_endpoint) {
+        if (ct_local_endpoint_copy_content(&source_connection->bound_local_endpoint,
+                                           &clone->bound_local_endpoint) < 0) {
+            log_error("Failed to copy bound local endpoint for connection clone");
             ct_connection_free(clone);
             return NULL;
         }
-    } else if (source_connection->framer_impl) {
-        clone->framer_impl = ct_framer_impl_deep_copy(source_connection->framer_impl);
+        clone->has_bound_local_endpoint = true;
+    }
+    if (shared_data) {
+        // Endpoints and framer are taken by reference, see ct_connection_detach_shared_data()
+        shared_data->ref_count++;
+        clone->shared_data = shared_data;
+        clone->all_remote_endpoints = shared_data->all_remote_endpoints;
+        clone->all_local_endpoints = shared_data->all_local_endpoints;
+        clone->framer_impl = shared_data->framer_impl;
+    } else {
+        clone->all_remote_endpoints = ct_remote_endpoints_deep_copy(
+            source_connection->all_remote_endpoints, source_connection->num_remote_endpoints);
+        clone->all_local_endpoints = ct_local_endpoints_deep_copy(
+            source_connection->all_local_endpoints, source_connection->num_local_endpoints);
+        clone->framer_impl = ct_framer_impl_deep_copy(framer_impl);
         if (!clone->framer_impl) {
-            log_error("Failed to copy framer implementation from source connection for connection clone");
+            log_error("Failed to copy framer implementation for connection clone");
             ct_connection_free(clone);
             return NULL;
         }
     }
+
+    // In the cases where a socket manager isn't provided, the protocol will insert
+    // a custom one to the new connection after cloning
+    if (socket_manager) {
+        ct_socket_manager_add_connection(socket_manager, clone);
+    }
+
+    clone->role = source_connection->role;
     clone->connection_callbacks = source_connection->connection_callbacks;
     clone->internal_connection_state = internal_connection_state;
 
@@ -242,7 +395,9 @@ void ct_connection_set_can_receive(ct_connection_t* connection, bool can_receive
     }
     log_trace("Setting canReceive to %s for connection %s", can_receive ? "true" : "false",
               connection->uuid);
+    ct_connection_group_uncount_member(connection);
     connection->properties.can_receive = can_receive;
+    ct_connection_group_count_member(connection);
 }
 
 void ct_connection_set_can_send(ct_connection_t* connection, bool can_send) {
@@ -250,7 +405,9 @@ void ct_connection_set_can_send(ct_connection_t* connection, bool can_send) {
         log_error("Connection is NULL in ct_connection_set_can_send");
         return;
     }
+    ct_connection_group_uncount_member(connection);
     connection->properties.can_send = can_send;
+    ct_connection_group_count_member(connection);
 }
 
 void ct_connection_mark_as_established(ct_connection_t* connection) {
@@ -258,7 +415,9 @@ void ct_connection_mark_as_established(ct_connection_t* connection) {
         log_error("Connection is NULL in ct_connection_mark_as_established");
         return;
     }
+    ct_connection_group_uncount_member(connection);
     connection->properties.state = CT_CONN_STATE_ESTABLISHED;
+    ct_connection_group_count_member(connection);
     ct_connection_set_can_send(connection, true);
     ct_connection_set_can_receive(connection, true);
     log_trace("Marked connection %s as established", connection->uuid);
@@ -269,7 +428,9 @@ void ct_connection_mark_as_closing(ct_connection_t* connection) {
         log_error("Connection is NULL in ct_connection_mark_as_closing");
         return;
     }
+    ct_connection_group_uncount_member(connection);
     connection->properties.state = CT_CONN_STATE_CLOSING;
+    ct_connection_group_count_member(connection);
     log_trace("Marked connection %s as closing", connection->uuid);
 }
 
@@ -278,7 +439,9 @@ void ct_connection_mark_as_closed(ct_connection_t* connection) {
         log_error("Connection is NULL in ct_connection_mark_as_closed");
         return;
     }
+    ct_connection_group_uncount_member(connection);
     connection->properties.state = CT_CONN_STATE_CLOSED;
+    ct_connection_group_count_member(connection);
     log_trace("Marked connection %s as closed", connection->uuid);
 }
 
@@ -430,14 +593,9 @@ int ct_receive_message(ct_connection_t* connection, const ct_receive_callbacks_t
         return -EINVAL;
     }
     log_trace("User attempting to receive message on connection: %s", connection->uuid);
-    if (!connection->received_messages || !connection->received_callbacks) {
-        log_error("ct_connection_t queues not initialized for receiving messages");
-        return -EIO;
-    }
-
-    if (!g_queue_is_empty(connection->received_messages)) {
+    if (!g_queue_is_empty(&connection->received_messages)) {
         log_trace("Calling receive callback immediately");
-        ct_queued_message_t* queued_message = g_queue_pop_head(connection->received_messages);
+        ct_queued_message_t* queued_message = g_queue_pop_head(&connection->received_messages);
         queued_message->context->per_receive_context = receive_callbacks->per_receive_context;
         if (receive_callbacks->receive_callback) {
             receive_callbacks->receive_callback(connection, queued_message->message,
@@ -461,8 +619,8 @@ int ct_receive_message(ct_connection_t* connection, const ct_receive_callbacks_t
     // If we don't have a message to receive, add the callback to the queue of
     // waiting callbacks
     log_trace("No message ready, pushing receive callback to queue %p",
-              (void*)connection->received_callbacks);
-    g_queue_push_tail(connection->received_callbacks, ptr);
+              (void*)&connection->received_callbacks);
+    g_queue_push_tail(&connection->received_callbacks, ptr);
     return 0;
 }
 
@@ -473,52 +631,62 @@ void ct_connection_close(ct_connection_t* connection) {
         return;
     }
     ct_connection_mark_as_closing(connection);
+    if (connection->send_pacer && ct_send_pacer_has_pending(connection->send_pacer)) {
+        log_debug("Deferring close of %s until paced messages are sent", connection->uuid);
+        connection->send_pacer->close_pending = true;
+        return;
+    }
     ct_socket_manager_close_connection(connection);
 }
 
+static void connection_clear_bound_local_endpoint(ct_connection_t* connection) {
+    if (!connection->has_bound_local_endpoint) {
+        return;
+    }
+    ct_local_endpoint_free_content(&connection->bound_local_endpoint);
+    memset(&connection->bound_local_endpoint, 0, sizeof(ct_local_endpoint_t));
+    connection->has_bound_local_endpoint = false;
+}
+
 void ct_connection_free_content(ct_connection_t* connection) {
     if (!connection) {
         return;
     }
     log_debug("Freeing content of connection: %s", connection->uuid);
 
-    if (connection->received_callbacks) {
-        // Free any pending callbacks in the queue
-        while (!g_queue_is_empty(connection->received_callbacks)) {
-            ct_receive_callbacks_t* callback = g_queue_pop_head(connection->received_callbacks);
-            if (callback) {
-                free(callback);
-            }
-        }
-        g_queue_free(connection->received_callbacks);
-        connection->received_callbacks = NULL;
+    // Free any pending callbacks in the queue
+    while (!g_queue_is_empty(&connection->received_callbacks)) {
+        free(g_queue_pop_head(&connection->received_callbacks));
     }
 
-    if (connection->received_messages) {
-        // Free any pending messages in the queue
-        while (!g_queue_is_empty(connection->received_messages)) {
-            ct_queued_message_t* q_msg = g_queue_pop_head(connection->received_messages);
-            ct_queued_message_free_all(q_msg);
-        }
-        g_queue_free(connection->received_messages);
-        connection->received_messages = NULL;
+    // Free any pending messages in the queue
+    while (!g_queue_is_empty(&connection->received_messages)) {
+        ct_queued_message_free_all(g_queue_pop_head(&connection->received_messages));
     }
 
-    if (connection->all_local_endpoints) {
+    // Fields that still point into shared_data are released with it
+    ct_connection_shared_data_t* shared_data = connection->shared_data;
+    if (connection->all_local_endpoints &&
+        (!shared_data || connection->all_local_endpoints != shared_data->all_local_endpoints)) {
         ct_local_endpoints_free(connection->all_local_endpoints, connection->num_local_endpoints);
-        connection->all_local_endpoints = NULL;
     }
-    if (connection->all_remote_endpoints) {
+    connection->all_local_endpoints = NULL;
+    connection_clear_bound_local_endpoint(connection);
+    if (connection->all_remote_endpoints &&
+        (!shared_data || connection->all_remote_endpoints != shared_data->all_remote_endpoints)) {
         ct_remote_endpoints_free(connection->all_remote_endpoints,
                                  connection->num_remote_endpoints);
-        connection->all_remote_endpoints = NULL;
     }
-
-    // Free security parameters (connection owns a deep copy)
-    if (connection->security_parameters) {
-        ct_security_parameters_free(connection->security_parameters);
-        connection->security_parameters = NULL;
+    connection->all_remote_endpoints = NULL;
+    // Immutable, so every connection holds its own reference
+    ct_security_parameters_free(connection->security_parameters);
+    connection->security_parameters = NULL;
+    if (!shared_data || connection->framer_impl != shared_data->framer_impl) {
+        ct_framer_impl_free(connection->framer_impl);
     }
+    connection->framer_impl = NULL;
+    ct_connection_shared_data_unref(shared_data);
+    connection->shared_data = NULL;
 
     // This needs to happen before unreferencing socket manager, since
     // connection group needs to reach through to free connection group state
@@ -539,7 +707,8 @@ void ct_connection_free_content(ct_connection_t* connection) {
         ct_socket_manager_unref(socket_manager);
         connection->socket_manager = NULL;
     }
-    ct_framer_impl_free(connection->framer_impl);
+    ct_send_pacer_free(connection->send_pacer);
+    connection->send_pacer = NULL;
 }
 
 void ct_connection_free(ct_connection_t* connection) {
@@ -549,7 +718,12 @@ void ct_connection_free(ct_connection_t* connection) {
 
 int ct_connection_send_to_protocol(ct_connection_t* connection, ct_message_t* message,
                                    ct_message_context_t* context) {
-    int rc = connection->socket_manager->protocol_impl->send(connection, message, context);
+    int rc = 0;
+    if (connection->send_pacer) {
+        rc = ct_send_pacer_submit(connection->send_pacer, message, context);
+    } else {
+        rc = connection->socket_manager->protocol_impl->send(connection, message, context);
+    }
     if (rc < 0) {
         log_error("Error sending message to protocol: %d", rc);
     }
@@ -559,13 +733,13 @@ int ct_connection_send_to_protocol(ct_connection_t* connection, ct_message_t* me
 void ct_connection_deliver_to_app(ct_connection_t* connection, ct_message_t* message,
                                   ct_message_context_t* context) {
     // Check if there's a waiting receive callback
-    if (g_queue_is_empty(connection->received_callbacks)) {
+    if (g_queue_is_empty(&connection->received_callbacks)) {
         log_trace("No receive callback ready, queueing message");
         ct_queued_message_t* queued_message = ct_queued_message_new(message, context);
-        g_queue_push_tail(connection->received_messages, queued_message);
+        g_queue_push_tail(&connection->received_messages, queued_message);
     } else {
         log_trace("Receive callback ready for connection: %s, calling it", connection->uuid);
-        ct_receive_callbacks_t* receive_callback = g_queue_pop_head(connection->received_callbacks);
+        ct_receive_callbacks_t* receive_callback = g_queue_pop_head(&connection->received_callbacks);
 
         if (!context) {
             log_warn("Message context is NULL, allocating new context");
@@ -608,8 +782,32 @@ void ct_connection_on_protocol_receive(ct_connection_t* connection, const void*
     }
 }
 
+int ct_connection_on_protocol_receive_datagram(ct_connection_t* connection, const void* data,
+                                               size_t len) {
+    ct_message_t* received_message =
+        len > 0 ? ct_message_new_with_content(data, len) : ct_message_new();
+    if (!received_message) {
+        log_error("Failed to allocate memory for received datagram");
+        return -ENOMEM;
+    }
+    ct_message_context_t* context = ct_message_context_new_from_connection(connection);
+    if (!context) {
+        log_error("Failed to allocate memory for message context");
+        ct_message_free(received_message);
+        return -ENOMEM;
+    }
+    ct_message_properties_set_reliable(&context->message_properties, false);
+
+    // A datagram is a whole message already, so it does not go through the framer
+    ct_connection_deliver_to_app(connection, received_message, context);
+    return 0;
+}
+
 void ct_connection_abort(ct_connection_t* connection) {
     log_info("Aborting connection: %s", connection->uuid);
+    if (connection->send_pacer) {
+        ct_send_pacer_fail_pending(connection->send_pacer, -ECONNABORTED);
+    }
     connection->socket_manager->protocol_impl->abort(connection);
 }
 
@@ -653,12 +851,12 @@ size_t ct_connection_get_total_num_grouped_connections(const ct_connection_t* co
     }
 
     ct_connection_group_t* group = connection->connection_group;
-    if (!group || !group->connections) {
+    if (!group) {
         log_error("Connection %s has no valid connection group", connection->uuid);
         return 0;
     }
 
-    return g_hash_table_size(group->connections);
+    return group->num_members;
 }
 
 size_t ct_connection_get_num_open_grouped_connections(const ct_connection_t* connection) {
@@ -668,23 +866,12 @@ size_t ct_connection_get_num_open_grouped_connections(const ct_connection_t* con
     }
 
     ct_connection_group_t* group = connection->connection_group;
-    if (!group || !group->connections) {
+    if (!group) {
         log_error("Connection %s has no valid connection group", connection->uuid);
         return 0;
     }
 
-    size_t num_active = 0;
-    GHashTableIter iter;
-    gpointer key, value;
-
-    g_hash_table_iter_init(&iter, group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* conn = (ct_connection_t*)value;
-        if (!ct_connection_is_closed(conn)) {
-            num_active++;
-        }
-    }
-    return num_active;
+    return group->num_open;
 }
 
 const char* ct_connection_get_protocol_name(const ct_connection_t* connection) {
@@ -709,6 +896,9 @@ ct_connection_get_active_local_endpoint(const ct_connection_t* connection) {
         log_error("ct_connection_get_local_endpoint called with NULL connection");
         return NULL;
     }
+    if (connection->has_bound_local_endpoint) {
+        return &connection->bound_local_endpoint;
+    }
     return &connection->all_local_endpoints[connection->active_local_endpoint];
 }
 
@@ -810,6 +1000,79 @@ int ct_connection_set_priority(ct_connection_t* connection, uint8_t priority) {
     return 0;
 }
 
+int ct_connection_apply_send_rate(ct_connection_t* connection) {
+    if (!connection || !connection->connection_group ||
+        !connection->connection_group->transport_properties || !connection->socket_manager) {
+        return 0;
+    }
+    const ct_transport_properties_t* transport_properties =
+        connection->connection_group->transport_properties;
+    uint64_t rate = ct_send_pacer_effective_rate(
+        ct_transport_properties_get_min_send_rate(transport_properties),
+        ct_transport_properties_get_max_send_rate(transport_properties));
+    if (rate == connection->send_rate) {
+        return 0;
+    }
+
+    int rc = ct_socket_manager_notify_protocol_of_send_rate_change(connection, rate);
+    if (rc == 0) {
+        log_debug("Protocol paces connection %s at %llu bit/s", connection->uuid,
+                  (unsigned long long)rate);
+        if (connection->send_pacer) {
+            // Release anything queued before the protocol took over
+            ct_send_pacer_set_rate(connection->send_pacer, CT_CONN_RATE_UNLIMITED);
+        }
+        connection->send_rate = rate;
+        return 0;
+    }
+    if (rc != -ENOTSUP) {
+        log_error("Failed to set send rate on connection %s: %d", connection->uuid, rc);
+        return rc;
+    }
+
+    if (connection->send_pacer) {
+        ct_send_pacer_set_rate(connection->send_pacer, rate);
+    } else {
+        connection->send_pacer = ct_send_pacer_new(connection, rate);
+        if (!connection->send_pacer) {
+            return -ENOMEM;
+        }
+    }
+    log_debug("Pacing connection %s at %llu bit/s", connection->uuid, (unsigned long long)rate);
+    connection->send_rate = rate;
+    return 0;
+}
+
+int ct_connection_set_send_rate(ct_connection_t* connection, uint64_t min_send_rate,
+                                uint64_t max_send_rate) {
+    if (!connection || !connection->connection_group ||
+        !connection->connection_group->transport_properties) {
+        log_error("ct_connection_set_send_rate called with NULL connection");
+        return -EINVAL;
+    }
+    if (min_send_rate != CT_CONN_RATE_UNLIMITED && min_send_rate > max_send_rate) {
+        log_error("minSendRate %llu exceeds maxSendRate %llu", (unsigned long long)min_send_rate,
+                  (unsigned long long)max_send_rate);
+        return -EINVAL;
+    }
+    ct_connection_group_t* group = connection->connection_group;
+    ct_transport_properties_set_min_send_rate(group->transport_properties, min_send_rate);
+    ct_transport_properties_set_max_send_rate(group->transport_properties, max_send_rate);
+
+    int result = 0;
+    for (ct_connection_t* member = group->members; member; member = member->group_next) {
+        if (!ct_connection_is_established(member)) {
+            // Applied when it becomes ready
+            continue;
+        }
+        int rc = ct_connection_apply_send_rate(member);
+        if (rc < 0) {
+            result = rc;
+        }
+    }
+    return result;
+}
+
 uint8_t ct_connection_get_priority(const ct_connection_t* connection) {
     if (!connection) {
         log_error("ct_connection_get_priority called with NULL connection");
@@ -845,6 +1108,7 @@ void ct_connection_set_active_remote_endpoint_index(ct_connection_t* connection,
 void ct_connection_set_active_local_endpoint_index(ct_connection_t* connection,
                                                    size_t local_endpoint_index) {
     assert(local_endpoint_index < connection->num_local_endpoints);
+    connection_clear_bound_local_endpoint(connection);
     connection->active_local_endpoint = local_endpoint_index;
 }
 
@@ -863,6 +1127,10 @@ int ct_connection_set_active_remote_endpoint(ct_connection_t* connection,
             return 0;
         }
     }
+    int rc = ct_connection_detach_shared_data(connection);
+    if (rc < 0) {
+        return rc;
+    }
     ct_remote_endpoint_t* temp =
         realloc(connection->all_remote_endpoints,
                 sizeof(ct_remote_endpoint_t) * (connection->num_remote_endpoints + 1));
@@ -873,7 +1141,7 @@ int ct_connection_set_active_remote_endpoint(ct_connection_t* connection,
 
     connection->num_remote_endpoints++;
     connection->all_remote_endpoints = temp;
-    int rc = ct_remote_endpoint_copy_content(remote_endpoint,
+    rc = ct_remote_endpoint_copy_content(remote_endpoint,
                                              temp + connection->num_remote_endpoints - 1);
     if (rc != 0) {
         log_error("Failed to deep copy new remote endpoint: %d", rc);
@@ -906,12 +1174,17 @@ int ct_connection_set_active_local_endpoint(ct_connection_t* connection,
             if (changed) {
                 *changed = (local_ix != connection->active_local_endpoint);
             }
+            connection_clear_bound_local_endpoint(connection);
             connection->active_local_endpoint = local_ix;
             return 0;
         }
     }
     log_debug("No matching local endpoint found, adding new local endpoint to list and setting it "
               "as active");
+    int rc = ct_connection_detach_shared_data(connection);
+    if (rc < 0) {
+        return rc;
+    }
     ct_local_endpoint_t* temp =
         realloc(connection->all_local_endpoints,
                 sizeof(ct_local_endpoint_t) * (connection->num_local_endpoints + 1));
@@ -922,8 +1195,7 @@ int ct_connection_set_active_local_endpoint(ct_connection_t* connection,
 
     connection->num_local_endpoints++;
     connection->all_local_endpoints = temp;
-    int rc =
-        ct_local_endpoint_copy_content(local_endpoint, temp + connection->num_local_endpoints - 1);
+    rc = ct_local_endpoint_copy_content(local_endpoint, temp + connection->num_local_endpoints - 1);
     if (rc != 0) {
         log_error("Failed to deep copy new local endpoint: %d", rc);
         connection->num_local_endpoints--; // Roll back the count since we failed to copy
@@ -938,15 +1210,27 @@ int ct_connection_set_active_local_endpoint(ct_connection_t* connection,
     return 0;
 }
 
-void ct_connection_set_all_local_port(ct_connection_t* connection, uint16_t port) {
-    for (size_t i = 0; i < ct_connection_get_num_local_endpoints(connection); i++) {
-        struct sockaddr_storage* addr = &connection->all_local_endpoints[i].resolved_address;
-        if (addr->ss_family == AF_INET) {
-            struct sockaddr_in* addr_in = (struct sockaddr_in*)addr;
-            addr_in->sin_port = htons(port);
-        } else if (addr->ss_family == AF_INET6) {
-            struct sockaddr_in6* addr_in6 = (struct sockaddr_in6*)addr;
-            addr_in6->sin6_port = htons(port);
-        }
+int ct_connection_set_bound_local_address(ct_connection_t* connection,
+                                          const struct sockaddr_storage* address) {
+    ct_local_endpoint_t bound = {0};
+    int rc = ct_local_endpoint_copy_content(ct_connection_get_active_local_endpoint(connection),
+                                            &bound);
+    if (rc < 0) {
+        log_error("Failed to copy active local endpoint of connection %s", connection->uuid);
+        return rc;
     }
+    if (!ct_address_is_unspecified(address)) {
+        ct_local_endpoint_set_resolved_address(&bound, address);
+    } else {
+        uint16_t port = address->ss_family == AF_INET6
+                            ? ntohs(((const struct sockaddr_in6*)address)->sin6_port)
+                            : ntohs(((const struct sockaddr_in*)address)->sin_port);
+        ct_local_endpoint_with_port(&bound, port);
+    }
+    connection_clear_bound_local_endpoint(connection);
+    connection->bound_local_endpoint = bound;
+    connection->has_bound_local_endpoint = true;
+    log_trace("Connection %s is bound to local port %u", connection->uuid,
+              ct_local_endpoint_get_resolved_port(&bound));
+    return 0;
 }
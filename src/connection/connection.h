@@ -4,13 +4,23 @@
 #include "ctaps.h"
 #include "ctaps_internal.h"
 
+/**
+ * @brief Create a client connection referencing endpoints and framer in shared data.
+ *
+ * The connection takes its own reference to shared_data, so racing attempts can all be
+ * started from one set of endpoint lists.
+ *
+ * @param[in] shared_data Endpoint lists and framer, see ct_connection_shared_data_new()
+ * @param[in] local_endpoint_index Index of the active local endpoint in shared_data
+ * @param[in] remote_endpoint_index Index of the active remote endpoint in shared_data
+ * @return Pointer to newly created connection, or NULL on error
+ */
 ct_connection_t* ct_connection_create_client(
-    const ct_protocol_impl_t* protocol_impl, ct_local_endpoint_t* local_endpoints,
-    size_t num_local_endpoints, size_t local_endpoint_index, ct_remote_endpoint_t* remote_endpoints,
-    size_t num_remote_endpoints, size_t remote_endpoint_index,
+    const ct_protocol_impl_t* protocol_impl, ct_connection_shared_data_t* shared_data,
+    size_t local_endpoint_index, size_t remote_endpoint_index,
     const ct_transport_properties_t* transport_properties,
     const ct_security_parameters_t* security_parameters,
-    const ct_connection_callbacks_t* connection_callbacks, const ct_framer_impl_t* framer_impl);
+    const ct_connection_callbacks_t* connection_callbacks);
 
 ct_connection_t* ct_connection_create_server_connection(
     ct_socket_manager_t* socket_manager, const ct_remote_endpoint_t* remote_endpoint,
@@ -32,6 +42,19 @@ ct_connection_t* ct_connection_create_server_connection(
  */
 void ct_connection_on_protocol_receive(ct_connection_t* connection, const void* data, size_t len);
 
+/**
+ * @brief Deliver a received datagram to the application as one complete message
+ *
+ * For protocols which carry unreliable messages next to their byte stream, e.g. QUIC DATAGRAM
+ * frames. The framer is skipped and the message context has msgReliable set to false.
+ *
+ * Takes a deep copy of the passed content in the buffer. Does NOT free the data buffer.
+ *
+ * @return 0 on success, -ENOMEM if the message could not be allocated
+ */
+int ct_connection_on_protocol_receive_datagram(ct_connection_t* connection, const void* data,
+                                               size_t len);
+
 /**
   * @brief Allocate connection with UUID and initialized queues.
   *
@@ -70,11 +93,13 @@ void ct_connection_free_content(ct_connection_t* connection);
 /**
  * @brief Create a new connection by cloning from an existing connection.
  *
- * Allocates and initializes a new connection in the same connection group as the source,
- * copying all relevant properties (endpoints, transport properties, security parameters, etc.).
+ * Allocates and initializes a new connection in the same connection group as the source.
+ * Endpoints and the framer are referenced through the source's ct_connection_shared_data_t
+ * instead of being copied, unless a different framer is given. The immutable security
+ * parameters are shared by reference.
  * This is used for creating additional streams in QUIC or cloning UDP connections.
  *
- * @param[in] src_clone Source connection to clone from
+ * @param[in] source_connection Source connection to clone from
  * @param[in] socket_manager Socket manager to use for the new connection (if NULL, it will be assigned a new socket manager)
  * @param[in] framer_impl Optional framer, if not set it will copy the framer from the source connection
  * @param[in] internal_connection_state Optional protocol-specific internal state for the new connection, if not set internal state will be NULL
@@ -85,6 +110,35 @@ ct_connection_t* ct_connection_create_clone(const ct_connection_t* source_connec
                                             const ct_framer_impl_t* framer_impl,
                                             void* internal_connection_state);
 
+/**
+ * @brief Give the connection its own copy of everything it references in its shared data.
+ *
+ * Must be called before modifying the endpoint lists or framer of a connection.
+ * No-op for connections without shared data.
+ *
+ * @param[in,out] connection The connection about to be modified
+ * @return 0 on success, -ENOMEM if a copy failed (the connection is left unchanged)
+ */
+int ct_connection_detach_shared_data(ct_connection_t* connection);
+
+/**
+ * @brief Create shared connection data with a reference count of one, held by the caller.
+ *
+ * Takes ownership of the endpoint lists on success, the framer is copied.
+ *
+ * @return The shared data, or NULL on allocation failure (the lists are left to the caller)
+ */
+ct_connection_shared_data_t* ct_connection_shared_data_new(ct_local_endpoint_t* local_endpoints,
+                                                           size_t num_local_endpoints,
+                                                           ct_remote_endpoint_t* remote_endpoints,
+                                                           size_t num_remote_endpoints,
+                                                           const ct_framer_impl_t* framer_impl);
+
+/**
+ * @brief Drop a reference to shared connection data, freeing it with the last one.
+ */
+void ct_connection_shared_data_unref(ct_connection_shared_data_t* shared_data);
+
 /**
  * @brief Set the can send connection property
  *
@@ -166,6 +220,28 @@ int ct_connection_set_active_local_endpoint(ct_connection_t* connection,
                                             const ct_local_endpoint_t* local_endpoint,
                                             bool* changed);
 
-void ct_connection_set_all_local_port(ct_connection_t* connection, uint16_t port);
+/**
+ * @brief Record the address the connection's socket is bound to.
+ *
+ * Kept in the connection itself rather than written into all_local_endpoints, so a
+ * connection still sharing its endpoints with a race or group does not have to detach
+ * when its socket gets an ephemeral port. The active local endpoint then reports this
+ * address until another one is made active.
+ *
+ * @param[in] address From getsockname(), for a wildcard address only the port is taken
+ * @return 0 on success, negative errno on failure
+ */
+int ct_connection_set_bound_local_address(ct_connection_t* connection,
+                                          const struct sockaddr_storage* address);
+
+/**
+ * @brief Enforce the group's minSendRate/maxSendRate on a connection.
+ *
+ * The protocol paces natively when it can, otherwise a userspace pacer is attached.
+ *
+ * @param[in,out] connection The connection to pace
+ * @return 0 on success, negative error code on failure
+ */
+int ct_connection_apply_send_rate(ct_connection_t* connection);
 
 #endif // CONNECTION_H
@@ -1,6 +1,7 @@
 #include "connection_group.h"
 
 #include "connection/connection.h"
+#include "connection/connection_pool.h"
 #include "connection/socket_manager/socket_manager.h"
 #include "transport_property/transport_properties.h"
 #include "util/uuid_util.h"
@@ -11,6 +12,52 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+static bool is_member(const ct_connection_group_t* group, const ct_connection_t* connection) {
+    return connection->connection_group == group &&
+           (group->members == connection || connection->group_prev != NULL);
+}
+
+static void count_member(ct_connection_group_t* group, const ct_connection_t* connection,
+                         bool add) {
+    // Counters only change by one, so a member is either counted in a bucket or not
+    size_t* counters[4] = {NULL};
+    size_t num_counters = 0;
+    if (connection->properties.state != CT_CONN_STATE_CLOSED) {
+        counters[num_counters++] = &group->num_open;
+    }
+    if (connection->properties.can_send) {
+        counters[num_counters++] = &group->num_sending;
+    }
+    if (connection->properties.can_receive) {
+        counters[num_counters++] = &group->num_receiving;
+    }
+    if (connection->properties.can_send || connection->properties.can_receive) {
+        counters[num_counters++] = &group->num_sending_or_receiving;
+    }
+    for (size_t i = 0; i < num_counters; i++) {
+        if (add) {
+            (*counters[i])++;
+        } else {
+            assert(*counters[i] > 0);
+            (*counters[i])--;
+        }
+    }
+}
+
+void ct_connection_group_count_member(ct_connection_t* connection) {
+    ct_connection_group_t* group = connection->connection_group;
+    if (group && is_member(group, connection)) {
+        count_member(group, connection, true);
+    }
+}
+
+void ct_connection_group_uncount_member(ct_connection_t* connection) {
+    ct_connection_group_t* group = connection->connection_group;
+    if (group && is_member(group, connection)) {
+        count_member(group, connection, false);
+    }
+}
+
 int ct_connection_group_add_connection(ct_connection_group_t* group, ct_connection_t* connection) {
 
     if (connection->connection_group) {
@@ -20,42 +67,37 @@ int ct_connection_group_add_connection(ct_connection_group_t* group, ct_connecti
     }
 
     log_debug("Adding connection with UUID %s connection group", connection->uuid);
-    int rc = g_hash_table_insert(group->connections, connection->uuid, connection);
-    if (!rc) {
-        log_error("Connection with UUID %s already exists in group", connection->uuid);
-        return -EEXIST;
+    connection->group_prev = group->members_tail;
+    connection->group_next = NULL;
+    if (group->members_tail) {
+        group->members_tail->group_next = connection;
+    } else {
+        group->members = connection;
     }
+    group->members_tail = connection;
+    group->num_members++;
     connection->connection_group = ct_connection_group_ref(group);
+    count_member(group, connection, true);
     return 0;
 }
 
 ct_connection_t* ct_connection_group_get_first(const ct_connection_group_t* group) {
-    if (!group || !group->connections) {
+    if (!group) {
         log_error("ct_connection_group_get_first called with NULL parameter");
         return NULL;
     }
-
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
-    g_hash_table_iter_init(&iter, group->connections);
-
-    if (g_hash_table_iter_next(&iter, &key, &value)) {
-        return (ct_connection_t*)value;
+    if (!group->members) {
+        log_debug("Connection group %s is empty, no first connection",
+                  group->connection_group_id);
     }
-
-    log_debug("Connection group %s is empty, no first connection", group->connection_group_id);
-    return NULL;
+    return group->members;
 }
 
 void ct_connection_group_abort_all(ct_connection_group_t* connection_group) {
     log_info("Aborting connection group: %s", connection_group->connection_group_id);
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
+    ct_connection_t* next = NULL;
+    for (ct_connection_t* connection = connection_group->members; connection; connection = next) {
+        next = connection->group_next;
         if (!ct_connection_is_closed(connection)) {
             log_trace("Aborting member in connection group: %s", connection->uuid);
             ct_connection_abort(connection);
@@ -66,39 +108,41 @@ void ct_connection_group_abort_all(ct_connection_group_t* connection_group) {
 }
 
 uint64_t ct_connection_group_get_num_active_connections(ct_connection_group_t* group) {
-    uint64_t count = 0;
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
-    g_hash_table_iter_init(&iter, group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
-        if (!ct_connection_is_closed(connection)) {
-            count++;
-        }
-    }
-    return count;
+    return group->num_open;
 }
 
 int ct_connection_group_remove_connection(ct_connection_group_t* group,
                                           ct_connection_t* connection) {
     log_debug("Removing connection with UUID %s from connection group", connection->uuid);
-    gboolean removed = g_hash_table_remove(group->connections, connection->uuid);
-    if (!removed) {
+    if (!is_member(group, connection)) {
         log_warn("Connection with UUID %s not found in group", connection->uuid);
         return -ENOENT;
     }
+    count_member(group, connection, false);
 
-    log_debug("Connection removed, remaining connections in group: %u",
-              g_hash_table_size(group->connections));
+    if (connection->group_prev) {
+        connection->group_prev->group_next = connection->group_next;
+    } else {
+        group->members = connection->group_next;
+    }
+    if (connection->group_next) {
+        connection->group_next->group_prev = connection->group_prev;
+    } else {
+        group->members_tail = connection->group_prev;
+    }
+    connection->group_prev = NULL;
+    connection->group_next = NULL;
+    group->num_members--;
+
+    log_debug("Connection removed, remaining connections in group: %zu", group->num_members);
     return 0;
 }
 
 bool ct_connection_group_is_empty(ct_connection_group_t* group) {
-    if (!group || !group->connections) {
+    if (!group) {
         return true;
     }
-    return g_hash_table_size(group->connections) == 0;
+    return group->num_members == 0;
 }
 
 void ct_connection_group_free(ct_connection_group_t* group) {
@@ -106,10 +150,7 @@ void ct_connection_group_free(ct_connection_group_t* group) {
         return;
     }
     log_debug("Freeing connection group %s", group->connection_group_id);
-    if (group->connections) {
-        g_hash_table_destroy(group->connections);
-        group->connections = NULL;
-    }
+    ct_connection_pool_remove(group);
     if (group->transport_properties) {
         ct_transport_properties_free(group->transport_properties);
         group->transport_properties = NULL;
@@ -166,8 +207,8 @@ void ct_connection_group_unref(const ct_connection_t* connection) {
     }
     ct_connection_group_t* group = connection->connection_group;
 
-    if (group->connections) {
-        g_hash_table_remove(connection->connection_group->connections, connection->uuid);
+    if (is_member(group, connection)) {
+        ct_connection_group_remove_connection(group, (ct_connection_t*)connection);
     }
 
     log_trace("Unrefing connection group %s with ref count: %u", group->connection_group_id,
@@ -192,12 +233,6 @@ ct_connection_group_t* ct_connection_group_new(const ct_transport_properties_t*
     }
     memset(group, 0, sizeof(ct_connection_group_t));
     generate_uuid_string(group->connection_group_id);
-    group->connections = g_hash_table_new(g_str_hash, g_str_equal);
-    if (!group->connections) {
-        log_error("Failed to create hash table for connection group");
-        free(group);
-        return NULL;
-    }
     if (transport_properties) {
         group->transport_properties = ct_transport_properties_deep_copy(transport_properties);
     }
@@ -206,7 +241,6 @@ ct_connection_group_t* ct_connection_group_new(const ct_transport_properties_t*
     }
     if (!group->transport_properties) {
         log_error("Failed to create transport properties for connection group");
-        g_hash_table_destroy(group->connections);
         free(group);
         return NULL;
     }
@@ -222,11 +256,7 @@ static int ct_connection_group_set_active_endpoint(ct_connection_group_t* group,
                                                    ct_endpoint_setter_fn setter) {
     assert(group && endpoint);
     int at_least_one_failure = 0;
-    GHashTableIter iter;
-    gpointer key = NULL, value = NULL;
-    g_hash_table_iter_init(&iter, group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* conn = (ct_connection_t*)value;
+    for (ct_connection_t* conn = group->members; conn; conn = conn->group_next) {
         int rc = setter(conn, endpoint, changed);
         if (rc != 0) {
             at_least_one_failure = rc;
@@ -258,20 +288,16 @@ const ct_transport_properties_t* ct_connection_group_get_transport_properties(co
 
 void ct_connection_group_notify_of_path_change(const ct_connection_group_t* connection_group) {
     // Intermediate to avoid concurrent modification
-    GSList* connections = NULL;
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
-        connections = g_slist_append(connections, connection);
-    }
-    for (GSList* node = connections; node != NULL; node = node->next) {
-        ct_connection_t* connection = (ct_connection_t*)node->data;
+    GPtrArray* connections = g_ptr_array_sized_new(connection_group->num_members);
+    for (ct_connection_t* connection = connection_group->members; connection;
+         connection = connection->group_next) {
+        g_ptr_array_add(connections, connection);
+    }
+    for (guint i = 0; i < connections->len; i++) {
+        ct_connection_t* connection = g_ptr_array_index(connections, i);
         if (connection->connection_callbacks.path_change) {
             connection->connection_callbacks.path_change(connection);
         }
     }
-    g_slist_free(connections);
+    g_ptr_array_free(connections, true);
 }
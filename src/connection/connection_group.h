@@ -31,6 +31,23 @@ ct_connection_t* ct_connection_group_get_first(const ct_connection_group_t* grou
  */
 uint64_t ct_connection_group_get_num_active_connections(ct_connection_group_t* group);
 
+/**
+ * @brief Add a member's current state to its group's counters.
+ *
+ * State setters call ct_connection_group_uncount_member() before and this after a change,
+ * so the counters in ct_connection_group_t never need a scan. No-op for non-members.
+ *
+ * @param[in] connection The connection whose state is counted
+ */
+void ct_connection_group_count_member(ct_connection_t* connection);
+
+/**
+ * @brief Remove a member's current state from its group's counters.
+ *
+ * @param[in] connection The connection whose state is uncounted
+ */
+void ct_connection_group_uncount_member(ct_connection_t* connection);
+
 /**
  * @brief Remove a connection from a connection group.
  *
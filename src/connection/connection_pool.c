@@ -0,0 +1,193 @@
+#include "connection_pool.h"
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <endpoint/remote_endpoint.h>
+#include <errno.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <logging/log.h>
+#include <netinet/in.h>
+#include <security_parameter/security_parameters.h>
+#include <stdlib.h>
+#include <string.h>
+#include <transport_property/selection_properties/selection_properties.h>
+
+// Pool key -> GPtrArray of ct_connection_group_t*, oldest first
+static GHashTable* connection_pool = NULL;
+
+char* ct_connection_pool_key_new(const ct_preconnection_t* preconnection) {
+    if (!preconnection || preconnection->num_remote_endpoints == 0) {
+        return NULL;
+    }
+    if (preconnection->num_local_endpoints > 0) {
+        log_debug("Not coalescing preconnection with explicit local endpoints");
+        return NULL;
+    }
+
+    GString* key = g_string_new("remote=");
+    for (size_t i = 0; i < preconnection->num_remote_endpoints; i++) {
+        ct_remote_endpoint_append_key(key, &preconnection->remote_endpoints[i]);
+    }
+
+    const ct_security_parameters_t* security_parameters = preconnection->security_parameters;
+    size_t num_alpns = 0;
+    const char* const* alpns = ct_security_parameters_get_alpns(security_parameters, &num_alpns);
+    g_string_append(key, "|alpn=");
+    for (size_t i = 0; alpns && i < num_alpns; i++) {
+        g_string_append_printf(key, "%s;", alpns[i]);
+    }
+
+    const char* sni = ct_security_parameters_get_server_name_identification(security_parameters);
+    g_string_append_printf(key, "|sni=%s|client_cert=", sni ? sni : "");
+    size_t num_client_certs = ct_security_parameters_get_client_certificate_count(security_parameters);
+    for (size_t i = 0; i < num_client_certs; i++) {
+        const char* cert = ct_security_parameters_get_client_certificate_file(security_parameters, i);
+        const char* key_file =
+            ct_security_parameters_get_client_certificate_key_file(security_parameters, i);
+        g_string_append_printf(key, "%s,%s;", cert ? cert : "", key_file ? key_file : "");
+    }
+
+    const ct_selection_masks_t* masks = &preconnection->selection_masks;
+    g_string_append_printf(key, "|selection=%" PRIx64 ",%" PRIx64 ",%" PRIx64 ",%" PRIx64,
+                           masks->require, masks->prohibit, masks->prefer, masks->avoid);
+
+    char* pool_key = strdup(key->str);
+    g_string_free(key, TRUE);
+    if (!pool_key) {
+        log_error("Failed to allocate memory for connection pool key");
+    }
+    return pool_key;
+}
+
+int ct_connection_pool_add(const char* pool_key, ct_connection_group_t* group) {
+    if (!pool_key || !group) {
+        return -EINVAL;
+    }
+    if (group->pool_key) {
+        log_trace("Connection group %s is already pooled", group->connection_group_id);
+        return 0;
+    }
+    group->pool_key = strdup(pool_key);
+    if (!group->pool_key) {
+        log_error("Failed to allocate memory for connection pool key");
+        return -ENOMEM;
+    }
+
+    if (!connection_pool) {
+        connection_pool = g_hash_table_new_full(g_str_hash, g_str_equal, free,
+                                                (GDestroyNotify)g_ptr_array_unref);
+    }
+    GPtrArray* groups = g_hash_table_lookup(connection_pool, pool_key);
+    if (!groups) {
+        char* table_key = strdup(pool_key);
+        if (!table_key) {
+            log_error("Failed to allocate memory for connection pool key");
+            free(group->pool_key);
+            group->pool_key = NULL;
+            return -ENOMEM;
+        }
+        groups = g_ptr_array_new();
+        g_hash_table_insert(connection_pool, table_key, groups);
+    }
+    g_ptr_array_add(groups, group);
+    log_debug("Added connection group %s to connection pool", group->connection_group_id);
+    return 0;
+}
+
+static bool member_protocol_is_compatible(const ct_connection_t* member,
+                                          const ct_selection_masks_t* selection_masks) {
+    if (!selection_masks) {
+        return true;
+    }
+    if (!member->socket_manager || !member->socket_manager->protocol_impl) {
+        return false;
+    }
+    ct_selection_masks_t capabilities;
+    ct_selection_masks_compile(&member->socket_manager->protocol_impl->selection_properties,
+                               &capabilities);
+    return ct_selection_masks_compatible(selection_masks, &capabilities);
+}
+
+static ct_connection_t* group_get_established_member(const ct_connection_group_t* group,
+                                                     const ct_selection_masks_t* selection_masks) {
+    uint64_t group_conn_limit =
+        group->transport_properties->connection_properties.list[GROUP_CONN_LIMIT].value.uint64_val;
+    if (group->num_open >= group_conn_limit) {
+        log_trace("Connection group %s reached its groupConnLimit of %llu",
+                  group->connection_group_id, (unsigned long long)group_conn_limit);
+        return NULL;
+    }
+    for (ct_connection_t* member = group->members; member; member = member->group_next) {
+        if (!ct_connection_is_established(member)) {
+            continue;
+        }
+        // All members of a group share its protocol
+        if (!member_protocol_is_compatible(member, selection_masks)) {
+            log_debug("Protocol of connection group %s does not satisfy the selection properties",
+                      group->connection_group_id);
+            return NULL;
+        }
+        return member;
+    }
+    return NULL;
+}
+
+ct_connection_t* ct_connection_pool_find(const char* pool_key,
+                                         const ct_selection_masks_t* selection_masks) {
+    if (!connection_pool || !pool_key) {
+        return NULL;
+    }
+    GPtrArray* groups = g_hash_table_lookup(connection_pool, pool_key);
+    if (!groups) {
+        return NULL;
+    }
+    for (guint i = 0; i < groups->len; i++) {
+        ct_connection_t* member =
+            group_get_established_member(g_ptr_array_index(groups, i), selection_masks);
+        if (member) {
+            return member;
+        }
+    }
+    return NULL;
+}
+
+void ct_connection_pool_remove(ct_connection_group_t* group) {
+    if (!group || !group->pool_key) {
+        return;
+    }
+    if (connection_pool) {
+        GPtrArray* groups = g_hash_table_lookup(connection_pool, group->pool_key);
+        if (groups) {
+            g_ptr_array_remove(groups, group);
+            if (groups->len == 0) {
+                g_hash_table_remove(connection_pool, group->pool_key);
+            }
+        }
+    }
+    log_debug("Removed connection group %s from connection pool", group->connection_group_id);
+    free(group->pool_key);
+    group->pool_key = NULL;
+}
+
+size_t ct_connection_pool_size(void) {
+    if (!connection_pool) {
+        return 0;
+    }
+    size_t num_groups = 0;
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, connection_pool);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        num_groups += ((GPtrArray*)value)->len;
+    }
+    return num_groups;
+}
+
+void ct_connection_pool_clear(void) {
+    if (!connection_pool) {
+        return;
+    }
+    g_hash_table_destroy(connection_pool);
+    connection_pool = NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef CT_CONNECTION_POOL_H
+#define CT_CONNECTION_POOL_H
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+
+/**
+ * @brief Key under which the connection groups of a preconnection are pooled.
+ *
+ * Made of the remote endpoints, ALPNs, server name, client certificates and selection
+ * properties, so that only preconnections that would negotiate an equivalent connection
+ * share a group.
+ *
+ * @return Newly allocated key, free with free(), or NULL if the preconnection cannot be
+ *         coalesced, e.g. because it specifies local endpoints.
+ */
+char* ct_connection_pool_key_new(const ct_preconnection_t* preconnection);
+
+/**
+ * @brief Make an established connection group available for coalescing.
+ *
+ * The pool does not hold a reference to the group, ct_connection_group_free() removes it.
+ *
+ * @param[in] pool_key Key from ct_connection_pool_key_new(), copied
+ * @param[in,out] group Group to add
+ * @return 0 on success, negative errno on failure
+ */
+int ct_connection_pool_add(const char* pool_key, ct_connection_group_t* group);
+
+/**
+ * @brief Find an established connection to open a new stream next to.
+ *
+ * A group is usable while one of its members is established, it has fewer open members
+ * than its groupConnLimit and its protocol is compatible with the selection masks.
+ *
+ * @param[in] selection_masks Compiled selection properties of the preconnection, NULL to
+ *                            accept any protocol
+ * @return An established member of a usable group, or NULL if there is none
+ */
+ct_connection_t* ct_connection_pool_find(const char* pool_key,
+                                         const ct_selection_masks_t* selection_masks);
+
+void ct_connection_pool_remove(ct_connection_group_t* group);
+
+size_t ct_connection_pool_size(void);
+
+// Forget every pooled group, the groups themselves are not affected
+void ct_connection_pool_clear(void);
+
+#endif // CT_CONNECTION_POOL_H
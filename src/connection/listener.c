@@ -1,14 +1,26 @@
+#include "listener.h"
+
 #include "ctaps.h"
 #include <connection/socket_manager/socket_manager.h>
 #include "transport_property/transport_properties.h"
 #include "security_parameter/security_parameters.h"
 #include "endpoint/local_endpoint.h"
 #include "candidate_gathering/candidate_gathering.h"
+#include <errno.h>
 #include <logging/log.h>
+#include <sched.h>
 #include <stdio.h>
+#include <string.h>
 
 void ct_listener_close(ct_listener_t* listener) {
-    ct_socket_manager_listener_close(listener->socket_manager);
+    if (!listener->socket_manager->stopped_listening) {
+        ct_socket_manager_listener_close(listener->socket_manager);
+    }
+    for (size_t i = 0; i < listener->num_extra_socket_managers; i++) {
+        if (!listener->extra_socket_managers[i]->stopped_listening) {
+            ct_socket_manager_listener_close(listener->extra_socket_managers[i]);
+        }
+    }
 }
 
 ct_listener_t* ct_listener_new(const ct_transport_properties_t* transport_properties,
@@ -50,9 +62,9 @@ ct_listener_t* ct_listener_new(const ct_transport_properties_t* transport_proper
         listener->connection_callbacks = *connection_callbacks;
     }
     if (security_parameters) {
-        listener->security_parameters = ct_security_parameters_deep_copy(security_parameters);
+        listener->security_parameters = ct_security_parameters_share(security_parameters);
         if (!listener->security_parameters) {
-            log_error("Failed to deep copy security parameters for listener");
+            log_error("Failed to share security parameters with listener");
             ct_listener_free(listener);
             return NULL;
         }
@@ -69,10 +81,108 @@ ct_listener_t* ct_listener_new(const ct_transport_properties_t* transport_proper
     return listener;
 }
 
+int ct_listener_add_protocol(ct_listener_t* listener, const ct_protocol_impl_t* protocol_impl) {
+    ct_socket_manager_t** extra_socket_managers =
+        realloc(listener->extra_socket_managers,
+                (listener->num_extra_socket_managers + 1) * sizeof(ct_socket_manager_t*));
+    if (!extra_socket_managers) {
+        log_error("Could not allocate memory for listener socket managers");
+        return -ENOMEM;
+    }
+    listener->extra_socket_managers = extra_socket_managers;
+    ct_socket_manager_t* socket_manager = ct_socket_manager_new(protocol_impl, listener);
+    if (!socket_manager) {
+        log_error("Failed to create socket manager for listener");
+        return -ENOMEM;
+    }
+    listener->extra_socket_managers[listener->num_extra_socket_managers++] =
+        ct_socket_manager_ref(socket_manager);
+    return 0;
+}
+
+void ct_listener_listen(ct_listener_t* listener) {
+    if (listener->num_extra_socket_managers == 0) {
+        ct_socket_manager_listen(listener);
+        return;
+    }
+    int rc = 0;
+    size_t num_listening = 0;
+    for (size_t i = 0; i <= listener->num_extra_socket_managers; i++) {
+        ct_socket_manager_t* socket_manager =
+            i == 0 ? listener->socket_manager : listener->extra_socket_managers[i - 1];
+        rc = socket_manager->protocol_impl->listen(socket_manager);
+        if (rc) {
+            // The other protocols are still worth accepting on
+            log_warn("Could not listen with %s: %d", socket_manager->protocol_impl->name, rc);
+            socket_manager->stopped_listening = true;
+            continue;
+        }
+        log_info("Listening on port %d with protocol %s", listener->local_endpoint->port,
+                 socket_manager->protocol_impl->name);
+        num_listening++;
+    }
+    if (num_listening == 0) {
+        log_error("Could not listen with any protocol");
+        if (listener->listener_callbacks.establishment_error) {
+            listener->listener_callbacks.establishment_error(listener, rc);
+        }
+        return;
+    }
+    listener->num_listening_socket_managers = num_listening;
+    if (listener->listener_callbacks.listener_ready) {
+        listener->listener_callbacks.listener_ready(listener);
+    }
+}
+
+bool ct_listener_socket_manager_stopped(ct_listener_t* listener) {
+    if (!listener || listener->num_listening_socket_managers <= 1) {
+        if (listener) {
+            listener->num_listening_socket_managers = 0;
+        }
+        return true;
+    }
+    listener->num_listening_socket_managers--;
+    return false;
+}
+
 const ct_local_endpoint_t* ct_listener_get_local_endpoint(const ct_listener_t* listener) {
     return listener->local_endpoint;
 }
 
+bool ct_listener_reuses_port(const ct_listener_t* listener) {
+    if (!listener->transport_properties) {
+        return false;
+    }
+    return ct_transport_properties_get_listener_reuse_port(listener->transport_properties);
+}
+
+int ct_listener_get_incoming_cpu(const ct_listener_t* listener) {
+    if (!listener->transport_properties ||
+        !ct_transport_properties_get_listener_cpu_affinity(listener->transport_properties)) {
+        return -1;
+    }
+#ifdef __linux__
+    // A process that may migrate would steer its flows to a CPU it no longer runs on
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) < 0) {
+        log_warn("Could not get the CPU affinity of the listening process: %s", strerror(errno));
+        return -1;
+    }
+    if (CPU_COUNT(&affinity) != 1) {
+        log_debug("Listening process is not pinned to one CPU, not setting SO_INCOMING_CPU");
+        return -1;
+    }
+    int cpu = sched_getcpu();
+    if (cpu < 0) {
+        log_warn("Could not get the CPU of the listening thread: %s", strerror(errno));
+    }
+    return cpu;
+#else
+    return -1;
+#endif
+}
+
 void ct_listener_free(ct_listener_t* listener) {
     log_trace("Freeing ct_listener_t %p", (void*)listener);
     if (!listener) {
@@ -87,6 +197,13 @@ void ct_listener_free(ct_listener_t* listener) {
         ct_socket_manager_unref(listener->socket_manager);
         listener->socket_manager = NULL;
     }
+    for (size_t i = 0; i < listener->num_extra_socket_managers; i++) {
+        listener->extra_socket_managers[i]->listener = NULL;
+        ct_socket_manager_unref(listener->extra_socket_managers[i]);
+    }
+    free(listener->extra_socket_managers);
+    listener->extra_socket_managers = NULL;
+    listener->num_extra_socket_managers = 0;
     ct_local_endpoint_free(listener->local_endpoint);
     ct_transport_properties_free(listener->transport_properties);
     ct_security_parameters_free(listener->security_parameters);
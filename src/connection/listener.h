@@ -10,6 +10,30 @@ ct_listener_t* ct_listener_new(const ct_transport_properties_t* transport_proper
                                const ct_security_parameters_t* security_parameters,
                                const ct_protocol_impl_t* protocol_impl);
 
+/**
+ * @brief Also listen with another protocol, on the same local endpoint.
+ *
+ * Must be called before ct_listener_listen().
+ *
+ * @return 0 on success, -ENOMEM on allocation failure
+ */
+int ct_listener_add_protocol(ct_listener_t* listener, const ct_protocol_impl_t* protocol_impl);
+
+/**
+ * @brief Start listening with every protocol of the listener.
+ *
+ * listener_ready() is called once at least one protocol listens, protocols which fail to
+ * listen are skipped. establishment_error() is called if none of them listens.
+ */
+void ct_listener_listen(ct_listener_t* listener);
+
+/**
+ * @brief Count a socket manager of the listener as no longer listening.
+ *
+ * @return true if it was the last one listening, so the listener is now closed
+ */
+bool ct_listener_socket_manager_stopped(ct_listener_t* listener);
+
 /**
  * @brief Get the local endpoint a listener is bound to.
  * @param[in] listener The listener
@@ -19,4 +43,23 @@ const ct_local_endpoint_t* ct_listener_get_local_endpoint(const ct_listener_t* l
 
 void ct_listener_mark_as_closed(ct_listener_t* listener);
 
+/**
+ * @brief Whether the listening socket sets SO_REUSEPORT, from listenerReusePort.
+ *
+ * Lets several processes, each with its own event loop, listen on the same port.
+ * QUIC listeners fail with -ENOTSUP if it is set.
+ */
+bool ct_listener_reuses_port(const ct_listener_t* listener);
+
+/**
+ * @brief CPU whose flows the listening socket should accept, for SO_INCOMING_CPU.
+ *
+ * This is the CPU the listen call runs on, which is only used if the process is
+ * pinned to that single CPU.
+ *
+ * @return The CPU, or -1 if listenerCpuAffinity is not set or the process may run on
+ *         several CPUs
+ */
+int ct_listener_get_incoming_cpu(const ct_listener_t* listener);
+
 #endif
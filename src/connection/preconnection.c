@@ -1,6 +1,10 @@
 
 #include "connection/socket_manager/socket_manager.h"
+#include "connection/bulk_initiate.h"
+#include "connection/connection.h"
+#include "connection/connection_pool.h"
 #include "connection/listener.h"
+#include "connection/warm_pool.h"
 #include "ctaps.h"
 #include "ctaps_internal.h"
 #include "message/message.h"
@@ -9,6 +13,7 @@
 #include "preconnection.h"
 #include "transport_property/selection_properties/selection_properties.h"
 #include <candidate_gathering/candidate_gathering.h>
+#include <candidate_gathering/candidate_plan.h>
 #include <candidate_gathering/candidate_racing.h>
 #include <endpoint/local_endpoint.h>
 #include <endpoint/remote_endpoint.h>
@@ -83,9 +88,11 @@ ct_preconnection_t* ct_preconnection_new(const ct_local_endpoint_t* const* local
         memcpy(&precon->transport_properties.connection_properties, &DEFAULT_CONNECTION_PROPERTIES,
                sizeof(ct_connection_properties_t));
     }
+    ct_selection_masks_compile(&precon->transport_properties.selection_properties,
+                               &precon->selection_masks);
 
-    // Deep copy security parameters so preconnection owns its own copy
-    precon->security_parameters = ct_security_parameters_deep_copy(security_parameters);
+    // Immutable copy, so listeners and connections created from it can share it by reference
+    precon->security_parameters = ct_security_parameters_share(security_parameters);
 
     if (num_local_endpoints > 0) {
         if (!local_endpoints) {
@@ -139,6 +146,9 @@ ct_preconnection_t* ct_preconnection_new(const ct_local_endpoint_t* const* local
         log_debug("No remote endpoints provided for preconnection, skipping copy");
     }
 
+    // Allocated up front, initiates only get a const preconnection to compile it into
+    precon->candidate_plan = ct_candidate_plan_new();
+
     return precon;
 }
 
@@ -146,8 +156,51 @@ typedef struct listener_candidate_node_array_ready_context_s {
     const ct_preconnection_t* preconnection;
     ct_listener_callbacks_t listener_callbacks;
     ct_connection_callbacks_t connection_callbacks;
+    bool listen_all_protocols;
 } listener_candidate_node_array_ready_context_t;
 
+static bool protocol_listens_on_udp(ct_protocol_enum_t protocol) {
+    return protocol == CT_PROTOCOL_UDP || protocol == CT_PROTOCOL_QUIC;
+}
+
+/**
+ * @brief Also listen with every other protocol among the candidates, in ranked order.
+ *
+ * Protocols which would bind the same kind of socket as an earlier one are skipped, as both
+ * cannot bind the local port. The port has to be fixed, with an ephemeral port each protocol
+ * would be bound to a different one.
+ *
+ * @return 0 on success, -EINVAL if another protocol would be added on an ephemeral port
+ */
+static int listener_add_candidate_protocols(ct_listener_t* listener,
+                                            const GArray* candidate_nodes) {
+    bool listens_on_udp =
+        protocol_listens_on_udp(listener->socket_manager->protocol_impl->protocol_enum);
+    bool listens_on_tcp = !listens_on_udp;
+    for (guint i = 1; i < candidate_nodes->len; i++) {
+        const ct_protocol_impl_t* protocol_impl =
+            g_array_index(candidate_nodes, ct_candidate_node_t, i)
+                .protocol_candidate->protocol_impl;
+        bool on_udp = protocol_listens_on_udp(protocol_impl->protocol_enum);
+        if ((on_udp && listens_on_udp) || (!on_udp && listens_on_tcp)) {
+            log_trace("Not listening with %s, its port is already taken", protocol_impl->name);
+            continue;
+        }
+        if (ct_local_endpoint_get_resolved_port(ct_listener_get_local_endpoint(listener)) == 0) {
+            log_error("Listening on every protocol requires a local port, %s would not share "
+                      "an ephemeral one", protocol_impl->name);
+            return -EINVAL;
+        }
+        int rc = ct_listener_add_protocol(listener, protocol_impl);
+        if (rc < 0) {
+            return rc;
+        }
+        listens_on_udp = listens_on_udp || on_udp;
+        listens_on_tcp = listens_on_tcp || !on_udp;
+    }
+    return 0;
+}
+
 void ct_listener_candidate_node_array_ready_cb(GArray* candidate_nodes, void* context) {
     log_info("Candidate gathering complete for listener, processing candidate nodes");
     listener_candidate_node_array_ready_context_t* listener_candidate_node_array_ready_context =
@@ -173,22 +226,33 @@ void ct_listener_candidate_node_array_ready_cb(GArray* candidate_nodes, void* co
         ct_preconnection_get_security_parameters(preconnection),
         first_node.protocol_candidate->protocol_impl);
 
+    int rc = -1;
+    if (listener && listener_candidate_node_array_ready_context->listen_all_protocols) {
+        rc = listener_add_candidate_protocols(listener, candidate_nodes);
+        if (rc < 0) {
+            log_error("Failed to add protocols to listener");
+            ct_listener_free(listener);
+            listener = NULL;
+        }
+    }
+
     if (!listener) {
         log_error("Failed to create listener listener");
         free_candidate_array(candidate_nodes);
         free(listener_candidate_node_array_ready_context);
         if (listener_callbacks.establishment_error) {
-            listener_callbacks.establishment_error(NULL, -1);
+            listener_callbacks.establishment_error(NULL, rc);
         }
         return;
     }
 
-    log_info("Starting to listen on port: %d with protocol: %s", first_node.local_endpoint->port,
-             listener->socket_manager->protocol_impl->name);
+    log_info("Starting to listen on port: %d with protocol: %s and %zu more",
+             first_node.local_endpoint->port, listener->socket_manager->protocol_impl->name,
+             listener->num_extra_socket_managers);
     free_candidate_array(candidate_nodes);
     free(listener_candidate_node_array_ready_context);
 
-    ct_socket_manager_listen(listener);
+    ct_listener_listen(listener);
 }
 
 int ct_preconnection_listen(const ct_preconnection_t* preconnection,
@@ -212,6 +276,7 @@ int ct_preconnection_listen(const ct_preconnection_t* preconnection,
 
     cb_context->preconnection = preconnection;
     cb_context->listener_callbacks = *listener_callbacks;
+    cb_context->listen_all_protocols = preconnection->listen_all_protocols;
     if (connection_callbacks) {
         cb_context->connection_callbacks = *connection_callbacks;
     }
@@ -233,6 +298,171 @@ int ct_preconnection_listen(const ct_preconnection_t* preconnection,
     return 0;
 }
 
+// An already established connection waiting for the next loop iteration to be handed out
+typedef struct ct_hand_out_s {
+    uv_timer_t timer;
+    ct_connection_t* connection;
+    ct_connection_callbacks_t connection_callbacks;
+    ct_message_t* message;                 // Owned copy of the initial message, or NULL
+    ct_message_context_t* message_context; // Owned copy, or NULL
+} ct_hand_out_t;
+
+static ct_hand_out_t* hand_out_new(const ct_connection_callbacks_t* connection_callbacks,
+                                   const ct_message_t* message,
+                                   const ct_message_context_t* message_context) {
+    ct_hand_out_t* hand_out = malloc(sizeof(ct_hand_out_t));
+    if (!hand_out) {
+        log_error("Failed to allocate connection hand-out");
+        return NULL;
+    }
+    memset(hand_out, 0, sizeof(ct_hand_out_t));
+    hand_out->connection_callbacks = *connection_callbacks;
+    if (message) {
+        hand_out->message = ct_message_deep_copy(message);
+        if (!hand_out->message) {
+            log_error("Failed to deep copy initial message for connection hand-out");
+            free(hand_out);
+            return NULL;
+        }
+    }
+    if (message_context) {
+        hand_out->message_context = ct_message_context_deep_copy(message_context);
+        if (!hand_out->message_context) {
+            log_error("Failed to deep copy message context for connection hand-out");
+            ct_message_free(hand_out->message);
+            free(hand_out);
+            return NULL;
+        }
+    }
+    return hand_out;
+}
+
+// For a hand-out whose timer was never started
+static void hand_out_free(ct_hand_out_t* hand_out) {
+    ct_message_free(hand_out->message);
+    ct_message_context_free(hand_out->message_context);
+    free(hand_out);
+}
+
+static void on_hand_out_timer_closed(uv_handle_t* handle) {
+    hand_out_free((ct_hand_out_t*)handle->data);
+}
+
+static void on_hand_out_timer(uv_timer_t* handle) {
+    ct_hand_out_t* hand_out = handle->data;
+    ct_connection_t* connection = hand_out->connection;
+    connection->connection_callbacks = hand_out->connection_callbacks;
+
+    if (ct_connection_is_closed_or_closing(connection)) {
+        log_warn("Connection %s was closed before it could be handed out", connection->uuid);
+        if (connection->connection_callbacks.establishment_error) {
+            connection->connection_callbacks.establishment_error(connection);
+        }
+    } else {
+        if (hand_out->message) {
+            int rc = ct_send_message_full(connection, hand_out->message, hand_out->message_context);
+            if (rc != 0) {
+                log_error("Failed to send initial message on connection %s: %d",
+                          connection->uuid, rc);
+                connection->socket_manager->callbacks.message_send_error(
+                    connection, ct_message_context_deep_copy(hand_out->message_context), rc);
+            }
+        }
+        if (connection->connection_callbacks.ready) {
+            connection->connection_callbacks.ready(connection);
+        }
+    }
+    uv_close((uv_handle_t*)handle, on_hand_out_timer_closed);
+}
+
+/**
+ * @brief Hand an already established connection to the user, as racing does for its winner.
+ *
+ * Happens on the next loop iteration, so ready() and the initial send never run inside the
+ * initiate call. The initial message is queued before ready() is called. Until then the
+ * connection has no callbacks, so it is not freed if it closes in between and the user gets
+ * establishment_error() instead.
+ */
+static void preconnection_hand_out_connection(ct_connection_t* connection,
+                                              ct_hand_out_t* hand_out) {
+    ct_connection_callbacks_t no_callbacks = {0};
+    connection->connection_callbacks = no_callbacks;
+    hand_out->connection = connection;
+    uv_timer_init(event_loop, &hand_out->timer);
+    hand_out->timer.data = hand_out;
+    uv_timer_start(&hand_out->timer, on_hand_out_timer, 0, 0);
+}
+
+/**
+ * @brief Hand out an idle connection from the preconnection's warm pool instead of racing.
+ *
+ * @return 0 if the connection will be handed to ready(), -ENOENT if no warm connection is idle
+ */
+static int preconnection_initiate_warm(const ct_preconnection_t* preconnection,
+                                       const ct_connection_callbacks_t* connection_callbacks,
+                                       const ct_message_t* message,
+                                       const ct_message_context_t* message_context) {
+    // Allocated first, so that a taken connection is never lost
+    ct_hand_out_t* hand_out = hand_out_new(connection_callbacks, message, message_context);
+    if (!hand_out) {
+        return -ENOMEM;
+    }
+    ct_connection_t* connection = ct_warm_pool_take(preconnection->warm_pool);
+    if (!connection) {
+        log_debug("No warm connection available, falling back to racing");
+        hand_out_free(hand_out);
+        return -ENOENT;
+    }
+    log_info("Using warm connection %s", connection->uuid);
+    preconnection_hand_out_connection(connection, hand_out);
+    return 0;
+}
+
+/**
+ * @brief Open a stream in a pooled QUIC connection group instead of racing.
+ *
+ * @return 0 if the connection will be handed to ready(), -ENOENT if no pooled group is usable
+ */
+static int preconnection_initiate_coalesced(const ct_preconnection_t* preconnection,
+                                            const ct_connection_callbacks_t* connection_callbacks,
+                                            const ct_message_t* message,
+                                            const ct_message_context_t* message_context) {
+    char* pool_key = ct_connection_pool_key_new(preconnection);
+    ct_connection_t* source_connection =
+        ct_connection_pool_find(pool_key, &preconnection->selection_masks);
+    free(pool_key);
+    if (!source_connection) {
+        return -ENOENT;
+    }
+    log_info("Coalescing connection into connection group %s",
+             source_connection->connection_group->connection_group_id);
+
+    ct_hand_out_t* hand_out = hand_out_new(connection_callbacks, message, message_context);
+    if (!hand_out) {
+        return -ENOMEM;
+    }
+    ct_connection_t* connection = ct_connection_create_clone(
+        source_connection, source_connection->socket_manager, preconnection->framer_impl, NULL);
+    if (!connection) {
+        log_error("Failed to create coalesced connection");
+        hand_out_free(hand_out);
+        return -ENOMEM;
+    }
+    // clone_connection() reports the stream ready right away, the user only hears of it later
+    ct_connection_callbacks_t no_callbacks = {0};
+    connection->connection_callbacks = no_callbacks;
+    int rc = source_connection->socket_manager->protocol_impl->clone_connection(source_connection,
+                                                                                connection);
+    if (rc < 0) {
+        log_error("Failed to initialize protocol state for coalesced connection: %d", rc);
+        ct_connection_free(connection);
+        hand_out_free(hand_out);
+        return rc;
+    }
+    preconnection_hand_out_connection(connection, hand_out);
+    return 0;
+}
+
 int ct_preconnection_initiate(const ct_preconnection_t* preconnection,
                               const ct_connection_callbacks_t* connection_callbacks) {
     log_info("Initiating connection from preconnection with candidate racing");
@@ -244,6 +474,18 @@ int ct_preconnection_initiate(const ct_preconnection_t* preconnection,
         log_error("Preconnection must have at least one remote endpoint to initiate connection");
         return -EINVAL;
     }
+    if (preconnection->coalesce_connections) {
+        int rc = preconnection_initiate_coalesced(preconnection, connection_callbacks, NULL, NULL);
+        if (rc != -ENOENT) {
+            return rc;
+        }
+    }
+    if (preconnection->warm_pool) {
+        int rc = preconnection_initiate_warm(preconnection, connection_callbacks, NULL, NULL);
+        if (rc != -ENOENT) {
+            return rc;
+        }
+    }
 
     // The winning connection will be passed to the ready()
     return preconnection_race(preconnection, *connection_callbacks);
@@ -262,6 +504,21 @@ int ct_preconnection_initiate_with_send(const ct_preconnection_t* preconnection,
         log_error("Preconnection must have at least one remote endpoint to initiate connection");
         return -EINVAL;
     }
+    if (preconnection->coalesce_connections) {
+        // No early data needed, the group is already established
+        int rc = preconnection_initiate_coalesced(preconnection, connection_callbacks, message,
+                                                  message_context);
+        if (rc != -ENOENT) {
+            return rc;
+        }
+    }
+    if (preconnection->warm_pool) {
+        int rc = preconnection_initiate_warm(preconnection, connection_callbacks, message,
+                                             message_context);
+        if (rc != -ENOENT) {
+            return rc;
+        }
+    }
     ct_message_t* msg_copy = NULL;
     if (message) {
         msg_copy = ct_message_deep_copy(message);
@@ -296,6 +553,12 @@ void ct_preconnection_free(ct_preconnection_t* preconnection) {
         return;
     }
 
+    ct_warm_pool_release(preconnection->warm_pool);
+    preconnection->warm_pool = NULL;
+
+    ct_candidate_plan_free(preconnection->candidate_plan);
+    preconnection->candidate_plan = NULL;
+
     // Free remote endpoint strings and array
     if (preconnection->remote_endpoints != NULL) {
         for (size_t i = 0; i < preconnection->num_remote_endpoints; i++) {
@@ -341,6 +604,136 @@ int ct_preconnection_set_framer(ct_preconnection_t* preconnection, const ct_fram
     return 0;
 }
 
+int ct_preconnection_set_connection_coalescing(ct_preconnection_t* preconnection, bool enabled) {
+    if (!preconnection) {
+        log_error("Preconnection is NULL in ct_preconnection_set_connection_coalescing");
+        return -EINVAL;
+    }
+    preconnection->coalesce_connections = enabled;
+    return 0;
+}
+
+/**
+ * @brief Copy of the preconnection to race with after the call returns, without coalescing.
+ */
+static ct_preconnection_t* preconnection_copy_for_racing(const ct_preconnection_t* preconnection) {
+    const ct_local_endpoint_t** local_endpoints =
+        calloc(preconnection->num_local_endpoints + 1, sizeof(ct_local_endpoint_t*));
+    const ct_remote_endpoint_t** remote_endpoints =
+        calloc(preconnection->num_remote_endpoints + 1, sizeof(ct_remote_endpoint_t*));
+    if (!local_endpoints || !remote_endpoints) {
+        log_error("Failed to allocate endpoint arrays for preconnection copy");
+        free(local_endpoints);
+        free(remote_endpoints);
+        return NULL;
+    }
+    for (size_t i = 0; i < preconnection->num_local_endpoints; i++) {
+        local_endpoints[i] = &preconnection->local_endpoints[i];
+    }
+    for (size_t i = 0; i < preconnection->num_remote_endpoints; i++) {
+        remote_endpoints[i] = &preconnection->remote_endpoints[i];
+    }
+
+    ct_preconnection_t* copy = ct_preconnection_new(
+        local_endpoints, preconnection->num_local_endpoints, remote_endpoints,
+        preconnection->num_remote_endpoints, &preconnection->transport_properties,
+        preconnection->security_parameters);
+    free(local_endpoints);
+    free(remote_endpoints);
+    if (!copy) {
+        return NULL;
+    }
+    if (ct_preconnection_set_framer(copy, preconnection->framer_impl) != 0) {
+        ct_preconnection_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+int ct_preconnection_set_warm_pool(ct_preconnection_t* preconnection, size_t min_connections,
+                                   size_t max_connections, uint64_t idle_timeout_ms) {
+    if (!preconnection) {
+        log_error("Preconnection is NULL in ct_preconnection_set_warm_pool");
+        return -EINVAL;
+    }
+    if (min_connections > max_connections) {
+        log_error("Warm pool minimum of %zu connections exceeds maximum of %zu", min_connections,
+                  max_connections);
+        return -EINVAL;
+    }
+
+    ct_warm_pool_release(preconnection->warm_pool);
+    preconnection->warm_pool = NULL;
+    if (max_connections == 0) {
+        log_debug("Warm pool disabled for preconnection");
+        return 0;
+    }
+    if (preconnection->num_remote_endpoints == 0) {
+        log_error("Preconnection must have at least one remote endpoint to keep warm connections");
+        return -EINVAL;
+    }
+
+    ct_preconnection_t* copy = preconnection_copy_for_racing(preconnection);
+    if (!copy) {
+        log_error("Failed to copy preconnection for warm pool");
+        return -ENOMEM;
+    }
+    preconnection->warm_pool =
+        ct_warm_pool_new(copy, min_connections, max_connections, idle_timeout_ms);
+    if (!preconnection->warm_pool) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+int ct_preconnection_set_listen_all_protocols(ct_preconnection_t* preconnection, bool enabled) {
+    if (!preconnection) {
+        log_error("Preconnection is NULL in ct_preconnection_set_listen_all_protocols");
+        return -EINVAL;
+    }
+    preconnection->listen_all_protocols = enabled;
+    return 0;
+}
+
+int ct_preconnection_set_initiate_ramp(ct_preconnection_t* preconnection, uint64_t ramp_ms) {
+    if (!preconnection) {
+        log_error("Preconnection is NULL in ct_preconnection_set_initiate_ramp");
+        return -EINVAL;
+    }
+    preconnection->initiate_ramp_ms = ramp_ms;
+    return 0;
+}
+
+int ct_preconnection_initiate_many(const ct_preconnection_t* preconnection,
+                                   size_t num_connections,
+                                   const ct_connection_callbacks_t* connection_callbacks) {
+    log_info("Initiating %zu connections from preconnection", num_connections);
+    if (!preconnection || !connection_callbacks || num_connections == 0) {
+        log_error("Invalid arguments in ct_preconnection_initiate_many");
+        return -EINVAL;
+    }
+    if (preconnection->num_remote_endpoints == 0) {
+        log_error("Preconnection must have at least one remote endpoint to initiate connection");
+        return -EINVAL;
+    }
+    ct_preconnection_t* copy = preconnection_copy_for_racing(preconnection);
+    if (!copy) {
+        log_error("Failed to copy preconnection for bulk initiate");
+        return -ENOMEM;
+    }
+    // NULL without a valid plan, the copy then gathers once for every connection
+    GArray* planned_candidates = ct_candidate_plan_instantiate(preconnection->candidate_plan);
+    return ct_bulk_initiate_start(copy, planned_candidates, num_connections,
+                                  preconnection->initiate_ramp_ms, connection_callbacks);
+}
+
+size_t ct_preconnection_get_num_warm_connections(const ct_preconnection_t* preconnection) {
+    if (!preconnection) {
+        return 0;
+    }
+    return ct_warm_pool_get_num_idle(preconnection->warm_pool);
+}
+
 const ct_local_endpoint_t*
 ct_preconnection_get_local_endpoints(const ct_preconnection_t* preconnection, size_t* out_count) {
     if (!out_count) {
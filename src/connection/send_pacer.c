@@ -0,0 +1,240 @@
+#include "connection/send_pacer.h"
+
+#include "connection/connection.h"
+#include "connection/socket_manager/socket_manager.h"
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include "message/message.h"
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_MS 1000000ULL
+
+static void on_pacer_timer(uv_timer_t* handle);
+
+uint64_t ct_send_pacer_effective_rate(uint64_t min_send_rate, uint64_t max_send_rate) {
+    if (max_send_rate == CT_CONN_RATE_UNLIMITED) {
+        return CT_CONN_RATE_UNLIMITED;
+    }
+    if (min_send_rate != CT_CONN_RATE_UNLIMITED && min_send_rate > max_send_rate) {
+        return min_send_rate;
+    }
+    return max_send_rate;
+}
+
+static void token_bucket_refill(ct_token_bucket_t* bucket, uint64_t now_ns) {
+    if (now_ns <= bucket->last_refill_ns) {
+        return;
+    }
+    uint64_t elapsed_ns = now_ns - bucket->last_refill_ns;
+    uint64_t earned = (uint64_t)((double)elapsed_ns * (double)bucket->rate_bytes_per_sec /
+                                 (double)NS_PER_SEC);
+    if (earned == 0) {
+        // Keep last_refill_ns, so the fraction is earned by a later refill
+        return;
+    }
+    if (bucket->tokens + (double)earned >= (double)bucket->burst_bytes) {
+        bucket->tokens = (int64_t)bucket->burst_bytes;
+        bucket->last_refill_ns = now_ns;
+        return;
+    }
+    bucket->tokens += (int64_t)earned;
+    // Only advance by the time that paid for whole tokens
+    bucket->last_refill_ns +=
+        (uint64_t)((double)earned * (double)NS_PER_SEC / (double)bucket->rate_bytes_per_sec);
+}
+
+void ct_token_bucket_set_rate(ct_token_bucket_t* bucket, uint64_t rate_bits_per_sec,
+                              uint64_t now_ns) {
+    if (rate_bits_per_sec == CT_CONN_RATE_UNLIMITED) {
+        bucket->rate_bytes_per_sec = UINT64_MAX;
+        bucket->burst_bytes = UINT64_MAX;
+        bucket->tokens = 0;
+        bucket->last_refill_ns = now_ns;
+        return;
+    }
+    if (bucket->rate_bytes_per_sec != UINT64_MAX) {
+        token_bucket_refill(bucket, now_ns);
+    }
+    bucket->rate_bytes_per_sec = rate_bits_per_sec / 8 > 0 ? rate_bits_per_sec / 8 : 1;
+    bucket->burst_bytes = bucket->rate_bytes_per_sec * CT_SEND_PACER_BURST_MS / 1000;
+    if (bucket->burst_bytes < CT_SEND_PACER_MIN_BURST_BYTES) {
+        bucket->burst_bytes = CT_SEND_PACER_MIN_BURST_BYTES;
+    }
+    if (bucket->tokens > (int64_t)bucket->burst_bytes) {
+        bucket->tokens = (int64_t)bucket->burst_bytes;
+    }
+    bucket->last_refill_ns = now_ns;
+}
+
+void ct_token_bucket_init(ct_token_bucket_t* bucket, uint64_t rate_bits_per_sec, uint64_t now_ns) {
+    memset(bucket, 0, sizeof(ct_token_bucket_t));
+    ct_token_bucket_set_rate(bucket, rate_bits_per_sec, now_ns);
+    if (bucket->rate_bytes_per_sec != UINT64_MAX) {
+        // Start full, so the first burst is not delayed
+        bucket->tokens = (int64_t)bucket->burst_bytes;
+    }
+}
+
+bool ct_token_bucket_consume(ct_token_bucket_t* bucket, size_t bytes, uint64_t now_ns) {
+    if (bucket->rate_bytes_per_sec == UINT64_MAX) {
+        return true;
+    }
+    token_bucket_refill(bucket, now_ns);
+    if (bucket->tokens < 0) {
+        return false;
+    }
+    bucket->tokens -= (int64_t)bytes;
+    return true;
+}
+
+uint64_t ct_token_bucket_time_until_ready_ns(const ct_token_bucket_t* bucket, uint64_t now_ns) {
+    if (bucket->rate_bytes_per_sec == UINT64_MAX || bucket->tokens >= 0) {
+        return 0;
+    }
+    uint64_t debt_ns = (uint64_t)((double)(-bucket->tokens) * (double)NS_PER_SEC /
+                                  (double)bucket->rate_bytes_per_sec) + 1;
+    uint64_t elapsed_ns = now_ns > bucket->last_refill_ns ? now_ns - bucket->last_refill_ns : 0;
+    return elapsed_ns >= debt_ns ? 0 : debt_ns - elapsed_ns;
+}
+
+ct_send_pacer_t* ct_send_pacer_new(ct_connection_t* connection, uint64_t rate_bits_per_sec) {
+    ct_send_pacer_t* pacer = malloc(sizeof(ct_send_pacer_t));
+    if (!pacer) {
+        log_error("Failed to allocate send pacer");
+        return NULL;
+    }
+    memset(pacer, 0, sizeof(ct_send_pacer_t));
+    pacer->timer = malloc(sizeof(uv_timer_t));
+    if (!pacer->timer) {
+        log_error("Failed to allocate send pacer timer");
+        free(pacer);
+        return NULL;
+    }
+    int rc = uv_timer_init(event_loop, pacer->timer);
+    if (rc < 0) {
+        log_error("Failed to initialize send pacer timer: %s", uv_strerror(rc));
+        free(pacer->timer);
+        free(pacer);
+        return NULL;
+    }
+    pacer->timer->data = pacer;
+    pacer->pending = g_queue_new();
+    pacer->connection = connection;
+    ct_token_bucket_init(&pacer->bucket, rate_bits_per_sec, uv_hrtime());
+    return pacer;
+}
+
+static void schedule_release(ct_send_pacer_t* pacer) {
+    uint64_t wait_ns = ct_token_bucket_time_until_ready_ns(&pacer->bucket, uv_hrtime());
+    // Round up, waking before the bucket is ready would only re-arm the timer
+    uint64_t wait_ms = (wait_ns + NS_PER_MS - 1) / NS_PER_MS;
+    uv_timer_start(pacer->timer, on_pacer_timer, wait_ms, 0);
+}
+
+static int send_now(ct_send_pacer_t* pacer, ct_message_t* message,
+                    ct_message_context_t* message_context) {
+    ct_connection_t* connection = pacer->connection;
+    return connection->socket_manager->protocol_impl->send(connection, message, message_context);
+}
+
+int ct_send_pacer_submit(ct_send_pacer_t* pacer, ct_message_t* message,
+                         ct_message_context_t* message_context) {
+    if (g_queue_is_empty(pacer->pending) &&
+        ct_token_bucket_consume(&pacer->bucket, message->length, uv_hrtime())) {
+        return send_now(pacer, message, message_context);
+    }
+    ct_queued_message_t* queued_message = ct_queued_message_new(message, message_context);
+    if (!queued_message) {
+        return -ENOMEM;
+    }
+    log_trace("Send rate reached on connection %s, queueing message", pacer->connection->uuid);
+    g_queue_push_tail(pacer->pending, queued_message);
+    if (!uv_is_active((uv_handle_t*)pacer->timer)) {
+        schedule_release(pacer);
+    }
+    return 0;
+}
+
+static void on_pacer_timer(uv_timer_t* handle) {
+    ct_send_pacer_t* pacer = handle->data;
+    ct_connection_t* connection = pacer->connection;
+
+    if (ct_connection_is_closed(connection)) {
+        ct_send_pacer_fail_pending(pacer, -EPIPE);
+        return;
+    }
+
+    while (!g_queue_is_empty(pacer->pending)) {
+        ct_queued_message_t* queued_message = g_queue_peek_head(pacer->pending);
+        if (!ct_token_bucket_consume(&pacer->bucket, queued_message->message->length,
+                                     uv_hrtime())) {
+            schedule_release(pacer);
+            return;
+        }
+        g_queue_pop_head(pacer->pending);
+        int rc = send_now(pacer, queued_message->message, queued_message->context);
+        if (rc < 0) {
+            log_error("Failed to release paced message on connection %s: %d", connection->uuid,
+                      rc);
+            ct_message_free(queued_message->message);
+            connection->socket_manager->callbacks.message_send_error(
+                connection, queued_message->context, rc);
+        }
+        free(queued_message);
+    }
+
+    if (pacer->close_pending) {
+        pacer->close_pending = false;
+        ct_socket_manager_close_connection(connection);
+    }
+}
+
+void ct_send_pacer_set_rate(ct_send_pacer_t* pacer, uint64_t rate_bits_per_sec) {
+    ct_token_bucket_set_rate(&pacer->bucket, rate_bits_per_sec, uv_hrtime());
+    if (!g_queue_is_empty(pacer->pending)) {
+        uv_timer_stop(pacer->timer);
+        schedule_release(pacer);
+    }
+}
+
+bool ct_send_pacer_has_pending(const ct_send_pacer_t* pacer) {
+    return !g_queue_is_empty(pacer->pending);
+}
+
+void ct_send_pacer_fail_pending(ct_send_pacer_t* pacer, int reason) {
+    ct_connection_t* connection = pacer->connection;
+    uv_timer_stop(pacer->timer);
+    pacer->close_pending = false;
+    while (!g_queue_is_empty(pacer->pending)) {
+        ct_queued_message_t* queued_message = g_queue_pop_head(pacer->pending);
+        ct_message_free(queued_message->message);
+        connection->socket_manager->callbacks.message_send_error(connection,
+                                                                 queued_message->context, reason);
+        free(queued_message);
+    }
+}
+
+static void on_pacer_timer_closed(uv_handle_t* handle) {
+    ct_send_pacer_t* pacer = handle->data;
+    free(pacer->timer);
+    free(pacer);
+}
+
+void ct_send_pacer_free(ct_send_pacer_t* pacer) {
+    if (!pacer) {
+        return;
+    }
+    while (!g_queue_is_empty(pacer->pending)) {
+        ct_queued_message_free_all(g_queue_pop_head(pacer->pending));
+    }
+    g_queue_free(pacer->pending);
+    pacer->pending = NULL;
+    uv_timer_stop(pacer->timer);
+    uv_close((uv_handle_t*)pacer->timer, on_pacer_timer_closed);
+}
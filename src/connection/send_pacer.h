@@ -0,0 +1,111 @@
+#ifndef CT_SEND_PACER_H
+#define CT_SEND_PACER_H
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <uv.h>
+
+// Bucket depth, in time at the configured rate
+#define CT_SEND_PACER_BURST_MS 10
+// Never shallower than two full-sized packets, so slow rates still send whole datagrams
+#define CT_SEND_PACER_MIN_BURST_BYTES 3000
+
+/**
+ * @brief Token bucket in bytes.
+ *
+ * Tokens may go negative: a message larger than the bucket is released as soon as the
+ * bucket is non-negative and its excess is paid back before the next release.
+ */
+typedef struct ct_token_bucket_s {
+    uint64_t rate_bytes_per_sec; ///< UINT64_MAX when unlimited
+    uint64_t burst_bytes;
+    int64_t tokens;
+    uint64_t last_refill_ns;
+} ct_token_bucket_t;
+
+/**
+ * @brief Per-connection userspace pacer.
+ *
+ * Used when the protocol cannot enforce maxSendRate itself. Messages that arrive while the
+ * bucket is empty wait in a release queue, which a uv timer drains as tokens accrue.
+ */
+typedef struct ct_send_pacer_s {
+    ct_token_bucket_t bucket;
+    GQueue* pending; // ct_queued_message_t waiting for tokens, in send order
+    uv_timer_t* timer;
+    ct_connection_t* connection;
+    bool close_pending; // Close the connection once pending has drained
+} ct_send_pacer_t;
+
+/**
+ * @brief Rate to enforce for the given minSendRate and maxSendRate, in bits per second.
+ *
+ * minSendRate is a floor, so it wins over a lower maxSendRate.
+ *
+ * @return The rate, or CT_CONN_RATE_UNLIMITED if sending should not be paced
+ */
+uint64_t ct_send_pacer_effective_rate(uint64_t min_send_rate, uint64_t max_send_rate);
+
+void ct_token_bucket_init(ct_token_bucket_t* bucket, uint64_t rate_bits_per_sec, uint64_t now_ns);
+
+void ct_token_bucket_set_rate(ct_token_bucket_t* bucket, uint64_t rate_bits_per_sec,
+                              uint64_t now_ns);
+
+/**
+ * @brief Take tokens for a message of the given size.
+ *
+ * @return true if the message may be sent now, false if the bucket is in debt
+ */
+bool ct_token_bucket_consume(ct_token_bucket_t* bucket, size_t bytes, uint64_t now_ns);
+
+/**
+ * @brief Time until ct_token_bucket_consume() succeeds again.
+ *
+ * @return Nanoseconds, 0 if tokens are available now
+ */
+uint64_t ct_token_bucket_time_until_ready_ns(const ct_token_bucket_t* bucket, uint64_t now_ns);
+
+/**
+ * @brief Create a pacer for a connection.
+ *
+ * @param[in] connection Connection whose sends are paced
+ * @param[in] rate_bits_per_sec Rate to enforce
+ * @return Pointer to the pacer, or NULL on error
+ */
+ct_send_pacer_t* ct_send_pacer_new(ct_connection_t* connection, uint64_t rate_bits_per_sec);
+
+/**
+ * @brief Pass a message to the protocol now, or queue it until the rate allows.
+ *
+ * @return 0 on success or when queued, negative protocol error on synchronous send failure
+ * @note On non-zero return the caller still owns the message and its context.
+ */
+int ct_send_pacer_submit(ct_send_pacer_t* pacer, ct_message_t* message,
+                         ct_message_context_t* message_context);
+
+/**
+ * @brief Change the enforced rate. Queued messages are rescheduled at the new rate.
+ */
+void ct_send_pacer_set_rate(ct_send_pacer_t* pacer, uint64_t rate_bits_per_sec);
+
+/**
+ * @brief Whether messages are waiting in the release queue.
+ */
+bool ct_send_pacer_has_pending(const ct_send_pacer_t* pacer);
+
+/**
+ * @brief Fail every queued message through the send_error callback.
+ */
+void ct_send_pacer_fail_pending(ct_send_pacer_t* pacer, int reason);
+
+/**
+ * @brief Free the pacer. Queued messages are dropped without callbacks.
+ *
+ * The timer is closed asynchronously, the pacer memory is released in its close callback.
+ */
+void ct_send_pacer_free(ct_send_pacer_t* pacer);
+
+#endif // CT_SEND_PACER_H
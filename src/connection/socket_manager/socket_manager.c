@@ -107,7 +107,8 @@ int socket_manager_insert_demuxed_connection(ct_socket_manager_t* socket_manager
 int ct_socket_manager_get_num_open_dependents(const ct_socket_manager_t* socket_manager) {
     log_trace("Checking how many open connections socket manager has");
     int counter = 0;
-    if (socket_manager->listener && socket_manager->listener->state != CT_LISTENER_STATE_CLOSED) {
+    if (socket_manager->listener && socket_manager->listener->state != CT_LISTENER_STATE_CLOSED &&
+        !socket_manager->stopped_listening) {
         counter++;
     }
 
@@ -180,6 +181,27 @@ void ct_socket_manager_notify_of_listener_close(ct_socket_manager_t* socket_mana
     }
 }
 
+/**
+ * @brief Record that the listener stopped accepting through this socket manager.
+ *
+ * The listener is only closed, and the user notified, once every protocol it listens on
+ * has stopped.
+ */
+static void socket_manager_stop_listening(ct_socket_manager_t* socket_manager) {
+    if (socket_manager->stopped_listening) {
+        log_debug("Socket manager %p already stopped listening", socket_manager);
+        return;
+    }
+    socket_manager->stopped_listening = true;
+    ct_listener_t* listener = socket_manager->listener;
+    if (!ct_listener_socket_manager_stopped(listener)) {
+        log_debug("Listener still listens on other protocols, not closing it yet");
+        return;
+    }
+    ct_listener_mark_as_closed(listener);
+    ct_socket_manager_notify_of_listener_close(socket_manager, listener);
+}
+
 void ct_socket_manager_listener_ready_cb(ct_listener_t* listener) {
     log_debug("Socket manager listener ready callback invoked");
     if (listener->listener_callbacks.listener_ready) {
@@ -278,9 +300,7 @@ void ct_socket_manager_closed_socket_cb(ct_socket_manager_t* socket_manager) {
         ct_connection_mark_as_closed(conn);
         ct_socket_manager_notify_of_connection_close(socket_manager, conn);
     } else {
-        ct_listener_t* listener = socket_manager->listener;
-        ct_listener_mark_as_closed(listener);
-        ct_socket_manager_notify_of_listener_close(socket_manager, listener);
+        socket_manager_stop_listening(socket_manager);
     }
 }
 
@@ -338,6 +358,7 @@ void ct_socket_manager_connection_ready_cb(ct_connection_t* connection) {
     log_debug("Socket manager connection ready callback invoked for connection: %s",
               connection->uuid);
     ct_connection_mark_as_established(connection);
+    ct_connection_apply_send_rate(connection);
     if (connection->connection_callbacks.ready) {
         connection->connection_callbacks.ready(connection);
     } else {
@@ -421,7 +442,6 @@ void ct_socket_manager_message_send_error_cb(ct_connection_t* connection,
 
 void ct_socket_manager_listener_closed_cb(ct_socket_manager_t* socket_manager) {
     log_debug("Socket manager listener closed callback invoked");
-    ct_listener_t* listener = socket_manager->listener;
     int num_open = ct_socket_manager_get_num_open_dependents(socket_manager);
 
     if (num_open == 1) {
@@ -435,13 +455,13 @@ void ct_socket_manager_listener_closed_cb(ct_socket_manager_t* socket_manager) {
                   num_open);
     }
 
-    ct_listener_mark_as_closed(listener);
-    ct_socket_manager_notify_of_listener_close(socket_manager, listener);
+    socket_manager_stop_listening(socket_manager);
 }
 
 void ct_socket_manager_connection_received_cb(ct_listener_t* listener,
                                               ct_connection_t* connection) {
     ct_connection_mark_as_established(connection);
+    ct_connection_apply_send_rate(connection);
     if (listener->listener_callbacks.connection_received) {
         listener->listener_callbacks.connection_received(listener, connection);
     } else {
@@ -498,6 +518,17 @@ int ct_socket_manager_notify_protocol_of_priority_change(ct_connection_t* connec
     }
 }
 
+int ct_socket_manager_notify_protocol_of_send_rate_change(ct_connection_t* connection,
+                                                          uint64_t max_send_rate) {
+    ct_socket_manager_t* socket_manager = connection->socket_manager;
+    if (socket_manager->protocol_impl->set_send_rate) {
+        return socket_manager->protocol_impl->set_send_rate(connection, max_send_rate);
+    } else {
+        log_debug("Protocol: %s does not pace sends itself", socket_manager->protocol_impl->name);
+        return -ENOTSUP;
+    }
+}
+
 void ct_socket_manager_free_connection_state(ct_connection_t* connection) {
     ct_socket_manager_t* socket_manager = connection->socket_manager;
     if (socket_manager->protocol_impl->free_connection_state) {
@@ -44,6 +44,9 @@ void ct_socket_manager_free(ct_socket_manager_t* socket_manager);
 int ct_socket_manager_notify_protocol_of_priority_change(ct_connection_t* connection,
                                                          uint8_t priority);
 
+int ct_socket_manager_notify_protocol_of_send_rate_change(ct_connection_t* connection,
+                                                          uint64_t max_send_rate);
+
 void ct_socket_manager_listen(ct_listener_t* listener);
 
 #endif //SOCKET_MANAGER_H
@@ -0,0 +1,265 @@
+#include "warm_pool.h"
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <candidate_gathering/candidate_racing.h>
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+typedef struct ct_warm_pool_entry_s {
+    ct_connection_t* connection;
+    uint64_t idle_since_ms;
+} ct_warm_pool_entry_t;
+
+struct ct_warm_pool_s {
+    // Private copy, in flight attempts may outlive the user's preconnection
+    ct_preconnection_t* preconnection;
+    size_t min_connections;
+    size_t max_connections;
+    size_t target_connections;
+    uint64_t idle_timeout_ms;
+
+    GQueue idle_connections; // ct_warm_pool_entry_t*, oldest first
+    size_t num_establishing;
+
+    uv_timer_t* idle_timer;
+    // Owner, idle timer and every in flight attempt hold a reference
+    unsigned int ref_count;
+    bool released;
+};
+
+static void warm_pool_unref(ct_warm_pool_t* pool) {
+    pool->ref_count--;
+    if (pool->ref_count > 0) {
+        return;
+    }
+    log_debug("Freeing warm pool");
+    ct_preconnection_free(pool->preconnection);
+    free(pool);
+}
+
+static void warm_pool_free_on_close(ct_connection_t* connection) {
+    ct_connection_free(connection);
+}
+
+static void warm_pool_discard(ct_connection_t* connection) {
+    log_debug("Closing warm connection %s", connection->uuid);
+    ct_connection_callbacks_t callbacks = {
+        .closed = warm_pool_free_on_close,
+    };
+    connection->connection_callbacks = callbacks;
+    if (ct_connection_is_closed(connection)) {
+        ct_connection_free(connection);
+        return;
+    }
+    if (!ct_connection_is_closing(connection)) {
+        ct_connection_close_group(connection);
+    }
+}
+
+static void warm_pool_on_ready(ct_connection_t* connection) {
+    ct_warm_pool_t* pool = connection->connection_callbacks.per_connection_context;
+    pool->num_establishing--;
+
+    if (pool->released ||
+        g_queue_get_length(&pool->idle_connections) >= pool->target_connections) {
+        warm_pool_discard(connection);
+    } else {
+        ct_warm_pool_entry_t* entry = malloc(sizeof(ct_warm_pool_entry_t));
+        if (!entry) {
+            log_error("Failed to allocate warm pool entry");
+            warm_pool_discard(connection);
+        } else {
+            entry->connection = connection;
+            entry->idle_since_ms = uv_now(event_loop);
+            g_queue_push_tail(&pool->idle_connections, entry);
+            log_debug("Warm connection %s is idle, %u idle in pool", connection->uuid,
+                      g_queue_get_length(&pool->idle_connections));
+        }
+    }
+    warm_pool_unref(pool);
+}
+
+static void warm_pool_on_race_failed(void* context) {
+    ct_warm_pool_t* pool = context;
+    log_warn("Failed to establish warm connection");
+    // Not retried right away, the next take or idle timer tick refills the pool
+    pool->num_establishing--;
+    warm_pool_unref(pool);
+}
+
+static void warm_pool_on_closed(ct_connection_t* connection) {
+    ct_warm_pool_t* pool = connection->connection_callbacks.per_connection_context;
+    for (GList* node = pool->idle_connections.head; node; node = node->next) {
+        ct_warm_pool_entry_t* entry = node->data;
+        if (entry->connection == connection) {
+            log_debug("Idle warm connection %s was closed", connection->uuid);
+            g_queue_delete_link(&pool->idle_connections, node);
+            free(entry);
+            break;
+        }
+    }
+    ct_connection_free(connection);
+}
+
+static void warm_pool_on_idle_timer(uv_timer_t* handle) {
+    ct_warm_pool_t* pool = handle->data;
+    uint64_t now = uv_now(event_loop);
+
+    ct_warm_pool_entry_t* oldest = g_queue_peek_head(&pool->idle_connections);
+    while (oldest && now - oldest->idle_since_ms >= pool->idle_timeout_ms &&
+           g_queue_get_length(&pool->idle_connections) + pool->num_establishing >
+               pool->min_connections) {
+        g_queue_pop_head(&pool->idle_connections);
+        warm_pool_discard(oldest->connection);
+        free(oldest);
+        if (pool->target_connections > pool->min_connections) {
+            pool->target_connections--;
+        }
+        oldest = g_queue_peek_head(&pool->idle_connections);
+    }
+    ct_warm_pool_fill(pool);
+}
+
+static void warm_pool_on_idle_timer_close(uv_handle_t* handle) {
+    ct_warm_pool_t* pool = handle->data;
+    free(handle);
+    warm_pool_unref(pool);
+}
+
+ct_warm_pool_t* ct_warm_pool_new(ct_preconnection_t* preconnection, size_t min_connections,
+                                 size_t max_connections, uint64_t idle_timeout_ms) {
+    ct_warm_pool_t* pool = malloc(sizeof(ct_warm_pool_t));
+    if (!pool) {
+        log_error("Failed to allocate warm pool");
+        ct_preconnection_free(preconnection);
+        return NULL;
+    }
+    memset(pool, 0, sizeof(ct_warm_pool_t));
+    pool->preconnection = preconnection;
+    pool->min_connections = min_connections;
+    pool->max_connections = max_connections;
+    pool->target_connections = min_connections;
+    pool->idle_timeout_ms = idle_timeout_ms;
+    g_queue_init(&pool->idle_connections);
+    pool->ref_count = 1;
+
+    if (idle_timeout_ms > 0) {
+        pool->idle_timer = malloc(sizeof(uv_timer_t));
+        if (!pool->idle_timer) {
+            log_error("Failed to allocate warm pool idle timer");
+            warm_pool_unref(pool);
+            return NULL;
+        }
+        uv_timer_init(event_loop, pool->idle_timer);
+        pool->idle_timer->data = pool;
+        uv_timer_start(pool->idle_timer, warm_pool_on_idle_timer, idle_timeout_ms,
+                       idle_timeout_ms);
+        // Idle connections keep the loop alive on their own, the timer should not
+        uv_unref((uv_handle_t*)pool->idle_timer);
+        pool->ref_count++;
+    }
+
+    log_info("Created warm pool with min %zu, max %zu connections", min_connections,
+             max_connections);
+    ct_warm_pool_fill(pool);
+    return pool;
+}
+
+void ct_warm_pool_release(ct_warm_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    log_debug("Releasing warm pool with %u idle connections",
+              g_queue_get_length(&pool->idle_connections));
+    pool->released = true;
+
+    ct_warm_pool_entry_t* entry = NULL;
+    while ((entry = g_queue_pop_head(&pool->idle_connections))) {
+        warm_pool_discard(entry->connection);
+        free(entry);
+    }
+    if (pool->idle_timer) {
+        uv_timer_stop(pool->idle_timer);
+        uv_close((uv_handle_t*)pool->idle_timer, warm_pool_on_idle_timer_close);
+        pool->idle_timer = NULL;
+    }
+    warm_pool_unref(pool);
+}
+
+ct_connection_t* ct_warm_pool_take(ct_warm_pool_t* pool) {
+    if (!pool) {
+        return NULL;
+    }
+    ct_connection_t* connection = NULL;
+    ct_warm_pool_entry_t* entry = NULL;
+    // Most recently established first, the oldest are the ones left to time out
+    while (!connection && (entry = g_queue_pop_tail(&pool->idle_connections))) {
+        if (ct_connection_is_established(entry->connection)) {
+            connection = entry->connection;
+        } else {
+            warm_pool_discard(entry->connection);
+        }
+        free(entry);
+    }
+
+    if (connection) {
+        log_debug("Took warm connection %s from pool", connection->uuid);
+    } else if (pool->target_connections < pool->max_connections) {
+        pool->target_connections++;
+        log_debug("Warm pool was empty, growing target to %zu connections",
+                  pool->target_connections);
+    }
+    ct_warm_pool_fill(pool);
+    return connection;
+}
+
+int ct_warm_pool_fill(ct_warm_pool_t* pool) {
+    if (!pool || pool->released) {
+        return 0;
+    }
+    size_t num_pending = g_queue_get_length(&pool->idle_connections) + pool->num_establishing;
+    if (num_pending >= pool->target_connections) {
+        return 0;
+    }
+    // Counted up front, failed races may be reported synchronously
+    size_t num_missing = pool->target_connections - num_pending;
+
+    ct_connection_callbacks_t callbacks = {
+        .ready = warm_pool_on_ready,
+        .closed = warm_pool_on_closed,
+        .per_connection_context = pool,
+    };
+    log_debug("Establishing %zu warm connections", num_missing);
+    for (size_t i = 0; i < num_missing; i++) {
+        pool->num_establishing++;
+        pool->ref_count++;
+        int rc = preconnection_race_with_failure_cb(pool->preconnection, callbacks,
+                                                    warm_pool_on_race_failed, pool);
+        if (rc < 0) {
+            log_error("Failed to start warm connection attempt: %d", rc);
+            pool->num_establishing--;
+            warm_pool_unref(pool);
+            return rc;
+        }
+    }
+    return 0;
+}
+
+size_t ct_warm_pool_get_num_idle(const ct_warm_pool_t* pool) {
+    if (!pool) {
+        return 0;
+    }
+    return pool->idle_connections.length;
+}
+
+size_t ct_warm_pool_get_num_establishing(const ct_warm_pool_t* pool) {
+    if (!pool) {
+        return 0;
+    }
+    return pool->num_establishing;
+}
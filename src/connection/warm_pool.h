@@ -0,0 +1,56 @@
+#ifndef CT_WARM_POOL_H
+#define CT_WARM_POOL_H
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+
+/**
+ * @brief Connections established ahead of demand for a preconnection.
+ *
+ * The pool tries to keep a target number of connections idle. The target starts at
+ * min_connections, grows by one up to max_connections every time ct_warm_pool_take() finds the
+ * pool empty, and shrinks back towards min_connections as idle connections time out.
+ */
+typedef struct ct_warm_pool_s ct_warm_pool_t;
+
+/**
+ * @brief Create a warm pool and start establishing its first connections.
+ *
+ * @param[in] preconnection Private copy the pool races with, the pool takes ownership of it
+ * @param[in] min_connections Connections kept idle even without demand
+ * @param[in] max_connections Upper bound on idle and establishing connections
+ * @param[in] idle_timeout_ms Close connections idle for longer than this beyond
+ *            min_connections, 0 to never close them
+ * @return New pool, or NULL on failure in which case the preconnection is freed
+ */
+ct_warm_pool_t* ct_warm_pool_new(ct_preconnection_t* preconnection, size_t min_connections,
+                                 size_t max_connections, uint64_t idle_timeout_ms);
+
+/**
+ * @brief Close every idle connection and release the pool.
+ *
+ * Attempts still in flight keep the pool alive, their connections are closed once ready.
+ */
+void ct_warm_pool_release(ct_warm_pool_t* pool);
+
+/**
+ * @brief Take the most recently established idle connection and start replacing it.
+ *
+ * The connection still has the pool's callbacks, the caller must replace them.
+ *
+ * @return An established connection, or NULL if none is idle
+ */
+ct_connection_t* ct_warm_pool_take(ct_warm_pool_t* pool);
+
+/**
+ * @brief Start enough attempts to bring idle and establishing connections up to the target.
+ *
+ * @return 0 on success, negative errno if an attempt could not be started
+ */
+int ct_warm_pool_fill(ct_warm_pool_t* pool);
+
+size_t ct_warm_pool_get_num_idle(const ct_warm_pool_t* pool);
+
+size_t ct_warm_pool_get_num_establishing(const ct_warm_pool_t* pool);
+
+#endif // CT_WARM_POOL_H
@@ -177,6 +177,8 @@ typedef struct ct_sec_property_s {
  */
 typedef struct ct_security_parameters_s {
     ct_security_parameter_t list[SEC_PROPERTY_END]; ///< Array of security parameters
+    size_t ref_count; ///< Owners of this object, each releases it with ct_security_parameters_free()
+    bool immutable;   ///< Shared between owners, setters fail with -EPERM
 } ct_security_parameters_t;
 
 #define create_sec_property_initializer(enum_name, string_name, property_type, token_name,         \
@@ -242,6 +244,19 @@ typedef struct ct_selection_properties_s {
     ct_selection_property_t list[SELECTION_PROPERTY_END]; ///< Array of selection properties
 } ct_selection_properties_t;
 
+/**
+ * @brief TYPE_PREFERENCE selection properties compiled into one bitmask per preference.
+ *
+ * Bit i stands for the property with ct_selection_property_enum_t value i, so pruning and
+ * ranking candidates needs no walk over ct_selection_properties_t::list.
+ */
+typedef struct ct_selection_masks_s {
+    uint64_t require;  ///< Properties set to REQUIRE
+    uint64_t prohibit; ///< Properties set to PROHIBIT
+    uint64_t prefer;   ///< Properties set to PREFER
+    uint64_t avoid;    ///< Properties set to AVOID
+} ct_selection_masks_t;
+
 extern const ct_selection_property_t DEFAULT_SELECTION_PROPERTIES[];
 
 /**
@@ -339,15 +354,41 @@ typedef struct ct_message_context_s {
     void* per_receive_context;                  ///< User context from ct_receive_callbacks_t
 } ct_message_context_t;
 
+/**
+ * @brief Immutable connection data shared by reference between members of a group.
+ *
+ * Built from a connection the first time it is cloned, or once per race for the connections
+ * of every attempt. Clones point their endpoint lists and framer into this block instead of
+ * owning a deep copy.
+ * A field of a connection is shared while its pointer equals the one in the block.
+ * A connection holding a block always has the same content as it, so it detaches
+ * (see ct_connection_detach_shared_data()) before modifying any of these fields.
+ */
+typedef struct ct_connection_shared_data_s {
+    size_t num_local_endpoints;
+    ct_local_endpoint_t* all_local_endpoints;
+    size_t num_remote_endpoints;
+    ct_remote_endpoint_t* all_remote_endpoints;
+    ct_framer_impl_t* framer_impl;
+    size_t ref_count; ///< One per connection holding the block, plus one for a race creating them
+} ct_connection_shared_data_t;
+
 /**
  * @brief Connection group for managing related connections.
  */
 typedef struct ct_connection_group_s {
     char connection_group_id[37];                    ///< Unique identifier for this group
-    GHashTable* connections;                         ///< Map of UUID string → ct_connection_t*
+    struct ct_connection_s* members;                 ///< Intrusive list of members, oldest first
+    struct ct_connection_s* members_tail;            ///< Last member, for O(1) append
+    size_t num_members;                              ///< Length of members
+    size_t num_open;                                 ///< Members not in CT_CONN_STATE_CLOSED
+    size_t num_sending;                              ///< Members with canSend
+    size_t num_receiving;                            ///< Members with canReceive
+    size_t num_sending_or_receiving;                 ///< Members with canSend or canReceive
     void* connection_group_state;                    ///< Protocol-specific shared state
     size_t ref_count;                                ///< Reference count for this connection group
     ct_transport_properties_t* transport_properties; ///< Transport and connection properties
+    char* pool_key; ///< Key in the connection pool, NULL unless available for coalescing
 } ct_connection_group_t;
 
 typedef void (*ct_on_connection_close_cb)(ct_connection_t*);
@@ -401,6 +442,12 @@ typedef struct ct_protocol_impl_s {
 
     int (*set_connection_priority)(ct_connection_t* connection, uint8_t priority);
 
+    /** @brief Enforce maxSendRate in the protocol, return -ENOTSUP to use the userspace pacer. */
+    int (*set_send_rate)(ct_connection_t* connection, uint64_t max_send_rate);
+
+    /** @brief Smoothed RTT of an established connection in microseconds, -ENOTSUP if unknown. */
+    int (*get_rtt)(const ct_connection_t* connection, uint64_t* rtt_us);
+
     /** @brief Free protocol-specific shared state in a connection group, useful for multiplexing */
     void (*free_connection_group_state)(ct_connection_group_t* connection_group);
 
@@ -428,8 +475,12 @@ typedef struct ct_listener_s {
         connection_callbacks; ///< User-provided callbacks for connection events on accepted connections
     ct_listener_state_enum_t state; ///< Current state of the listener
     ct_security_parameters_t*
-        security_parameters; ///< Security configuration for accepted connections (owned copy)
-    struct ct_socket_manager_s* socket_manager; ///< Socket manager handling listening sockets
+        security_parameters; ///< Security configuration for accepted connections (immutable, one reference)
+    struct ct_socket_manager_s* socket_manager; ///< Socket manager of the first protocol listened on
+    struct ct_socket_manager_s**
+        extra_socket_managers;        ///< Socket managers of further protocols, one reference each
+    size_t num_extra_socket_managers; ///< Number of further protocols listened on
+    size_t num_listening_socket_managers; ///< Socket managers which have not stopped listening
 } ct_listener_t;
 
 /**
@@ -443,12 +494,18 @@ typedef struct ct_listener_s {
  */
 typedef struct ct_preconnection_s {
     ct_transport_properties_t transport_properties; ///< Transport property preferences
-    ct_security_parameters_t* security_parameters;  ///< Security configuration (owned copy)
+    ct_security_parameters_t* security_parameters;  ///< Security configuration (immutable copy)
     ct_local_endpoint_t* local_endpoints;           ///< Local endpoint specification
     size_t num_local_endpoints;                     ///< Number of local endpoints
     ct_remote_endpoint_t* remote_endpoints;         ///< Array of remote endpoints
     size_t num_remote_endpoints;                    ///< Number of remote endpoints
     ct_framer_impl_t* framer_impl;                  ///< Optional message framer
+    bool coalesce_connections;                      ///< Reuse pooled QUIC connection groups
+    struct ct_warm_pool_s* warm_pool;               ///< Pre-established connections, or NULL
+    struct ct_candidate_plan_s* candidate_plan;     ///< Candidates reused across initiates
+    uint64_t initiate_ramp_ms;                      ///< Spread of ct_preconnection_initiate_many()
+    bool listen_all_protocols;                      ///< Listen on every compatible protocol
+    ct_selection_masks_t selection_masks;           ///< transport_properties, compiled
 } ct_preconnection_t;
 
 // ===================================
@@ -485,6 +542,7 @@ typedef struct ct_socket_manager_s {
     struct ct_listener_s* listener;
     ct_socket_manager_callbacks_t callbacks;
     ct_socket_manager_close_reason_enum_t close_reason;
+    bool stopped_listening; // The listener no longer accepts connections through this socket
 } ct_socket_manager_t;
 
 // =============================================================================
@@ -511,11 +569,13 @@ typedef struct ct_per_connection_properties_s {
 typedef struct ct_connection_s {
     char uuid[37]; ///< Unique identifier for this connection (Should not be used in a crypto sensitive context)
     ct_connection_group_t* connection_group; ///< Connection group (never NULL)
-    ct_security_parameters_t* security_parameters; ///< Security configuration (TLS/QUIC, owned copy)
+    ct_security_parameters_t* security_parameters; ///< Security configuration (TLS/QUIC, immutable, one reference)
 
     size_t num_local_endpoints;
     size_t active_local_endpoint; ///< index into all_local_endpoints
-    ct_local_endpoint_t* all_local_endpoints; ///< Local endpoint (bound address/port)
+    ct_local_endpoint_t* all_local_endpoints; ///< Local endpoint candidates, may be shared
+    ct_local_endpoint_t bound_local_endpoint; ///< Active local endpoint as bound by the socket
+    bool has_bound_local_endpoint; ///< Whether bound_local_endpoint overrides the active entry
 
     size_t num_remote_endpoints;
     size_t active_remote_endpoint; ///< index into all_remote_endpoints for currently active remote endpoint
@@ -531,10 +591,18 @@ typedef struct ct_connection_s {
 
     ct_socket_manager_t* socket_manager; ///< Socket manager
 
-    GQueue* received_callbacks; ///< Queue of pending receive callbacks
-    GQueue* received_messages;  ///< Queue of received messages
+    GQueue received_callbacks; ///< Queue of pending receive callbacks
+    GQueue received_messages;  ///< Queue of received messages
 
     bool sent_early_data; ///< True if 0-RTT was used for this connection and we sent early data
+
+    uint64_t send_rate;                  ///< Enforced send rate in bits/s, CT_CONN_RATE_UNLIMITED if none
+    struct ct_send_pacer_s* send_pacer; ///< Userspace pacer, NULL unless the protocol cannot pace
+
+    struct ct_connection_s* group_prev; ///< Previous member of connection_group
+    struct ct_connection_s* group_next; ///< Next member of connection_group
+
+    ct_connection_shared_data_t* shared_data; ///< Data shared with clones, NULL until first cloned
 } ct_connection_t;
 
 #endif
@@ -0,0 +1,329 @@
+#include "dns_cache.h"
+
+#include "candidate_gathering/candidate_gathering.h"
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <endpoint/port_util.h>
+#include <endpoint/remote_endpoint.h>
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <uv.h>
+
+typedef struct ct_dns_cache_entry_s {
+    char* key; // NULL when the entry bypasses the cache
+    int family;
+    struct sockaddr_storage* addresses;
+    size_t num_addresses;
+    uint64_t expires_at_ms;
+
+    bool lookup_pending;
+    GPtrArray* waiters; // ct_remote_resolve_call_context_t*, waiting for the pending lookup
+    bool in_table;      // Cleared when the cache is cleared while the lookup is in flight
+} ct_dns_cache_entry_t;
+
+static uint32_t dns_cache_ttl_ms = CT_DNS_CACHE_DEFAULT_TTL_MS;
+
+// "hostname\nservice\nfamily" -> ct_dns_cache_entry_t*
+static GHashTable* dns_cache = NULL;
+
+void ct_set_dns_cache_ttl(uint32_t ttl_ms) {
+    log_debug("Setting DNS cache TTL to %u ms", ttl_ms);
+    dns_cache_ttl_ms = ttl_ms;
+    if (ttl_ms == 0) {
+        ct_dns_cache_clear();
+        ct_service_port_cache_clear();
+    }
+}
+
+uint32_t ct_dns_cache_get_ttl(void) {
+    return dns_cache_ttl_ms;
+}
+
+static void dns_cache_entry_free(ct_dns_cache_entry_t* entry) {
+    free(entry->key);
+    free(entry->addresses);
+    if (entry->waiters) {
+        g_ptr_array_unref(entry->waiters);
+    }
+    free(entry);
+}
+
+static ct_dns_cache_entry_t* dns_cache_entry_new(char* key, int family) {
+    ct_dns_cache_entry_t* entry = calloc(1, sizeof(ct_dns_cache_entry_t));
+    if (!entry) {
+        log_error("Could not allocate memory for DNS cache entry");
+        free(key);
+        return NULL;
+    }
+    entry->key = key;
+    entry->family = family;
+    entry->waiters = g_ptr_array_new();
+    return entry;
+}
+
+static bool dns_cache_entry_is_fresh(const ct_dns_cache_entry_t* entry) {
+    return !entry->lookup_pending && entry->num_addresses > 0 &&
+           uv_now(event_loop) < entry->expires_at_ms;
+}
+
+/**
+ * @brief Build the endpoint list for one resolve context, which owns it afterwards.
+ */
+static void dns_cache_deliver(const ct_dns_cache_entry_t* entry,
+                              ct_remote_resolve_call_context_t* context) {
+    if (entry->num_addresses == 0) {
+        ct_remote_endpoint_resolve_cb(NULL, 0, context);
+        return;
+    }
+    ct_remote_endpoint_t* out_list = malloc(entry->num_addresses * sizeof(ct_remote_endpoint_t));
+    if (!out_list) {
+        log_error("Could not allocate memory for ct_remote_endpoint_t output list");
+        ct_remote_endpoint_resolve_cb(NULL, 0, context);
+        return;
+    }
+    for (size_t i = 0; i < entry->num_addresses; i++) {
+        ct_remote_endpoint_t* new_node = &out_list[i];
+        ct_remote_endpoint_build(new_node);
+        new_node->port = context->assigned_port;
+        new_node->resolved_address = entry->addresses[i];
+        if (new_node->resolved_address.ss_family == AF_INET) {
+            ((struct sockaddr_in*)&new_node->resolved_address)->sin_port =
+                htons(context->assigned_port);
+        } else {
+            ((struct sockaddr_in6*)&new_node->resolved_address)->sin6_port =
+                htons(context->assigned_port);
+        }
+    }
+    ct_remote_endpoint_resolve_cb(out_list, entry->num_addresses, context);
+}
+
+static int dns_cache_store_addresses(ct_dns_cache_entry_t* entry, const struct addrinfo* res) {
+    size_t num_addresses = 0;
+    for (const struct addrinfo* ptr = res; ptr != NULL; ptr = ptr->ai_next) {
+        if (ptr->ai_family == AF_INET || ptr->ai_family == AF_INET6) {
+            num_addresses++;
+        }
+    }
+    free(entry->addresses);
+    entry->addresses = NULL;
+    entry->num_addresses = 0;
+    if (num_addresses == 0) {
+        return 0;
+    }
+    entry->addresses = calloc(num_addresses, sizeof(struct sockaddr_storage));
+    if (!entry->addresses) {
+        log_error("Could not allocate memory for resolved addresses");
+        return -ENOMEM;
+    }
+    for (const struct addrinfo* ptr = res; ptr != NULL; ptr = ptr->ai_next) {
+        if (ptr->ai_family == AF_INET) {
+            memcpy(&entry->addresses[entry->num_addresses++], ptr->ai_addr,
+                   sizeof(struct sockaddr_in));
+        } else if (ptr->ai_family == AF_INET6) {
+            memcpy(&entry->addresses[entry->num_addresses++], ptr->ai_addr,
+                   sizeof(struct sockaddr_in6));
+        }
+    }
+    return 0;
+}
+
+static void on_dns_cache_lookup_cb(uv_getaddrinfo_t* req, int status, struct addrinfo* res) {
+    ct_dns_cache_entry_t* entry = req->data;
+    log_trace("DNS lookup completed with status: %d", status);
+
+    int rc = status;
+    if (status < 0 && entry->family != AF_UNSPEC) {
+        // Names without records of one family are common, the other half of the lookup decides
+        log_debug("DNS lookup for family %d failed: %s", entry->family, uv_strerror(status));
+    } else if (status < 0) {
+        log_error("DNS lookup failed for %s: %s", entry->key ? entry->key : "uncached lookup",
+                  uv_strerror(status));
+    } else {
+        rc = dns_cache_store_addresses(entry, res);
+        uv_freeaddrinfo(res);
+    }
+    free(req);
+
+    entry->lookup_pending = false;
+    entry->expires_at_ms = uv_now(event_loop) + dns_cache_ttl_ms;
+    if (rc < 0) {
+        free(entry->addresses);
+        entry->addresses = NULL;
+        entry->num_addresses = 0;
+    }
+
+    // Detached first, a waiter may start another lookup of the same name from its callback
+    GPtrArray* waiters = entry->waiters;
+    entry->waiters = g_ptr_array_new();
+
+    bool keep = entry->in_table && rc == 0 && entry->num_addresses > 0 && dns_cache_ttl_ms > 0;
+    if (!keep && entry->in_table) {
+        g_hash_table_remove(dns_cache, entry->key);
+        entry->in_table = false;
+    }
+    log_debug("Delivering DNS lookup result with %zu addresses to %u waiters",
+              entry->num_addresses, waiters->len);
+    for (guint i = 0; i < waiters->len; i++) {
+        dns_cache_deliver(entry, g_ptr_array_index(waiters, i));
+    }
+    g_ptr_array_unref(waiters);
+    if (!keep) {
+        dns_cache_entry_free(entry);
+    }
+}
+
+static int dns_cache_start_lookup(ct_dns_cache_entry_t* entry, const char* hostname,
+                                  const char* service) {
+    uv_getaddrinfo_t* request = calloc(1, sizeof(uv_getaddrinfo_t));
+    if (!request) {
+        log_error("Could not allocate memory for uv_getaddrinfo_t request");
+        return -ENOMEM;
+    }
+    request->data = entry;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = entry->family;
+    int rc = uv_getaddrinfo(event_loop, request, on_dns_cache_lookup_cb, hostname, service,
+                            entry->family == AF_UNSPEC ? NULL : &hints);
+    if (rc < 0) {
+        log_error("Synchronous error in initiating DNS lookup for hostname %s: %s\n", hostname,
+                  uv_strerror(rc));
+        free(request);
+        return rc;
+    }
+    entry->lookup_pending = true;
+    return 0;
+}
+
+static void dns_cache_evict_expired(void) {
+    uint64_t now = uv_now(event_loop);
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, dns_cache);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ct_dns_cache_entry_t* entry = value;
+        if (!entry->lookup_pending && now >= entry->expires_at_ms) {
+            g_hash_table_iter_remove(&iter);
+            dns_cache_entry_free(entry);
+        }
+    }
+}
+
+/**
+ * @brief Single lookup for one context, used when the cache is bypassed or full.
+ */
+static int dns_cache_resolve_uncached(const char* hostname, const char* service, int family,
+                                      ct_remote_resolve_call_context_t* context) {
+    ct_dns_cache_entry_t* entry = dns_cache_entry_new(NULL, family);
+    if (!entry) {
+        return -ENOMEM;
+    }
+    g_ptr_array_add(entry->waiters, context);
+    int rc = dns_cache_start_lookup(entry, hostname, service);
+    if (rc < 0) {
+        dns_cache_entry_free(entry);
+    }
+    return rc;
+}
+
+int ct_dns_cache_resolve(const char* hostname, const char* service, int family,
+                         ct_remote_resolve_call_context_t* context) {
+    log_trace("Performing dns lookup for hostname: %s\n", hostname);
+    if (dns_cache_ttl_ms == 0) {
+        return dns_cache_resolve_uncached(hostname, service, family, context);
+    }
+
+    char* key = g_strdup_printf("%s\n%s\n%d", hostname, service ? service : "", family);
+    if (!key) {
+        log_error("Could not allocate memory for DNS cache key");
+        return -ENOMEM;
+    }
+    if (!dns_cache) {
+        dns_cache = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+    ct_dns_cache_entry_t* entry = g_hash_table_lookup(dns_cache, key);
+    if (entry && dns_cache_entry_is_fresh(entry)) {
+        log_debug("DNS cache hit for %s", hostname);
+        g_free(key);
+        dns_cache_deliver(entry, context);
+        return 0;
+    }
+    if (entry && entry->lookup_pending) {
+        log_debug("Joining DNS lookup in flight for %s", hostname);
+        g_free(key);
+        g_ptr_array_add(entry->waiters, context);
+        return 0;
+    }
+    if (entry) {
+        log_debug("DNS cache entry for %s expired", hostname);
+        g_free(key);
+    } else {
+        if (g_hash_table_size(dns_cache) >= CT_DNS_CACHE_MAX_ENTRIES) {
+            dns_cache_evict_expired();
+        }
+        if (g_hash_table_size(dns_cache) >= CT_DNS_CACHE_MAX_ENTRIES) {
+            log_debug("DNS cache is full, not caching lookup for %s", hostname);
+            g_free(key);
+            return dns_cache_resolve_uncached(hostname, service, family, context);
+        }
+        entry = dns_cache_entry_new(strdup(key), family);
+        g_free(key);
+        if (!entry) {
+            return -ENOMEM;
+        }
+        if (!entry->key) {
+            log_error("Could not allocate memory for DNS cache key");
+            dns_cache_entry_free(entry);
+            return -ENOMEM;
+        }
+        g_hash_table_insert(dns_cache, entry->key, entry);
+        entry->in_table = true;
+    }
+
+    g_ptr_array_add(entry->waiters, context);
+    int rc = dns_cache_start_lookup(entry, hostname, service);
+    if (rc < 0) {
+        g_ptr_array_remove(entry->waiters, context);
+        if (entry->waiters->len == 0) {
+            g_hash_table_remove(dns_cache, entry->key);
+            dns_cache_entry_free(entry);
+        }
+        return rc;
+    }
+    return 0;
+}
+
+size_t ct_dns_cache_size(void) {
+    if (!dns_cache) {
+        return 0;
+    }
+    return g_hash_table_size(dns_cache);
+}
+
+void ct_dns_cache_clear(void) {
+    if (!dns_cache) {
+        return;
+    }
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, dns_cache);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ct_dns_cache_entry_t* entry = value;
+        if (entry->lookup_pending) {
+            // Freed once its waiters got the result
+            entry->in_table = false;
+        } else {
+            dns_cache_entry_free(entry);
+        }
+    }
+    g_hash_table_destroy(dns_cache);
+    dns_cache = NULL;
+}
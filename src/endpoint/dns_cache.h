@@ -0,0 +1,36 @@
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include "candidate_gathering/candidate_gathering.h"
+#include <stdint.h>
+
+/*
+ * Lifetime of cached lookups. getaddrinfo() does not report the TTLs of the records it
+ * resolved, so every entry lives this long unless changed with ct_set_dns_cache_ttl().
+ */
+#define CT_DNS_CACHE_DEFAULT_TTL_MS 30000
+#define CT_DNS_CACHE_MAX_ENTRIES 256
+
+/**
+ * @brief Resolve a hostname, answering from the cache when possible.
+ *
+ * A fresh cached answer is passed to ct_remote_endpoint_resolve_cb() before this returns.
+ * Otherwise the context waits for a lookup, which is shared with every other request for the
+ * same hostname, service and family while it is in flight.
+ *
+ * @return 0 if the callback was or will be called, negative error code otherwise
+ */
+int ct_dns_cache_resolve(const char* hostname, const char* service, int family,
+                         ct_remote_resolve_call_context_t* context);
+
+/**
+ * @brief Get how long resolved addresses and service ports are cached, 0 if the cache is bypassed.
+ */
+uint32_t ct_dns_cache_get_ttl(void);
+
+size_t ct_dns_cache_size(void);
+
+// Forget every cached answer, lookups in flight still complete
+void ct_dns_cache_clear(void);
+
+#endif // DNS_CACHE_H
@@ -0,0 +1,220 @@
+#include "interface_cache.h"
+
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#endif
+
+typedef struct ct_interface_address_s {
+    char* name;
+    struct sockaddr_storage address;
+} ct_interface_address_t;
+
+static GArray* interface_addresses = NULL; // ct_interface_address_t, NULL until enumerated
+static bool addresses_stale = true;
+static uint64_t generation = 0;
+
+#ifdef __linux__
+static int netlink_fd = -1; // -1 while not watching
+#endif
+
+static void interface_address_clear(gpointer data) {
+    free(((ct_interface_address_t*)data)->name);
+}
+
+static GArray* enumerate_interface_addresses(void) {
+    uv_interface_address_t* interfaces = NULL;
+    int count = 0;
+    int rc = uv_interface_addresses(&interfaces, &count);
+    if (rc != 0) {
+        log_error("uv_interface_addresses failed: %s", uv_strerror(rc));
+        return NULL;
+    }
+    log_debug("Found %d interfaces on the system", count);
+
+    GArray* addresses = g_array_sized_new(FALSE, TRUE, sizeof(ct_interface_address_t), count);
+    g_array_set_clear_func(addresses, interface_address_clear);
+    for (int i = 0; i < count; i++) {
+        ct_interface_address_t entry = {0};
+        if (interfaces[i].address.address4.sin_family == AF_INET) {
+            memcpy(&entry.address, &interfaces[i].address.address4, sizeof(struct sockaddr_in));
+        } else if (interfaces[i].address.address6.sin6_family == AF_INET6) {
+            memcpy(&entry.address, &interfaces[i].address.address6, sizeof(struct sockaddr_in6));
+        } else {
+            continue;
+        }
+        entry.name = strdup(interfaces[i].name);
+        if (!entry.name) {
+            log_error("Could not allocate memory for interface name");
+            g_array_free(addresses, TRUE);
+            uv_free_interface_addresses(interfaces, count);
+            return NULL;
+        }
+        g_array_append_val(addresses, entry);
+    }
+    uv_free_interface_addresses(interfaces, count);
+    return addresses;
+}
+
+static bool interface_addresses_equal(const GArray* a, const GArray* b) {
+    if (!a || !b || a->len != b->len) {
+        return false;
+    }
+    for (guint i = 0; i < a->len; i++) {
+        const ct_interface_address_t* entry_a = &g_array_index(a, ct_interface_address_t, i);
+        const ct_interface_address_t* entry_b = &g_array_index(b, ct_interface_address_t, i);
+        if (strcmp(entry_a->name, entry_b->name) != 0 ||
+            memcmp(&entry_a->address, &entry_b->address, sizeof(entry_a->address)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read the address changes netlink queued since the last lookup, without blocking.
+ */
+static void interface_cache_read_netlink(void) {
+#ifdef __linux__
+    if (netlink_fd < 0) {
+        return;
+    }
+    char buffer[8192];
+    bool changed = false;
+    for (;;) {
+        ssize_t len = recv(netlink_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                // The kernel dropped notifications, assume the worst
+                changed = true;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_warn("Error reading netlink socket: %s", strerror(errno));
+                changed = true;
+            }
+            break;
+        }
+        int remaining = (int)len;
+        for (const struct nlmsghdr* header = (const struct nlmsghdr*)buffer;
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_type == RTM_NEWADDR || header->nlmsg_type == RTM_DELADDR) {
+                changed = true;
+            }
+        }
+    }
+    if (changed) {
+        log_debug("Netlink reported an interface address change");
+        addresses_stale = true;
+    }
+#endif
+}
+
+/**
+ * @brief Enumerate the interfaces again unless netlink says nothing changed since the last time.
+ */
+static void interface_cache_refresh(void) {
+    interface_cache_read_netlink();
+    if (interface_addresses && !addresses_stale && ct_interface_cache_is_watching()) {
+        return;
+    }
+    GArray* addresses = enumerate_interface_addresses();
+    if (!addresses) {
+        // Keep answering from the old addresses, if any
+        return;
+    }
+    if (!interface_addresses_equal(interface_addresses, addresses)) {
+        generation++;
+        log_debug("Interface addresses changed, %u addresses in generation %lu", addresses->len,
+                  generation);
+    }
+    if (interface_addresses) {
+        g_array_free(interface_addresses, TRUE);
+    }
+    interface_addresses = addresses;
+    addresses_stale = false;
+}
+
+void ct_interface_cache_start(void) {
+#ifdef __linux__
+    if (netlink_fd >= 0) {
+        return;
+    }
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        log_debug("Could not open netlink socket, enumerating interfaces on every lookup: %s",
+                  strerror(errno));
+        return;
+    }
+    struct sockaddr_nl address = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR,
+    };
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        log_debug("Could not subscribe to interface address changes: %s", strerror(errno));
+        close(fd);
+        return;
+    }
+    netlink_fd = fd;
+    // Changes before the subscription were not reported
+    addresses_stale = true;
+    log_debug("Watching interface addresses over netlink");
+#endif
+}
+
+void ct_interface_cache_stop(void) {
+#ifdef __linux__
+    if (netlink_fd >= 0) {
+        close(netlink_fd);
+        netlink_fd = -1;
+    }
+#endif
+    if (interface_addresses) {
+        g_array_free(interface_addresses, TRUE);
+        interface_addresses = NULL;
+    }
+    addresses_stale = true;
+}
+
+bool ct_interface_cache_is_watching(void) {
+#ifdef __linux__
+    return netlink_fd >= 0;
+#else
+    return false;
+#endif
+}
+
+int ct_interface_cache_get_addresses(const char* interface_name,
+                                     struct sockaddr_storage* addresses, int max_addresses) {
+    interface_cache_refresh();
+    if (!interface_addresses) {
+        return 0;
+    }
+    bool any = strcmp(interface_name, "any") == 0;
+    int num_found = 0;
+    for (guint i = 0; i < interface_addresses->len && num_found < max_addresses; i++) {
+        const ct_interface_address_t* entry =
+            &g_array_index(interface_addresses, ct_interface_address_t, i);
+        log_trace("Comparing interface name: %s to target interface name: %s", entry->name,
+                  interface_name);
+        if (any || strcmp(entry->name, interface_name) == 0) {
+            addresses[num_found++] = entry->address;
+        }
+    }
+    return num_found;
+}
+
+uint64_t ct_interface_cache_generation(void) {
+    interface_cache_refresh();
+    return generation;
+}
@@ -0,0 +1,49 @@
+#ifndef INTERFACE_CACHE_H
+#define INTERFACE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*
+ * Interface addresses of the host, enumerated once and kept until the kernel reports a change.
+ *
+ * On Linux, ct_interface_cache_start() subscribes to address changes over netlink. The
+ * notifications queue up on a non-blocking socket which every lookup reads, so the cache needs
+ * nothing from the event loop. Without that subscription, e.g. before ct_initialize() or when
+ * the netlink socket cannot be opened, every lookup enumerates the interfaces again.
+ */
+
+/**
+ * @brief Watch for interface address changes.
+ *
+ * Failing to subscribe is not an error, the cache then enumerates on every lookup.
+ */
+void ct_interface_cache_start(void);
+
+/**
+ * @brief Stop watching and forget the addresses.
+ */
+void ct_interface_cache_stop(void);
+
+/**
+ * @brief Copy the addresses of an interface.
+ *
+ * @param[in] interface_name Name of the interface, "any" for every interface
+ * @param[out] addresses Receives at most max_addresses addresses
+ * @return Number of addresses copied
+ */
+int ct_interface_cache_get_addresses(const char* interface_name,
+                                     struct sockaddr_storage* addresses, int max_addresses);
+
+/**
+ * @brief Counter which changes whenever the interface addresses do.
+ *
+ * Lets caches of anything derived from the local addresses check they are still valid.
+ */
+uint64_t ct_interface_cache_generation(void);
+
+// True while changes are reported over netlink instead of found by enumerating
+bool ct_interface_cache_is_watching(void);
+
+#endif // INTERFACE_CACHE_H
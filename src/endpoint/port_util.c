@@ -1,6 +1,8 @@
 #include "port_util.h"
 
 #include "ctaps.h"
+#include "dns_cache.h"
+#include <glib.h>
 #include <logging/log.h>
 #include <netdb.h>
 #include <netinet/in.h>
@@ -9,7 +11,31 @@
 #include <string.h>
 #include <sys/socket.h>
 
+// "family:service" -> port, the services database does not change while running
+static GHashTable* service_port_cache = NULL;
+
+static bool service_port_cache_lookup(const char* key, int32_t* port) {
+    gpointer value = NULL;
+    if (!service_port_cache ||
+        !g_hash_table_lookup_extended(service_port_cache, key, NULL, &value)) {
+        return false;
+    }
+    *port = GPOINTER_TO_INT(value);
+    return true;
+}
+
 int32_t ct_get_service_port(const char* service, int family) {
+    char* key = NULL;
+    if (ct_dns_cache_get_ttl() > 0 && service) {
+        int32_t port = 0;
+        key = g_strdup_printf("%d:%s", family, service);
+        if (service_port_cache_lookup(key, &port)) {
+            log_trace("Service port cache hit for %s", service);
+            g_free(key);
+            return port;
+        }
+    }
+
     struct addrinfo hints;
     struct addrinfo* result = NULL;
 
@@ -21,6 +47,7 @@ int32_t ct_get_service_port(const char* service, int family) {
     const int status = getaddrinfo(NULL, service, &hints, &result);
     if (status != 0) {
         log_error("getaddrinfo error: %s\n", gai_strerror(status));
+        g_free(key);
         return status;
     }
 
@@ -40,6 +67,22 @@ int32_t ct_get_service_port(const char* service, int family) {
     freeaddrinfo(result);
     if (res == -1) {
         log_warn("Could not find port for service %s\n", service);
+        g_free(key);
+        return res;
+    }
+    if (key) {
+        if (!service_port_cache) {
+            service_port_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        }
+        g_hash_table_replace(service_port_cache, key, GINT_TO_POINTER(res));
     }
     return res;
 }
+
+void ct_service_port_cache_clear(void) {
+    if (!service_port_cache) {
+        return;
+    }
+    g_hash_table_destroy(service_port_cache);
+    service_port_cache = NULL;
+}
@@ -11,4 +11,6 @@
 
 int32_t ct_get_service_port(const char* service, int family);
 
+void ct_service_port_cache_clear(void);
+
 #endif //PORT_UTIL_H
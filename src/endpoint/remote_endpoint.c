@@ -5,6 +5,7 @@
 
 #include <endpoint/port_util.h>
 #include <endpoint/util.h>
+#include <arpa/inet.h>
 #include <errno.h>
 #include <logging/log.h>
 #include <netinet/in.h>
@@ -275,3 +276,22 @@ bool ct_remote_endpoint_resolved_equals(const ct_remote_endpoint_t* endpoint1,
     }
     return ct_sockaddr_equal(&endpoint1->resolved_address, &endpoint2->resolved_address);
 }
+
+void ct_remote_endpoint_append_key(GString* key, const ct_remote_endpoint_t* remote_endpoint) {
+    if (remote_endpoint->hostname) {
+        g_string_append(key, remote_endpoint->hostname);
+    } else {
+        char addr_str[INET6_ADDRSTRLEN] = {0};
+        const struct sockaddr_storage* ss = &remote_endpoint->resolved_address;
+        if (ss->ss_family == AF_INET) {
+            inet_ntop(AF_INET, &((const struct sockaddr_in*)ss)->sin_addr, addr_str,
+                      sizeof(addr_str));
+        } else if (ss->ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((const struct sockaddr_in6*)ss)->sin6_addr, addr_str,
+                      sizeof(addr_str));
+        }
+        g_string_append(key, addr_str);
+    }
+    g_string_append_printf(key, ":%u/%s;", remote_endpoint->port,
+                           remote_endpoint->service ? remote_endpoint->service : "");
+}
@@ -25,6 +25,11 @@ void ct_remote_endpoints_free(ct_remote_endpoint_t* remote_endpoints, size_t num
 bool ct_remote_endpoint_resolved_equals(const ct_remote_endpoint_t* endpoint1,
                                         const ct_remote_endpoint_t* endpoint2);
 
+/**
+ * @brief Append "host:port/service;" to a cache key, host being the hostname or the address.
+ */
+void ct_remote_endpoint_append_key(GString* key, const ct_remote_endpoint_t* remote_endpoint);
+
 /**
  * @ingroup remote_endpoints
  * @brief Free string fields in a remote endpoint without freeing the structure.
@@ -5,9 +5,11 @@
 #include "ctaps.h"
 #include "protocol/quic/quic.h"
 #include <assert.h>
+#include <errno.h>
 #include <logging/log.h>
 #include <netinet/in.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <uv.h>
@@ -27,8 +29,13 @@ ct_addr_scope_t ct_get_addr_scope(const struct sockaddr_storage* addr) {
     return CT_ADDR_SCOPE_OTHER;
 }
 
-uv_udp_t* create_udp_listening_on_local(const ct_local_endpoint_t* local_endpoint,
-                                        uv_alloc_cb alloc_cb, uv_udp_recv_cb on_read_cb) {
+static void on_udp_listen_failed_closed(uv_handle_t* handle) {
+    free(handle);
+}
+
+static uv_udp_t* create_udp_listening(const ct_local_endpoint_t* local_endpoint, bool reuse_port,
+                                      int incoming_cpu, uv_alloc_cb alloc_cb,
+                                      uv_udp_recv_cb on_read_cb) {
     bool is_ephemeral = ct_local_endpoint_get_resolved_port(local_endpoint) == 0;
     if (!is_ephemeral) {
         log_debug("Creating UDP socket for set local endpoint");
@@ -51,12 +58,21 @@ uv_udp_t* create_udp_listening_on_local(const ct_local_endpoint_t* local_endpoin
         return NULL;
     }
 
-    int rc = uv_udp_init(event_loop, new_udp_handle);
+    // SO_REUSEPORT has to be set before binding, so the socket is then created right away
+    unsigned int family = AF_UNSPEC;
+    if (reuse_port) {
+        family = is_ephemeral ? AF_INET : ct_local_endpoint_get_address_family(local_endpoint);
+    }
+    int rc = uv_udp_init_ex(event_loop, new_udp_handle, family);
     if (rc < 0) {
         log_error("Error initializing udp handle: %s", uv_strerror(rc));
         free(new_udp_handle);
         return NULL;
     }
+    if (reuse_port && ct_handle_set_reuseport((uv_handle_t*)new_udp_handle, incoming_cpu) < 0) {
+        uv_close((uv_handle_t*)new_udp_handle, on_udp_listen_failed_closed);
+        return NULL;
+    }
 
     if (is_ephemeral) {
         log_debug("Binding UDP socket to ephemeral port");
@@ -71,7 +87,8 @@ uv_udp_t* create_udp_listening_on_local(const ct_local_endpoint_t* local_endpoin
     }
     if (rc < 0) {
         log_error("Problem with auto-binding: %s", uv_strerror(rc));
-        free(new_udp_handle);
+        // The handle is freed once closed
+        uv_close((uv_handle_t*)new_udp_handle, on_udp_listen_failed_closed);
         return NULL;
     }
 
@@ -79,12 +96,23 @@ uv_udp_t* create_udp_listening_on_local(const ct_local_endpoint_t* local_endpoin
     rc = uv_udp_recv_start(new_udp_handle, alloc_cb, on_read_cb);
     if (rc < 0) {
         log_error("Error starting UDP receive: %s", uv_strerror(rc));
-        free(new_udp_handle);
+        uv_close((uv_handle_t*)new_udp_handle, on_udp_listen_failed_closed);
         return NULL;
     }
     return new_udp_handle;
 }
 
+uv_udp_t* create_udp_listening_on_local(const ct_local_endpoint_t* local_endpoint,
+                                        uv_alloc_cb alloc_cb, uv_udp_recv_cb on_read_cb) {
+    return create_udp_listening(local_endpoint, false, -1, alloc_cb, on_read_cb);
+}
+
+uv_udp_t* create_udp_listening_on_local_reuseport(const ct_local_endpoint_t* local_endpoint,
+                                                  int incoming_cpu, uv_alloc_cb alloc_cb,
+                                                  uv_udp_recv_cb on_read_cb) {
+    return create_udp_listening(local_endpoint, true, incoming_cpu, alloc_cb, on_read_cb);
+}
+
 static void poll_recv_cb(uv_poll_t* handle, int status, int events) {
     if (status < 0 || !(events & UV_READABLE))
         return;
@@ -144,6 +172,37 @@ static void poll_recv_cb(uv_poll_t* handle, int status, int events) {
                       (struct sockaddr*)&addr_to);
 }
 
+int ct_socket_set_reuseport(uv_os_fd_t fd, int incoming_cpu) {
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        int err = errno;
+        log_error("Failed to set SO_REUSEPORT: %s", strerror(err));
+        return -err;
+    }
+    if (incoming_cpu < 0) {
+        return 0;
+    }
+#ifdef SO_INCOMING_CPU
+    if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, sizeof(incoming_cpu)) < 0) {
+        // Only a hint, without it the kernel picks the socket by hashing the flow
+        log_warn("Failed to set SO_INCOMING_CPU to %d: %s", incoming_cpu, strerror(errno));
+    }
+#else
+    log_debug("SO_INCOMING_CPU is not supported, ignoring CPU hint %d", incoming_cpu);
+#endif
+    return 0;
+}
+
+int ct_handle_set_reuseport(uv_handle_t* handle, int incoming_cpu) {
+    uv_os_fd_t fd;
+    int rc = uv_fileno(handle, &fd);
+    if (rc < 0) {
+        log_error("Could not get socket of handle to set SO_REUSEPORT: %s", uv_strerror(rc));
+        return rc;
+    }
+    return ct_socket_set_reuseport(fd, incoming_cpu);
+}
+
 // We have to have direct access to the FD for recvmsg to get the destination address
 // This is needed because QUIC needs to know the destionation address for migration
 ct_udp_poll_handle_t* create_udp_poll_on_local(const ct_local_endpoint_t* local_endpoint) {
@@ -251,51 +310,17 @@ int resolve_local_endpoint_from_poll(ct_udp_poll_handle_t* handle, ct_connection
         return -errno;
     }
 
-    if (!ct_address_is_unspecified(&addr)) {
-        log_debug("Setting active local endpoint on connection to resolved local endpoint");
-        ct_local_endpoint_set_resolved_address(&connection->all_local_endpoints[connection->active_local_endpoint], &addr);
-    } else {
-        log_debug("Local address is wildcard, not setting active local endpoint on connection");
-    }
-    uint16_t port = addr.ss_family  == AF_INET ? ntohs(((struct sockaddr_in*)&addr)->sin_port) : ntohs(((struct sockaddr_in6*)&addr)->sin6_port);
-
-    ct_connection_set_all_local_port(connection, port);
-
-    return 0;
+    return ct_connection_set_bound_local_address(connection, &addr);
 }
 
 int resolve_local_endpoint_from_handle(uv_handle_t* handle, ct_connection_t* connection) {
-    ct_local_endpoint_t local_endpoint = {0};
     struct sockaddr_storage addr = {0};
-    ;
     int rc = get_sockaddr_from_handle(handle, &addr);
     if (rc != 0) {
         log_error("Failed to get socket address from handle: %d", rc);
         return rc;
     }
-
-    rc = ct_local_endpoint_from_sockaddr(&local_endpoint, &addr);
-    if (rc != 0) {
-        log_error("Failed to create local endpoint from sockaddr: %d", rc);
-        return rc;
-    }
-
-    if (!ct_address_is_unspecified(&addr)) {
-        log_debug("Setting active local endpoint on connection to resolved local endpoint");
-        rc = ct_connection_set_active_local_endpoint(connection, &local_endpoint, NULL);
-        if (rc != 0) {
-            log_error("Failed to set active local endpoint on connection: %d", rc);
-            return rc;
-        }
-    } else {
-        log_debug("Local address is wildcard, not setting active local endpoint on connection");
-    }
-
-    log_debug("Setting all local port on connection to %d",
-              ct_local_endpoint_get_resolved_port(&local_endpoint));
-
-    ct_connection_set_all_local_port(connection, ct_local_endpoint_get_resolved_port(&local_endpoint));
-    return 0;
+    return ct_connection_set_bound_local_address(connection, &addr);
 }
 
 bool ct_address_is_unspecified(const struct sockaddr_storage* addr) {
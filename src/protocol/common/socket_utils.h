@@ -25,6 +25,11 @@ typedef void (*ct_udp_recv_cb)(uv_poll_t* handle, int fd, const uint8_t* buf, ss
 uv_udp_t* create_udp_listening_on_local(const ct_local_endpoint_t* local_endpoint,
                                         uv_alloc_cb alloc_cb, uv_udp_recv_cb on_read_cb);
 
+// Same as create_udp_listening_on_local, but sets SO_REUSEPORT, see ct_socket_set_reuseport()
+uv_udp_t* create_udp_listening_on_local_reuseport(const ct_local_endpoint_t* local_endpoint,
+                                                  int incoming_cpu, uv_alloc_cb alloc_cb,
+                                                  uv_udp_recv_cb on_read_cb);
+
 uv_udp_t* create_udp_listening_on_ephemeral(uv_alloc_cb alloc_cb, uv_udp_recv_cb on_read_cb);
 
 int resolve_local_endpoint_from_poll(ct_udp_poll_handle_t* handle, ct_connection_t* connection);
@@ -40,4 +45,19 @@ int get_sockaddr_from_handle(const uv_handle_t* handle, struct sockaddr_storage*
 
 ct_udp_poll_handle_t* create_udp_poll_on_local(const ct_local_endpoint_t* local_endpoint);
 
+/**
+ * @brief Let several sockets bind the same address and port with SO_REUSEPORT.
+ *
+ * Each process listening on the port runs its own event loop, so the kernel spreads the
+ * incoming flows over the cores those processes run on.
+ *
+ * @param[in] incoming_cpu If not negative, also set SO_INCOMING_CPU so the kernel prefers this
+ *                         socket for flows received on that CPU. Failing to set it is not an error.
+ * @return 0 on success, negative errno if SO_REUSEPORT could not be set
+ */
+int ct_socket_set_reuseport(uv_os_fd_t fd, int incoming_cpu);
+
+// ct_socket_set_reuseport() on the socket of a libuv handle, which must already exist
+int ct_handle_set_reuseport(uv_handle_t* handle, int incoming_cpu);
+
 #endif // SOCKET_UTILS_H
@@ -1,8 +1,11 @@
 #include "quic.h"
 #include "connection/connection.h"
 #include "connection/connection_group.h"
+#include "connection/listener.h"
 #include "ctaps.h"
 #include "protocol/common/socket_utils.h"
+#include "protocol/quic/quic_cert_cache.h"
+#include "protocol/quic/quic_ticket_store.h"
 #include "transport_property/transport_properties.h"
 #include <assert.h>
 #include <glib.h>
@@ -10,6 +13,9 @@
 #include <net/if.h>
 #include <netinet/in.h>
 #include <picoquic.h>
+#include <picoquic_bbr.h>
+#include <picoquic_cubic.h>
+#include <picoquic_newreno.h>
 #include <picoquic_utils.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -61,6 +67,7 @@ const ct_protocol_impl_t
          .free_socket_state = quic_free_socket_state,
          .close_connection_group = quic_close_connection_group,
          .set_connection_priority = ct_quic_set_connection_priority,
+         .get_rtt = ct_quic_get_rtt,
          .free_connection_state = quic_free_state,
          .free_connection_group_state = ct_free_quic_connection_group_state
 };
@@ -159,16 +166,9 @@ void socket_timer_close_cb(uv_handle_t* handle) {
         log_warn("QUIC socket timer close callback called with NULL context");
         return;
     }
-    if (quic_ctx->ticket_store_path) {
-        int rc = picoquic_save_session_tickets(quic_ctx->picoquic_ctx, quic_ctx->ticket_store_path);
-        if (rc != 0) {
-            log_error("Failed to save QUIC session tickets to store %s: %d",
-                      quic_ctx->ticket_store_path, rc);
-        } else {
-            log_trace("Successfully saved QUIC session tickets to store %s",
-                      quic_ctx->ticket_store_path);
-        }
-    }
+    // Persists the tickets of this context
+    ct_quic_ticket_store_detach(quic_ctx->ticket_partition, quic_ctx->picoquic_ctx);
+    quic_ctx->ticket_partition = NULL;
     log_debug("Freeing QUIC socket state timer handle");
     if (quic_ctx->poll_handle) {
         log_debug("Stopping and closing socket state poll handle");
@@ -182,6 +182,43 @@ void socket_timer_close_cb(uv_handle_t* handle) {
     }
 }
 
+const picoquic_congestion_algorithm_t*
+ct_quic_congestion_algorithm(const ct_transport_properties_t* transport_properties) {
+    if (!transport_properties) {
+        return NULL;
+    }
+    switch (ct_transport_properties_get_congestion_algorithm(transport_properties)) {
+    case CT_CONGESTION_ALGORITHM_NEWRENO:
+        return picoquic_newreno_algorithm;
+    case CT_CONGESTION_ALGORITHM_CUBIC:
+        return picoquic_cubic_algorithm;
+    case CT_CONGESTION_ALGORITHM_DCUBIC:
+        return picoquic_dcubic_algorithm;
+    case CT_CONGESTION_ALGORITHM_BBR:
+        return picoquic_bbr_algorithm;
+    case CT_CONGESTION_ALGORITHM_AUTO:
+    default:
+        break;
+    }
+
+    switch (ct_transport_properties_get_conn_capacity_profile(transport_properties)) {
+    case CT_CAPACITY_PROFILE_SCAVENGER:
+        // Backs off when queueing delay grows, so it yields to other traffic like LEDBAT
+        return picoquic_dcubic_algorithm;
+    case CT_CAPACITY_PROFILE_LOW_LATENCY_INTERACTIVE:
+    case CT_CAPACITY_PROFILE_LOW_LATENCY_NON_INTERACTIVE:
+    case CT_CAPACITY_PROFILE_CONSTANT_RATE_STREAMING:
+        // Paced sending that drains the bottleneck queue keeps delay low
+        return picoquic_bbr_algorithm;
+    case CT_CAPACITY_PROFILE_CAPACITY_SEEKING:
+        return picoquic_bbr_algorithm;
+    case CT_CAPACITY_PROFILE_BEST_EFFORT:
+    default:
+        // Keep the picoquic default
+        return NULL;
+    }
+}
+
 ct_quic_socket_state_t* ct_quic_socket_state_new(
     const char* cert_file, const char* key_file, ct_socket_manager_t* socket_manager,
     const ct_security_parameters_t* security_parameters, const ct_transport_properties_t* transport_properties,
@@ -205,18 +242,10 @@ ct_quic_socket_state_t* ct_quic_socket_state_new(
 
     socket_state->initial_message = initial_message;
 
-    // Store certificate file names (deep copy)
-    socket_state->cert_file_name = strdup(cert_file);
-    if (!socket_state->cert_file_name) {
-        log_error("Failed to duplicate certificate file name");
-        free(socket_state);
-        return NULL;
-    }
-
-    socket_state->key_file_name = strdup(key_file);
-    if (!socket_state->key_file_name) {
-        log_error("Failed to duplicate key file name");
-        free(socket_state->cert_file_name);
+    // Parsed once per process, and again only when the files change on disk
+    socket_state->cert_entry = ct_quic_cert_cache_get(cert_file, key_file);
+    if (!socket_state->cert_entry) {
+        log_error("Failed to load certificate %s and key %s", cert_file, key_file);
         free(socket_state);
         return NULL;
     }
@@ -224,20 +253,18 @@ ct_quic_socket_state_t* ct_quic_socket_state_new(
     socket_state->socket_manager = socket_manager;
     socket_manager->internal_socket_manager_state = socket_state;
 
-    // Store ticket store path for 0-RTT session persistence
+    // Session tickets are shared with every other socket state of the same configuration
+    const char* ticket_file = NULL;
     if (ticket_store_path) {
-        log_trace("Setting ticket store path to %s for QUIC context", ticket_store_path);
-        socket_state->ticket_store_path = strdup(ticket_store_path);
-        if (!socket_state->ticket_store_path) {
-            log_error("Failed to duplicate ticket store path");
-            free(socket_state->key_file_name);
-            free(socket_state->cert_file_name);
+        socket_state->ticket_partition =
+            ct_quic_ticket_store_get_partition(cert_file, key_file, ticket_store_path);
+        if (!socket_state->ticket_partition) {
+            log_error("Failed to get session ticket store for QUIC context");
+            ct_quic_cert_entry_release(socket_state->cert_entry);
             free(socket_state);
             return NULL;
         }
-    } else {
-        log_trace("Ticket store path not specified in security parameters for QUIC context");
-        socket_state->ticket_store_path = NULL;
+        ticket_file = ct_quic_ticket_store_prepare(socket_state->ticket_partition);
     }
 
     size_t out_num_alpns = 0;
@@ -246,16 +273,12 @@ ct_quic_socket_state_t* ct_quic_socket_state_new(
         ct_security_parameters_get_alpns(security_parameters, &out_num_alpns);
     if (!alpn_strings) {
         log_error("No ALPN strings specified in security parameters for QUIC context");
-        free(socket_state->ticket_store_path);
-        free(socket_state->key_file_name);
-        free(socket_state->cert_file_name);
+        ct_quic_cert_entry_release(socket_state->cert_entry);
         return NULL;
     }
     if (out_num_alpns == 0) {
         log_error("ALPN string array is empty in security parameters for QUIC context");
-        free(socket_state->ticket_store_path);
-        free(socket_state->key_file_name);
-        free(socket_state->cert_file_name);
+        ct_quic_cert_entry_release(socket_state->cert_entry);
         return NULL;
     }
 
@@ -273,16 +296,21 @@ ct_quic_socket_state_t* ct_quic_socket_state_new(
         ticket_key_length = stek_len;
     }
 
-    // Create picoquic context
+    // Create picoquic context, the certificate chain and key come from the cache below
     socket_state->picoquic_ctx = picoquic_create(
-        MAX_CONCURRENT_QUIC_CONNECTIONS, socket_state->cert_file_name, socket_state->key_file_name,
-        NULL, alpn_strings[0], picoquic_callback, socket_state, NULL, NULL, NULL,
-        picoquic_current_time(), NULL, ticket_store_path, ticket_key, ticket_key_length);
+        MAX_CONCURRENT_QUIC_CONNECTIONS, NULL, NULL, NULL, alpn_strings[0], picoquic_callback, socket_state, NULL, NULL,
+        NULL, picoquic_current_time(), NULL, ticket_file, ticket_key, ticket_key_length);
     if (!socket_state->picoquic_ctx) {
         log_error("Failed to create picoquic context");
-        free(socket_state->ticket_store_path);
-        free(socket_state->key_file_name);
-        free(socket_state->cert_file_name);
+        ct_quic_cert_entry_release(socket_state->cert_entry);
+        free(socket_state);
+        return NULL;
+    }
+
+    if (ct_quic_cert_entry_apply(socket_state->cert_entry, socket_state->picoquic_ctx) != 0) {
+        log_error("Failed to install certificate in picoquic context");
+        picoquic_free(socket_state->picoquic_ctx);
+        ct_quic_cert_entry_release(socket_state->cert_entry);
         free(socket_state);
         return NULL;
     }
@@ -290,15 +318,24 @@ ct_quic_socket_state_t* ct_quic_socket_state_new(
     picoquic_set_default_idle_timeout(socket_state->picoquic_ctx, ct_transport_properties_get_conn_timeout_ms(transport_properties));
     picoquic_set_default_priority(socket_state->picoquic_ctx, CT_CONNECTION_DEFAULT_PRIORITY);
     picoquic_enable_path_callbacks_default(socket_state->picoquic_ctx, 1);
+    picoquic_set_default_tp_value(socket_state->picoquic_ctx, picoquic_tp_initial_max_streams_bidi,
+                                  MAX_QUIC_STREAMS_PER_CONNECTION);
+    // Allow messages with msgReliable=false to be sent as DATAGRAM frames
+    picoquic_set_default_tp_value(socket_state->picoquic_ctx, picoquic_tp_max_datagram_frame_size,
+                                  MAX_QUIC_DATAGRAM_FRAME_SIZE);
+
+    const picoquic_congestion_algorithm_t* congestion_algorithm =
+        ct_quic_congestion_algorithm(transport_properties);
+    if (congestion_algorithm) {
+        picoquic_set_default_congestion_algorithm(socket_state->picoquic_ctx, congestion_algorithm);
+    }
 
     // Set up timer handle for this context
     socket_state->timer_handle = malloc(sizeof(uv_timer_t));
     if (!socket_state->timer_handle) {
         log_error("Failed to allocate memory for QUIC context timer");
         picoquic_free(socket_state->picoquic_ctx);
-        free(socket_state->ticket_store_path);
-        free(socket_state->key_file_name);
-        free(socket_state->cert_file_name);
+        ct_quic_cert_entry_release(socket_state->cert_entry);
         free(socket_state);
         return NULL;
     }
@@ -308,14 +345,13 @@ ct_quic_socket_state_t* ct_quic_socket_state_new(
         log_error("Error initializing QUIC context timer: %s", uv_strerror(rc));
         free(socket_state->timer_handle);
         picoquic_free(socket_state->picoquic_ctx);
-        free(socket_state->ticket_store_path);
-        free(socket_state->key_file_name);
-        free(socket_state->cert_file_name);
+        ct_quic_cert_entry_release(socket_state->cert_entry);
         free(socket_state);
         return NULL;
     }
 
     socket_state->timer_handle->data = socket_state;
+    ct_quic_ticket_store_attach(socket_state->ticket_partition, socket_state->picoquic_ctx);
 
     log_debug("Created QUIC context with cert=%s, key=%s", cert_file, key_file);
     return socket_state;
@@ -505,12 +541,9 @@ int handle_closed_picoquic_connection(ct_connection_group_t* connection_group) {
 
     ct_socket_manager_t* socket_manager = NULL;
 
-    GPtrArray* connections_to_notify = g_ptr_array_new();
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
+    GPtrArray* connections_to_notify = g_ptr_array_sized_new(connection_group->num_open);
+    for (ct_connection_t* connection = connection_group->members; connection;
+         connection = connection->group_next) {
         socket_manager = connection->socket_manager;
         if (!ct_connection_is_closed(connection)) {
             g_ptr_array_add(connections_to_notify, connection);
@@ -531,12 +564,9 @@ int handle_aborted_picoquic_connection_group(ct_connection_group_t* connection_g
 
     ct_socket_manager_t* socket_manager = NULL;
 
-    GPtrArray* connections_to_notify = g_ptr_array_new();
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
+    GPtrArray* connections_to_notify = g_ptr_array_sized_new(connection_group->num_open);
+    for (ct_connection_t* connection = connection_group->members; connection;
+         connection = connection->group_next) {
         socket_manager = connection->socket_manager;
         if (!ct_connection_is_closed(connection)) {
             g_ptr_array_add(connections_to_notify, connection);
@@ -584,6 +614,31 @@ static int handle_stream_data(ct_connection_t* connection, const uint8_t* bytes,
     return 0;
 }
 
+/**
+ * Deliver a received DATAGRAM frame as one complete message.
+ *
+ * Datagrams belong to the QUIC connection rather than a stream, so they go to the first
+ * connection of the group which is not closed. Stream state such as a received FIN does not
+ * apply to them. A datagram which cannot be delivered is dropped, it is unreliable anyway.
+ */
+static void handle_datagram(ct_connection_group_t* connection_group, const uint8_t* bytes,
+                            size_t length) {
+    ct_connection_t* connection = ct_connection_group_get_first(connection_group);
+    while (connection && ct_connection_is_closed(connection)) {
+        connection = connection->group_next;
+    }
+    if (!connection) {
+        log_warn("Dropping %zu byte QUIC datagram, no open connection to deliver it to", length);
+        return;
+    }
+    log_debug("Received %zu byte QUIC datagram for connection %s", length, connection->uuid);
+    int rc = ct_connection_on_protocol_receive_datagram(connection, bytes, length);
+    if (rc < 0) {
+        log_warn("Dropping %zu byte QUIC datagram for connection %s: %d", length,
+                 connection->uuid, rc);
+    }
+}
+
 /**
  * Helper function to handle FIN reception on a stream.
  * Sets canReceive=false and closes the connection if both directions are closed.
@@ -603,19 +658,7 @@ static void handle_stream_fin(ct_connection_t* connection) {
 
     // Check if both send and receive directions are closed
     bool can_send = ct_connection_can_send(connection);
-
-    size_t num_active = 0;
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, connection->connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* conn = (ct_connection_t*)value;
-        if (ct_connection_can_send(conn) || ct_connection_can_receive(conn)) {
-            log_debug("Connection %s is still active (can_send=%d, can_receive=%d)", conn->uuid,
-                      ct_connection_can_send(conn), ct_connection_can_receive(conn));
-            num_active++;
-        }
-    }
+    size_t num_active = connection->connection_group->num_sending_or_receiving;
 
     if (num_active == 0) {
         log_debug("No more active connections in group after receiving FIN, closing entire QUIC "
@@ -706,12 +749,17 @@ int probe_all_paths(const ct_connection_group_t* group) {
 
     const ct_remote_endpoint_t* remote_endpoint =
     ct_connection_get_active_remote_endpoint(connection);
+    // Every path leaves from the one socket, the candidates do not carry its port
+    uint16_t bound_port =
+        ct_local_endpoint_get_resolved_port(ct_connection_get_active_local_endpoint(connection));
     for (size_t j = 0; j < ct_connection_get_num_local_endpoints(connection); j++) {
         if (j == connection->active_local_endpoint) {
             continue;
         }
-        const ct_local_endpoint_t* local_endpoint =
-            &ct_connection_get_local_endpoints_list(connection)[j];
+        // Shallow copy, only its address is used
+        ct_local_endpoint_t path_local_endpoint = ct_connection_get_local_endpoints_list(connection)[j];
+        ct_local_endpoint_with_port(&path_local_endpoint, bound_port);
+        const ct_local_endpoint_t* local_endpoint = &path_local_endpoint;
 
         if (local_endpoint->resolved_address.ss_family !=
             remote_endpoint->resolved_address.ss_family) {
@@ -752,6 +800,206 @@ int probe_all_paths(const ct_connection_group_t* group) {
     return at_least_one_success;
 }
 
+/**
+ * Stream priority used while a message is at the head of its stream's send queue.
+ *
+ * Messages with the default msgPriority use the connection priority. Other values shift it,
+ * so urgent messages on one stream of a group overtake bulk data queued on other streams.
+ * A higher msgPriority is more urgent (RFC 9622), while picoquic, like connPriority, treats
+ * lower values as more urgent, hence the offset is subtracted.
+ */
+static uint8_t quic_stream_priority_for_message(const ct_connection_t* connection,
+                                                const ct_message_context_t* message_context) {
+    int64_t priority = ct_connection_get_priority(connection);
+    if (message_context) {
+        priority -= (int64_t)ct_message_properties_get_priority(&message_context->message_properties) -
+                    CT_MESSAGE_DEFAULT_PRIORITY;
+    }
+    if (priority < 0) {
+        return 0;
+    }
+    if (priority > UINT8_MAX) {
+        return UINT8_MAX;
+    }
+    return (uint8_t)priority;
+}
+
+// Reprioritize the stream according to the message now at the head of its send queue
+static void apply_head_of_queue_priority(ct_connection_t* connection,
+                                         ct_quic_stream_state_t* stream_state) {
+    ct_quic_send_data_t* head = g_queue_peek_head(stream_state->send_queue);
+    if (!head || (stream_state->send_priority_set && stream_state->send_priority == head->priority)) {
+        return;
+    }
+    picoquic_cnx_t* cnx = ct_connection_get_picoquic_connection(connection);
+    int rc = picoquic_set_stream_priority(cnx, stream_state->stream_id, head->priority);
+    if (rc != 0) {
+        log_warn("Could not set priority %u on QUIC stream %llu: %d", head->priority,
+                 (unsigned long long)stream_state->stream_id, rc);
+        return;
+    }
+    log_trace("QUIC stream %llu priority set to %u", (unsigned long long)stream_state->stream_id,
+              head->priority);
+    stream_state->send_priority = head->priority;
+    stream_state->send_priority_set = true;
+}
+
+static void free_queued_quic_sends(ct_connection_t* connection, int reason) {
+    ct_quic_stream_state_t* stream_state = ct_connection_get_stream_state(connection);
+    if (!stream_state || !stream_state->send_queue) {
+        return;
+    }
+    while (!g_queue_is_empty(stream_state->send_queue)) {
+        ct_quic_send_data_t* send_data = g_queue_pop_head(stream_state->send_queue);
+        if (reason != 0 && connection->socket_manager) {
+            connection->socket_manager->callbacks.message_send_error(
+                connection, send_data->message_context, reason);
+        } else {
+            ct_message_context_free(send_data->message_context);
+        }
+        ct_message_free(send_data->message);
+        free(send_data);
+    }
+}
+
+// Defer message_sent() until picoquic has returned, it must not be re-entered from the callback
+static void queue_sent_message(ct_connection_t* connection, ct_quic_stream_state_t* stream_state,
+                               ct_message_context_t* message_context) {
+    ct_quic_socket_state_t* socket_state = ct_connection_get_quic_socket_state(connection);
+    ct_quic_sent_message_t* sent = malloc(sizeof(ct_quic_sent_message_t));
+    if (!socket_state || !sent) {
+        log_error("Could not defer sent notification, reporting it right away");
+        free(sent);
+        connection->socket_manager->callbacks.message_sent(connection, message_context);
+        return;
+    }
+    if (!socket_state->sent_messages) {
+        socket_state->sent_messages = g_queue_new();
+    }
+    sent->connection = connection;
+    sent->message_context = message_context;
+    g_queue_push_tail(socket_state->sent_messages, sent);
+    stream_state->num_sent_pending++;
+}
+
+void ct_quic_report_sent_messages(ct_quic_socket_state_t* socket_state) {
+    if (!socket_state->sent_messages) {
+        return;
+    }
+    // The callbacks may send and close, which can report from a nested timer run
+    ct_quic_sent_message_t* sent;
+    while ((sent = g_queue_pop_head(socket_state->sent_messages))) {
+        ct_quic_stream_state_t* stream_state = ct_connection_get_stream_state(sent->connection);
+        stream_state->num_sent_pending--;
+        sent->connection->socket_manager->callbacks.message_sent(sent->connection,
+                                                                 sent->message_context);
+        free(sent);
+    }
+}
+
+// Forget the unreported sent messages of a connection which is being freed
+static void drop_sent_messages(ct_connection_t* connection) {
+    ct_quic_socket_state_t* socket_state = ct_connection_get_quic_socket_state(connection);
+    if (!socket_state || !socket_state->sent_messages) {
+        return;
+    }
+    GList* link = socket_state->sent_messages->head;
+    while (link) {
+        GList* next = link->next;
+        ct_quic_sent_message_t* sent = link->data;
+        if (sent->connection == connection) {
+            ct_message_context_free(sent->message_context);
+            free(sent);
+            g_queue_delete_link(socket_state->sent_messages, link);
+        }
+        link = next;
+    }
+}
+
+// Hand a fully copied message back and report it as sent later
+static void complete_send(ct_connection_t* connection, ct_quic_stream_state_t* stream_state) {
+    ct_quic_send_data_t* send_data = g_queue_pop_head(stream_state->send_queue);
+    queue_sent_message(connection, stream_state, send_data->message_context);
+    ct_message_free(send_data->message);
+    free(send_data);
+}
+
+/**
+ * Fill the space picoquic offers from as many queued messages as fit.
+ *
+ * Packing stops at a message with another priority, so the stream is reprioritized before
+ * picoquic pulls from it again. Messages are reported as sent once their last byte has been
+ * handed to picoquic, after picoquic has returned.
+ */
+static int handle_prepare_to_send(ct_connection_t* connection, void* context, size_t space) {
+    ct_quic_stream_state_t* stream_state = ct_connection_get_stream_state(connection);
+    GQueue* send_queue = stream_state ? stream_state->send_queue : NULL;
+    ct_quic_send_data_t* head = send_queue ? g_queue_peek_head(send_queue) : NULL;
+
+    if (!head) {
+        // Nothing queued, send a FIN requested by a close if there is one
+        bool is_fin = stream_state && stream_state->fin_pending;
+        if (is_fin) {
+            stream_state->fin_pending = false;
+        }
+        (void)picoquic_provide_stream_data_buffer(context, 0, is_fin, 0);
+        return 0;
+    }
+
+    // Work out what goes into this packet before asking picoquic for the buffer
+    size_t to_send = 0;
+    size_t num_complete = 0;
+    bool is_fin = false;
+    bool drains_queue = false;
+    for (GList* link = send_queue->head; link; link = link->next) {
+        ct_quic_send_data_t* send_data = link->data;
+        if (send_data->priority != head->priority) {
+            break;
+        }
+        size_t remaining = send_data->message->length - send_data->offset;
+        if (remaining > space - to_send) {
+            to_send = space;
+            break;
+        }
+        to_send += remaining;
+        num_complete++;
+        if (send_data->fin || (!link->next && stream_state->fin_pending)) {
+            is_fin = true;
+            break;
+        }
+        drains_queue = !link->next;
+    }
+    bool still_active = !is_fin && !drains_queue;
+
+    uint8_t* buffer = picoquic_provide_stream_data_buffer(context, to_send, is_fin, still_active);
+    if (!buffer) {
+        log_error("picoquic did not provide a buffer for %zu bytes of stream data", to_send);
+        return -EIO;
+    }
+
+    size_t copied = 0;
+    for (size_t i = 0; i < num_complete; i++) {
+        ct_quic_send_data_t* send_data = g_queue_peek_head(send_queue);
+        size_t remaining = send_data->message->length - send_data->offset;
+        memcpy(buffer + copied, send_data->message->content + send_data->offset, remaining);
+        copied += remaining;
+        complete_send(connection, stream_state);
+    }
+    if (copied < to_send) {
+        // The rest of the space goes to the start of a message which does not fit completely
+        ct_quic_send_data_t* send_data = g_queue_peek_head(send_queue);
+        memcpy(buffer + copied, send_data->message->content + send_data->offset, to_send - copied);
+        send_data->offset += to_send - copied;
+    }
+
+    if (is_fin) {
+        stream_state->fin_pending = false;
+    } else {
+        apply_head_of_queue_priority(connection, stream_state);
+    }
+    return 0;
+}
+
 int picoquic_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
                       picoquic_call_back_event_t fin_or_event, void* callback_ctx,
                       void* v_stream_ctx) {
@@ -877,6 +1125,7 @@ int picoquic_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, s
             connection = (ct_connection_t*)v_stream_ctx;
             log_info("Peer sent STOP_SENDING for connection %p", (void*)connection);
             ct_connection_set_can_send(connection, false);
+            free_queued_quic_sends(connection, -EPIPE);
         } else {
             log_warn("Received STOP_SENDING on stream %llu but no stream context available",
                      (unsigned long long)stream_id);
@@ -913,6 +1162,21 @@ int picoquic_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, s
             return rc;
         }
         break;
+    case picoquic_callback_datagram:
+        handle_datagram(connection_group, bytes, length);
+        break;
+    case picoquic_callback_prepare_to_send:
+        if (!v_stream_ctx) {
+            log_warn("picoquic requested data for stream %llu without stream context",
+                     (unsigned long long)stream_id);
+            (void)picoquic_provide_stream_data_buffer(bytes, 0, 0, 0);
+            break;
+        }
+        rc = handle_prepare_to_send((ct_connection_t*)v_stream_ctx, bytes, length);
+        if (rc < 0) {
+            return rc;
+        }
+        break;
     case picoquic_callback_application_close: {
         log_info("Received picoquic_callback_application_close event, waiting for close callback");
     } break;
@@ -1115,8 +1379,9 @@ void on_quic_poll_read(ct_socket_manager_t* socket_manager, const uint8_t* buf,
             free(remote_endpoint);
             return;
         }
+        // Not listener->socket_manager, the listener may also listen on other protocols
         ct_connection_t* connection = ct_connection_create_server_connection(
-            listener->socket_manager, remote_endpoint, listener->local_endpoint,
+            socket_state->socket_manager, remote_endpoint, listener->local_endpoint,
             listener->transport_properties,
             listener->security_parameters, &listener->connection_callbacks, NULL);
         if (!connection) {
@@ -1141,8 +1406,6 @@ void on_quic_poll_read(ct_socket_manager_t* socket_manager, const uint8_t* buf,
         group_state->picoquic_connection = cnx;
 
         log_trace("Setting up received ct_connection_t state for new ct_connection_t");
-        ct_quic_socket_state_t* socket_state =
-            (ct_quic_socket_state_t*)listener->socket_manager->internal_socket_manager_state;
         rc = resolve_local_endpoint_from_poll(socket_state->poll_handle, connection);
         if (rc < 0) {
             log_error("Could not get UDP socket name for QUIC connection: %s", uv_strerror(rc));
@@ -1231,6 +1494,7 @@ void on_socket_timer(uv_timer_t* timer_handle) {
     } while (send_length > 0);
     log_trace("Finished sending QUIC packets");
 
+    ct_quic_report_sent_messages(socket_state);
     reset_quic_timer(socket_state);
 }
 
@@ -1500,19 +1764,7 @@ int quic_close_connection(ct_connection_t* connection) {
 
     ct_connection_set_can_send(connection, false);
 
-    size_t num_active = 0;
-    GHashTableIter iter;
-    gpointer key, value;
-
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* conn = (ct_connection_t*)value;
-        if (ct_connection_can_send(conn) || ct_connection_can_receive(conn)) {
-            log_debug("Connection %s is still active (can_send=%d, can_receive=%d)", conn->uuid,
-                      ct_connection_can_send(conn), ct_connection_can_receive(conn));
-            num_active++;
-        }
-    }
+    size_t num_active = connection_group->num_sending_or_receiving;
     int rc = 0;
 
     if (num_active > 0) {
@@ -1520,8 +1772,16 @@ int quic_close_connection(ct_connection_t* connection) {
         if (ct_connection_stream_is_initialized(connection)) {
             log_debug("Sending FIN on stream for connection %s", connection->uuid);
             uint64_t stream_id = ct_connection_get_stream_id(connection);
-            rc = picoquic_add_to_stream_with_ctx(group_state->picoquic_connection, stream_id, NULL,
-                                                 0, 1, connection);
+            ct_quic_stream_state_t* stream_state = ct_connection_get_stream_state(connection);
+            if (stream_state->send_queue && !g_queue_is_empty(stream_state->send_queue)) {
+                // FIN is sent together with the last queued message
+                stream_state->fin_pending = true;
+                rc = picoquic_mark_active_stream(group_state->picoquic_connection, stream_id, 1,
+                                                 connection);
+            } else {
+                rc = picoquic_add_to_stream_with_ctx(group_state->picoquic_connection, stream_id,
+                                                     NULL, 0, 1, connection);
+            }
 
             // Force immediate packet preparation and sending
             ct_quic_socket_state_t* socket_state =
@@ -1594,10 +1854,59 @@ int quic_clone_connection(const struct ct_connection_s* source_connection,
     return 0;
 }
 
+// Bytes of a DATAGRAM frame besides its payload: the frame type and the length varint
+static size_t quic_datagram_frame_overhead(size_t length) {
+    size_t length_size = 8;
+    if (length < 0x40) {
+        length_size = 1;
+    } else if (length < 0x4000) {
+        length_size = 2;
+    } else if (length < 0x40000000) {
+        length_size = 4;
+    }
+    return 1 + length_size;
+}
+
+/**
+ * Send an unreliable message as a DATAGRAM frame (RFC 9221).
+ *
+ * @return 0 if the message was queued as a datagram, -EOPNOTSUPP if it has to be sent on
+ * the stream instead because the peer does not accept datagrams or the message does not fit.
+ */
+static int quic_send_datagram(ct_connection_t* connection, picoquic_cnx_t* cnx,
+                              ct_message_t* message, ct_message_context_t* message_context) {
+    const picoquic_tp_t* remote_tp = picoquic_get_transport_parameters(cnx, 0);
+    if (!remote_tp || remote_tp->max_datagram_frame_size == 0) {
+        log_debug("Peer does not support QUIC datagrams, sending unreliable message on stream");
+        return -EOPNOTSUPP;
+    }
+    // max_datagram_frame_size limits the whole frame, not only its payload
+    if (message->length + quic_datagram_frame_overhead(message->length) >
+        remote_tp->max_datagram_frame_size) {
+        log_debug("Unreliable message of %zu bytes exceeds peer datagram limit of %llu bytes, "
+                  "sending on stream",
+                  message->length, (unsigned long long)remote_tp->max_datagram_frame_size);
+        return -EOPNOTSUPP;
+    }
+
+    int rc = picoquic_queue_datagram_frame(cnx, message->length, (const uint8_t*)message->content);
+    if (rc != 0) {
+        log_debug("Could not queue QUIC datagram (%d), sending unreliable message on stream", rc);
+        return -EOPNOTSUPP;
+    }
+    log_debug("Queued %zu byte QUIC datagram for connection: %s", message->length,
+              connection->uuid);
+
+    // picoquic_queue_datagram_frame copies the data, sent is reported once the timer has run
+    ct_message_free(message);
+    queue_sent_message(connection, ct_connection_get_stream_state(connection), message_context);
+    reset_quic_timer(ct_connection_get_quic_socket_state(connection));
+    return 0;
+}
+
 int quic_send(ct_connection_t* connection, ct_message_t* message,
               ct_message_context_t* message_context) {
     log_debug("Sending message over QUIC");
-    ct_socket_manager_t* socket_manager = connection->socket_manager;
     picoquic_cnx_t* cnx = ct_connection_get_picoquic_connection(connection);
 
     if (!cnx) {
@@ -1611,6 +1920,13 @@ int quic_send(ct_connection_t* connection, ct_message_t* message,
         return -EAGAIN;
     }
 
+    if (message_context && !ct_message_properties_get_reliable(&message_context->message_properties) &&
+        !ct_message_properties_get_final(&message_context->message_properties)) {
+        if (quic_send_datagram(connection, cnx, message, message_context) == 0) {
+            return 0;
+        }
+    }
+
     if (!ct_connection_stream_is_initialized(connection)) {
         log_debug("First message sent on QUIC stream for connection %s, initializing stream",
                   connection->uuid);
@@ -1618,39 +1934,48 @@ int quic_send(ct_connection_t* connection, ct_message_t* message,
         ct_connection_assign_next_free_stream(connection, false);
     }
 
-    // Add data to the stream (set_fin=0 since we're not closing the stream)
+    ct_quic_stream_state_t* stream_state = ct_connection_get_stream_state(connection);
+    if (!stream_state->send_queue) {
+        stream_state->send_queue = g_queue_new();
+    }
+
+    ct_quic_send_data_t* send_data = malloc(sizeof(ct_quic_send_data_t));
+    if (!send_data) {
+        log_error("Failed to allocate memory for QUIC send data");
+        return -ENOMEM;
+    }
+    memset(send_data, 0, sizeof(ct_quic_send_data_t));
+    send_data->message = message;
+    send_data->message_context = message_context;
+    send_data->priority = quic_stream_priority_for_message(connection, message_context);
+
     uint64_t stream_id = ct_connection_get_stream_id(connection);
     log_debug("Queuing %zu bytes for QUIC, sending on stream %llu, connection: %s", message->length,
               (unsigned long long)stream_id, connection->uuid);
 
-    int set_fin = 0;
     if (message_context && ct_message_properties_get_final(&message_context->message_properties)) {
         log_debug("Setting FIN on QUIC stream %llu for connection: %s",
                   (unsigned long long)stream_id, connection->uuid);
-        set_fin = 1;
+        send_data->fin = true;
     }
 
-    int rc = picoquic_add_to_stream_with_ctx(cnx, stream_id, (const uint8_t*)message->content,
-                                             message->length, set_fin, connection);
-
+    // The message is not copied into picoquic, bytes are pulled from it when packets are built
+    int rc = picoquic_mark_active_stream(cnx, stream_id, 1, connection);
     if (rc != 0) {
-        log_error("Error queuing data to QUIC stream: %d", rc);
+        log_error("Error marking QUIC stream active: %d", rc);
         if (rc == PICOQUIC_ERROR_INVALID_STREAM_ID) {
             log_error("Invalid stream ID: %llu", (unsigned long long)stream_id);
         }
+        free(send_data);
         return -EIO;
     }
-
-    // picoquic_add_to_stream copies the data internally, so we can free the message now
-    // message context is freed in the socket manager after the callback
-    ct_message_free(message);
+    g_queue_push_tail(stream_state->send_queue, send_data);
+    apply_head_of_queue_priority(connection, stream_state);
 
     // Reset the timer to ensure data gets processed and sent immediately
     ct_quic_socket_state_t* quic_context = ct_connection_get_quic_socket_state(connection);
     reset_quic_timer(quic_context);
 
-    socket_manager->callbacks.message_sent(connection, message_context);
-
     return 0;
 }
 
@@ -1658,6 +1983,13 @@ int quic_listen(ct_socket_manager_t* socket_manager) {
     log_debug("Starting QUIC listen");
     ct_listener_t* listener = socket_manager->listener;
 
+    // picoquic does not steer packets by connection ID, so with SO_REUSEPORT a client whose
+    // address or port changes would reach a process that does not know its connection
+    if (ct_listener_reuses_port(listener)) {
+        log_error("listenerReusePort is not supported for QUIC listeners");
+        return -ENOTSUP;
+    }
+
     // Get certificate from listener's security parameters
     if (!listener->security_parameters) {
         log_error("Security parameters required for QUIC listener");
@@ -1686,7 +2018,7 @@ int quic_listen(ct_socket_manager_t* socket_manager) {
     ct_quic_socket_state_t* socket_state = ct_quic_socket_state_new(
         cert_file,
         key_file,
-        listener->socket_manager,
+        socket_manager,
         listener->security_parameters,
         listener->transport_properties,
         NULL);
@@ -1733,6 +2065,13 @@ void quic_free_state(ct_connection_t* connection) {
     }
     ct_quic_stream_state_t* stream_state =
         (ct_quic_stream_state_t*)connection->internal_connection_state;
+    if (stream_state->send_queue) {
+        free_queued_quic_sends(connection, 0);
+        g_queue_free(stream_state->send_queue);
+    }
+    if (stream_state->num_sent_pending > 0) {
+        drop_sent_messages(connection);
+    }
     free(stream_state);
 }
 
@@ -1788,27 +2127,49 @@ int ct_quic_set_connection_priority(ct_connection_t* connection, uint8_t priorit
         log_error("Error setting QUIC stream priority: %d", rc);
         return -EIO;
     }
+    stream_state->send_priority = priority;
+    stream_state->send_priority_set = true;
     return 0;
 }
 
+int ct_quic_get_rtt(const ct_connection_t* connection, uint64_t* rtt_us) {
+    picoquic_cnx_t* cnx = ct_connection_get_picoquic_connection(connection);
+    if (!cnx) {
+        return -ENOTSUP;
+    }
+    // picoquic's smoothed RTT of the default path
+    uint64_t rtt = picoquic_get_rtt(cnx);
+    if (rtt == 0) {
+        return -ENOTSUP;
+    }
+    *rtt_us = rtt;
+    return 0;
+}
+
+static void quic_free_socket_state_content(ct_quic_socket_state_t* socket_state) {
+    if (socket_state->sent_messages) {
+        ct_quic_sent_message_t* sent;
+        while ((sent = g_queue_pop_head(socket_state->sent_messages))) {
+            ct_message_context_free(sent->message_context);
+            free(sent);
+        }
+        g_queue_free(socket_state->sent_messages);
+    }
+    free(socket_state->poll_handle);
+    free(socket_state->timer_handle);
+    // No-op unless the socket state was freed without closing its timer
+    ct_quic_ticket_store_detach(socket_state->ticket_partition, socket_state->picoquic_ctx);
+    picoquic_free(socket_state->picoquic_ctx);
+    ct_quic_cert_entry_release(socket_state->cert_entry);
+    free(socket_state);
+}
+
 void quic_free_socket_state(struct ct_socket_manager_s* socket_manager) {
     ct_quic_socket_state_t* socket_state =
         (ct_quic_socket_state_t*)socket_manager->internal_socket_manager_state;
     log_debug("Freeing QUIC socket state");
     if (socket_state) {
         log_debug("Freeing QUIC socket state resources");
-        picoquic_free(socket_state->picoquic_ctx);
-        free(socket_state->poll_handle);
-        free(socket_state->timer_handle);
-        if (socket_state->cert_file_name) {
-            free(socket_state->cert_file_name);
-        }
-        if (socket_state->ticket_store_path) {
-            free(socket_state->ticket_store_path);
-        }
-        if (socket_state->key_file_name) {
-            free(socket_state->key_file_name);
-        }
-        free(socket_state);
+        quic_free_socket_state_content(socket_state);
     }
 }
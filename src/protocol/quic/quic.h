@@ -4,6 +4,8 @@
 #include "ctaps.h"
 #include "ctaps_internal.h"
 #include "protocol/common/socket_utils.h"
+#include "protocol/quic/quic_cert_cache.h"
+#include "protocol/quic/quic_ticket_store.h"
 #include <picoquic.h>
 #include <stdbool.h>
 #include <uv.h>
@@ -16,6 +18,12 @@ struct ct_listener_s;
 // Passed as a parameter to picoquic_create()
 #define MAX_CONCURRENT_QUIC_CONNECTIONS 256
 
+// Advertised initial_max_streams_bidi, each stream is a ct_connection_t in the group
+#define MAX_QUIC_STREAMS_PER_CONNECTION 16384
+
+// Advertised max_datagram_frame_size transport parameter (RFC 9221)
+#define MAX_QUIC_DATAGRAM_FRAME_SIZE PICOQUIC_MAX_PACKET_SIZE
+
 // Per-socket QUIC state
 // Gotten through socket_manager internal state
 // 1-1 with socket manager, so freed when socket manager is freed.
@@ -24,11 +32,11 @@ typedef struct ct_quic_socket_state_s {
     picoquic_quic_t* picoquic_ctx;
     uv_timer_t* timer_handle;
     struct ct_socket_manager_s* socket_manager; // Back-pointer to owner
-    char* cert_file_name;
-    char* key_file_name;
-    char* ticket_store_path;                       // Path for 0-RTT session ticket persistence
+    ct_quic_cert_entry_t* cert_entry;              // Reference into the certificate cache
+    ct_quic_ticket_partition_t* ticket_partition;  // Shared 0-RTT session tickets, or NULL
     ct_message_t* initial_message;                 // For freeing when a client connection is done
     ct_message_context_t* initial_message_context; // For freeing when a client connection is done
+    GQueue* sent_messages; // ct_quic_sent_message_t, reported once picoquic has built its packets
 } ct_quic_socket_state_t;
 
 // Shared state across all streams in a QUIC connection group
@@ -43,8 +51,30 @@ typedef struct ct_connection_quic_group_state_s {
 typedef struct ct_quic_stream_state_s {
     uint64_t stream_id;
     bool stream_initialized;
+    GQueue* send_queue; // ct_quic_send_data_t waiting to be pulled by picoquic, created on first send
+    bool fin_pending;   // Close requested while sends were queued, FIN follows the last one
+    bool send_priority_set; // Whether send_priority has been applied to the picoquic stream
+    uint8_t send_priority;  // picoquic stream priority derived from the head of send_queue
+    size_t num_sent_pending; // Messages of this stream in the socket state's sent_messages
 } ct_quic_stream_state_t;
 
+// A message queued on a stream. picoquic pulls bytes from it in
+// picoquic_callback_prepare_to_send as flow and congestion control allow.
+typedef struct ct_quic_send_data_s {
+    ct_message_t* message;
+    ct_message_context_t* message_context;
+    size_t offset;    // Bytes already handed to picoquic
+    bool fin;         // Send FIN after the last byte of this message
+    uint8_t priority; // picoquic stream priority while this message is at the head of the queue
+} ct_quic_send_data_t;
+
+// A message picoquic took the last byte of during packet assembly. message_sent() is called
+// after picoquic has returned, so the callback can safely send or close.
+typedef struct ct_quic_sent_message_s {
+    ct_connection_t* connection;
+    ct_message_context_t* message_context;
+} ct_quic_sent_message_t;
+
 // QUIC context management
 ct_quic_socket_state_t* ct_quic_socket_state_new(
     const char* cert_file, const char* key_file, ct_socket_manager_t* socket_manager,
@@ -55,6 +85,17 @@ void on_quic_poll_read(ct_socket_manager_t* socket_manager, const uint8_t* buf,
                        const struct sockaddr* addr_from, const struct sockaddr* addr_to);
 
 void ct_quic_socket_state_free(ct_quic_socket_state_t* socket_state);
+
+/**
+ * @brief Congestion control algorithm for a QUIC context.
+ *
+ * An explicit congestionAlgorithm wins, otherwise it is derived from connCapacityProfile.
+ *
+ * @return The algorithm, or NULL to keep the picoquic default
+ */
+const picoquic_congestion_algorithm_t*
+ct_quic_congestion_algorithm(const ct_transport_properties_t* transport_properties);
+
 void ct_close_quic_context(ct_quic_socket_state_t* socket_state);
 
 void ct_free_quic_connection_group_state(ct_connection_group_t* connection_group);
@@ -84,6 +125,7 @@ int quic_clone_connection(const struct ct_connection_s* source_connection,
 void quic_free_state(ct_connection_t* connection);
 void quic_close_connection_group(ct_connection_group_t* connection_group);
 int ct_quic_set_connection_priority(ct_connection_t* connection, uint8_t priority);
+int ct_quic_get_rtt(const ct_connection_t* connection, uint64_t* rtt_us);
 void quic_free_socket_state(struct ct_socket_manager_s* socket_manager);
 
 ct_quic_socket_state_t* ct_quic_context_ref(ct_quic_socket_state_t* context);
@@ -94,6 +136,12 @@ ct_quic_connection_group_state_t*
 ct_connection_get_quic_group_state(const ct_connection_t* connection);
 ct_quic_stream_state_t* ct_connection_get_stream_state(const ct_connection_t* connection);
 ct_quic_socket_state_t* ct_connection_get_quic_socket_state(const ct_connection_t* connection);
+/**
+ * @brief Call message_sent() for the messages picoquic finished pulling since the last call.
+ *
+ * Called by the socket timer once picoquic_prepare_next_packet() has returned.
+ */
+void ct_quic_report_sent_messages(ct_quic_socket_state_t* socket_state);
 
 // Protocol interface (definition in quic.c)
 extern const ct_protocol_impl_t quic_protocol_interface;
@@ -0,0 +1,207 @@
+#include "quic_cert_cache.h"
+
+#include <errno.h>
+#include <glib.h>
+#include <logging/log.h>
+#include <picotls.h>
+#include <picotls/pembase64.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Identifies the version of a file that was parsed
+typedef struct ct_file_stamp_s {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+} ct_file_stamp_t;
+
+struct ct_quic_cert_entry_s {
+    ptls_iovec_t certs[CT_QUIC_MAX_CERT_CHAIN_LENGTH];
+    size_t num_certs;
+    ptls_iovec_t key; // DER encoded private key
+    ct_file_stamp_t cert_stamp;
+    ct_file_stamp_t key_stamp;
+    size_t ref_count;
+};
+
+// Keyed by "<cert_file>\n<key_file>", holds one reference to each entry
+static GHashTable* cert_cache = NULL;
+
+// PEM labels picoquic accepts for private keys
+static const char* const private_key_labels[] = {
+    "PRIVATE KEY",
+    "EC PRIVATE KEY",
+    "RSA PRIVATE KEY",
+};
+
+static int file_stamp_get(const char* file_name, ct_file_stamp_t* stamp) {
+    struct stat st;
+    if (stat(file_name, &st) != 0) {
+        return -errno;
+    }
+    stamp->device = st.st_dev;
+    stamp->inode = st.st_ino;
+    stamp->size = st.st_size;
+    stamp->modified = st.st_mtim;
+    return 0;
+}
+
+static bool file_stamp_equal(const ct_file_stamp_t* a, const ct_file_stamp_t* b) {
+    return a->device == b->device && a->inode == b->inode && a->size == b->size &&
+           a->modified.tv_sec == b->modified.tv_sec && a->modified.tv_nsec == b->modified.tv_nsec;
+}
+
+static void cert_entry_free(ct_quic_cert_entry_t* entry) {
+    for (size_t i = 0; i < entry->num_certs; i++) {
+        free(entry->certs[i].base);
+    }
+    free(entry->key.base);
+    free(entry);
+}
+
+static ct_quic_cert_entry_t* cert_entry_load(const char* cert_file, const char* key_file,
+                                             const ct_file_stamp_t* cert_stamp,
+                                             const ct_file_stamp_t* key_stamp) {
+    ct_quic_cert_entry_t* entry = malloc(sizeof(ct_quic_cert_entry_t));
+    if (!entry) {
+        log_error("Failed to allocate memory for certificate cache entry");
+        return NULL;
+    }
+    memset(entry, 0, sizeof(ct_quic_cert_entry_t));
+    entry->cert_stamp = *cert_stamp;
+    entry->key_stamp = *key_stamp;
+    entry->ref_count = 1;
+
+    int rc = ptls_load_pem_objects(cert_file, "CERTIFICATE", entry->certs,
+                                   CT_QUIC_MAX_CERT_CHAIN_LENGTH, &entry->num_certs);
+    if (rc != 0 || entry->num_certs == 0) {
+        log_error("Failed to load certificate chain from %s: %d", cert_file, rc);
+        cert_entry_free(entry);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < sizeof(private_key_labels) / sizeof(private_key_labels[0]); i++) {
+        size_t num_keys = 0;
+        rc = ptls_load_pem_objects(key_file, private_key_labels[i], &entry->key, 1, &num_keys);
+        if (rc == 0 && num_keys == 1) {
+            log_debug("Loaded certificate chain of length %zu from %s and key from %s",
+                      entry->num_certs, cert_file, key_file);
+            return entry;
+        }
+    }
+    log_error("Failed to load private key from %s", key_file);
+    cert_entry_free(entry);
+    return NULL;
+}
+
+static void cert_entry_unref(gpointer data) {
+    ct_quic_cert_entry_release((ct_quic_cert_entry_t*)data);
+}
+
+ct_quic_cert_entry_t* ct_quic_cert_cache_get(const char* cert_file, const char* key_file) {
+    if (!cert_file || !key_file) {
+        log_error("Certificate and key file are required");
+        return NULL;
+    }
+
+    ct_file_stamp_t cert_stamp;
+    ct_file_stamp_t key_stamp;
+    int rc = file_stamp_get(cert_file, &cert_stamp);
+    if (rc < 0) {
+        log_error("Could not stat certificate file %s: %s", cert_file, strerror(-rc));
+        return NULL;
+    }
+    rc = file_stamp_get(key_file, &key_stamp);
+    if (rc < 0) {
+        log_error("Could not stat key file %s: %s", key_file, strerror(-rc));
+        return NULL;
+    }
+
+    if (!cert_cache) {
+        cert_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, cert_entry_unref);
+    }
+
+    char* cache_key = g_strdup_printf("%s\n%s", cert_file, key_file);
+    ct_quic_cert_entry_t* entry = g_hash_table_lookup(cert_cache, cache_key);
+    if (entry && file_stamp_equal(&entry->cert_stamp, &cert_stamp) &&
+        file_stamp_equal(&entry->key_stamp, &key_stamp)) {
+        log_trace("Certificate cache hit for %s", cert_file);
+        g_free(cache_key);
+        entry->ref_count++;
+        return entry;
+    }
+    if (entry) {
+        log_debug("Certificate or key changed on disk, reloading %s", cert_file);
+    }
+
+    entry = cert_entry_load(cert_file, key_file, &cert_stamp, &key_stamp);
+    if (!entry) {
+        g_free(cache_key);
+        return NULL;
+    }
+    // Replaces and releases a stale entry, users of it keep their own reference
+    g_hash_table_replace(cert_cache, cache_key, entry);
+    entry->ref_count++;
+    return entry;
+}
+
+void ct_quic_cert_entry_release(ct_quic_cert_entry_t* entry) {
+    if (!entry) {
+        return;
+    }
+    if (--entry->ref_count == 0) {
+        cert_entry_free(entry);
+    }
+}
+
+int ct_quic_cert_entry_apply(const ct_quic_cert_entry_t* entry, picoquic_quic_t* quic) {
+    if (!entry || !quic) {
+        return -EINVAL;
+    }
+
+    ptls_iovec_t* chain = calloc(entry->num_certs, sizeof(ptls_iovec_t));
+    if (!chain) {
+        log_error("Failed to allocate memory for certificate chain");
+        return -ENOMEM;
+    }
+    for (size_t i = 0; i < entry->num_certs; i++) {
+        chain[i].base = malloc(entry->certs[i].len);
+        if (!chain[i].base) {
+            log_error("Failed to allocate memory for certificate");
+            for (size_t j = 0; j < i; j++) {
+                free(chain[j].base);
+            }
+            free(chain);
+            return -ENOMEM;
+        }
+        memcpy(chain[i].base, entry->certs[i].base, entry->certs[i].len);
+        chain[i].len = entry->certs[i].len;
+    }
+    // picoquic owns the chain from here on
+    picoquic_set_tls_certificate_chain(quic, chain, entry->num_certs);
+
+    if (picoquic_set_tls_key(quic, entry->key.base, entry->key.len) != 0) {
+        log_error("picoquic rejected the cached private key");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+size_t ct_quic_cert_entry_get_num_certs(const ct_quic_cert_entry_t* entry) {
+    return entry ? entry->num_certs : 0;
+}
+
+size_t ct_quic_cert_cache_size(void) {
+    return cert_cache ? g_hash_table_size(cert_cache) : 0;
+}
+
+void ct_quic_cert_cache_clear(void) {
+    if (!cert_cache) {
+        return;
+    }
+    g_hash_table_destroy(cert_cache);
+    cert_cache = NULL;
+}
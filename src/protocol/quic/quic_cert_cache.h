@@ -0,0 +1,55 @@
+#ifndef QUIC_CERT_CACHE_H
+#define QUIC_CERT_CACHE_H
+
+#include <picoquic.h>
+#include <stddef.h>
+
+// Longest certificate chain loaded from a single PEM file
+#define CT_QUIC_MAX_CERT_CHAIN_LENGTH 16
+
+/**
+ * @brief A certificate chain and private key parsed from a pair of PEM files.
+ *
+ * Entries are owned by the process-wide certificate cache and reference counted, so a QUIC
+ * socket state can keep using its entry after the files change and the cache replaced it.
+ */
+typedef struct ct_quic_cert_entry_s ct_quic_cert_entry_t;
+
+/**
+ * @brief Get the parsed certificate chain and key for a pair of PEM files.
+ *
+ * The files are only read and parsed the first time, or when their size, modification time or
+ * inode differ from when they were last loaded. Later calls cost two stat() calls.
+ *
+ * @param[in] cert_file Path to the PEM certificate chain
+ * @param[in] key_file Path to the PEM private key
+ * @return A new reference to the entry, or NULL if the files could not be loaded.
+ *         Release it with ct_quic_cert_entry_release().
+ */
+ct_quic_cert_entry_t* ct_quic_cert_cache_get(const char* cert_file, const char* key_file);
+
+void ct_quic_cert_entry_release(ct_quic_cert_entry_t* entry);
+
+/**
+ * @brief Install the certificate chain and key of an entry in a picoquic context.
+ *
+ * picoquic takes ownership of the chain it is given, so every context receives its own copy
+ * of the DER buffers. No files are read.
+ *
+ * @return 0 on success, negative errno on failure
+ */
+int ct_quic_cert_entry_apply(const ct_quic_cert_entry_t* entry, picoquic_quic_t* quic);
+
+size_t ct_quic_cert_entry_get_num_certs(const ct_quic_cert_entry_t* entry);
+
+// Number of file pairs currently cached
+size_t ct_quic_cert_cache_size(void);
+
+/**
+ * @brief Drop every cached entry.
+ *
+ * Entries still referenced by socket states stay valid until they are released.
+ */
+void ct_quic_cert_cache_clear(void);
+
+#endif // QUIC_CERT_CACHE_H
@@ -0,0 +1,109 @@
+#include "quic_ticket_store.h"
+
+#include <glib.h>
+#include <logging/log.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ct_quic_ticket_partition_s {
+    char* ticket_store_path;
+    GPtrArray* contexts; // Attached picoquic_quic_t*, oldest first
+};
+
+// Keyed by "<cert_file>\n<key_file>\n<ticket_store_path>"
+static GHashTable* partitions = NULL;
+
+static void partition_free(gpointer data) {
+    ct_quic_ticket_partition_t* partition = data;
+    if (partition->contexts->len > 0) {
+        log_warn("Freeing ticket store partition with %u attached QUIC contexts",
+                 partition->contexts->len);
+    }
+    g_ptr_array_free(partition->contexts, TRUE);
+    free(partition->ticket_store_path);
+    free(partition);
+}
+
+static void partition_save(ct_quic_ticket_partition_t* partition, picoquic_quic_t* quic) {
+    int rc = picoquic_save_session_tickets(quic, partition->ticket_store_path);
+    if (rc != 0) {
+        log_error("Failed to save QUIC session tickets to store %s: %d",
+                  partition->ticket_store_path, rc);
+    } else {
+        log_trace("Successfully saved QUIC session tickets to store %s",
+                  partition->ticket_store_path);
+    }
+}
+
+ct_quic_ticket_partition_t* ct_quic_ticket_store_get_partition(const char* cert_file,
+                                                               const char* key_file,
+                                                               const char* ticket_store_path) {
+    if (!ticket_store_path) {
+        log_error("A ticket store path is required for a session ticket partition");
+        return NULL;
+    }
+    if (!partitions) {
+        partitions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, partition_free);
+    }
+    char* partition_key = g_strdup_printf("%s\n%s\n%s", cert_file ? cert_file : "",
+                                          key_file ? key_file : "", ticket_store_path);
+    ct_quic_ticket_partition_t* partition = g_hash_table_lookup(partitions, partition_key);
+    if (partition) {
+        g_free(partition_key);
+        return partition;
+    }
+
+    partition = malloc(sizeof(ct_quic_ticket_partition_t));
+    if (!partition) {
+        log_error("Failed to allocate memory for ticket store partition");
+        g_free(partition_key);
+        return NULL;
+    }
+    memset(partition, 0, sizeof(ct_quic_ticket_partition_t));
+    partition->ticket_store_path = strdup(ticket_store_path);
+    if (!partition->ticket_store_path) {
+        log_error("Failed to duplicate ticket store path");
+        free(partition);
+        g_free(partition_key);
+        return NULL;
+    }
+    partition->contexts = g_ptr_array_new();
+    g_hash_table_insert(partitions, partition_key, partition);
+    return partition;
+}
+
+const char* ct_quic_ticket_store_prepare(ct_quic_ticket_partition_t* partition) {
+    if (partition->contexts->len > 0) {
+        partition_save(partition,
+                       g_ptr_array_index(partition->contexts, partition->contexts->len - 1));
+    }
+    return partition->ticket_store_path;
+}
+
+void ct_quic_ticket_store_attach(ct_quic_ticket_partition_t* partition, picoquic_quic_t* quic) {
+    if (!partition || !quic) {
+        return;
+    }
+    g_ptr_array_add(partition->contexts, quic);
+    log_debug("Attached QUIC context to ticket store partition with %u contexts",
+              partition->contexts->len);
+}
+
+void ct_quic_ticket_store_detach(ct_quic_ticket_partition_t* partition, picoquic_quic_t* quic) {
+    if (!partition || !quic || !g_ptr_array_remove(partition->contexts, quic)) {
+        return;
+    }
+    partition_save(partition, quic);
+}
+
+size_t ct_quic_ticket_partition_get_num_contexts(const ct_quic_ticket_partition_t* partition) {
+    return partition ? partition->contexts->len : 0;
+}
+
+void ct_quic_ticket_store_clear(void) {
+    if (!partitions) {
+        return;
+    }
+    g_hash_table_destroy(partitions);
+    partitions = NULL;
+}
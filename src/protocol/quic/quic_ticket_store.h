@@ -0,0 +1,63 @@
+#ifndef QUIC_TICKET_STORE_H
+#define QUIC_TICKET_STORE_H
+
+#include <picoquic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Session tickets shared by every QUIC socket state with the same configuration.
+ *
+ * Tickets are partitioned by client certificate, key and ticket store path, so that a
+ * connection never resumes a session that was authenticated with different credentials.
+ * Tickets only move through picoquic's own ticket file functions, with the ticket file of
+ * the partition as the hand-over: before a new picoquic context loads it, the file is
+ * rewritten from the newest live context of the partition, which holds the file's tickets
+ * from when it was created plus every ticket it learned since. Tickets an older live
+ * context learned afterwards reach the file when that context is detached.
+ *
+ * Socket states without a ticket store path have no partition and keep their own tickets.
+ */
+typedef struct ct_quic_ticket_partition_s ct_quic_ticket_partition_t;
+
+/**
+ * @brief Get the partition for a configuration, creating it on first use.
+ *
+ * @param[in] cert_file Certificate file of the socket state
+ * @param[in] key_file Key file of the socket state
+ * @param[in] ticket_store_path File tickets are persisted to, must not be NULL
+ * @return The partition, owned by the store, or NULL on error
+ */
+ct_quic_ticket_partition_t* ct_quic_ticket_store_get_partition(const char* cert_file,
+                                                               const char* key_file,
+                                                               const char* ticket_store_path);
+
+/**
+ * @brief Bring the ticket file of a partition up to date before picoquic_create() loads it.
+ *
+ * @return The ticket file to pass to picoquic_create()
+ */
+const char* ct_quic_ticket_store_prepare(ct_quic_ticket_partition_t* partition);
+
+/**
+ * @brief Register a picoquic context created from the ticket file of its partition.
+ */
+void ct_quic_ticket_store_attach(ct_quic_ticket_partition_t* partition, picoquic_quic_t* quic);
+
+/**
+ * @brief Save the tickets of a picoquic context that is about to be freed.
+ *
+ * Safe to call for a context that is not attached, or with a NULL partition.
+ */
+void ct_quic_ticket_store_detach(ct_quic_ticket_partition_t* partition, picoquic_quic_t* quic);
+
+size_t ct_quic_ticket_partition_get_num_contexts(const ct_quic_ticket_partition_t* partition);
+
+/**
+ * @brief Free every partition.
+ *
+ * Must only be called once no socket state is attached, i.e. after the event loop has finished.
+ */
+void ct_quic_ticket_store_clear(void);
+
+#endif // QUIC_TICKET_STORE_H
@@ -10,10 +10,13 @@
 #include "protocol/common/socket_utils.h"
 #include <errno.h>
 #include <logging/log.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <uv.h>
@@ -60,6 +63,8 @@ const ct_protocol_impl_t
             .free_connection_state = tcp_free_state,
             .free_socket_state = tcp_free_socket_state,
             .close_connection_group = tcp_close_connection_group,
+            .set_send_rate = tcp_set_send_rate,
+            .get_rtt = tcp_get_rtt,
             .free_connection_group_state = tcp_free_connection_group_state,
 };
 
@@ -130,6 +135,10 @@ void on_stop_listen(uv_handle_t* handle) {
     socket_manager->callbacks.closed_listener(socket_manager);
 }
 
+static void on_listen_failed_closed(uv_handle_t* handle) {
+    free(handle);
+}
+
 void on_libuv_close(uv_handle_t* handle) {
     log_debug("libuv TCP handle successfully closed");
     ct_socket_manager_t* socket_manager = handle->data;
@@ -444,39 +453,94 @@ int tcp_send(ct_connection_t* connection, ct_message_t* message, ct_message_cont
     return 0;
 }
 
+int tcp_set_send_rate(ct_connection_t* connection, uint64_t max_send_rate) {
+#ifdef SO_MAX_PACING_RATE
+    ct_tcp_socket_state_t* socket_state = connection->socket_manager->internal_socket_manager_state;
+    uv_os_fd_t fd;
+    int rc = uv_fileno((uv_handle_t*)socket_state->tcp_handle, &fd);
+    if (rc < 0) {
+        log_debug("Could not get TCP socket fd for pacing: %s", uv_strerror(rc));
+        return -ENOTSUP;
+    }
+    // The kernel takes bytes per second, ~0 means unlimited. TCP paces internally since
+    // Linux 4.13, so this does not depend on the fq qdisc.
+    uint64_t pacing_rate = max_send_rate == CT_CONN_RATE_UNLIMITED ? UINT64_MAX : max_send_rate / 8;
+    if (setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &pacing_rate, sizeof(pacing_rate)) < 0) {
+        log_debug("SO_MAX_PACING_RATE not supported: %s", strerror(errno));
+        return -ENOTSUP;
+    }
+    return 0;
+#else
+    (void)connection;
+    (void)max_send_rate;
+    return -ENOTSUP;
+#endif
+}
+
+int tcp_get_rtt(const ct_connection_t* connection, uint64_t* rtt_us) {
+#ifdef TCP_INFO
+    ct_tcp_socket_state_t* socket_state = connection->socket_manager->internal_socket_manager_state;
+    uv_os_fd_t fd;
+    int rc = uv_fileno((uv_handle_t*)socket_state->tcp_handle, &fd);
+    if (rc < 0) {
+        log_debug("Could not get TCP socket fd for TCP_INFO: %s", uv_strerror(rc));
+        return -ENOTSUP;
+    }
+    struct tcp_info info;
+    socklen_t info_len = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &info_len) < 0) {
+        log_debug("Could not read TCP_INFO: %s", strerror(errno));
+        return -ENOTSUP;
+    }
+    if (info.tcpi_rtt == 0) {
+        log_debug("No RTT estimate from TCP_INFO yet");
+        return -ENOTSUP;
+    }
+    *rtt_us = info.tcpi_rtt;
+    return 0;
+#else
+    (void)connection;
+    (void)rtt_us;
+    return -ENOTSUP;
+#endif
+}
+
 int tcp_listen(ct_socket_manager_t* socket_manager) {
     log_debug("Listening via TCP");
+    ct_listener_t* listener = socket_manager->listener;
+    const struct sockaddr_storage* addr =
+        ct_local_endpoint_get_resolved_address(ct_listener_get_local_endpoint(listener));
+    bool reuse_port = ct_listener_reuses_port(listener);
+
     uv_tcp_t* new_tcp_handle = malloc(sizeof(uv_tcp_t));
     if (!new_tcp_handle) {
         log_error("Failed to allocate memory for TCP handle");
         return -ENOMEM;
     }
 
-    ct_listener_t* listener = socket_manager->listener;
-
-    int rc = uv_tcp_init(event_loop, new_tcp_handle);
+    // SO_REUSEPORT has to be set before binding, so the socket is then created right away
+    int rc = uv_tcp_init_ex(event_loop, new_tcp_handle, reuse_port ? addr->ss_family : AF_UNSPEC);
     if (rc < 0) {
         log_error("Error initializing tcp handle: %s", uv_strerror(rc));
         free(new_tcp_handle);
         return rc;
     }
 
-    const ct_local_endpoint_t* local_endpoint = ct_listener_get_local_endpoint(listener);
-    rc =
-        uv_tcp_bind(new_tcp_handle,
-                    (const struct sockaddr*)ct_local_endpoint_get_resolved_address(local_endpoint), 0);
-    if (rc < 0) {
-        log_error("Error binding TCP handle: %s", uv_strerror(rc));
-        free(new_tcp_handle);
-        return rc;
+    if (reuse_port) {
+        rc = ct_handle_set_reuseport((uv_handle_t*)new_tcp_handle,
+                                     ct_listener_get_incoming_cpu(listener));
+    }
+    if (rc == 0) {
+        rc = uv_tcp_bind(new_tcp_handle, (const struct sockaddr*)addr, 0);
+    }
+    if (rc == 0) {
+        log_debug("Listening on handle: %p", new_tcp_handle);
+        rc = uv_listen((uv_stream_t*)new_tcp_handle, SOMAXCONN, new_stream_connection_cb);
     }
-
-    log_debug("Listening on handle: %p", new_tcp_handle);
-    rc = uv_listen((uv_stream_t*)new_tcp_handle, SOMAXCONN, new_stream_connection_cb);
-
     if (rc < 0) {
         log_error("Error starting TCP listen: %s", uv_strerror(rc));
-        free(new_tcp_handle);
+        // The handle is freed once closed
+        uv_close((uv_handle_t*)new_tcp_handle, on_listen_failed_closed);
         return rc;
     }
 
@@ -668,20 +732,16 @@ void tcp_free_socket_state(ct_socket_manager_t* socket_manager) {
 void tcp_close_connection_group(ct_connection_group_t* connection_group) {
     log_debug("Closing all connections in TCP connection group: %s", connection_group->connection_group_id);
     // Intermediate to avoid concurrent modification
-    GSList* connections = NULL;
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
-        connections = g_slist_append(connections, connection);
-    }
-    for (GSList* node = connections; node != NULL; node = node->next) {
-        ct_connection_t* connection = (ct_connection_t*)node->data;
+    GPtrArray* connections = g_ptr_array_sized_new(connection_group->num_members);
+    for (ct_connection_t* connection = connection_group->members; connection;
+         connection = connection->group_next) {
+        g_ptr_array_add(connections, connection);
+    }
+    for (guint i = 0; i < connections->len; i++) {
+        ct_connection_t* connection = g_ptr_array_index(connections, i);
         if (!ct_connection_is_closed_or_closing(connection)) {
             tcp_close(connection);
         }
     }
-    g_slist_free(connections);
+    g_ptr_array_free(connections, true);
 }
@@ -37,6 +37,14 @@ int tcp_clone_connection(const struct ct_connection_s* source_connection,
                          struct ct_connection_s* target_connection);
 void tcp_free_state(ct_connection_t* connection);
 void tcp_close_connection_group(ct_connection_group_t* connection_group);
+/**
+  * @brief Cap the send rate with SO_MAX_PACING_RATE, -ENOTSUP if the kernel does not support it.
+  */
+int tcp_set_send_rate(ct_connection_t* connection, uint64_t max_send_rate);
+/**
+  * @brief The kernel's smoothed RTT from TCP_INFO, -ENOTSUP where that is not available.
+  */
+int tcp_get_rtt(const ct_connection_t* connection, uint64_t* rtt_us);
 /**
   * @brief No-op, TCP is not multiplexed and therefore has no shared state across cloned connections.
   */
@@ -329,10 +329,14 @@ void socket_listen_callback(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf
 int udp_listen(ct_socket_manager_t* socket_manager) {
     log_debug("Listening via UDP");
 
-    const ct_local_endpoint_t* local_endpoint =
-        ct_listener_get_local_endpoint(socket_manager->listener);
+    ct_listener_t* listener = socket_manager->listener;
+    const ct_local_endpoint_t* local_endpoint = ct_listener_get_local_endpoint(listener);
     uv_udp_t* udp_handle =
-        create_udp_listening_on_local(local_endpoint, alloc_buffer, socket_listen_callback);
+        ct_listener_reuses_port(listener)
+            ? create_udp_listening_on_local_reuseport(local_endpoint,
+                                                      ct_listener_get_incoming_cpu(listener),
+                                                      alloc_buffer, socket_listen_callback)
+            : create_udp_listening_on_local(local_endpoint, alloc_buffer, socket_listen_callback);
     if (!udp_handle) {
         log_error("Failed to create UDP handle for listening");
         return -EIO;
@@ -421,18 +425,13 @@ void udp_free_socket_state(ct_socket_manager_t* socket_manager) {
 
 void udp_close_connection_group(ct_connection_group_t* connection_group) {
     // Intermediate to avoid concurrent modification
-    GSList* connections = NULL;
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
-    g_hash_table_iter_init(&iter, connection_group->connections);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        ct_connection_t* connection = (ct_connection_t*)value;
-        connections = g_slist_append(connections, connection);
+    GPtrArray* connections = g_ptr_array_sized_new(connection_group->num_members);
+    for (ct_connection_t* connection = connection_group->members; connection;
+         connection = connection->group_next) {
+        g_ptr_array_add(connections, connection);
     }
-    for (GSList* node = connections; node != NULL; node = node->next) {
-        ct_connection_t* connection = (ct_connection_t*)node->data;
-        udp_close(connection);
+    for (guint i = 0; i < connections->len; i++) {
+        udp_close(g_ptr_array_index(connections, i));
     }
-    g_slist_free(connections);
+    g_ptr_array_free(connections, true);
 }
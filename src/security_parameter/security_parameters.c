@@ -4,7 +4,10 @@
 #include "security_parameter/certificate_bundles/certificate_bundles.h"
 #include "security_parameter/security_parameters.h"
 
+#include <assert.h>
+#include <errno.h>
 #include <logging/log.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -16,9 +19,18 @@ ct_security_parameters_t* ct_security_parameters_new(void) {
     }
     memset(params, 0, sizeof(ct_security_parameters_t));
     memcpy(params, &DEFAULT_SECURITY_PARAMETERS, sizeof(ct_security_parameters_t));
+    params->ref_count = 1;
     return params;
 }
 
+static bool security_parameters_is_writable(const ct_security_parameters_t* sec) {
+    if (sec->immutable) {
+        log_error("Security parameters in use by a preconnection, listener or connection cannot be modified");
+        return false;
+    }
+    return true;
+}
+
 static void ct_string_array_value_free(ct_string_array_t arr) {
     log_trace("Freeing string array with %zu strings", arr.num_strings);
     for (size_t i = 0; i < arr.num_strings; i++) {
@@ -32,6 +44,10 @@ void ct_security_parameters_free(ct_security_parameters_t* security_parameters)
     if (!security_parameters) {
         return;
     }
+    if (security_parameters->ref_count > 1) {
+        security_parameters->ref_count--;
+        return;
+    }
     for (size_t i = 0; i < SEC_PROPERTY_END; i++) {
         ct_security_parameter_t* sec_param = &security_parameters->list[i];
         switch (sec_param->type) {
@@ -162,12 +178,66 @@ ct_security_parameters_t* ct_security_parameters_deep_copy(const ct_security_par
     return copy;
 }
 
+ct_security_parameters_t* ct_security_parameters_ref(const ct_security_parameters_t* security_parameters) {
+    if (!security_parameters) {
+        return NULL;
+    }
+    assert(security_parameters->immutable);
+    ct_security_parameters_t* shared = (ct_security_parameters_t*)security_parameters;
+    shared->ref_count++;
+    return shared;
+}
+
+ct_security_parameters_t* ct_security_parameters_share(const ct_security_parameters_t* source) {
+    if (!source) {
+        return NULL;
+    }
+    if (source->immutable) {
+        return ct_security_parameters_ref(source);
+    }
+    ct_security_parameters_t* copy = ct_security_parameters_deep_copy(source);
+    if (!copy) {
+        log_error("Failed to copy security parameters for sharing");
+        return NULL;
+    }
+    copy->immutable = true;
+    return copy;
+}
+
+ct_security_parameters_t* ct_security_parameters_with_alpn(const ct_security_parameters_t* source,
+                                                           const char* alpn) {
+    if (!source) {
+        return NULL;
+    }
+    const ct_string_array_t* alpns = &source->list[ALPN].value.array_of_strings;
+    if ((!alpn && alpns->num_strings == 0) ||
+        (alpn && alpns->num_strings == 1 && strcmp(alpns->strings[0], alpn) == 0)) {
+        return ct_security_parameters_share(source);
+    }
+
+    ct_security_parameters_t* copy = ct_security_parameters_deep_copy(source);
+    if (!copy) {
+        log_error("Failed to copy security parameters for ALPN %s", alpn ? alpn : "(none)");
+        return NULL;
+    }
+    ct_security_parameters_clear_alpn(copy);
+    if (alpn && ct_security_parameters_add_alpn(copy, alpn) < 0) {
+        ct_security_parameters_free(copy);
+        return NULL;
+    }
+    copy->immutable = true;
+    return copy;
+}
+
 int ct_security_parameters_set_ticket_store_path(ct_security_parameters_t* sec,
                                                  const char* ticket_store_path) {
     if (!sec) {
         log_error("Attempted to set ticket store path on NULL security parameters");
         return -EINVAL;
     }
+    if (!security_parameters_is_writable(sec)) {
+        return -EPERM;
+    }
     if (sec->list[TICKET_STORE_PATH].value.string) {
         log_trace("Freeing existing ticket store path before setting new value");
         free(sec->list[TICKET_STORE_PATH].value.string);
@@ -226,6 +296,9 @@ int ct_security_parameters_clear_alpn(ct_security_parameters_t* sec) {
         log_warn("Attempted to clear alpn on NULL security parameters");
         return -EINVAL;
     }
+    if (!security_parameters_is_writable(sec)) {
+        return -EPERM;
+    }
     for (size_t i = 0; i < sec->list[ALPN].value.array_of_strings.num_strings; i++) {
         free(sec->list[ALPN].value.array_of_strings.strings[i]);
     }
@@ -240,6 +313,9 @@ int ct_security_parameters_clear_alpn(ct_security_parameters_t* sec) {
 int ct_security_parameters_add_to_array_of_strings(ct_security_parameters_t* sec,
                                                    ct_security_property_enum_t type,
                                                    const char* value) {
+    if (!security_parameters_is_writable(sec)) {
+        return -EPERM;
+    }
     ct_string_array_t prev_arr = sec->list[type].value.array_of_strings;
 
     char** new_strings = realloc(prev_arr.strings, (prev_arr.num_strings + 1) * sizeof(char*));
@@ -302,6 +378,9 @@ int ct_security_parameters_set_session_ticket_encryption_key(ct_security_paramet
         log_error("Invalid security parameters argument to set session ticket encryption key");
         return -EINVAL;
     }
+    if (!security_parameters_is_writable(sec)) {
+        return -EPERM;
+    }
     if (sec->list[SESSION_TICKET_ENCRYPTION_KEY].value.byte_array.length != 0) {
         free(sec->list[SESSION_TICKET_ENCRYPTION_KEY].value.byte_array.bytes);
         sec->list[SESSION_TICKET_ENCRYPTION_KEY].value.byte_array.bytes = NULL;
@@ -328,6 +407,9 @@ int ct_security_parameters_add_certificate(ct_security_parameters_t* sec,
         log_debug("Security parameters: %p, key_file: %p", sec, key_file);
         return -EINVAL;
     }
+    if (!security_parameters_is_writable(sec)) {
+        return -EPERM;
+    }
     ct_certificate_bundles_t prev_bundles = sec->list[type].value.certificate_bundles;
 
     ct_certificate_bundle_t* bundle_array =
@@ -445,6 +527,9 @@ int ct_security_parameters_set_server_name_identification(
         log_error("Attempted to set server name identification on NULL security parameters");
         return -EINVAL;
     }
+    if (!security_parameters_is_writable(security_parameters)) {
+        return -EPERM;
+    }
     if (security_parameters->list[SERVER_NAME_IDENTIFICATION].value.string) {
         log_trace("Freeing existing server name identification before setting new value");
         free(security_parameters->list[SERVER_NAME_IDENTIFICATION].value.string);
@@ -13,4 +13,37 @@
  */
 ct_security_parameters_t* ct_security_parameters_deep_copy(const ct_security_parameters_t* source);
 
+/**
+ * @brief Get immutable security parameters to store in a preconnection, listener or connection.
+ *
+ * Immutable parameters are shared by taking a reference. Mutable ones, as created by the
+ * user, are copied once into a new immutable object.
+ *
+ * @param source Security parameters to share, may be NULL
+ * @return Reference to release with ct_security_parameters_free(), NULL if source is NULL or on failure
+ */
+ct_security_parameters_t* ct_security_parameters_share(const ct_security_parameters_t* source);
+
+/**
+ * @brief Take another reference to immutable security parameters.
+ *
+ * @param security_parameters Immutable security parameters, may be NULL
+ * @return security_parameters, to release with ct_security_parameters_free()
+ */
+ct_security_parameters_t* ct_security_parameters_ref(const ct_security_parameters_t* security_parameters);
+
+/**
+ * @brief Immutable security parameters offering exactly one ALPN.
+ *
+ * Used when racing, where every candidate negotiates a single ALPN. If source already offers
+ * exactly that ALPN (or none when alpn is NULL), a reference to source is returned instead
+ * of a copy.
+ *
+ * @param source Immutable security parameters to derive from
+ * @param alpn ALPN to offer, NULL for none
+ * @return Reference to release with ct_security_parameters_free(), NULL on failure
+ */
+ct_security_parameters_t* ct_security_parameters_with_alpn(const ct_security_parameters_t* source,
+                                                           const char* alpn);
+
 #endif // CT_SECURITY_PARAMETERS_H
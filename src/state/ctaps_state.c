@@ -1,6 +1,14 @@
 #include "ctaps.h"
 
+#include "candidate_gathering/destination_cache.h"
+#include "candidate_gathering/rtt_history.h"
+#include "connection/connection_pool.h"
+#include "endpoint/dns_cache.h"
+#include "endpoint/interface_cache.h"
+#include "endpoint/port_util.h"
 #include "logging/log.h"
+#include "protocol/quic/quic_cert_cache.h"
+#include "protocol/quic/quic_ticket_store.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <uv.h>
@@ -18,6 +26,7 @@ int ct_initialize(void) {
         free(event_loop);
         return rc;
     }
+    ct_interface_cache_start();
 
     return 0;
 }
@@ -29,6 +38,14 @@ int ct_close(void) {
         return rc;
     }
     free(event_loop);
+    ct_connection_pool_clear();
+    ct_quic_cert_cache_clear();
+    ct_quic_ticket_store_clear();
+    ct_dns_cache_clear();
+    ct_service_port_cache_clear();
+    ct_rtt_history_clear();
+    ct_destination_cache_clear();
+    ct_interface_cache_stop();
     log_info("Successfully closed CTaps");
     return 0;
 }
@@ -163,6 +163,31 @@ bool ct_connection_properties_get_isolate_session(ct_connection_properties_t* co
     return conn_props->list[ISOLATE_SESSION].value.bool_val;
 }
 
+bool ct_connection_properties_get_listener_reuse_port(ct_connection_properties_t* conn_props) {
+    if (!conn_props) {
+        log_warn("Null pointer passed to get_listener_reuse_port");
+        return false;
+    }
+    return conn_props->list[LISTENER_REUSE_PORT].value.bool_val;
+}
+
+bool ct_connection_properties_get_listener_cpu_affinity(ct_connection_properties_t* conn_props) {
+    if (!conn_props) {
+        log_warn("Null pointer passed to get_listener_cpu_affinity");
+        return false;
+    }
+    return conn_props->list[LISTENER_CPU_AFFINITY].value.bool_val;
+}
+
+ct_congestion_algorithm_enum_t
+ct_connection_properties_get_congestion_algorithm(ct_connection_properties_t* conn_props) {
+    if (!conn_props) {
+        log_warn("Null pointer passed to get_congestion_algorithm");
+        return CT_CONGESTION_ALGORITHM_AUTO;
+    }
+    return (ct_congestion_algorithm_enum_t)conn_props->list[CONGESTION_ALGORITHM].value.enum_val;
+}
+
 uint64_t ct_connection_properties_get_singular_transmission_msg_max_len(
     ct_connection_properties_t* conn_props) {
     if (!conn_props) {
@@ -332,6 +357,33 @@ void ct_connection_properties_set_isolate_session(ct_connection_properties_t* co
     conn_props->list[ISOLATE_SESSION].value.bool_val = isolate_session;
 }
 
+void ct_connection_properties_set_listener_reuse_port(ct_connection_properties_t* conn_props,
+                                                      bool listener_reuse_port) {
+    if (!conn_props) {
+        log_warn("Null pointer passed to set_listener_reuse_port");
+        return;
+    }
+    conn_props->list[LISTENER_REUSE_PORT].value.bool_val = listener_reuse_port;
+}
+
+void ct_connection_properties_set_listener_cpu_affinity(ct_connection_properties_t* conn_props,
+                                                        bool listener_cpu_affinity) {
+    if (!conn_props) {
+        log_warn("Null pointer passed to set_listener_cpu_affinity");
+        return;
+    }
+    conn_props->list[LISTENER_CPU_AFFINITY].value.bool_val = listener_cpu_affinity;
+}
+
+void ct_connection_properties_set_congestion_algorithm(
+    ct_connection_properties_t* conn_props, ct_congestion_algorithm_enum_t congestion_algorithm) {
+    if (!conn_props) {
+        log_warn("Null pointer passed to set_congestion_algorithm");
+        return;
+    }
+    conn_props->list[CONGESTION_ALGORITHM].value.enum_val = congestion_algorithm;
+}
+
 void ct_connection_properties_set_user_timeout_value_ms(ct_connection_properties_t* conn_props,
                                                         uint32_t user_timeout_value_ms) {
     if (!conn_props) {
@@ -71,3 +71,47 @@ void ct_selection_properties_deep_copy(ct_selection_properties_t* dest,
             src->list[PVD].value.preference_set_val.combinations[i].preference;
     }
 }
+
+void ct_selection_masks_compile(const ct_selection_properties_t* selection_properties,
+                                ct_selection_masks_t* masks) {
+    memset(masks, 0, sizeof(ct_selection_masks_t));
+    for (int i = 0; i < SELECTION_PROPERTY_END; i++) {
+        // Protocol implementations only fill in values, so the type comes from the defaults
+        if (DEFAULT_SELECTION_PROPERTIES[i].type != TYPE_PREFERENCE) {
+            continue;
+        }
+        uint64_t bit = UINT64_C(1) << i;
+        switch (selection_properties->list[i].value.simple_preference) {
+        case REQUIRE:
+            masks->require |= bit;
+            break;
+        case PROHIBIT:
+            masks->prohibit |= bit;
+            break;
+        case PREFER:
+            masks->prefer |= bit;
+            break;
+        case AVOID:
+            masks->avoid |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool ct_selection_masks_compatible(const ct_selection_masks_t* desired,
+                                   const ct_selection_masks_t* capabilities) {
+    return !(desired->require & capabilities->prohibit) &&
+           !(desired->prohibit & capabilities->require);
+}
+
+int ct_selection_masks_prefer_score(const ct_selection_masks_t* desired,
+                                    const ct_selection_masks_t* capabilities) {
+    return __builtin_popcountll(desired->prefer & ~capabilities->prohibit);
+}
+
+int ct_selection_masks_avoid_score(const ct_selection_masks_t* desired,
+                                   const ct_selection_masks_t* capabilities) {
+    return __builtin_popcountll(desired->avoid & ~capabilities->require);
+}
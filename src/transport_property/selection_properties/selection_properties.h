@@ -18,4 +18,34 @@ void ct_selection_properties_cleanup(ct_selection_properties_t* selection_proper
 void ct_selection_properties_deep_copy(ct_selection_properties_t* dest,
                                        const ct_selection_properties_t* src);
 
+/**
+ * @brief Compile the TYPE_PREFERENCE entries of selection properties into bitmasks.
+ *
+ * @param[in] selection_properties Desired properties of a preconnection, or the properties
+ *                                 a protocol implementation provides.
+ * @param[out] masks Bitmasks to fill in.
+ */
+void ct_selection_masks_compile(const ct_selection_properties_t* selection_properties,
+                                ct_selection_masks_t* masks);
+
+/**
+ * @brief Check whether a protocol can satisfy the REQUIRE and PROHIBIT preferences.
+ *
+ * @return false if the protocol prohibits a required property or requires a prohibited one
+ */
+bool ct_selection_masks_compatible(const ct_selection_masks_t* desired,
+                                   const ct_selection_masks_t* capabilities);
+
+/**
+ * @brief Number of PREFER properties the protocol can provide.
+ */
+int ct_selection_masks_prefer_score(const ct_selection_masks_t* desired,
+                                    const ct_selection_masks_t* capabilities);
+
+/**
+ * @brief Number of AVOID properties the protocol can do without.
+ */
+int ct_selection_masks_avoid_score(const ct_selection_masks_t* desired,
+                                   const ct_selection_masks_t* capabilities);
+
 #endif // CT_SELECTION_PROPERTIES_H
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+  #include "candidate_gathering/candidate_arena.h"
+}
+
+TEST(CandidateArenaUnitTest, allocationsAreZeroedAndAligned) {
+    ct_candidate_arena_t* arena = ct_candidate_arena_new();
+    ASSERT_NE(arena, nullptr);
+
+    unsigned char* first = (unsigned char*)ct_candidate_arena_alloc(arena, 3);
+    unsigned char* second = (unsigned char*)ct_candidate_arena_alloc(arena, 40);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ((uintptr_t)first % 16, 0u);
+    EXPECT_EQ((uintptr_t)second % 16, 0u);
+    EXPECT_GE(second, first + 3);
+    for (size_t i = 0; i < 40; i++) {
+        EXPECT_EQ(second[i], 0);
+    }
+    EXPECT_EQ(ct_candidate_arena_num_blocks(arena), 1u);
+
+    ct_candidate_arena_unref(arena);
+}
+
+TEST(CandidateArenaUnitTest, copiesStrings) {
+    ct_candidate_arena_t* arena = ct_candidate_arena_new();
+    ASSERT_NE(arena, nullptr);
+
+    char original[] = "h3";
+    char* copy = ct_candidate_arena_strdup(arena, original);
+    ASSERT_NE(copy, nullptr);
+    original[0] = 'x';
+    EXPECT_STREQ(copy, "h3");
+    EXPECT_EQ(ct_candidate_arena_strdup(arena, nullptr), nullptr);
+
+    ct_candidate_arena_unref(arena);
+}
+
+TEST(CandidateArenaUnitTest, chainsBlocksWhenFull) {
+    ct_candidate_arena_t* arena = ct_candidate_arena_new();
+    ASSERT_NE(arena, nullptr);
+
+    void* small = ct_candidate_arena_alloc(arena, 64);
+    void* oversized = ct_candidate_arena_alloc(arena, CT_CANDIDATE_ARENA_BLOCK_SIZE * 2);
+    ASSERT_NE(small, nullptr);
+    ASSERT_NE(oversized, nullptr);
+    EXPECT_EQ(ct_candidate_arena_num_blocks(arena), 2u);
+    memset(oversized, 0xab, CT_CANDIDATE_ARENA_BLOCK_SIZE * 2);
+
+    // The oversized block does not take the place of the partly used one
+    void* next = ct_candidate_arena_alloc(arena, 64);
+    EXPECT_EQ((unsigned char*)next, (unsigned char*)small + 64);
+    EXPECT_EQ(ct_candidate_arena_num_blocks(arena), 2u);
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_NE(ct_candidate_arena_alloc(arena, CT_CANDIDATE_ARENA_BLOCK_SIZE / 2), nullptr);
+    }
+    EXPECT_EQ(ct_candidate_arena_num_blocks(arena), 4u);
+
+    ct_candidate_arena_unref(arena);
+}
+
+TEST(CandidateArenaUnitTest, livesUntilLastReferenceIsDropped) {
+    ct_candidate_arena_t* arena = ct_candidate_arena_new();
+    ASSERT_NE(arena, nullptr);
+    char* copy = ct_candidate_arena_strdup(arena, "still here");
+
+    ct_candidate_arena_ref(arena);
+    ct_candidate_arena_unref(arena);
+    // ASAN reports a use after free if the first unref released the memory
+    EXPECT_STREQ(copy, "still here");
+
+    ct_candidate_arena_unref(arena);
+}
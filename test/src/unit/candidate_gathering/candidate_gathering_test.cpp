@@ -3,6 +3,7 @@
 #include <netinet/in.h>
 #include <map>
 #include <string>
+#include <vector>
 
 extern "C" {
   #include "fff.h"
@@ -10,6 +11,7 @@ extern "C" {
   #include "ctaps.h"
   #include "ctaps_internal.h"
   #include "candidate_gathering/candidate_gathering.h"
+  #include "candidate_gathering/candidate_plan.h"
   #include "endpoint/local_endpoint.h"
   #include "endpoint/remote_endpoint.h"
 
@@ -166,6 +168,43 @@ TEST_F(CandidateGatheringTest, PrunesPathAndProtocol) {
     free_candidate_array(candidates);
 }
 
+TEST_F(CandidateGatheringTest, SkipsLookupsForPrunedPathsAndProtocols) {
+    ct_transport_properties_set_reliability(props, REQUIRE); // UDP pruned
+    int rc = ct_transport_properties_add_interface_preference(props, "Ethernet", REQUIRE);
+    ASSERT_EQ(rc, 0);
+    BuildPreconnection();
+
+    GArray* candidates = GatherCandidates();
+    ASSERT_NE(candidates, nullptr);
+    ASSERT_EQ(candidates->len, 1 * 2 * 1);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_fake.call_count, 1 * 2 * 1);
+
+    free_candidate_array(candidates);
+}
+
+TEST_F(CandidateGatheringTest, CandidatesShareOneArena) {
+    BuildPreconnection();
+
+    GArray* candidates = GatherCandidates();
+    ASSERT_NE(candidates, nullptr);
+    ASSERT_EQ(candidates->len, 2 * 3 * 1);
+    ct_candidate_arena_t* arena = g_array_index(candidates, ct_candidate_node_t, 0).arena;
+    ASSERT_NE(arena, nullptr);
+    for (guint i = 0; i < candidates->len; i++) {
+        EXPECT_EQ(g_array_index(candidates, ct_candidate_node_t, i).arena, arena);
+    }
+    // Only the first block, holding the tables and every endpoint, is needed here
+    EXPECT_EQ(ct_candidate_arena_num_blocks(arena), 1u);
+
+    // A copy keeps the arena alive after the array is freed
+    ct_candidate_node_t* copy = ct_candidate_node_copy(&g_array_index(candidates, ct_candidate_node_t, 0));
+    ASSERT_NE(copy, nullptr);
+    free_candidate_array(candidates);
+    EXPECT_EQ(copy->remote_endpoint->port, 80);
+    ct_candidate_node_free_content(copy);
+    free(copy);
+}
+
 TEST_F(CandidateGatheringTest, SortsOnPreferOverAvoidTCPAndQUIC) {
     ct_transport_properties_set_reliability(props, REQUIRE);       // Prune UDP
     // QUIC should win even if TCP has more avoids, since prefers are stronger than avoids
@@ -252,3 +291,157 @@ TEST_F(CandidateGatheringTest, AlpnIsOnlySetWhenSupportedByProtocol) {
 
     free_candidate_array(candidates);
 }
+
+TEST_F(CandidateGatheringTest, CompilesCandidatePlanForLaterInitiates) {
+    BuildPreconnection();
+
+    GArray* candidates = GatherCandidates();
+    ASSERT_NE(candidates, nullptr);
+
+    GArray* planned = ct_candidate_plan_instantiate(preconnection->candidate_plan);
+    ASSERT_NE(planned, nullptr);
+    ASSERT_EQ(planned->len, candidates->len);
+    for (guint i = 0; i < planned->len; i++) {
+        EXPECT_EQ(g_array_index(planned, ct_candidate_node_t, i).protocol_candidate->protocol_impl,
+                  g_array_index(candidates, ct_candidate_node_t, i).protocol_candidate->protocol_impl);
+    }
+
+    free_candidate_array(planned);
+    free_candidate_array(candidates);
+}
+
+// --- Batched delivery ---
+
+static std::vector<ct_remote_resolve_call_context_t*> pending_a_lookups;
+static std::vector<ct_remote_resolve_call_context_t*> pending_aaaa_lookups;
+
+// Leaves every lookup in flight, split like a hostname lookup would be
+int remote_endpoint_resolve_fake_split(const ct_remote_endpoint_t*, ct_remote_resolve_call_context_t* context) {
+    ct_remote_resolve_call_context_t* aaaa_context = ct_remote_resolve_call_context_split(context);
+    EXPECT_NE(aaaa_context, nullptr);
+    pending_a_lookups.push_back(context);
+    pending_aaaa_lookups.push_back(aaaa_context);
+    return 0;
+}
+
+static void answer_lookups(std::vector<ct_remote_resolve_call_context_t*>& lookups) {
+    std::vector<ct_remote_resolve_call_context_t*> answering;
+    answering.swap(lookups);
+    for (ct_remote_resolve_call_context_t* context : answering) {
+        ct_remote_endpoint_t* list = (ct_remote_endpoint_t*)malloc(sizeof(ct_remote_endpoint_t));
+        ct_remote_endpoint_build(&list[0]);
+        if (context->family == AF_INET6) {
+            struct in6_addr address = {};
+            inet_pton(AF_INET6, "2001:db8::1", &address);
+            ct_remote_endpoint_with_ipv6(&list[0], address);
+        } else {
+            ct_remote_endpoint_with_ipv4(&list[0], inet_addr("192.0.2.1"));
+        }
+        ct_remote_endpoint_resolve_cb(list, 1, context);
+    }
+}
+
+struct candidate_batches_t {
+    std::vector<GArray*> batches;
+    bool got_last = false;
+};
+
+static void capture_candidate_batch(GArray* candidate_array, bool is_last, void* context) {
+    candidate_batches_t* out = (candidate_batches_t*)context;
+    out->batches.push_back(candidate_array);
+    out->got_last = is_last;
+}
+
+class CandidateBatchTest : public CandidateGatheringTest {
+protected:
+    candidate_batches_t delivered;
+
+    void SetUp() override {
+        CandidateGatheringTest::SetUp();
+        ASSERT_EQ(ct_initialize(), 0);
+        pending_a_lookups.clear();
+        pending_aaaa_lookups.clear();
+        faked_ct_remote_endpoint_resolve_fake.custom_fake = remote_endpoint_resolve_fake_split;
+    }
+
+    void TearDown() override {
+        for (GArray* batch : delivered.batches) {
+            if (batch) {
+                free_candidate_array(batch);
+            }
+        }
+        // Closes the batch timer
+        uv_run(event_loop, UV_RUN_NOWAIT);
+        ASSERT_EQ(ct_close(), 0);
+        CandidateGatheringTest::TearDown();
+    }
+
+    void StartBatchedGathering() {
+        BuildPreconnection();
+        ct_candidate_gathering_callbacks_t callbacks = {
+            .candidate_node_array_ready_cb = nullptr,
+            .candidate_node_batch_cb = capture_candidate_batch,
+            .context = &delivered,
+        };
+        ASSERT_EQ(ct_get_ordered_candidate_nodes(preconnection, callbacks), 0);
+        ASSERT_EQ(pending_aaaa_lookups.size(), 2 * 3 * 1u);
+    }
+};
+
+TEST_F(CandidateBatchTest, AaaaAnswersAreRacedBeforeALookupsComplete) {
+    StartBatchedGathering();
+
+    answer_lookups(pending_aaaa_lookups);
+    EXPECT_TRUE(delivered.batches.empty());
+    uv_run(event_loop, UV_RUN_NOWAIT);
+
+    ASSERT_EQ(delivered.batches.size(), 1u);
+    EXPECT_FALSE(delivered.got_last);
+    EXPECT_EQ(delivered.batches[0]->len, 2 * 3 * 1u);
+    EXPECT_EQ(g_array_index(delivered.batches[0], ct_candidate_node_t, 0).remote_endpoint->resolved_address.ss_family, AF_INET6);
+
+    // The final batch only holds the answers which were not delivered yet
+    answer_lookups(pending_a_lookups);
+    ASSERT_EQ(delivered.batches.size(), 2u);
+    EXPECT_TRUE(delivered.got_last);
+    EXPECT_EQ(delivered.batches[1]->len, 2 * 3 * 1u);
+    EXPECT_EQ(g_array_index(delivered.batches[1], ct_candidate_node_t, 0).remote_endpoint->resolved_address.ss_family, AF_INET);
+}
+
+TEST_F(CandidateBatchTest, AAnswersWaitForResolutionDelay) {
+    StartBatchedGathering();
+
+    answer_lookups(pending_a_lookups);
+    uv_run(event_loop, UV_RUN_NOWAIT);
+    EXPECT_TRUE(delivered.batches.empty());
+
+    uint64_t waiting_since = uv_now(event_loop);
+    uv_run(event_loop, UV_RUN_ONCE);
+    uv_update_time(event_loop);
+
+    ASSERT_EQ(delivered.batches.size(), 1u);
+    EXPECT_FALSE(delivered.got_last);
+    EXPECT_GE(uv_now(event_loop) - waiting_since, (uint64_t)CT_RESOLUTION_DELAY_MS);
+    EXPECT_EQ(delivered.batches[0]->len, 2 * 3 * 1u);
+
+    answer_lookups(pending_aaaa_lookups);
+    ASSERT_EQ(delivered.batches.size(), 2u);
+    EXPECT_TRUE(delivered.got_last);
+}
+
+TEST_F(CandidateBatchTest, EmptyAaaaAnswerDoesNotDelayA) {
+    StartBatchedGathering();
+
+    std::vector<ct_remote_resolve_call_context_t*> aaaa_lookups;
+    aaaa_lookups.swap(pending_aaaa_lookups);
+    for (ct_remote_resolve_call_context_t* context : aaaa_lookups) {
+        ct_remote_endpoint_resolve_cb(nullptr, 0, context);
+    }
+    EXPECT_TRUE(delivered.batches.empty());
+
+    // Only the A answers are left, so they complete the tree
+    answer_lookups(pending_a_lookups);
+    ASSERT_EQ(delivered.batches.size(), 1u);
+    EXPECT_TRUE(delivered.got_last);
+    EXPECT_EQ(delivered.batches[0]->len, 2 * 3 * 1u);
+}
@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+extern "C" {
+  #include "ctaps.h"
+  #include "ctaps_internal.h"
+  #include "candidate_gathering/candidate_gathering.h"
+  #include "candidate_gathering/candidate_plan.h"
+  #include "endpoint/dns_cache.h"
+}
+
+class CandidatePlanUnitTest : public ::testing::Test {
+protected:
+    ct_candidate_plan_t* plan = nullptr;
+    ct_local_endpoint_t* local_endpoint = nullptr;
+    ct_remote_endpoint_t* remote_endpoint = nullptr;
+
+    void SetUp() override {
+        plan = ct_candidate_plan_new();
+        ASSERT_NE(plan, nullptr);
+        local_endpoint = ct_local_endpoint_new();
+        remote_endpoint = ct_remote_endpoint_new();
+        ct_remote_endpoint_with_ipv4(remote_endpoint, inet_addr("192.0.2.1"));
+        ct_remote_endpoint_with_port(remote_endpoint, 443);
+    }
+
+    void TearDown() override {
+        ct_set_dns_cache_ttl(CT_DNS_CACHE_DEFAULT_TTL_MS);
+        ct_candidate_plan_free(plan);
+        ct_local_endpoint_free(local_endpoint);
+        ct_remote_endpoint_free(remote_endpoint);
+    }
+
+    GArray* NewCandidateArray(size_t num_candidates) {
+        GArray* candidates = g_array_new(false, false, sizeof(ct_candidate_node_t));
+        ct_candidate_node_t node = {};
+        node.type = NODE_TYPE_ENDPOINT;
+        node.local_endpoint = local_endpoint;
+        node.remote_endpoint = remote_endpoint;
+        for (size_t i = 0; i < num_candidates; i++) {
+            ct_candidate_node_t* copy = ct_candidate_node_copy(&node);
+            g_array_append_val(candidates, *copy);
+            free(copy);
+        }
+        return candidates;
+    }
+};
+
+TEST_F(CandidatePlanUnitTest, hasNoCandidatesUntilCompiled) {
+    EXPECT_EQ(ct_candidate_plan_instantiate(plan), nullptr);
+}
+
+TEST_F(CandidatePlanUnitTest, instantiatesIndependentCopies) {
+    ct_candidate_plan_compile(plan, NewCandidateArray(3));
+
+    GArray* first = ct_candidate_plan_instantiate(plan);
+    GArray* second = ct_candidate_plan_instantiate(plan);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(first->len, 3u);
+    ASSERT_EQ(second->len, 3u);
+
+    ct_candidate_node_t a = g_array_index(first, ct_candidate_node_t, 0);
+    ct_candidate_node_t b = g_array_index(second, ct_candidate_node_t, 0);
+    EXPECT_NE(a.remote_endpoint, b.remote_endpoint);
+    EXPECT_EQ(ntohs(((struct sockaddr_in*)&a.remote_endpoint->resolved_address)->sin_port), 443);
+
+    // Races own and free their copies, the plan stays usable
+    free_candidate_array(first);
+    free_candidate_array(second);
+    GArray* third = ct_candidate_plan_instantiate(plan);
+    ASSERT_NE(third, nullptr);
+    free_candidate_array(third);
+}
+
+TEST_F(CandidatePlanUnitTest, invalidateForgetsCandidates) {
+    ct_candidate_plan_compile(plan, NewCandidateArray(2));
+    ct_candidate_plan_invalidate(plan);
+
+    EXPECT_EQ(ct_candidate_plan_instantiate(plan), nullptr);
+}
+
+TEST_F(CandidatePlanUnitTest, emptyCandidateSetIsNotCompiled) {
+    ct_candidate_plan_compile(plan, NewCandidateArray(0));
+
+    EXPECT_EQ(ct_candidate_plan_instantiate(plan), nullptr);
+}
+
+TEST_F(CandidatePlanUnitTest, disabledDnsCacheDisablesPlan) {
+    ct_candidate_plan_compile(plan, NewCandidateArray(2));
+    ct_set_dns_cache_ttl(0);
+
+    EXPECT_EQ(ct_candidate_plan_instantiate(plan), nullptr);
+
+    ct_candidate_plan_compile(plan, NewCandidateArray(2));
+    EXPECT_EQ(ct_candidate_plan_instantiate(plan), nullptr);
+}
@@ -0,0 +1,234 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <uv.h>
+
+extern "C" {
+  #include "fff.h"
+  #include "ctaps.h"
+  #include "ctaps_internal.h"
+  #include "candidate_gathering/candidate_racing.h"
+  #include "connection/connection.h"
+  #include "endpoint/local_endpoint.h"
+  #include "protocol/common/socket_utils.h"
+
+  DEFINE_FFF_GLOBALS;
+  FAKE_VALUE_FUNC(ct_connection_shared_data_t*, __wrap_ct_connection_shared_data_new,
+                  ct_local_endpoint_t*, size_t, ct_remote_endpoint_t*, size_t,
+                  const ct_framer_impl_t*);
+
+  ct_connection_shared_data_t* __real_ct_connection_shared_data_new(
+      ct_local_endpoint_t* local_endpoints, size_t num_local_endpoints,
+      ct_remote_endpoint_t* remote_endpoints, size_t num_remote_endpoints,
+      const ct_framer_impl_t* framer_impl);
+
+  void racing_context_index_endpoints(ct_racing_context_t* context, size_t first_attempt);
+}
+
+namespace {
+
+void set_address(struct sockaddr_storage* storage, const char* ip, uint16_t port) {
+    memset(storage, 0, sizeof(*storage));
+    struct sockaddr_in* in = (struct sockaddr_in*)storage;
+    in->sin_family = AF_INET;
+    in->sin_port = htons(port);
+    inet_pton(AF_INET, ip, &in->sin_addr);
+}
+
+} // namespace
+
+class CandidateRacingUnitTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        RESET_FAKE(__wrap_ct_connection_shared_data_new);
+        FFF_RESET_HISTORY();
+        __wrap_ct_connection_shared_data_new_fake.custom_fake =
+            __real_ct_connection_shared_data_new;
+
+        context = (ct_racing_context_t*)calloc(1, sizeof(ct_racing_context_t));
+        context->preconnection = &preconnection;
+
+        // Distinct objects with equal addresses, like the candidates of several protocols
+        set_address(&local[0].resolved_address, "10.0.0.1", 0);
+        set_address(&local[1].resolved_address, "10.0.0.1", 0);
+        set_address(&remote[0].resolved_address, "192.0.2.1", 443);
+        set_address(&remote[1].resolved_address, "192.0.2.2", 443);
+        set_address(&remote[2].resolved_address, "192.0.2.1", 443);
+        set_address(&remote[3].resolved_address, "192.0.2.3", 443);
+
+        dummy_protocol_impl.name = "dummy";
+        dummy_protocol_impl.protocol_enum = CT_PROTOCOL_TCP;
+    }
+
+    void TearDown() override {
+        if (context->local_endpoint_indices) {
+            g_hash_table_destroy(context->local_endpoint_indices);
+            g_hash_table_destroy(context->remote_endpoint_indices);
+        }
+        ct_connection_shared_data_unref(context->endpoints);
+        free(context->attempts);
+        free(context);
+    }
+
+    // Appends attempts the way a Happy Eyeballs batch does and indexes them
+    void add_attempts(const size_t* local_indices, const size_t* remote_indices, size_t count) {
+        size_t first_attempt = context->num_attempts;
+        context->attempts = (ct_racing_attempt_t*)realloc(
+            context->attempts, (first_attempt + count) * sizeof(ct_racing_attempt_t));
+        for (size_t i = 0; i < count; i++) {
+            ct_racing_attempt_t* attempt = &context->attempts[first_attempt + i];
+            memset(attempt, 0, sizeof(ct_racing_attempt_t));
+            attempt->candidate.local_endpoint = &local[local_indices[i]];
+            attempt->candidate.remote_endpoint = &remote[remote_indices[i]];
+            attempt->attempt_index = first_attempt + i;
+            attempt->context = context;
+        }
+        context->num_attempts += count;
+        racing_context_index_endpoints(context, first_attempt);
+    }
+
+    ct_preconnection_t preconnection = {};
+    ct_racing_context_t* context = nullptr;
+    ct_local_endpoint_t local[2] = {};
+    ct_remote_endpoint_t remote[4] = {};
+    ct_protocol_impl_t dummy_protocol_impl = {};
+};
+
+TEST_F(CandidateRacingUnitTest, equalEndpointsGetTheSameIndex) {
+    const size_t local_indices[] = {0, 1, 0, 1};
+    const size_t remote_indices[] = {0, 1, 2, 1};
+    add_attempts(local_indices, remote_indices, 4);
+
+    ASSERT_NE(context->endpoints, nullptr);
+    EXPECT_EQ(context->endpoints->num_local_endpoints, 1u);
+    EXPECT_EQ(context->endpoints->num_remote_endpoints, 2u);
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(context->attempts[i].local_endpoint_index, 0u);
+    }
+    EXPECT_EQ(context->attempts[0].remote_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[1].remote_endpoint_index, 1u);
+    EXPECT_EQ(context->attempts[2].remote_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[3].remote_endpoint_index, 1u);
+    EXPECT_EQ(__wrap_ct_connection_shared_data_new_fake.call_count, 1u);
+}
+
+TEST_F(CandidateRacingUnitTest, laterBatchExtendsEndpointsAndKeepsIndices) {
+    const size_t first_local[] = {0, 0};
+    const size_t first_remote[] = {0, 1};
+    add_attempts(first_local, first_remote, 2);
+    ct_connection_shared_data_t* first_block = context->endpoints;
+
+    // A connection created from the first batch holds on to its block
+    ct_connection_t* connection = ct_connection_create_client(
+        &dummy_protocol_impl, first_block, context->attempts[1].local_endpoint_index,
+        context->attempts[1].remote_endpoint_index, NULL, NULL, NULL);
+    ASSERT_NE(connection, nullptr);
+    EXPECT_EQ(first_block->ref_count, 2u);
+
+    const size_t second_local[] = {1, 0};
+    const size_t second_remote[] = {3, 2};
+    add_attempts(second_local, second_remote, 2);
+
+    ct_connection_shared_data_t* second_block = context->endpoints;
+    ASSERT_NE(second_block, first_block);
+    EXPECT_EQ(second_block->num_local_endpoints, 1u);
+    EXPECT_EQ(second_block->num_remote_endpoints, 3u);
+    // Old attempts keep their indices, the new block starts with the old entries
+    EXPECT_EQ(context->attempts[0].remote_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[1].remote_endpoint_index, 1u);
+    EXPECT_EQ(context->attempts[2].remote_endpoint_index, 2u);
+    EXPECT_EQ(context->attempts[3].remote_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[2].local_endpoint_index, 0u);
+    EXPECT_EQ(memcmp(&second_block->all_remote_endpoints[1].resolved_address,
+                     &first_block->all_remote_endpoints[1].resolved_address,
+                     sizeof(struct sockaddr_in)),
+              0);
+
+    // The connection still reads its endpoint from the block it was created with
+    EXPECT_EQ(first_block->ref_count, 1u);
+    EXPECT_EQ(connection->shared_data, first_block);
+    EXPECT_EQ(connection->num_remote_endpoints, 2u);
+    EXPECT_EQ(memcmp(&ct_connection_get_active_remote_endpoint(connection)->resolved_address,
+                     &remote[1].resolved_address, sizeof(struct sockaddr_in)),
+              0);
+
+    // Connections of the new batch index into the new block
+    ct_connection_t* new_connection = ct_connection_create_client(
+        &dummy_protocol_impl, second_block, context->attempts[2].local_endpoint_index,
+        context->attempts[2].remote_endpoint_index, NULL, NULL, NULL);
+    ASSERT_NE(new_connection, nullptr);
+    EXPECT_EQ(memcmp(&ct_connection_get_active_remote_endpoint(new_connection)->resolved_address,
+                     &remote[3].resolved_address, sizeof(struct sockaddr_in)),
+              0);
+
+    ct_connection_free(new_connection);
+    ct_connection_free(connection);
+    EXPECT_EQ(second_block->ref_count, 1u);
+}
+
+TEST_F(CandidateRacingUnitTest, failedCopyLeavesNewEndpointsWithoutIndex) {
+    const size_t first_local[] = {0};
+    const size_t first_remote[] = {0};
+    add_attempts(first_local, first_remote, 1);
+    ct_connection_shared_data_t* first_block = context->endpoints;
+
+    __wrap_ct_connection_shared_data_new_fake.custom_fake = NULL;
+    __wrap_ct_connection_shared_data_new_fake.return_val = NULL;
+    const size_t second_local[] = {0, 1};
+    const size_t second_remote[] = {3, 2};
+    add_attempts(second_local, second_remote, 2);
+
+    // The race keeps the block it had, only the endpoint that was not in it is missing
+    EXPECT_EQ(context->endpoints, first_block);
+    EXPECT_EQ(context->attempts[0].remote_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[1].local_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[1].remote_endpoint_index, CT_RACING_NO_ENDPOINT);
+    EXPECT_EQ(context->attempts[2].local_endpoint_index, 0u);
+    EXPECT_EQ(context->attempts[2].remote_endpoint_index, 0u);
+
+    // The endpoint was forgotten, so a later batch can still add it
+    __wrap_ct_connection_shared_data_new_fake.custom_fake =
+        __real_ct_connection_shared_data_new;
+    const size_t third_local[] = {0};
+    const size_t third_remote[] = {3};
+    add_attempts(third_local, third_remote, 1);
+
+    ASSERT_NE(context->endpoints, first_block);
+    EXPECT_EQ(context->endpoints->num_remote_endpoints, 2u);
+    EXPECT_EQ(context->attempts[3].remote_endpoint_index, 1u);
+    EXPECT_EQ(context->attempts[1].remote_endpoint_index, CT_RACING_NO_ENDPOINT);
+}
+
+TEST_F(CandidateRacingUnitTest, startedTcpAttemptStillSharesTheBlock) {
+    const size_t local_indices[] = {0, 0};
+    const size_t remote_indices[] = {0, 1};
+    add_attempts(local_indices, remote_indices, 2);
+    ct_connection_shared_data_t* block = context->endpoints;
+    ct_connection_t* connection = ct_connection_create_client(
+        &dummy_protocol_impl, block, context->attempts[0].local_endpoint_index,
+        context->attempts[0].remote_endpoint_index, NULL, NULL, NULL);
+    ASSERT_NE(connection, nullptr);
+
+    // Like the socket of a TCP attempt, bound to an ephemeral port
+    uv_tcp_t tcp_handle;
+    ASSERT_EQ(uv_tcp_init(uv_default_loop(), &tcp_handle), 0);
+    struct sockaddr_storage bind_address;
+    set_address(&bind_address, "127.0.0.1", 0);
+    ASSERT_EQ(uv_tcp_bind(&tcp_handle, (const struct sockaddr*)&bind_address, 0), 0);
+
+    ASSERT_EQ(resolve_local_endpoint_from_handle((uv_handle_t*)&tcp_handle, connection), 0);
+
+    // The bound port is kept in the connection, the block is neither copied nor changed
+    EXPECT_EQ(connection->shared_data, block);
+    EXPECT_EQ(connection->all_local_endpoints, block->all_local_endpoints);
+    EXPECT_EQ(block->ref_count, 2u);
+    EXPECT_NE(ct_local_endpoint_get_resolved_port(ct_connection_get_active_local_endpoint(connection)),
+              0);
+    EXPECT_EQ(ct_local_endpoint_get_resolved_port(&block->all_local_endpoints[0]), 0);
+
+    ct_connection_free(connection);
+    uv_close((uv_handle_t*)&tcp_handle, NULL);
+    uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+}
@@ -0,0 +1,187 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+
+extern "C" {
+  #include "ctaps.h"
+  #include "ctaps_internal.h"
+  #include "candidate_gathering/candidate_gathering.h"
+  #include "candidate_gathering/destination_cache.h"
+}
+
+namespace {
+
+ct_preconnection_t* new_preconnection(const char* hostname, ct_selection_preference_enum_t multistreaming) {
+    ct_remote_endpoint_t* remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(remote, hostname);
+    ct_remote_endpoint_with_port(remote, 443);
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ct_transport_properties_set_multistreaming(transport_properties, multistreaming);
+
+    ct_preconnection_t* preconnection =
+        ct_preconnection_new(NULL, 0, (const ct_remote_endpoint_t**)&remote, 1,
+                             transport_properties, NULL);
+    ct_transport_properties_free(transport_properties);
+    ct_remote_endpoint_free(remote);
+    return preconnection;
+}
+
+void set_address(struct sockaddr_storage* storage, const char* ip, uint16_t port) {
+    memset(storage, 0, sizeof(*storage));
+    if (strchr(ip, ':')) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)storage;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        inet_pton(AF_INET6, ip, &in6->sin6_addr);
+    } else {
+        struct sockaddr_in* in = (struct sockaddr_in*)storage;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        inet_pton(AF_INET, ip, &in->sin_addr);
+    }
+}
+
+} // namespace
+
+class DestinationCacheUnitTest : public ::testing::Test {
+protected:
+    ct_protocol_impl_t tcp = {};
+    ct_protocol_impl_t quic = {};
+    ct_protocol_candidate_t tcp_candidate = {};
+    ct_protocol_candidate_t quic_candidate = {};
+    ct_local_endpoint_t wifi = {};
+    ct_local_endpoint_t cellular = {};
+    ct_remote_endpoint_t remote_v4 = {};
+    ct_remote_endpoint_t remote_v6 = {};
+
+    void SetUp() override {
+        ASSERT_EQ(ct_initialize(), 0);
+        tcp.name = "TCP";
+        tcp.protocol_enum = CT_PROTOCOL_TCP;
+        quic.name = "QUIC";
+        quic.protocol_enum = CT_PROTOCOL_QUIC;
+        tcp_candidate.protocol_impl = &tcp;
+        quic_candidate.protocol_impl = &quic;
+        set_address(&wifi.resolved_address, "192.168.1.10", 0);
+        set_address(&cellular.resolved_address, "10.20.30.40", 0);
+        set_address(&remote_v4.resolved_address, "192.0.2.1", 443);
+        set_address(&remote_v6.resolved_address, "2001:db8::1", 443);
+    }
+
+    void TearDown() override {
+        ct_destination_cache_clear();
+        ASSERT_EQ(ct_close(), 0);
+    }
+
+    ct_candidate_node_t candidate(ct_protocol_candidate_t* protocol_candidate,
+                                  ct_local_endpoint_t* local, ct_remote_endpoint_t* remote) {
+        ct_candidate_node_t node = {};
+        node.type = NODE_TYPE_ENDPOINT;
+        node.protocol_candidate = protocol_candidate;
+        node.local_endpoint = local;
+        node.remote_endpoint = remote;
+        return node;
+    }
+};
+
+TEST_F(DestinationCacheUnitTest, keyDependsOnRemoteEndpointsAndSelectionProperties) {
+    ct_preconnection_t* first = new_preconnection("example.com", PREFER);
+    ct_preconnection_t* second = new_preconnection("example.com", PREFER);
+    ct_preconnection_t* other_properties = new_preconnection("example.com", PROHIBIT);
+    ct_preconnection_t* other_host = new_preconnection("example.org", PREFER);
+
+    char* first_key = ct_destination_cache_key_new(first);
+    char* second_key = ct_destination_cache_key_new(second);
+    char* other_properties_key = ct_destination_cache_key_new(other_properties);
+    char* other_host_key = ct_destination_cache_key_new(other_host);
+    ASSERT_NE(first_key, nullptr);
+    EXPECT_STREQ(first_key, second_key);
+    EXPECT_STRNE(first_key, other_properties_key);
+    EXPECT_STRNE(first_key, other_host_key);
+
+    free(first_key);
+    free(second_key);
+    free(other_properties_key);
+    free(other_host_key);
+    ct_preconnection_free(first);
+    ct_preconnection_free(second);
+    ct_preconnection_free(other_properties);
+    ct_preconnection_free(other_host);
+}
+
+TEST_F(DestinationCacheUnitTest, remembersWinnerUntilRemoved) {
+    ct_destination_winner_t winner;
+    EXPECT_FALSE(ct_destination_cache_lookup("destination", &winner));
+
+    ct_candidate_node_t node = candidate(&quic_candidate, &cellular, &remote_v6);
+    ct_destination_cache_record("destination", &node, 35);
+    ASSERT_TRUE(ct_destination_cache_lookup("destination", &winner));
+    EXPECT_EQ(winner.protocol, CT_PROTOCOL_QUIC);
+    EXPECT_EQ(winner.family, AF_INET6);
+    EXPECT_EQ(winner.handshake_ms, 35u);
+    EXPECT_EQ(ct_destination_cache_size(), 1u);
+
+    ct_destination_cache_remove("destination");
+    EXPECT_FALSE(ct_destination_cache_lookup("destination", &winner));
+}
+
+TEST_F(DestinationCacheUnitTest, promotesWinnerAndSimilarCandidates) {
+    GArray* candidates = g_array_new(FALSE, FALSE, sizeof(ct_candidate_node_t));
+    ct_candidate_node_t nodes[] = {
+        candidate(&quic_candidate, &wifi, &remote_v6),
+        candidate(&quic_candidate, &wifi, &remote_v4),
+        candidate(&tcp_candidate, &wifi, &remote_v4),
+        candidate(&tcp_candidate, &cellular, &remote_v4),
+        candidate(&tcp_candidate, &wifi, &remote_v6),
+    };
+    g_array_append_vals(candidates, nodes, 5);
+
+    // A connection from another port of the same address won
+    ct_local_endpoint_t cellular_with_port = cellular;
+    ((struct sockaddr_in*)&cellular_with_port.resolved_address)->sin_port = htons(50000);
+    ct_candidate_node_t won = candidate(&tcp_candidate, &cellular_with_port, &remote_v4);
+    ct_destination_cache_record("destination", &won, 12);
+    ct_destination_winner_t winner;
+    ASSERT_TRUE(ct_destination_cache_lookup("destination", &winner));
+
+    EXPECT_TRUE(ct_destination_cache_promote(&winner, candidates));
+    ct_candidate_node_t* promoted = (ct_candidate_node_t*)candidates->data;
+    EXPECT_EQ(promoted[0].local_endpoint, &cellular);
+    // TCP over IPv4 from another interface comes next, the rest keep their order
+    EXPECT_EQ(promoted[1].protocol_candidate, &tcp_candidate);
+    EXPECT_EQ(promoted[1].local_endpoint, &wifi);
+    EXPECT_EQ(promoted[1].remote_endpoint, &remote_v4);
+    EXPECT_EQ(promoted[2].remote_endpoint, &remote_v6);
+    EXPECT_EQ(promoted[2].protocol_candidate, &quic_candidate);
+    EXPECT_EQ(promoted[3].remote_endpoint, &remote_v4);
+    EXPECT_EQ(promoted[3].protocol_candidate, &quic_candidate);
+    EXPECT_EQ(promoted[4].remote_endpoint, &remote_v6);
+    EXPECT_EQ(promoted[4].protocol_candidate, &tcp_candidate);
+
+    g_array_free(candidates, TRUE);
+}
+
+TEST_F(DestinationCacheUnitTest, keepsOrderWithoutExactMatch) {
+    GArray* candidates = g_array_new(FALSE, FALSE, sizeof(ct_candidate_node_t));
+    ct_candidate_node_t nodes[] = {
+        candidate(&tcp_candidate, &wifi, &remote_v4),
+        candidate(&quic_candidate, &wifi, &remote_v4),
+    };
+    g_array_append_vals(candidates, nodes, 2);
+
+    ct_candidate_node_t won = candidate(&quic_candidate, &cellular, &remote_v4);
+    ct_destination_cache_record("destination", &won, 12);
+    ct_destination_winner_t winner;
+    ASSERT_TRUE(ct_destination_cache_lookup("destination", &winner));
+
+    // QUIC from wifi is only similar, it is still tried first
+    EXPECT_FALSE(ct_destination_cache_promote(&winner, candidates));
+    EXPECT_EQ(g_array_index(candidates, ct_candidate_node_t, 0).protocol_candidate,
+              &quic_candidate);
+    EXPECT_EQ(g_array_index(candidates, ct_candidate_node_t, 1).protocol_candidate,
+              &tcp_candidate);
+
+    g_array_free(candidates, TRUE);
+}
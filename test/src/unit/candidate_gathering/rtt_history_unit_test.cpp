@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+extern "C" {
+  #include "ctaps.h"
+  #include "candidate_gathering/rtt_history.h"
+}
+
+class RttHistoryUnitTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(ct_initialize(), 0);
+    }
+
+    void TearDown() override {
+        ct_set_connection_attempt_delay(0);
+        ASSERT_EQ(ct_close(), 0);
+    }
+
+    static struct sockaddr_storage address(const char* ip, uint16_t port) {
+        struct sockaddr_storage storage = {};
+        struct sockaddr_in* in = (struct sockaddr_in*)&storage;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        inet_pton(AF_INET, ip, &in->sin_addr);
+        return storage;
+    }
+};
+
+TEST_F(RttHistoryUnitTest, usesDefaultDelayWithoutHistory) {
+    struct sockaddr_storage remote = address("192.0.2.1", 443);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&remote), (uint64_t)DEFAULT_CONNECTION_ATTEMPT_DELAY_MS);
+    EXPECT_EQ(ct_rtt_history_size(), 0u);
+}
+
+TEST_F(RttHistoryUnitTest, delayFollowsRttOfDestination) {
+    struct sockaddr_storage remote = address("192.0.2.1", 443);
+    // SRTT 40 ms and RTTVAR 20 ms after the first sample
+    ct_rtt_history_add_sample(&remote, 40000);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&remote), 120u);
+
+    // Any port of the same address shares the history
+    struct sockaddr_storage other_port = address("192.0.2.1", 8443);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&other_port), 120u);
+    struct sockaddr_storage other_address = address("192.0.2.2", 443);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&other_address),
+              (uint64_t)DEFAULT_CONNECTION_ATTEMPT_DELAY_MS);
+
+    // Identical samples shrink the variance: RTTVAR 15 ms, SRTT 40 ms
+    ct_rtt_history_add_sample(&remote, 40000);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&remote), 100u);
+    EXPECT_EQ(ct_rtt_history_size(), 1u);
+}
+
+TEST_F(RttHistoryUnitTest, delayIsClampedToRfc8305Bounds) {
+    struct sockaddr_storage data_centre = address("192.0.2.1", 443);
+    struct sockaddr_storage satellite = address("192.0.2.2", 443);
+    ct_rtt_history_add_sample(&data_centre, 500);
+    ct_rtt_history_add_sample(&satellite, 900000);
+
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&data_centre),
+              (uint64_t)CT_MIN_CONNECTION_ATTEMPT_DELAY_MS);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&satellite),
+              (uint64_t)CT_MAX_CONNECTION_ATTEMPT_DELAY_MS);
+}
+
+TEST_F(RttHistoryUnitTest, fixedDelayTakesPrecedence) {
+    struct sockaddr_storage remote = address("192.0.2.1", 443);
+    ct_rtt_history_add_sample(&remote, 40000);
+
+    ct_set_connection_attempt_delay(300);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&remote), 300u);
+
+    ct_set_connection_attempt_delay(0);
+    EXPECT_EQ(ct_rtt_history_attempt_delay_ms(&remote), 120u);
+}
+
+TEST_F(RttHistoryUnitTest, evictsLeastRecentDestinationWhenFull) {
+    for (int i = 0; i <= CT_RTT_HISTORY_MAX_ENTRIES; i++) {
+        char ip[INET_ADDRSTRLEN];
+        snprintf(ip, sizeof(ip), "10.0.%d.%d", i / 256, i % 256);
+        struct sockaddr_storage remote = address(ip, 443);
+        ct_rtt_history_add_sample(&remote, 40000);
+    }
+    EXPECT_EQ(ct_rtt_history_size(), (size_t)CT_RTT_HISTORY_MAX_ENTRIES);
+
+    ct_rtt_history_clear();
+    EXPECT_EQ(ct_rtt_history_size(), 0u);
+}
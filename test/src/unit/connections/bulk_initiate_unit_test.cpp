@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <cstring>
+extern "C" {
+#include "fff.h"
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <candidate_gathering/candidate_gathering.h>
+#include <connection/connection.h>
+
+typedef void (*race_failed_cb_t)(void*);
+
+DEFINE_FFF_GLOBALS;
+FAKE_VALUE_FUNC(int, __wrap_preconnection_race_candidates_with_failure_cb,
+                const ct_preconnection_t*, ct_connection_callbacks_t, GArray*, race_failed_cb_t,
+                void*);
+FAKE_VOID_FUNC(on_ready, ct_connection_t*);
+FAKE_VOID_FUNC(on_establishment_error, ct_connection_t*);
+}
+
+static unsigned int num_candidates_raced = 0;
+
+// The race owns the candidates
+static int free_raced_candidates(const ct_preconnection_t*, ct_connection_callbacks_t,
+                                 GArray* candidate_nodes, race_failed_cb_t, void*) {
+    num_candidates_raced = candidate_nodes->len;
+    free_candidate_array(candidate_nodes);
+    return 0;
+}
+
+class BulkInitiateUnitTest : public ::testing::Test {
+protected:
+    ct_connection_t connections[3];
+    ct_preconnection_t* preconnection = nullptr;
+    ct_connection_callbacks_t callbacks = {};
+
+    void SetUp() override {
+        ASSERT_EQ(ct_initialize(), 0);
+        RESET_FAKE(__wrap_preconnection_race_candidates_with_failure_cb);
+        RESET_FAKE(on_ready);
+        RESET_FAKE(on_establishment_error);
+        FFF_RESET_HISTORY();
+        __wrap_preconnection_race_candidates_with_failure_cb_fake.custom_fake =
+            free_raced_candidates;
+        num_candidates_raced = 0;
+        memset(connections, 0, sizeof(connections));
+
+        ct_remote_endpoint_t* remote = ct_remote_endpoint_new();
+        ct_remote_endpoint_with_ipv4(remote, inet_addr("127.0.0.1"));
+        ct_remote_endpoint_with_port(remote, 4433);
+        preconnection = ct_preconnection_new(NULL, 0, (const ct_remote_endpoint_t**)&remote, 1,
+                                             NULL, NULL);
+        ct_remote_endpoint_free(remote);
+        ASSERT_NE(preconnection, nullptr);
+        callbacks.ready = on_ready;
+        callbacks.establishment_error = on_establishment_error;
+        callbacks.per_connection_context = &callbacks;
+    }
+
+    void TearDown() override {
+        ct_preconnection_free(preconnection);
+        // Lets the ramp timer of a concluded bulk initiate close
+        ct_start_event_loop();
+        ASSERT_EQ(ct_close(), 0);
+    }
+
+    void complete_race(unsigned int call, ct_connection_t* connection) {
+        connection->connection_callbacks =
+            __wrap_preconnection_race_candidates_with_failure_cb_fake.arg1_history[call];
+        ct_connection_mark_as_established(connection);
+        connection->connection_callbacks.ready(connection);
+    }
+
+    void fail_race(unsigned int call) {
+        __wrap_preconnection_race_candidates_with_failure_cb_fake.arg3_history[call](
+            __wrap_preconnection_race_candidates_with_failure_cb_fake.arg4_history[call]);
+    }
+};
+
+TEST_F(BulkInitiateUnitTest, RejectsZeroConnections) {
+    EXPECT_EQ(ct_preconnection_initiate_many(preconnection, 0, &callbacks), -EINVAL);
+    EXPECT_EQ(__wrap_preconnection_race_candidates_with_failure_cb_fake.call_count, 0u);
+}
+
+TEST_F(BulkInitiateUnitTest, StartsEveryRaceFromTheSameCandidatesWithoutRamp) {
+    ASSERT_EQ(ct_preconnection_initiate_many(preconnection, 3, &callbacks), 0);
+
+    ASSERT_EQ(__wrap_preconnection_race_candidates_with_failure_cb_fake.call_count, 3u);
+    EXPECT_GT(num_candidates_raced, 0u);
+    // Every race got its own copy of the candidates
+    EXPECT_NE(__wrap_preconnection_race_candidates_with_failure_cb_fake.arg2_history[0],
+              __wrap_preconnection_race_candidates_with_failure_cb_fake.arg2_history[1]);
+
+    complete_race(0, &connections[0]);
+    fail_race(1);
+    complete_race(2, &connections[2]);
+
+    EXPECT_EQ(on_ready_fake.call_count, 2u);
+    // The winners got the user's callbacks back
+    EXPECT_EQ(connections[0].connection_callbacks.ready, on_ready);
+    EXPECT_EQ(connections[2].connection_callbacks.per_connection_context, &callbacks);
+}
+
+TEST_F(BulkInitiateUnitTest, SpreadsRacesOverRamp) {
+    ASSERT_EQ(ct_preconnection_set_initiate_ramp(preconnection, 30), 0);
+    ASSERT_EQ(ct_preconnection_initiate_many(preconnection, 3, &callbacks), 0);
+    EXPECT_EQ(__wrap_preconnection_race_candidates_with_failure_cb_fake.call_count, 1u);
+
+    // Returns once the ramp timer stops, after the last race was started
+    ct_start_event_loop();
+    ASSERT_EQ(__wrap_preconnection_race_candidates_with_failure_cb_fake.call_count, 3u);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        fail_race(i);
+    }
+    EXPECT_EQ(on_ready_fake.call_count, 0u);
+}
@@ -46,12 +46,14 @@ protected:
         for (int i = 0; i < num_connections; i++) {
             memset(&connections[i], 0, sizeof(ct_connection_t));
             snprintf(connections[i].uuid, sizeof(connections[i].uuid), "test-uuid-%d", i);
-            g_hash_table_insert(group->connections, connections[i].uuid, &connections[i]);
+            ct_connection_group_add_connection(group, &connections[i]);
         }
     }
 
     void TearDown() override {
-        g_hash_table_remove_all(group->connections);
+        for (int i = 0; i < num_connections; i++) {
+            ct_connection_group_remove_connection(group, &connections[i]);
+        }
         ct_connection_group_free(group);
 
     }
@@ -93,6 +95,56 @@ TEST_F(ConnectionGroupUnitTests, AbortAll_MixedStates_SkipsOnlyClosed) {
     EXPECT_EQ(__wrap_ct_connection_abort_fake.call_count, 3);
 }
 
+// ── member counters ───────────────────────────────────────────────────────────
+
+TEST_F(ConnectionGroupUnitTests, Counters_FollowStateTransitions) {
+    for (int i = 0; i < num_connections; i++) {
+        ct_connection_mark_as_established(&connections[i]);
+    }
+    EXPECT_EQ(group->num_members, (size_t)num_connections);
+    EXPECT_EQ(group->num_open, (size_t)num_connections);
+    EXPECT_EQ(group->num_sending, (size_t)num_connections);
+    EXPECT_EQ(group->num_receiving, (size_t)num_connections);
+
+    ct_connection_set_can_send(&connections[0], false);
+    ct_connection_set_can_receive(&connections[1], false);
+    EXPECT_EQ(group->num_sending, (size_t)num_connections - 1);
+    EXPECT_EQ(group->num_receiving, (size_t)num_connections - 1);
+    EXPECT_EQ(group->num_sending_or_receiving, (size_t)num_connections);
+
+    ct_connection_set_can_receive(&connections[0], false);
+    ct_connection_mark_as_closed(&connections[0]);
+    EXPECT_EQ(group->num_sending_or_receiving, (size_t)num_connections - 1);
+    EXPECT_EQ(group->num_open, (size_t)num_connections - 1);
+    EXPECT_EQ(ct_connection_group_get_num_active_connections(group), (uint64_t)num_connections - 1);
+}
+
+TEST_F(ConnectionGroupUnitTests, Counters_RemovedMemberIsUncounted) {
+    for (int i = 0; i < num_connections; i++) {
+        ct_connection_mark_as_established(&connections[i]);
+    }
+
+    EXPECT_EQ(ct_connection_group_remove_connection(group, &connections[1]), 0);
+    EXPECT_EQ(ct_connection_group_remove_connection(group, &connections[1]), -ENOENT);
+
+    EXPECT_EQ(group->num_members, (size_t)num_connections - 1);
+    EXPECT_EQ(group->num_open, (size_t)num_connections - 1);
+    EXPECT_EQ(group->num_sending_or_receiving, (size_t)num_connections - 1);
+    // No longer a member, so its transitions do not touch the group
+    ct_connection_mark_as_closed(&connections[1]);
+    EXPECT_EQ(group->num_open, (size_t)num_connections - 1);
+}
+
+TEST_F(ConnectionGroupUnitTests, Members_IterateInInsertionOrder) {
+    ct_connection_group_remove_connection(group, &connections[0]);
+    ct_connection_group_remove_connection(group, &connections[3]);
+
+    EXPECT_EQ(ct_connection_group_get_first(group), &connections[1]);
+    EXPECT_EQ(connections[1].group_next, &connections[2]);
+    EXPECT_EQ(connections[2].group_next, nullptr);
+    EXPECT_EQ(group->members_tail, &connections[2]);
+}
+
 // ── set_active_remote_endpoint ────────────────────────────────────────────────
 
 TEST_F(ConnectionGroupUnitTests, setActiveRemoteEndpoint_NullGroupDies) {
@@ -0,0 +1,151 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <cstring>
+extern "C" {
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <connection/connection.h>
+#include <connection/connection_group.h>
+#include <connection/connection_pool.h>
+}
+
+namespace {
+
+ct_preconnection_t* new_preconnection(const char* hostname, const char* alpn,
+                                      bool with_local_endpoint = false) {
+    ct_remote_endpoint_t* remote = ct_remote_endpoint_new();
+    ct_remote_endpoint_with_hostname(remote, hostname);
+    ct_remote_endpoint_with_port(remote, 4433);
+    ct_local_endpoint_t* local = ct_local_endpoint_new();
+    ct_local_endpoint_with_port(local, 5000);
+
+    ct_security_parameters_t* security_parameters = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(security_parameters, alpn);
+
+    ct_preconnection_t* preconnection =
+        ct_preconnection_new((const ct_local_endpoint_t**)&local, with_local_endpoint ? 1 : 0,
+                             (const ct_remote_endpoint_t**)&remote, 1, NULL, security_parameters);
+    ct_security_parameters_free(security_parameters);
+    ct_local_endpoint_free(local);
+    ct_remote_endpoint_free(remote);
+    return preconnection;
+}
+
+} // namespace
+
+class ConnectionPoolUnitTest : public ::testing::Test {
+protected:
+    ct_connection_group_t* group = nullptr;
+    ct_connection_t connection;
+
+    void SetUp() override {
+        group = ct_connection_group_new(NULL);
+        memset(&connection, 0, sizeof(ct_connection_t));
+        ct_connection_group_add_connection(group, &connection);
+    }
+
+    void TearDown() override {
+        ct_connection_group_remove_connection(group, &connection);
+        ct_connection_group_free(group);
+        ct_connection_pool_clear();
+    }
+};
+
+TEST_F(ConnectionPoolUnitTest, keyIsSharedByEquivalentPreconnections) {
+    ct_preconnection_t* first = new_preconnection("example.com", "h3");
+    ct_preconnection_t* second = new_preconnection("example.com", "h3");
+    ct_preconnection_t* other_alpn = new_preconnection("example.com", "hq-interop");
+    ct_preconnection_t* other_host = new_preconnection("example.org", "h3");
+
+    char* first_key = ct_connection_pool_key_new(first);
+    char* second_key = ct_connection_pool_key_new(second);
+    char* other_alpn_key = ct_connection_pool_key_new(other_alpn);
+    char* other_host_key = ct_connection_pool_key_new(other_host);
+
+    ASSERT_NE(first_key, nullptr);
+    EXPECT_STREQ(first_key, second_key);
+    EXPECT_STRNE(first_key, other_alpn_key);
+    EXPECT_STRNE(first_key, other_host_key);
+
+    free(first_key);
+    free(second_key);
+    free(other_alpn_key);
+    free(other_host_key);
+    ct_preconnection_free(first);
+    ct_preconnection_free(second);
+    ct_preconnection_free(other_alpn);
+    ct_preconnection_free(other_host);
+}
+
+TEST_F(ConnectionPoolUnitTest, keyDependsOnSelectionProperties) {
+    ct_preconnection_t* first = new_preconnection("example.com", "h3");
+    ct_preconnection_t* unreliable = new_preconnection("example.com", "h3");
+    unreliable->selection_masks.require &= ~(UINT64_C(1) << RELIABILITY);
+    unreliable->selection_masks.prohibit |= UINT64_C(1) << RELIABILITY;
+
+    char* first_key = ct_connection_pool_key_new(first);
+    char* unreliable_key = ct_connection_pool_key_new(unreliable);
+    EXPECT_STRNE(first_key, unreliable_key);
+
+    free(first_key);
+    free(unreliable_key);
+    ct_preconnection_free(first);
+    ct_preconnection_free(unreliable);
+}
+
+TEST_F(ConnectionPoolUnitTest, preconnectionWithLocalEndpointIsNotCoalesced) {
+    ct_preconnection_t* preconnection = new_preconnection("example.com", "h3", true);
+
+    EXPECT_EQ(ct_connection_pool_key_new(preconnection), nullptr);
+
+    ct_preconnection_free(preconnection);
+}
+
+TEST_F(ConnectionPoolUnitTest, findReturnsEstablishedMember) {
+    ASSERT_EQ(ct_connection_pool_add("key", group), 0);
+
+    // Still establishing
+    EXPECT_EQ(ct_connection_pool_find("key", NULL), nullptr);
+
+    ct_connection_mark_as_established(&connection);
+
+    EXPECT_EQ(ct_connection_pool_find("key", NULL), &connection);
+    EXPECT_EQ(ct_connection_pool_find("other key", NULL), nullptr);
+}
+
+TEST_F(ConnectionPoolUnitTest, groupWithIncompatibleProtocolIsNotReused) {
+    ASSERT_EQ(ct_connection_pool_add("key", group), 0);
+    ct_protocol_impl_t protocol_impl = {};
+    protocol_impl.selection_properties.list[RELIABILITY].value.simple_preference = PROHIBIT;
+    ct_socket_manager_t socket_manager = {};
+    socket_manager.protocol_impl = &protocol_impl;
+    connection.socket_manager = &socket_manager;
+    ct_connection_mark_as_established(&connection);
+
+    ct_selection_masks_t reliable = {};
+    reliable.require = UINT64_C(1) << RELIABILITY;
+    EXPECT_EQ(ct_connection_pool_find("key", &reliable), nullptr);
+
+    ct_selection_masks_t no_preference = {};
+    EXPECT_EQ(ct_connection_pool_find("key", &no_preference), &connection);
+    connection.socket_manager = NULL;
+}
+
+TEST_F(ConnectionPoolUnitTest, groupAtGroupConnLimitIsNotReused) {
+    group->transport_properties->connection_properties.list[GROUP_CONN_LIMIT].value.uint64_val = 1;
+    ASSERT_EQ(ct_connection_pool_add("key", group), 0);
+    ct_connection_mark_as_established(&connection);
+
+    EXPECT_EQ(ct_connection_pool_find("key", NULL), nullptr);
+}
+
+TEST_F(ConnectionPoolUnitTest, freedGroupLeavesPool) {
+    ct_connection_group_t* other_group = ct_connection_group_new(NULL);
+    ASSERT_EQ(ct_connection_pool_add("key", group), 0);
+    ASSERT_EQ(ct_connection_pool_add("key", other_group), 0);
+    ASSERT_EQ(ct_connection_pool_size(), 2u);
+
+    ct_connection_group_free(other_group);
+
+    EXPECT_EQ(ct_connection_pool_size(), 1u);
+}
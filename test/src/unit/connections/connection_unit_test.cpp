@@ -99,6 +99,8 @@ protected:
             clone->connection_group = nullptr;
             ct_connection_free(clone);
         }
+        // Cloning attached a copy of the stack allocated data to the original connection
+        ct_connection_shared_data_unref(dummy_connection.shared_data);
         ct_connection_group_free(dummy_connection_group);
     }
 
@@ -300,6 +302,57 @@ TEST_F(ConnectionUnitTests, cloneSocketManagerIsSetWhenProvided) {
     ASSERT_EQ(__wrap_ct_socket_manager_add_connection_fake.arg1_val, clone);
 }
 
+TEST_F(ConnectionUnitTests, clonesReferenceSharedDataInsteadOfCopying) {
+    clone = ct_connection_create_clone(&dummy_connection, nullptr, nullptr, nullptr);
+    ASSERT_NE(clone, nullptr);
+    ct_connection_t* second_clone =
+        ct_connection_create_clone(clone, nullptr, nullptr, nullptr);
+    ASSERT_NE(second_clone, nullptr);
+
+    ct_connection_shared_data_t* shared_data = dummy_connection.shared_data;
+    ASSERT_NE(shared_data, nullptr);
+    // The source keeps its own data, the block is a copy of it
+    EXPECT_EQ(dummy_connection.all_local_endpoints, &dummy_local_endpoint);
+    EXPECT_EQ(clone->shared_data, shared_data);
+    EXPECT_EQ(second_clone->shared_data, shared_data);
+    EXPECT_EQ(shared_data->ref_count, 3u);
+
+    EXPECT_EQ(clone->all_local_endpoints, shared_data->all_local_endpoints);
+    EXPECT_EQ(clone->all_remote_endpoints, shared_data->all_remote_endpoints);
+    EXPECT_EQ(second_clone->all_local_endpoints, shared_data->all_local_endpoints);
+    EXPECT_EQ(second_clone->num_local_endpoints, 1u);
+    EXPECT_EQ(second_clone->num_remote_endpoints, 1u);
+
+    second_clone->connection_group = nullptr;
+    ct_connection_free(second_clone);
+    EXPECT_EQ(shared_data->ref_count, 2u);
+}
+
+TEST_F(ConnectionUnitTests, detachGivesConnectionItsOwnCopy) {
+    clone = ct_connection_create_clone(&dummy_connection, nullptr, nullptr, nullptr);
+    ASSERT_NE(clone, nullptr);
+    ct_connection_shared_data_t* shared_data = clone->shared_data;
+
+    ASSERT_EQ(ct_connection_detach_shared_data(clone), 0);
+
+    EXPECT_EQ(clone->shared_data, nullptr);
+    EXPECT_NE(clone->all_local_endpoints, nullptr);
+    EXPECT_NE(clone->all_local_endpoints, shared_data->all_local_endpoints);
+    EXPECT_NE(clone->all_remote_endpoints, shared_data->all_remote_endpoints);
+    EXPECT_EQ(shared_data->ref_count, 1u);
+}
+
+TEST_F(ConnectionUnitTests, cloneWithOwnFramerDoesNotShare) {
+    clone = ct_connection_create_clone(&dummy_connection, nullptr, &dummy_framer_impl, nullptr);
+    ASSERT_NE(clone, nullptr);
+
+    EXPECT_EQ(clone->shared_data, nullptr);
+    EXPECT_EQ(dummy_connection.shared_data, nullptr);
+    ASSERT_NE(clone->framer_impl, nullptr);
+    EXPECT_NE(clone->framer_impl, &dummy_framer_impl);
+    EXPECT_EQ(clone->framer_impl->encode_message, fake_encode_message);
+}
+
 TEST_F(ConnectionUnitTests, priorityIsSetToDefaultWhenCloning) {
     // make sure that priority is not read from source connection
     ct_connection_set_priority(&dummy_connection, 123);
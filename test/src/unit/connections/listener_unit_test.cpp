@@ -0,0 +1,193 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "fff.h"
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <connection/socket_manager/socket_manager.h>
+#include <connection/listener.h>
+#include "logging/log.h"
+}
+
+extern "C" void ct_socket_manager_closed_socket_cb(ct_socket_manager_t* socket_manager);
+extern "C" void ct_socket_manager_listener_closed_cb(ct_socket_manager_t* socket_manager);
+
+extern "C" {
+DEFINE_FFF_GLOBALS;
+FAKE_VALUE_FUNC(int, fake_tcp_listen, ct_socket_manager_t*);
+FAKE_VALUE_FUNC(int, fake_quic_listen, ct_socket_manager_t*);
+FAKE_VOID_FUNC(fake_close_listener, ct_socket_manager_t*);
+FAKE_VOID_FUNC(fake_close_socket, ct_socket_manager_t*);
+FAKE_VOID_FUNC(fake_listener_ready, ct_listener_t*);
+FAKE_VOID_FUNC(fake_establishment_error, ct_listener_t*, int);
+FAKE_VOID_FUNC(fake_listener_closed, ct_listener_t*);
+}
+
+// Protocols report a stopped listener and then a closed socket, as once their handles are closed
+static void close_listener_and_report(ct_socket_manager_t* socket_manager) {
+    ct_socket_manager_listener_closed_cb(socket_manager);
+}
+
+static void close_socket_and_report(ct_socket_manager_t* socket_manager) {
+    ct_socket_manager_closed_socket_cb(socket_manager);
+}
+
+class ListenerUnitTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        RESET_FAKE(fake_tcp_listen);
+        RESET_FAKE(fake_quic_listen);
+        RESET_FAKE(fake_close_listener);
+        RESET_FAKE(fake_close_socket);
+        RESET_FAKE(fake_listener_ready);
+        RESET_FAKE(fake_establishment_error);
+        RESET_FAKE(fake_listener_closed);
+        FFF_RESET_HISTORY();
+
+        fake_close_listener_fake.custom_fake = close_listener_and_report;
+        fake_close_socket_fake.custom_fake = close_socket_and_report;
+
+        tcp_protocol_impl.name = "TCP";
+        tcp_protocol_impl.protocol_enum = CT_PROTOCOL_TCP;
+        tcp_protocol_impl.listen = fake_tcp_listen;
+        tcp_protocol_impl.close_listener = fake_close_listener;
+        tcp_protocol_impl.close_socket = fake_close_socket;
+
+        quic_protocol_impl = tcp_protocol_impl;
+        quic_protocol_impl.name = "QUIC";
+        quic_protocol_impl.protocol_enum = CT_PROTOCOL_QUIC;
+        quic_protocol_impl.listen = fake_quic_listen;
+
+        listener_callbacks.listener_ready = fake_listener_ready;
+        listener_callbacks.establishment_error = fake_establishment_error;
+        listener_callbacks.listener_closed = fake_listener_closed;
+
+        ct_local_endpoint_t* local_endpoint = ct_local_endpoint_new();
+        listener = ct_listener_new(NULL, local_endpoint, &listener_callbacks, NULL, NULL,
+                                   &tcp_protocol_impl);
+        ct_local_endpoint_free(local_endpoint);
+        ASSERT_NE(listener, nullptr);
+    }
+
+    void TearDown() override {
+        ct_listener_free(listener);
+    }
+
+    void add_quic() {
+        ASSERT_EQ(ct_listener_add_protocol(listener, &quic_protocol_impl), 0);
+        ASSERT_EQ(listener->num_extra_socket_managers, 1u);
+    }
+
+    ct_protocol_impl_t tcp_protocol_impl = {};
+    ct_protocol_impl_t quic_protocol_impl = {};
+    ct_listener_callbacks_t listener_callbacks = {};
+    ct_listener_t* listener = nullptr;
+};
+
+TEST_F(ListenerUnitTests, severalProtocols_listensWithEachAndIsReadyOnce) {
+    add_quic();
+
+    ct_listener_listen(listener);
+
+    ASSERT_EQ(fake_tcp_listen_fake.call_count, 1);
+    ASSERT_EQ(fake_tcp_listen_fake.arg0_val, listener->socket_manager);
+    ASSERT_EQ(fake_quic_listen_fake.call_count, 1);
+    ASSERT_EQ(fake_quic_listen_fake.arg0_val, listener->extra_socket_managers[0]);
+    ASSERT_EQ(listener->extra_socket_managers[0]->listener, listener);
+    ASSERT_EQ(fake_listener_ready_fake.call_count, 1);
+    ASSERT_EQ(fake_establishment_error_fake.call_count, 0);
+    ASSERT_EQ(listener->num_listening_socket_managers, 2u);
+    ASSERT_FALSE(ct_listener_is_closed(listener));
+}
+
+TEST_F(ListenerUnitTests, severalProtocols_protocolFailingToBindIsSkipped) {
+    add_quic();
+    fake_tcp_listen_fake.return_val = -EADDRINUSE;
+
+    ct_listener_listen(listener);
+
+    ASSERT_EQ(fake_quic_listen_fake.call_count, 1);
+    ASSERT_EQ(fake_listener_ready_fake.call_count, 1);
+    ASSERT_EQ(fake_establishment_error_fake.call_count, 0);
+    ASSERT_TRUE(listener->socket_manager->stopped_listening);
+    ASSERT_FALSE(listener->extra_socket_managers[0]->stopped_listening);
+    ASSERT_EQ(listener->num_listening_socket_managers, 1u);
+
+    // Only the protocol which bound is closed, and it alone closes the listener
+    ct_listener_close(listener);
+
+    ASSERT_EQ(fake_close_listener_fake.call_count, 1);
+    ASSERT_EQ(fake_close_listener_fake.arg0_val, listener->extra_socket_managers[0]);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 1);
+    ASSERT_TRUE(ct_listener_is_closed(listener));
+}
+
+TEST_F(ListenerUnitTests, severalProtocols_establishmentErrorWhenNoneBinds) {
+    add_quic();
+    fake_tcp_listen_fake.return_val = -EADDRINUSE;
+    fake_quic_listen_fake.return_val = -EACCES;
+
+    ct_listener_listen(listener);
+
+    ASSERT_EQ(fake_listener_ready_fake.call_count, 0);
+    ASSERT_EQ(fake_establishment_error_fake.call_count, 1);
+    ASSERT_EQ(fake_establishment_error_fake.arg0_val, listener);
+    ASSERT_EQ(fake_establishment_error_fake.arg1_val, -EACCES);
+}
+
+TEST_F(ListenerUnitTests, severalProtocols_closedReportedOnceAfterLastSocketManagerStops) {
+    add_quic();
+    ct_listener_listen(listener);
+    ct_socket_manager_t* tcp_socket_manager = listener->socket_manager;
+    ct_socket_manager_t* quic_socket_manager = listener->extra_socket_managers[0];
+
+    // The QUIC socket went away on its own, TCP still accepts
+    ct_socket_manager_closed_socket_cb(quic_socket_manager);
+
+    ASSERT_TRUE(quic_socket_manager->stopped_listening);
+    ASSERT_EQ(listener->num_listening_socket_managers, 1u);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 0);
+    ASSERT_FALSE(ct_listener_is_closed(listener));
+
+    // A repeated report from a stopped socket manager is not counted again
+    ct_socket_manager_closed_socket_cb(quic_socket_manager);
+    ASSERT_EQ(listener->num_listening_socket_managers, 1u);
+    ASSERT_FALSE(ct_listener_is_closed(listener));
+
+    ct_socket_manager_closed_socket_cb(tcp_socket_manager);
+
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 1);
+    ASSERT_EQ(fake_listener_closed_fake.arg0_val, listener);
+    ASSERT_TRUE(ct_listener_is_closed(listener));
+    ASSERT_EQ(listener->num_listening_socket_managers, 0u);
+
+    ct_socket_manager_closed_socket_cb(tcp_socket_manager);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 1);
+}
+
+TEST_F(ListenerUnitTests, severalProtocols_closeStopsEachProtocolAndReportsClosedOnce) {
+    add_quic();
+    ct_listener_listen(listener);
+
+    ct_listener_close(listener);
+
+    ASSERT_EQ(fake_close_listener_fake.call_count, 2);
+    ASSERT_EQ(fake_close_listener_fake.arg0_history[0], listener->socket_manager);
+    ASSERT_EQ(fake_close_listener_fake.arg0_history[1], listener->extra_socket_managers[0]);
+    ASSERT_EQ(fake_close_socket_fake.call_count, 2);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 1);
+    ASSERT_TRUE(ct_listener_is_closed(listener));
+}
+
+TEST_F(ListenerUnitTests, singleProtocol_closedReportedWhenItStops) {
+    ct_listener_listen(listener);
+
+    ASSERT_EQ(fake_tcp_listen_fake.call_count, 1);
+    ASSERT_EQ(fake_listener_ready_fake.call_count, 1);
+
+    ct_listener_close(listener);
+
+    ASSERT_EQ(fake_close_listener_fake.call_count, 1);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 1);
+    ASSERT_TRUE(ct_listener_is_closed(listener));
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include "connection/connection.h"
+#include "connection/send_pacer.h"
+#include "message/message_context.h"
+}
+
+namespace {
+
+const uint64_t NS_PER_MS = 1000000ULL;
+// 3000 bytes per 100 ms, with the minimum bucket depth of 3000 bytes
+const uint64_t RATE_BITS_PER_SEC = 240000;
+
+std::vector<uint64_t> send_times_ns;
+
+int record_send(ct_connection_t* connection, ct_message_t* message,
+                ct_message_context_t* message_context) {
+    (void)connection;
+    send_times_ns.push_back(uv_hrtime());
+    ct_message_free(message);
+    ct_message_context_free(message_context);
+    return 0;
+}
+
+} // namespace
+
+TEST(SendPacerUnitTest, effectiveRateIsMaxSendRateFlooredByMinSendRate) {
+    ASSERT_EQ(ct_send_pacer_effective_rate(CT_CONN_RATE_UNLIMITED, CT_CONN_RATE_UNLIMITED),
+              CT_CONN_RATE_UNLIMITED);
+    ASSERT_EQ(ct_send_pacer_effective_rate(CT_CONN_RATE_UNLIMITED, 1000), 1000u);
+    ASSERT_EQ(ct_send_pacer_effective_rate(500, 1000), 1000u);
+    ASSERT_EQ(ct_send_pacer_effective_rate(2000, 1000), 2000u);
+    ASSERT_EQ(ct_send_pacer_effective_rate(2000, CT_CONN_RATE_UNLIMITED), CT_CONN_RATE_UNLIMITED);
+}
+
+TEST(SendPacerUnitTest, bucketStartsFullAndGoesIntoDebt) {
+    ct_token_bucket_t bucket;
+    ct_token_bucket_init(&bucket, RATE_BITS_PER_SEC, 0);
+
+    ASSERT_EQ(bucket.burst_bytes, (uint64_t)CT_SEND_PACER_MIN_BURST_BYTES);
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 2000, 0));
+    // A message larger than what is left still goes out, the excess is paid back later
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 2000, 0));
+    ASSERT_FALSE(ct_token_bucket_consume(&bucket, 1, 0));
+    ASSERT_GT(ct_token_bucket_time_until_ready_ns(&bucket, 0), 0u);
+}
+
+TEST(SendPacerUnitTest, bucketRefillsAtConfiguredRate) {
+    ct_token_bucket_t bucket;
+    ct_token_bucket_init(&bucket, RATE_BITS_PER_SEC, 0);
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 6000, 0));
+
+    // 3000 bytes of debt at 30000 bytes per second
+    uint64_t wait_ns = ct_token_bucket_time_until_ready_ns(&bucket, 0);
+    ASSERT_NEAR((double)wait_ns, 100.0 * NS_PER_MS, (double)NS_PER_MS);
+    ASSERT_FALSE(ct_token_bucket_consume(&bucket, 1, 50 * NS_PER_MS));
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 1, wait_ns));
+}
+
+TEST(SendPacerUnitTest, idleBucketDoesNotExceedBurst) {
+    ct_token_bucket_t bucket;
+    ct_token_bucket_init(&bucket, RATE_BITS_PER_SEC, 0);
+
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 1, 10000 * NS_PER_MS));
+    ASSERT_EQ(bucket.tokens, (int64_t)CT_SEND_PACER_MIN_BURST_BYTES - 1);
+}
+
+TEST(SendPacerUnitTest, unlimitedBucketNeverBlocks) {
+    ct_token_bucket_t bucket;
+    ct_token_bucket_init(&bucket, RATE_BITS_PER_SEC, 0);
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 10000, 0));
+
+    ct_token_bucket_set_rate(&bucket, CT_CONN_RATE_UNLIMITED, 0);
+
+    ASSERT_TRUE(ct_token_bucket_consume(&bucket, 1000000, 0));
+    ASSERT_EQ(ct_token_bucket_time_until_ready_ns(&bucket, 0), 0u);
+}
+
+TEST(SendPacerUnitTest, queuedMessagesAreReleasedAtConfiguredRate) {
+    event_loop = uv_default_loop();
+    send_times_ns.clear();
+
+    ct_protocol_impl_t protocol_impl = {};
+    protocol_impl.name = "paced";
+    protocol_impl.send = record_send;
+    ct_socket_manager_t socket_manager = {};
+    socket_manager.protocol_impl = &protocol_impl;
+    ct_connection_t* connection = ct_connection_create_empty_with_uuid();
+    connection->socket_manager = &socket_manager;
+
+    ct_send_pacer_t* pacer = ct_send_pacer_new(connection, RATE_BITS_PER_SEC);
+    ASSERT_NE(pacer, nullptr);
+
+    std::vector<char> content(3000, 'x');
+    for (int i = 0; i < 4; i++) {
+        ct_message_t* message = ct_message_new_with_content(content.data(), content.size());
+        ASSERT_EQ(ct_send_pacer_submit(pacer, message, ct_message_context_new()), 0);
+    }
+    // The full bucket lets the first message through, the second borrows from the future
+    ASSERT_EQ(send_times_ns.size(), 2u);
+    ASSERT_TRUE(ct_send_pacer_has_pending(pacer));
+
+    uv_run(event_loop, UV_RUN_DEFAULT);
+
+    ASSERT_EQ(send_times_ns.size(), 4u);
+    ASSERT_FALSE(ct_send_pacer_has_pending(pacer));
+    // Each release waits for the previous message's 3000 bytes to be paid back
+    ASSERT_GE(send_times_ns[2] - send_times_ns[1], 95 * NS_PER_MS);
+    ASSERT_GE(send_times_ns[3] - send_times_ns[2], 95 * NS_PER_MS);
+
+    ct_send_pacer_free(pacer);
+    uv_run(event_loop, UV_RUN_DEFAULT);
+    connection->socket_manager = NULL;
+    ct_connection_free(connection);
+}
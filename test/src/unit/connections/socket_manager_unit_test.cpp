@@ -9,10 +9,12 @@ extern "C" {
 #include <connection/socket_manager/socket_manager.h>
 #include <message/message.h>
 #include <connection/connection.h>
+#include <connection/listener.h>
 #include "logging/log.h"
 }
 
 extern "C" void ct_socket_manager_message_sent_cb(ct_connection_t* connection, ct_message_context_t* message_context);
+extern "C" void ct_socket_manager_closed_socket_cb(ct_socket_manager_t* socket_manager);
 extern "C" void ct_socket_manager_message_send_error_cb(ct_connection_t* connection, ct_message_context_t* message_context, int reason);
 
 extern "C" {
@@ -26,6 +28,7 @@ FAKE_VALUE_FUNC(GSList*, __wrap_g_slist_prepend, GSList*, gpointer);
 FAKE_VALUE_FUNC(int, fake_listen, ct_socket_manager_t*);
 FAKE_VOID_FUNC(fake_listener_ready, ct_listener_t*);
 FAKE_VOID_FUNC(fake_establishment_error, ct_listener_t*, int);
+FAKE_VOID_FUNC(fake_listener_closed, ct_listener_t*);
 FAKE_VALUE_FUNC(int, fake_close, ct_connection_t*);
 }
 
@@ -41,6 +44,7 @@ protected:
         RESET_FAKE(fake_listen);
         RESET_FAKE(fake_listener_ready);
         RESET_FAKE(fake_establishment_error);
+        RESET_FAKE(fake_listener_closed);
         RESET_FAKE(fake_close);
         FFF_RESET_HISTORY();
 
@@ -283,3 +287,50 @@ TEST_F(SocketManagerUnitTests, closeConnection_protocolSucceeds_returnsZero) {
     ASSERT_EQ(fake_close_fake.call_count, 1);
     ASSERT_EQ(fake_close_fake.arg0_val, &dummy_connection);
 }
+
+TEST_F(SocketManagerUnitTests, listenerWithSeveralProtocols_listensWithEachAndIsReadyOnce) {
+    ct_socket_manager_t second_socket_manager = dummy_socket_manager;
+    ct_socket_manager_t* extra_socket_managers[] = {&second_socket_manager};
+    dummy_listener.extra_socket_managers = extra_socket_managers;
+    dummy_listener.num_extra_socket_managers = 1;
+
+    ct_listener_listen(&dummy_listener);
+
+    ASSERT_EQ(fake_listen_fake.call_count, 2);
+    ASSERT_EQ(fake_listen_fake.arg0_history[0], &dummy_socket_manager);
+    ASSERT_EQ(fake_listen_fake.arg0_history[1], &second_socket_manager);
+    ASSERT_EQ(fake_listener_ready_fake.call_count, 1);
+    ASSERT_EQ(dummy_listener.num_listening_socket_managers, 2u);
+}
+
+TEST_F(SocketManagerUnitTests, listenerWithSeveralProtocols_skipsProtocolFailingToListen) {
+    ct_socket_manager_t second_socket_manager = dummy_socket_manager;
+    ct_socket_manager_t* extra_socket_managers[] = {&second_socket_manager};
+    dummy_listener.extra_socket_managers = extra_socket_managers;
+    dummy_listener.num_extra_socket_managers = 1;
+    int listen_results[] = {-EADDRINUSE, 0};
+    SET_RETURN_SEQ(fake_listen, listen_results, 2);
+
+    ct_listener_listen(&dummy_listener);
+
+    ASSERT_EQ(fake_listener_ready_fake.call_count, 1);
+    ASSERT_EQ(fake_establishment_error_fake.call_count, 0);
+    ASSERT_TRUE(dummy_socket_manager.stopped_listening);
+    ASSERT_EQ(dummy_listener.num_listening_socket_managers, 1u);
+}
+
+TEST_F(SocketManagerUnitTests, listenerWithSeveralProtocols_closesOnceLastProtocolStops) {
+    ct_socket_manager_t second_socket_manager = dummy_socket_manager;
+    dummy_socket_manager.listener = &dummy_listener;
+    second_socket_manager.listener = &dummy_listener;
+    dummy_listener.listener_callbacks.listener_closed = fake_listener_closed;
+    dummy_listener.num_listening_socket_managers = 2;
+
+    ct_socket_manager_closed_socket_cb(&dummy_socket_manager);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 0);
+    ASSERT_FALSE(ct_listener_is_closed(&dummy_listener));
+
+    ct_socket_manager_closed_socket_cb(&second_socket_manager);
+    ASSERT_EQ(fake_listener_closed_fake.call_count, 1);
+    ASSERT_TRUE(ct_listener_is_closed(&dummy_listener));
+}
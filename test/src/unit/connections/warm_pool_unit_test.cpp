@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <cstring>
+extern "C" {
+#include "fff.h"
+#include "ctaps.h"
+#include "ctaps_internal.h"
+#include <connection/connection.h>
+#include <connection/warm_pool.h>
+
+typedef void (*race_failed_cb_t)(void*);
+
+DEFINE_FFF_GLOBALS;
+FAKE_VALUE_FUNC(int, __wrap_preconnection_race_with_failure_cb, const ct_preconnection_t*,
+                ct_connection_callbacks_t, race_failed_cb_t, void*);
+FAKE_VOID_FUNC(__wrap_ct_connection_close_group, ct_connection_t*);
+}
+
+class WarmPoolUnitTest : public ::testing::Test {
+protected:
+    ct_connection_t connections[4];
+
+    void SetUp() override {
+        ASSERT_EQ(ct_initialize(), 0);
+        RESET_FAKE(__wrap_preconnection_race_with_failure_cb);
+        RESET_FAKE(__wrap_ct_connection_close_group);
+        FFF_RESET_HISTORY();
+        memset(connections, 0, sizeof(connections));
+    }
+
+    void TearDown() override {
+        ASSERT_EQ(ct_close(), 0);
+    }
+
+    ct_preconnection_t* new_preconnection() {
+        ct_remote_endpoint_t* remote = ct_remote_endpoint_new();
+        ct_remote_endpoint_with_ipv4(remote, inet_addr("127.0.0.1"));
+        ct_remote_endpoint_with_port(remote, 4433);
+        ct_preconnection_t* preconnection = ct_preconnection_new(
+            NULL, 0, (const ct_remote_endpoint_t**)&remote, 1, NULL, NULL);
+        ct_remote_endpoint_free(remote);
+        return preconnection;
+    }
+
+    // Completes the race started by the given call to preconnection_race_with_failure_cb
+    void complete_attempt(unsigned int call, ct_connection_t* connection) {
+        connection->connection_callbacks =
+            __wrap_preconnection_race_with_failure_cb_fake.arg1_history[call];
+        ct_connection_mark_as_established(connection);
+        connection->connection_callbacks.ready(connection);
+    }
+
+    void fail_attempt(unsigned int call) {
+        __wrap_preconnection_race_with_failure_cb_fake.arg2_history[call](
+            __wrap_preconnection_race_with_failure_cb_fake.arg3_history[call]);
+    }
+};
+
+TEST_F(WarmPoolUnitTest, newPoolEstablishesMinConnections) {
+    ct_warm_pool_t* pool = ct_warm_pool_new(new_preconnection(), 2, 4, 0);
+    ASSERT_NE(pool, nullptr);
+
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 2u);
+    EXPECT_EQ(ct_warm_pool_get_num_establishing(pool), 2u);
+
+    fail_attempt(0);
+    fail_attempt(1);
+    EXPECT_EQ(ct_warm_pool_get_num_establishing(pool), 0u);
+    ct_warm_pool_release(pool);
+}
+
+TEST_F(WarmPoolUnitTest, takeHandsOutMostRecentConnectionAndRefills) {
+    ct_warm_pool_t* pool = ct_warm_pool_new(new_preconnection(), 2, 2, 0);
+    complete_attempt(0, &connections[0]);
+    complete_attempt(1, &connections[1]);
+    ASSERT_EQ(ct_warm_pool_get_num_idle(pool), 2u);
+
+    EXPECT_EQ(ct_warm_pool_take(pool), &connections[1]);
+
+    EXPECT_EQ(ct_warm_pool_get_num_idle(pool), 1u);
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 3u);
+
+    fail_attempt(2);
+    ct_warm_pool_release(pool);
+    EXPECT_EQ(__wrap_ct_connection_close_group_fake.call_count, 1u);
+    EXPECT_EQ(__wrap_ct_connection_close_group_fake.arg0_val, &connections[0]);
+}
+
+TEST_F(WarmPoolUnitTest, emptyPoolGrowsUpToMax) {
+    ct_warm_pool_t* pool = ct_warm_pool_new(new_preconnection(), 0, 1, 0);
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 0u);
+
+    EXPECT_EQ(ct_warm_pool_take(pool), nullptr);
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 1u);
+
+    // Already at max with one connection establishing
+    EXPECT_EQ(ct_warm_pool_take(pool), nullptr);
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 1u);
+
+    complete_attempt(0, &connections[0]);
+    EXPECT_EQ(ct_warm_pool_take(pool), &connections[0]);
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 2u);
+
+    fail_attempt(1);
+    ct_warm_pool_release(pool);
+}
+
+TEST_F(WarmPoolUnitTest, connectionReadyAfterReleaseIsClosed) {
+    ct_warm_pool_t* pool = ct_warm_pool_new(new_preconnection(), 1, 1, 0);
+    ct_warm_pool_release(pool);
+    EXPECT_EQ(__wrap_ct_connection_close_group_fake.call_count, 0u);
+
+    // Frees the pool, ASan reports it if the in flight attempt did not keep it alive
+    complete_attempt(0, &connections[0]);
+
+    EXPECT_EQ(__wrap_ct_connection_close_group_fake.call_count, 1u);
+    EXPECT_EQ(__wrap_ct_connection_close_group_fake.arg0_val, &connections[0]);
+}
+
+TEST_F(WarmPoolUnitTest, preconnectionRejectsInvalidWarmPool) {
+    ct_preconnection_t* preconnection = new_preconnection();
+
+    EXPECT_EQ(ct_preconnection_set_warm_pool(NULL, 1, 1, 0), -EINVAL);
+    EXPECT_EQ(ct_preconnection_set_warm_pool(preconnection, 2, 1, 0), -EINVAL);
+    EXPECT_EQ(ct_preconnection_set_warm_pool(preconnection, 0, 0, 0), 0);
+    EXPECT_EQ(ct_preconnection_get_num_warm_connections(preconnection), 0u);
+    EXPECT_EQ(__wrap_preconnection_race_with_failure_cb_fake.call_count, 0u);
+
+    ct_preconnection_free(preconnection);
+}
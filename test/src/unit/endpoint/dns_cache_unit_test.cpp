@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <cstdlib>
+
+extern "C" {
+  #include "fff.h"
+  #include "ctaps.h"
+  #include "ctaps_internal.h"
+  #include "endpoint/dns_cache.h"
+  #include "candidate_gathering/candidate_gathering.h"
+  DEFINE_FFF_GLOBALS;
+
+  FAKE_VOID_FUNC(faked_ct_remote_endpoint_resolve_cb, ct_remote_endpoint_t*, size_t, ct_remote_resolve_call_context_t*);
+  FAKE_VALUE_FUNC(int, __wrap_uv_getaddrinfo, uv_loop_t*, uv_getaddrinfo_t*, uv_getaddrinfo_cb, const char*, const char*, const struct addrinfo*);
+}
+
+static uint16_t last_delivered_port = 0;
+
+// The resolve callback owns the list, check the port it was given and free it
+extern "C" void __wrap_ct_remote_endpoint_resolve_cb(ct_remote_endpoint_t* ep, size_t count, ct_remote_resolve_call_context_t* ctx) {
+    faked_ct_remote_endpoint_resolve_cb(ep, count, ctx);
+    if (ep) {
+        last_delivered_port = ntohs(((struct sockaddr_in*)&ep[0].resolved_address)->sin_port);
+    }
+    free(ep);
+}
+
+class DnsCacheUnitTest : public ::testing::Test {
+protected:
+    ct_remote_resolve_call_context_t first_context = {};
+    ct_remote_resolve_call_context_t second_context = {};
+
+    void SetUp() override {
+        ASSERT_EQ(ct_initialize(), 0);
+        FFF_RESET_HISTORY();
+        RESET_FAKE(faked_ct_remote_endpoint_resolve_cb);
+        RESET_FAKE(__wrap_uv_getaddrinfo);
+        last_delivered_port = 0;
+        first_context.assigned_port = 443;
+        second_context.assigned_port = 8443;
+    }
+
+    void TearDown() override {
+        ct_set_dns_cache_ttl(CT_DNS_CACHE_DEFAULT_TTL_MS);
+        ASSERT_EQ(ct_close(), 0);
+    }
+
+    // Completes the given call to uv_getaddrinfo with a single IPv4 address
+    void complete_lookup(unsigned int call) {
+        struct addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_flags = AI_NUMERICHOST;
+        struct addrinfo* res = nullptr;
+        ASSERT_EQ(getaddrinfo("192.0.2.1", nullptr, &hints, &res), 0);
+        __wrap_uv_getaddrinfo_fake.arg2_history[call](__wrap_uv_getaddrinfo_fake.arg1_history[call], 0, res);
+    }
+};
+
+TEST_F(DnsCacheUnitTest, concurrentLookupsShareOneQuery) {
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", nullptr, AF_UNSPEC, &first_context), 0);
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", nullptr, AF_UNSPEC, &second_context), 0);
+
+    EXPECT_EQ(__wrap_uv_getaddrinfo_fake.call_count, 1u);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.call_count, 0u);
+
+    complete_lookup(0);
+
+    ASSERT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.call_count, 2u);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.arg1_history[0], 1u);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.arg2_history[0], &first_context);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.arg2_history[1], &second_context);
+    // Each waiter gets its own port
+    EXPECT_EQ(last_delivered_port, 8443);
+}
+
+TEST_F(DnsCacheUnitTest, cachedAnswerIsDeliveredSynchronously) {
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", nullptr, AF_UNSPEC, &first_context), 0);
+    complete_lookup(0);
+    ASSERT_EQ(ct_dns_cache_size(), 1u);
+
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", nullptr, AF_UNSPEC, &second_context), 0);
+
+    EXPECT_EQ(__wrap_uv_getaddrinfo_fake.call_count, 1u);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.call_count, 2u);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.arg2_val, &second_context);
+    EXPECT_EQ(last_delivered_port, 8443);
+}
+
+TEST_F(DnsCacheUnitTest, differentServicesAreCachedSeparately) {
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", "https", AF_UNSPEC, &first_context), 0);
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", "http", AF_UNSPEC, &second_context), 0);
+
+    EXPECT_EQ(__wrap_uv_getaddrinfo_fake.call_count, 2u);
+    complete_lookup(0);
+    complete_lookup(1);
+    EXPECT_EQ(ct_dns_cache_size(), 2u);
+}
+
+TEST_F(DnsCacheUnitTest, zeroTtlBypassesCache) {
+    ct_set_dns_cache_ttl(0);
+
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", nullptr, AF_UNSPEC, &first_context), 0);
+    ASSERT_EQ(ct_dns_cache_resolve("example.com", nullptr, AF_UNSPEC, &second_context), 0);
+    EXPECT_EQ(__wrap_uv_getaddrinfo_fake.call_count, 2u);
+
+    complete_lookup(0);
+    complete_lookup(1);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.call_count, 2u);
+    EXPECT_EQ(ct_dns_cache_size(), 0u);
+}
+
+TEST_F(DnsCacheUnitTest, failedLookupIsNotCached) {
+    ASSERT_EQ(ct_dns_cache_resolve("example.invalid", nullptr, AF_UNSPEC, &first_context), 0);
+    __wrap_uv_getaddrinfo_fake.arg2_val(__wrap_uv_getaddrinfo_fake.arg1_val, UV_EAI_NONAME, nullptr);
+
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.call_count, 1u);
+    EXPECT_EQ(faked_ct_remote_endpoint_resolve_cb_fake.arg0_val, nullptr);
+    EXPECT_EQ(ct_dns_cache_size(), 0u);
+
+    ASSERT_EQ(ct_dns_cache_resolve("example.invalid", nullptr, AF_UNSPEC, &second_context), 0);
+    EXPECT_EQ(__wrap_uv_getaddrinfo_fake.call_count, 2u);
+    complete_lookup(1);
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+extern "C" {
+  #include "fff.h"
+  #include "ctaps.h"
+  #include "ctaps_internal.h"
+  #include "endpoint/interface_cache.h"
+  DEFINE_FFF_GLOBALS;
+
+  FAKE_VALUE_FUNC(int, __wrap_uv_interface_addresses, uv_interface_address_t**, int*);
+  FAKE_VOID_FUNC(__wrap_uv_free_interface_addresses, uv_interface_address_t*, int);
+}
+
+static uv_interface_address_t fake_interfaces[3];
+static int num_fake_interfaces = 0;
+
+static void add_fake_interface(const char* name, const char* ipv4) {
+    uv_interface_address_t* interface = &fake_interfaces[num_fake_interfaces++];
+    *interface = {};
+    interface->name = const_cast<char*>(name);
+    interface->address.address4.sin_family = AF_INET;
+    inet_pton(AF_INET, ipv4, &interface->address.address4.sin_addr);
+}
+
+static int custom_uv_interface_addresses(uv_interface_address_t** addresses, int* count) {
+    *addresses = fake_interfaces;
+    *count = num_fake_interfaces;
+    return 0;
+}
+
+class InterfaceCacheUnitTest : public ::testing::Test {
+protected:
+    struct sockaddr_storage addresses[8] = {};
+
+    void SetUp() override {
+        FFF_RESET_HISTORY();
+        RESET_FAKE(__wrap_uv_interface_addresses);
+        RESET_FAKE(__wrap_uv_free_interface_addresses);
+        __wrap_uv_interface_addresses_fake.custom_fake = custom_uv_interface_addresses;
+        num_fake_interfaces = 0;
+        add_fake_interface("lo", "127.0.0.1");
+        add_fake_interface("eth0", "192.0.2.1");
+    }
+
+    void TearDown() override {
+        ct_interface_cache_stop();
+    }
+};
+
+TEST_F(InterfaceCacheUnitTest, FiltersAddressesByInterfaceName) {
+    ASSERT_EQ(ct_interface_cache_get_addresses("eth0", addresses, 8), 1);
+    char buffer[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &((struct sockaddr_in*)&addresses[0])->sin_addr, buffer, sizeof(buffer));
+    EXPECT_STREQ(buffer, "192.0.2.1");
+
+    EXPECT_EQ(ct_interface_cache_get_addresses("any", addresses, 8), 2);
+    EXPECT_EQ(ct_interface_cache_get_addresses("any", addresses, 1), 1);
+    EXPECT_EQ(ct_interface_cache_get_addresses("wlan0", addresses, 8), 0);
+}
+
+TEST_F(InterfaceCacheUnitTest, EnumeratesOnEveryLookupWithoutWatching) {
+    ASSERT_FALSE(ct_interface_cache_is_watching());
+    uint64_t generation = ct_interface_cache_generation();
+    EXPECT_EQ(ct_interface_cache_generation(), generation);
+
+    add_fake_interface("wlan0", "198.51.100.1");
+
+    EXPECT_EQ(ct_interface_cache_get_addresses("wlan0", addresses, 8), 1);
+    EXPECT_NE(ct_interface_cache_generation(), generation);
+    EXPECT_EQ(__wrap_uv_interface_addresses_fake.call_count, 4);
+}
+
+TEST_F(InterfaceCacheUnitTest, ReusesAddressesWhileWatching) {
+    ASSERT_EQ(ct_initialize(), 0);
+    if (!ct_interface_cache_is_watching()) {
+        ASSERT_EQ(ct_close(), 0);
+        GTEST_SKIP() << "Interface address changes cannot be watched here";
+    }
+
+    EXPECT_EQ(ct_interface_cache_get_addresses("any", addresses, 8), 2);
+    uint64_t generation = ct_interface_cache_generation();
+    add_fake_interface("wlan0", "198.51.100.1");
+
+    // Nothing was reported over netlink, so the change to the fake goes unnoticed
+    EXPECT_EQ(ct_interface_cache_get_addresses("any", addresses, 8), 2);
+    EXPECT_EQ(ct_interface_cache_generation(), generation);
+    EXPECT_EQ(__wrap_uv_interface_addresses_fake.call_count, 1);
+
+    ASSERT_EQ(ct_close(), 0);
+    EXPECT_FALSE(ct_interface_cache_is_watching());
+}
+
+static int num_timer_callbacks = 0;
+
+static void count_timer_callback(uv_timer_t* timer) {
+    (void)timer;
+    num_timer_callbacks++;
+}
+
+TEST_F(InterfaceCacheUnitTest, StopDoesNotRunTheEventLoop) {
+    ASSERT_EQ(ct_initialize(), 0);
+    num_timer_callbacks = 0;
+    uv_timer_t timer;
+    uv_timer_init(event_loop, &timer);
+    uv_timer_start(&timer, count_timer_callback, 0, 0);
+
+    // A due callback of the user must not run while CTaps shuts down
+    ct_interface_cache_stop();
+    EXPECT_EQ(num_timer_callbacks, 0);
+    EXPECT_FALSE(ct_interface_cache_is_watching());
+
+    uv_close((uv_handle_t*)&timer, NULL);
+    uv_run(event_loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(num_timer_callbacks, 0);
+    ASSERT_EQ(ct_close(), 0);
+}
@@ -25,7 +25,7 @@ extern "C" void __wrap_ct_remote_endpoint_resolve_cb(ct_remote_endpoint_t* ep, s
 class RemoteEndpointResolveTest : public ::testing::Test {
 protected:
     ct_remote_endpoint_t* remote_endpoint = nullptr;
-    // A minimal context — the fakes don't dereference parent_node or gather_context,
+    // A minimal context — the fakes don't dereference protocol_index or gather_context,
     // so nulls are fine here.
     ct_remote_resolve_call_context_t context = {};
 
@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+extern "C" {
+  #include "protocol/quic/quic_cert_cache.h"
+}
+
+namespace {
+
+const std::string CERT_FILE = std::string(TEST_RESOURCE_DIR) + "/cert.pem";
+const std::string KEY_FILE = std::string(TEST_RESOURCE_DIR) + "/key.pem";
+
+void copy_file(const std::string& from, const std::string& to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+}
+
+} // namespace
+
+class QuicCertCacheUnitTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        ct_quic_cert_cache_clear();
+    }
+};
+
+TEST_F(QuicCertCacheUnitTest, sameFilesAreOnlyParsedOnce) {
+    ct_quic_cert_entry_t* first = ct_quic_cert_cache_get(CERT_FILE.c_str(), KEY_FILE.c_str());
+    ct_quic_cert_entry_t* second = ct_quic_cert_cache_get(CERT_FILE.c_str(), KEY_FILE.c_str());
+
+    ASSERT_NE(first, nullptr);
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(ct_quic_cert_entry_get_num_certs(first), 1u);
+    ASSERT_EQ(ct_quic_cert_cache_size(), 1u);
+
+    ct_quic_cert_entry_release(first);
+    ct_quic_cert_entry_release(second);
+}
+
+TEST_F(QuicCertCacheUnitTest, missingFilesAreNotCached) {
+    ct_quic_cert_entry_t* entry = ct_quic_cert_cache_get("/nonexistent/cert.pem", KEY_FILE.c_str());
+
+    ASSERT_EQ(entry, nullptr);
+    ASSERT_EQ(ct_quic_cert_cache_size(), 0u);
+}
+
+TEST_F(QuicCertCacheUnitTest, fileWithoutPrivateKeyIsRejected) {
+    ct_quic_cert_entry_t* entry = ct_quic_cert_cache_get(CERT_FILE.c_str(), CERT_FILE.c_str());
+
+    ASSERT_EQ(entry, nullptr);
+}
+
+TEST_F(QuicCertCacheUnitTest, changedFileIsReloadedAndOldEntryStaysValid) {
+    char dir_template[] = "/tmp/ctaps_cert_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string cert_copy = std::string(dir_template) + "/cert.pem";
+    std::string key_copy = std::string(dir_template) + "/key.pem";
+    copy_file(CERT_FILE, cert_copy);
+    copy_file(KEY_FILE, key_copy);
+
+    ct_quic_cert_entry_t* before = ct_quic_cert_cache_get(cert_copy.c_str(), key_copy.c_str());
+    ASSERT_NE(before, nullptr);
+
+    // Trailing data outside the PEM block changes the size without breaking parsing
+    std::ofstream(cert_copy, std::ios::app) << "\n";
+    ct_quic_cert_entry_t* after = ct_quic_cert_cache_get(cert_copy.c_str(), key_copy.c_str());
+
+    ASSERT_NE(after, nullptr);
+    ASSERT_NE(before, after);
+    ASSERT_EQ(ct_quic_cert_cache_size(), 1u);
+    ASSERT_EQ(ct_quic_cert_entry_get_num_certs(before), 1u);
+
+    ct_quic_cert_entry_release(before);
+    ct_quic_cert_entry_release(after);
+    std::remove(cert_copy.c_str());
+    std::remove(key_copy.c_str());
+    rmdir(dir_template);
+}
+
+TEST_F(QuicCertCacheUnitTest, clearKeepsReferencedEntriesAlive) {
+    ct_quic_cert_entry_t* entry = ct_quic_cert_cache_get(CERT_FILE.c_str(), KEY_FILE.c_str());
+    ASSERT_NE(entry, nullptr);
+
+    ct_quic_cert_cache_clear();
+
+    ASSERT_EQ(ct_quic_cert_cache_size(), 0u);
+    ASSERT_EQ(ct_quic_cert_entry_get_num_certs(entry), 1u);
+    ct_quic_cert_entry_release(entry);
+}
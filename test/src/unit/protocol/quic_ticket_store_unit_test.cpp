@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+extern "C" {
+  #include "ctaps.h"
+  #include "protocol/quic/quic_ticket_store.h"
+}
+
+namespace {
+
+const char* CERT_FILE = TEST_RESOURCE_DIR "/cert.pem";
+const char* KEY_FILE = TEST_RESOURCE_DIR "/key.pem";
+
+picoquic_quic_t* new_client_context(const char* ticket_file) {
+    return picoquic_create(8, NULL, NULL, NULL, "simple-ping", NULL, NULL, NULL, NULL, NULL,
+                           picoquic_current_time(), NULL, ticket_file, NULL, 0);
+}
+
+} // namespace
+
+class QuicTicketStoreUnitTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(ct_initialize(), 0);
+        ticket_file = "/tmp/ctaps_ticket_store_unit_test_" + std::to_string(getpid()) + ".bin";
+        unlink(ticket_file.c_str());
+    }
+
+    void TearDown() override {
+        ASSERT_EQ(ct_close(), 0);
+        unlink(ticket_file.c_str());
+    }
+
+    std::string ticket_file;
+};
+
+TEST_F(QuicTicketStoreUnitTest, partitionsAreSeparatedByCredentialsAndStorePath) {
+    ct_quic_ticket_partition_t* partition =
+        ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, ticket_file.c_str());
+    ASSERT_NE(partition, nullptr);
+
+    ASSERT_EQ(ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, ticket_file.c_str()), partition);
+    ASSERT_NE(ct_quic_ticket_store_get_partition(CERT_FILE, CERT_FILE, ticket_file.c_str()), partition);
+    ASSERT_NE(ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, "/tmp/ctaps_other_tickets.bin"),
+              partition);
+}
+
+TEST_F(QuicTicketStoreUnitTest, noPartitionWithoutTicketStorePath) {
+    ASSERT_EQ(ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, NULL), nullptr);
+}
+
+TEST_F(QuicTicketStoreUnitTest, prepareWithoutLiveContextDoesNotWriteTicketFile) {
+    ct_quic_ticket_partition_t* partition =
+        ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, ticket_file.c_str());
+
+    ASSERT_STREQ(ct_quic_ticket_store_prepare(partition), ticket_file.c_str());
+    ASSERT_NE(access(ticket_file.c_str(), F_OK), 0);
+}
+
+TEST_F(QuicTicketStoreUnitTest, prepareSavesTicketsOfLiveContextForNewContext) {
+    ct_quic_ticket_partition_t* partition =
+        ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, ticket_file.c_str());
+    picoquic_quic_t* first = new_client_context(ct_quic_ticket_store_prepare(partition));
+    ASSERT_NE(first, nullptr);
+    ct_quic_ticket_store_attach(partition, first);
+
+    // The new context loads the file the live one was just saved to
+    const char* loaded_file = ct_quic_ticket_store_prepare(partition);
+    ASSERT_EQ(access(loaded_file, F_OK), 0);
+    picoquic_quic_t* second = new_client_context(loaded_file);
+    ASSERT_NE(second, nullptr);
+    ct_quic_ticket_store_attach(partition, second);
+    ASSERT_EQ(ct_quic_ticket_partition_get_num_contexts(partition), 2u);
+
+    ct_quic_ticket_store_detach(partition, first);
+    ct_quic_ticket_store_detach(partition, second);
+    ASSERT_EQ(ct_quic_ticket_partition_get_num_contexts(partition), 0u);
+    picoquic_free(first);
+    picoquic_free(second);
+}
+
+TEST_F(QuicTicketStoreUnitTest, detachSavesTicketsOnceAndIgnoresUnknownContexts) {
+    ct_quic_ticket_partition_t* partition =
+        ct_quic_ticket_store_get_partition(CERT_FILE, KEY_FILE, ticket_file.c_str());
+    picoquic_quic_t* quic = new_client_context(NULL);
+    ASSERT_NE(quic, nullptr);
+
+    ct_quic_ticket_store_detach(partition, quic);
+    ct_quic_ticket_store_detach(NULL, quic);
+    ASSERT_NE(access(ticket_file.c_str(), F_OK), 0);
+
+    ct_quic_ticket_store_attach(partition, quic);
+    ct_quic_ticket_store_detach(partition, quic);
+    ASSERT_EQ(access(ticket_file.c_str(), F_OK), 0);
+    ASSERT_EQ(ct_quic_ticket_partition_get_num_contexts(partition), 0u);
+    picoquic_free(quic);
+}
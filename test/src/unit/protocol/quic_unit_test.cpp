@@ -1,6 +1,10 @@
 #include "gtest/gtest.h"
 extern "C" {
+  #include "message/message.h"
   #include "protocol/quic/quic.h"
+  #include <picoquic_bbr.h>
+  #include <picoquic_cubic.h>
+  #include <picoquic_newreno.h>
   #include "fff.h"
 }
 
@@ -9,6 +13,16 @@ DEFINE_FFF_GLOBALS;
 extern "C" {
 
 FAKE_VALUE_FUNC(int, __wrap_picoquic_set_stream_priority, picoquic_cnx_t*, uint64_t, uint8_t);
+FAKE_VALUE_FUNC(uint8_t*, __wrap_picoquic_provide_stream_data_buffer, void*, size_t, int, int);
+FAKE_VALUE_FUNC(picoquic_state_enum, __wrap_picoquic_get_cnx_state, picoquic_cnx_t*);
+FAKE_VALUE_FUNC(const picoquic_tp_t*, __wrap_picoquic_get_transport_parameters, picoquic_cnx_t*, int);
+FAKE_VALUE_FUNC(int, __wrap_picoquic_queue_datagram_frame, picoquic_cnx_t*, size_t, const uint8_t*);
+FAKE_VALUE_FUNC(int, __wrap_picoquic_mark_active_stream, picoquic_cnx_t*, uint64_t, int, void*);
+FAKE_VOID_FUNC(fake_message_sent, ct_connection_t*, ct_message_context_t*);
+
+int picoquic_callback(picoquic_cnx_t* cnx, uint64_t stream_id, uint8_t* bytes, size_t length,
+                      picoquic_call_back_event_t fin_or_event, void* callback_ctx,
+                      void* v_stream_ctx);
 
 }
 
@@ -16,12 +30,22 @@ class QuicUnitTest : public ::testing::Test {
 protected:
     void SetUp() override {
         RESET_FAKE(__wrap_picoquic_set_stream_priority);
+        RESET_FAKE(__wrap_picoquic_provide_stream_data_buffer);
+        RESET_FAKE(__wrap_picoquic_get_cnx_state);
+        RESET_FAKE(__wrap_picoquic_get_transport_parameters);
+        RESET_FAKE(__wrap_picoquic_queue_datagram_frame);
+        RESET_FAKE(__wrap_picoquic_mark_active_stream);
+        RESET_FAKE(fake_message_sent);
         FFF_RESET_HISTORY();
         dummy_group_state.picoquic_connection = dummy_cnx;
+        dummy_group_state.socket_state = &dummy_socket_state;
         dummy_group.connection_group_state = &dummy_group_state;
         dummy_connection.connection_group = &dummy_group;
+        dummy_connection.properties.can_receive = true;
 
         dummy_connection.internal_connection_state = &dummy_stream_state;
+        dummy_socket_manager.callbacks.message_sent = fake_message_sent;
+        dummy_connection.socket_manager = &dummy_socket_manager;
 
         dummy_stream_state.stream_id = 123;
         dummy_stream_state.stream_initialized = true;
@@ -31,12 +55,40 @@ protected:
 
     
     void TearDown() override {
+        if (dummy_stream_state.send_queue) {
+            g_queue_free(dummy_stream_state.send_queue);
+        }
+        if (dummy_socket_state.sent_messages) {
+            g_queue_free_full(dummy_socket_state.sent_messages, free);
+        }
+    }
+
+    // Queue a message the way quic_send does, without requiring a picoquic connection
+    void queue_send(const char* content, size_t length, bool fin,
+                    uint8_t priority = CT_CONNECTION_DEFAULT_PRIORITY) {
+        if (!dummy_stream_state.send_queue) {
+            dummy_stream_state.send_queue = g_queue_new();
+        }
+        ct_quic_send_data_t* send_data = (ct_quic_send_data_t*)calloc(1, sizeof(ct_quic_send_data_t));
+        send_data->message = ct_message_new_with_content(content, length);
+        send_data->fin = fin;
+        send_data->priority = priority;
+        g_queue_push_tail(dummy_stream_state.send_queue, send_data);
+    }
+
+    int prepare_to_send(size_t space) {
+        return picoquic_callback(dummy_cnx, dummy_stream_state.stream_id, (uint8_t*)0x1, space,
+                                 picoquic_callback_prepare_to_send, &dummy_group,
+                                 &dummy_connection);
     }
 
     ct_connection_t dummy_connection = {0};
     ct_connection_group_t dummy_group = {0};
     ct_quic_stream_state_t dummy_stream_state = {0};
     ct_quic_connection_group_state_t dummy_group_state = {0};
+    ct_socket_manager_t dummy_socket_manager = {0};
+    ct_quic_socket_state_t dummy_socket_state = {0};
+    uint8_t packet_buffer[64] = {0};
     picoquic_cnx_t* dummy_cnx = (picoquic_cnx_t*)0xdeadbeef; // Dummy pointer value for testing
 };
 
@@ -85,3 +137,268 @@ TEST_F(QuicUnitTest, diesOnNoStreamState) {
     GTEST_SKIP() << "Asserts disabled in release build";
 #endif
 }
+
+TEST_F(QuicUnitTest, prepareToSendPullsMessageInChunks) {
+    queue_send("0123456789", 10, false);
+    __wrap_picoquic_provide_stream_data_buffer_fake.return_val = packet_buffer;
+
+    ASSERT_EQ(prepare_to_send(4), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 4);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg2_val, 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg3_val, 1); // Still active
+    ASSERT_EQ(memcmp(packet_buffer, "0123", 4), 0);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 0);
+
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 6);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg3_val, 0); // Queue drained
+    ASSERT_EQ(memcmp(packet_buffer, "456789", 6), 0);
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 1);
+    ASSERT_EQ(fake_message_sent_fake.arg0_val, &dummy_connection);
+    ASSERT_TRUE(g_queue_is_empty(dummy_stream_state.send_queue));
+}
+
+TEST_F(QuicUnitTest, prepareToSendSetsFinAfterFinalMessage) {
+    queue_send("abc", 3, false);
+    queue_send("def", 3, true);
+    __wrap_picoquic_provide_stream_data_buffer_fake.return_val = packet_buffer;
+
+    // Both messages share one packet, the FIN follows the last one
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.call_count, 1);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 6);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg2_val, 1);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg3_val, 0);
+    ASSERT_EQ(memcmp(packet_buffer, "abcdef", 6), 0);
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 2);
+}
+
+TEST_F(QuicUnitTest, prepareToSendSendsPendingFinWhenQueueIsEmpty) {
+    dummy_stream_state.fin_pending = true;
+
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.call_count, 1);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg2_val, 1);
+    ASSERT_FALSE(dummy_stream_state.fin_pending);
+}
+
+TEST_F(QuicUnitTest, prepareToSendFailsWithoutBuffer) {
+    queue_send("abc", 3, false);
+    __wrap_picoquic_provide_stream_data_buffer_fake.return_val = NULL;
+
+    ASSERT_EQ(prepare_to_send(32), -EIO);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 0);
+
+    ct_quic_send_data_t* send_data = (ct_quic_send_data_t*)g_queue_pop_head(dummy_stream_state.send_queue);
+    ct_message_free(send_data->message);
+    free(send_data);
+}
+
+TEST_F(QuicUnitTest, streamIsReprioritizedWhenNextMessageReachesHeadOfQueue) {
+    queue_send("bulk", 4, false);
+    queue_send("urgent", 6, false, 10);
+    __wrap_picoquic_provide_stream_data_buffer_fake.return_val = packet_buffer;
+
+    // The urgent message has another priority, so it waits for the next packet
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 4);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg3_val, 1);
+
+    ASSERT_EQ(__wrap_picoquic_set_stream_priority_fake.call_count, 1);
+    ASSERT_EQ(__wrap_picoquic_set_stream_priority_fake.arg1_val, dummy_stream_state.stream_id);
+    ASSERT_EQ(__wrap_picoquic_set_stream_priority_fake.arg2_val, 10);
+    ASSERT_TRUE(dummy_stream_state.send_priority_set);
+
+    // Priority is not reapplied when unchanged
+    queue_send("urgent", 6, false, 10);
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 12);
+    ASSERT_EQ(__wrap_picoquic_set_stream_priority_fake.call_count, 1);
+    ASSERT_TRUE(g_queue_is_empty(dummy_stream_state.send_queue));
+
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 3);
+}
+
+TEST_F(QuicUnitTest, prepareToSendPacksSeveralMessagesIntoOnePacket) {
+    queue_send("ab", 2, false);
+    queue_send("cd", 2, false);
+    queue_send("ef", 2, false);
+    __wrap_picoquic_provide_stream_data_buffer_fake.return_val = packet_buffer;
+
+    ASSERT_EQ(prepare_to_send(5), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.call_count, 1);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 5);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg2_val, 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg3_val, 1); // "f" is left
+    ASSERT_EQ(memcmp(packet_buffer, "abcde", 5), 0);
+    ASSERT_EQ(g_queue_get_length(dummy_stream_state.send_queue), 1u);
+
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg1_val, 1);
+    ASSERT_EQ(__wrap_picoquic_provide_stream_data_buffer_fake.arg3_val, 0);
+    ASSERT_EQ(packet_buffer[0], 'f');
+
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 3);
+}
+
+TEST_F(QuicUnitTest, messageSentIsReportedAfterPicoquicReturns) {
+    queue_send("abc", 3, false);
+    __wrap_picoquic_provide_stream_data_buffer_fake.return_val = packet_buffer;
+
+    // Nothing is reported from within the prepare_to_send callback
+    ASSERT_EQ(prepare_to_send(32), 0);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 0);
+    ASSERT_EQ(dummy_stream_state.num_sent_pending, 1u);
+
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 1);
+    ASSERT_EQ(fake_message_sent_fake.arg0_val, &dummy_connection);
+    ASSERT_EQ(dummy_stream_state.num_sent_pending, 0u);
+    ASSERT_TRUE(g_queue_is_empty(dummy_socket_state.sent_messages));
+}
+
+TEST(QuicCongestionAlgorithmTest, capacityProfileSelectsAlgorithm) {
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ASSERT_NE(transport_properties, nullptr);
+
+    ASSERT_EQ(ct_quic_congestion_algorithm(transport_properties), nullptr);
+
+    ct_transport_properties_set_conn_capacity_profile(transport_properties,
+                                                      CT_CAPACITY_PROFILE_CAPACITY_SEEKING);
+    ASSERT_EQ(ct_quic_congestion_algorithm(transport_properties), picoquic_bbr_algorithm);
+
+    ct_transport_properties_set_conn_capacity_profile(transport_properties,
+                                                      CT_CAPACITY_PROFILE_SCAVENGER);
+    ASSERT_EQ(ct_quic_congestion_algorithm(transport_properties), picoquic_dcubic_algorithm);
+
+    ct_transport_properties_set_conn_capacity_profile(transport_properties,
+                                                      CT_CAPACITY_PROFILE_LOW_LATENCY_INTERACTIVE);
+    ASSERT_EQ(ct_quic_congestion_algorithm(transport_properties), picoquic_bbr_algorithm);
+
+    ct_transport_properties_free(transport_properties);
+}
+
+TEST(QuicCongestionAlgorithmTest, explicitAlgorithmOverridesCapacityProfile) {
+    ct_transport_properties_t* transport_properties = ct_transport_properties_new();
+    ASSERT_NE(transport_properties, nullptr);
+
+    ct_transport_properties_set_conn_capacity_profile(transport_properties,
+                                                      CT_CAPACITY_PROFILE_CAPACITY_SEEKING);
+    ct_transport_properties_set_congestion_algorithm(transport_properties,
+                                                     CT_CONGESTION_ALGORITHM_CUBIC);
+    ASSERT_EQ(ct_quic_congestion_algorithm(transport_properties), picoquic_cubic_algorithm);
+
+    ct_transport_properties_set_congestion_algorithm(transport_properties,
+                                                     CT_CONGESTION_ALGORITHM_NEWRENO);
+    ASSERT_EQ(ct_quic_congestion_algorithm(transport_properties), picoquic_newreno_algorithm);
+
+    ct_transport_properties_free(transport_properties);
+}
+
+TEST(QuicCongestionAlgorithmTest, noPropertiesKeepsDefault) {
+    ASSERT_EQ(ct_quic_congestion_algorithm(NULL), nullptr);
+}
+
+TEST_F(QuicUnitTest, unreliableMessageIsQueuedAsDatagram) {
+    picoquic_tp_t remote_tp = {0};
+    remote_tp.max_datagram_frame_size = 1200;
+    __wrap_picoquic_get_cnx_state_fake.return_val = picoquic_state_ready;
+    __wrap_picoquic_get_transport_parameters_fake.return_val = &remote_tp;
+    __wrap_picoquic_queue_datagram_frame_fake.return_val = 0;
+
+    ct_message_t* message = ct_message_new_with_content("datagram", 8);
+    ct_message_context_t* message_context = ct_message_context_new();
+    ct_message_properties_set_reliable(&message_context->message_properties, false);
+
+    ASSERT_EQ(quic_send(&dummy_connection, message, message_context), 0);
+
+    ASSERT_EQ(__wrap_picoquic_queue_datagram_frame_fake.call_count, 1);
+    ASSERT_EQ(__wrap_picoquic_queue_datagram_frame_fake.arg0_val, dummy_cnx);
+    ASSERT_EQ(__wrap_picoquic_queue_datagram_frame_fake.arg1_val, 8);
+    // Nothing was written to the stream
+    ASSERT_TRUE(!dummy_stream_state.send_queue || g_queue_is_empty(dummy_stream_state.send_queue));
+
+    // Sent is not reported from within quic_send
+    ASSERT_EQ(fake_message_sent_fake.call_count, 0);
+    ASSERT_EQ(dummy_stream_state.num_sent_pending, 1u);
+
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ASSERT_EQ(fake_message_sent_fake.call_count, 1);
+    ASSERT_EQ(fake_message_sent_fake.arg1_val, message_context);
+
+    ct_message_context_free(message_context);
+}
+
+TEST_F(QuicUnitTest, datagramLimitIncludesFrameOverhead) {
+    picoquic_tp_t remote_tp = {0};
+    remote_tp.max_datagram_frame_size = 100;
+    __wrap_picoquic_get_cnx_state_fake.return_val = picoquic_state_ready;
+    __wrap_picoquic_get_transport_parameters_fake.return_val = &remote_tp;
+    __wrap_picoquic_queue_datagram_frame_fake.return_val = 0;
+    __wrap_picoquic_mark_active_stream_fake.return_val = 0;
+    char content[98] = {0};
+
+    // Type byte, two byte length and 97 bytes of payload fill the frame exactly
+    ct_message_context_t* fitting_context = ct_message_context_new();
+    ct_message_properties_set_reliable(&fitting_context->message_properties, false);
+    ASSERT_EQ(quic_send(&dummy_connection, ct_message_new_with_content(content, 97),
+                        fitting_context),
+              0);
+    ASSERT_EQ(__wrap_picoquic_queue_datagram_frame_fake.call_count, 1);
+
+    // One more byte does not fit, so the message goes on the stream
+    ct_message_context_t* stream_context = ct_message_context_new();
+    ct_message_properties_set_reliable(&stream_context->message_properties, false);
+    ASSERT_EQ(quic_send(&dummy_connection, ct_message_new_with_content(content, 98),
+                        stream_context),
+              0);
+    ASSERT_EQ(__wrap_picoquic_queue_datagram_frame_fake.call_count, 1);
+    ASSERT_EQ(__wrap_picoquic_mark_active_stream_fake.call_count, 1);
+    ASSERT_EQ(g_queue_get_length(dummy_stream_state.send_queue), 1u);
+
+    ct_quic_send_data_t* send_data = (ct_quic_send_data_t*)g_queue_pop_head(dummy_stream_state.send_queue);
+    ASSERT_EQ(send_data->message->length, 98u);
+    ct_message_free(send_data->message);
+    free(send_data);
+    ct_quic_report_sent_messages(&dummy_socket_state);
+    ct_message_context_free(fitting_context);
+    ct_message_context_free(stream_context);
+}
+
+TEST_F(QuicUnitTest, receivedDatagramIsDeliveredAsOneMessage) {
+    dummy_group.members = &dummy_connection;
+    uint8_t datagram[] = "whole datagram";
+
+    int rc = picoquic_callback(dummy_cnx, 0, datagram, sizeof(datagram), picoquic_callback_datagram,
+                               &dummy_group, NULL);
+
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(g_queue_get_length(&dummy_connection.received_messages), 1);
+    ct_queued_message_t* received =
+        (ct_queued_message_t*)g_queue_pop_head(&dummy_connection.received_messages);
+    ASSERT_EQ(received->message->length, sizeof(datagram));
+    ASSERT_EQ(memcmp(received->message->content, datagram, sizeof(datagram)), 0);
+    ASSERT_FALSE(ct_message_properties_get_reliable(&received->context->message_properties));
+    ct_queued_message_free_all(received);
+}
+
+TEST_F(QuicUnitTest, datagramIsDeliveredAfterStreamReceivedFin) {
+    dummy_group.members = &dummy_connection;
+    dummy_connection.properties.can_receive = false; // The first stream has received FIN
+    uint8_t datagram[] = "after fin";
+
+    int rc = picoquic_callback(dummy_cnx, 0, datagram, sizeof(datagram), picoquic_callback_datagram,
+                               &dummy_group, NULL);
+
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(g_queue_get_length(&dummy_connection.received_messages), 1);
+    ct_queued_message_t* received =
+        (ct_queued_message_t*)g_queue_pop_head(&dummy_connection.received_messages);
+    ASSERT_EQ(received->message->length, sizeof(datagram));
+    ct_queued_message_free_all(received);
+}
@@ -7,9 +7,12 @@ FAKE_VOID_FUNC(faked_uv_tcp_close_reset, uv_tcp_t*, uv_close_cb);
 FAKE_VOID_FUNC(faked_uv_close, uv_handle_t*, uv_close_cb);
 FAKE_VOID_FUNC(faked_socket_manager_aborted_connection_cb, ct_connection_t*);
 FAKE_VOID_FUNC(faked_socket_manager_closed_connection_cb, ct_connection_t*);
+FAKE_VOID_FUNC(faked_socket_manager_closed_listener_cb, ct_socket_manager_t*);
 FAKE_VOID_FUNC(faked_message_send_error, ct_connection_t*, ct_message_context_t*, int);
 FAKE_VOID_FUNC(faked_message_free, ct_message_t*);
 FAKE_VALUE_FUNC(int, __wrap_uv_is_closing, const uv_handle_t*);
+FAKE_VALUE_FUNC(int, __wrap_uv_tcp_init_ex, uv_loop_t*, uv_tcp_t*, unsigned int);
+FAKE_VALUE_FUNC(int, __wrap_uv_tcp_bind, uv_tcp_t*, const struct sockaddr*, unsigned int);
 }
 
 
@@ -54,6 +57,7 @@ protected:
         );
         dummy_socket_manager.callbacks.aborted_connection = faked_socket_manager_aborted_connection_cb;
         dummy_socket_manager.callbacks.closed_connection = faked_socket_manager_closed_connection_cb;
+        dummy_socket_manager.callbacks.closed_listener = faked_socket_manager_closed_listener_cb;
         dummy_socket_manager.callbacks.message_send_error = faked_message_send_error;
         __wrap_uv_is_closing_fake.return_val = 0;
 
@@ -70,6 +74,9 @@ protected:
 
         RESET_FAKE(faked_socket_manager_aborted_connection_cb);
         RESET_FAKE(faked_socket_manager_closed_connection_cb)
+        RESET_FAKE(faked_socket_manager_closed_listener_cb);
+        RESET_FAKE(__wrap_uv_tcp_init_ex);
+        RESET_FAKE(__wrap_uv_tcp_bind);
         FFF_RESET_HISTORY();
     }
 
@@ -144,3 +151,38 @@ TEST_F(TcpUnitTest, sendErrorInvokedOnWriteError) {
     ASSERT_EQ(faked_message_send_error_fake.arg2_val, UV_ECONNRESET);
     ASSERT_EQ(faked_message_free_fake.call_count, 1);
 }
+
+TEST_F(TcpUnitTest, closedListenerCalledOnceListenSocketClosed) {
+    tcp_protocol_interface.close_listener(&dummy_socket_manager);
+
+    ASSERT_EQ(1, faked_uv_close_fake.call_count);
+    ASSERT_EQ((uv_handle_t*)&dummy_tcp_handle, faked_uv_close_fake.arg0_val);
+    ASSERT_EQ(1, faked_socket_manager_closed_listener_cb_fake.call_count);
+    ASSERT_EQ(&dummy_socket_manager, faked_socket_manager_closed_listener_cb_fake.arg0_val);
+}
+
+TEST_F(TcpUnitTest, listenFailureClosesHandleWithoutClosingListener) {
+    ct_local_endpoint_t local_endpoint = {0};
+    struct sockaddr_in* addr = (struct sockaddr_in*)&local_endpoint.resolved_address;
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(4433);
+    ct_listener_t listener = {0};
+    listener.local_endpoint = &local_endpoint;
+    dummy_socket_manager.listener = &listener;
+    void* socket_state = dummy_socket_manager.internal_socket_manager_state;
+    __wrap_uv_tcp_bind_fake.return_val = UV_EADDRINUSE;
+
+    int rc = tcp_protocol_interface.listen(&dummy_socket_manager);
+
+    ASSERT_EQ(UV_EADDRINUSE, rc);
+    ASSERT_EQ(1, __wrap_uv_tcp_init_ex_fake.call_count);
+    ASSERT_EQ((unsigned int)AF_UNSPEC, __wrap_uv_tcp_init_ex_fake.arg2_val);
+    // The initialized handle has to be closed, the listener itself never started
+    ASSERT_EQ(1, faked_uv_close_fake.call_count);
+    ASSERT_EQ((uv_handle_t*)__wrap_uv_tcp_init_ex_fake.arg1_val, faked_uv_close_fake.arg0_val);
+    ASSERT_EQ(0, faked_socket_manager_closed_listener_cb_fake.call_count);
+    ASSERT_EQ(socket_state, dummy_socket_manager.internal_socket_manager_state);
+
+    // Freeing in the close callback is wrapped away
+    __real_free(faked_uv_close_fake.arg0_val);
+}
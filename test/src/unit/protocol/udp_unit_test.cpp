@@ -9,25 +9,45 @@ extern "C" {
 DEFINE_FFF_GLOBALS;
 FAKE_VOID_FUNC(faked_message_send_error, ct_connection_t*, ct_message_context_t*, int);
 FAKE_VOID_FUNC(faked_message_free, ct_message_t*);
+FAKE_VOID_FUNC(faked_free, void*);
+FAKE_VOID_FUNC(faked_uv_close, uv_handle_t*, uv_close_cb);
+FAKE_VOID_FUNC(faked_socket_closed, ct_socket_manager_t*);
+FAKE_VALUE_FUNC(int, __wrap_uv_udp_init_ex, uv_loop_t*, uv_udp_t*, unsigned int);
+FAKE_VALUE_FUNC(int, __wrap_uv_udp_bind, uv_udp_t*, const struct sockaddr*, unsigned int);
+FAKE_VALUE_FUNC(int, __wrap_uv_udp_recv_stop, uv_udp_t*);
 
 extern "C" {
   void __wrap_ct_message_free(ct_message_t* message) {
     faked_message_free(message);
   }
 
-  void __wrap_free(void* message) {
+  void __wrap_free(void* ptr) {
+    faked_free(ptr);
+  }
+
+  void __wrap_uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
+    faked_uv_close(handle, close_cb);
+    close_cb(handle);
   }
 }
 
 class UdpUnitTest : public ::testing::Test {
 protected:
     void SetUp() override {
+        dummy_socket_manager = {0};
         dummy_socket_manager.callbacks.message_send_error = faked_message_send_error;
+        dummy_socket_manager.callbacks.socket_closed = faked_socket_closed;
         dummy_connection.socket_manager = &dummy_socket_manager;
         dummy_send_data.connection = &dummy_connection;
         dummy_send_data.message_context = &dummy_message_context;
         dummy_send_data.message = &dummy_message;
         RESET_FAKE(faked_message_send_error);
+        RESET_FAKE(faked_free);
+        RESET_FAKE(faked_uv_close);
+        RESET_FAKE(faked_socket_closed);
+        RESET_FAKE(__wrap_uv_udp_init_ex);
+        RESET_FAKE(__wrap_uv_udp_bind);
+        RESET_FAKE(__wrap_uv_udp_recv_stop);
         FFF_RESET_HISTORY();
     }
 
@@ -57,3 +77,56 @@ TEST_F(UdpUnitTest, messageSendErrorInvokedOnWriteError) {
     // the dummy send data so
     __real_free(req);
 }
+
+TEST_F(UdpUnitTest, socketClosedReportedOnceSocketIsClosed) {
+    uv_udp_t udp_handle = {0};
+    udp_handle.data = &dummy_socket_manager;
+    ct_udp_socket_state_t* socket_state = ct_udp_socket_state_new(&udp_handle);
+    dummy_socket_manager.internal_socket_manager_state = socket_state;
+
+    udp_close_socket(&dummy_socket_manager);
+
+    ASSERT_EQ(__wrap_uv_udp_recv_stop_fake.call_count, 1);
+    ASSERT_EQ(faked_uv_close_fake.call_count, 1);
+    ASSERT_EQ(faked_uv_close_fake.arg0_val, (uv_handle_t*)&udp_handle);
+    ASSERT_EQ(faked_socket_closed_fake.call_count, 1);
+    ASSERT_EQ(faked_socket_closed_fake.arg0_val, &dummy_socket_manager);
+    __real_free(socket_state);
+}
+
+TEST_F(UdpUnitTest, freeSocketStateFreesHandleAndState) {
+    uv_udp_t* udp_handle = (uv_udp_t*)calloc(1, sizeof(uv_udp_t));
+    ct_udp_socket_state_t* socket_state = ct_udp_socket_state_new(udp_handle);
+    dummy_socket_manager.internal_socket_manager_state = socket_state;
+
+    udp_free_socket_state(&dummy_socket_manager);
+
+    ASSERT_EQ(faked_free_fake.call_count, 2);
+    ASSERT_EQ(faked_free_fake.arg0_history[0], udp_handle);
+    ASSERT_EQ(faked_free_fake.arg0_history[1], socket_state);
+    __real_free(udp_handle);
+    __real_free(socket_state);
+}
+
+TEST_F(UdpUnitTest, listenFailsAndClosesHandleWhenBindFails) {
+    ct_local_endpoint_t local_endpoint = {0};
+    struct sockaddr_in* addr = (struct sockaddr_in*)&local_endpoint.resolved_address;
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(4433);
+    ct_listener_t listener = {0};
+    listener.local_endpoint = &local_endpoint;
+    dummy_socket_manager.listener = &listener;
+    __wrap_uv_udp_bind_fake.return_val = UV_EADDRINUSE;
+
+    int rc = udp_listen(&dummy_socket_manager);
+
+    ASSERT_EQ(rc, -EIO);
+    ASSERT_EQ(__wrap_uv_udp_init_ex_fake.call_count, 1);
+    // The initialized handle has to be closed, and no socket state is left behind
+    ASSERT_EQ(faked_uv_close_fake.call_count, 1);
+    ASSERT_EQ(faked_uv_close_fake.arg0_val, (uv_handle_t*)__wrap_uv_udp_init_ex_fake.arg1_val);
+    ASSERT_EQ(dummy_socket_manager.internal_socket_manager_state, nullptr);
+    ASSERT_EQ(faked_socket_closed_fake.call_count, 0);
+    // Freeing in the close callback is wrapped away
+    __real_free(faked_uv_close_fake.arg0_val);
+}
@@ -1,6 +1,7 @@
 #include <gmock/gmock-matchers.h>
 
 #include "gtest/gtest.h"
+#include <cerrno>
 extern "C" {
 #include "ctaps.h"
 #include "ctaps_internal.h"
@@ -452,3 +453,101 @@ TEST(SecurityParametersTest, ModifyingSourceDoesNotAffectCopy) {
     ct_security_parameters_free(src);
     ct_security_parameters_free(copy);
 }
+
+// =============================================================================
+// Sharing Tests
+// =============================================================================
+
+TEST(SecurityParametersTest, ShareCopiesMutableParametersOnce) {
+    ct_security_parameters_t* src = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(src, "h2");
+
+    ct_security_parameters_t* shared = ct_security_parameters_share(src);
+    ASSERT_NE(shared, nullptr);
+    EXPECT_NE(shared, src);
+    EXPECT_TRUE(shared->immutable);
+    EXPECT_FALSE(src->immutable);
+
+    ct_security_parameters_t* second = ct_security_parameters_share(shared);
+    EXPECT_EQ(second, shared);
+    EXPECT_EQ(shared->ref_count, 2);
+
+    ct_security_parameters_free(second);
+    EXPECT_EQ(shared->ref_count, 1);
+    size_t num_alpns = 0;
+    ct_security_parameters_get_alpns(shared, &num_alpns);
+    EXPECT_EQ(num_alpns, 1);
+
+    ct_security_parameters_free(shared);
+    ct_security_parameters_free(src);
+}
+
+TEST(SecurityParametersTest, ShareReturnsNullForNullSource) {
+    EXPECT_EQ(ct_security_parameters_share(nullptr), nullptr);
+}
+
+TEST(SecurityParametersTest, SettersRejectSharedParameters) {
+    ct_security_parameters_t* src = ct_security_parameters_new();
+    ct_security_parameters_t* shared = ct_security_parameters_share(src);
+    ASSERT_NE(shared, nullptr);
+
+    EXPECT_EQ(ct_security_parameters_add_alpn(shared, "h2"), -EPERM);
+    EXPECT_EQ(ct_security_parameters_clear_alpn(shared), -EPERM);
+    EXPECT_EQ(ct_security_parameters_set_server_name_identification(shared, "example.com"), -EPERM);
+    EXPECT_EQ(ct_security_parameters_set_ticket_store_path(shared, "/tmp/tickets"), -EPERM);
+    EXPECT_EQ(ct_security_parameters_add_server_certificate(shared, "cert.pem", "key.pem"), -EPERM);
+    EXPECT_FALSE(shared->list[ALPN].set_by_user);
+
+    // The user's own object stays writable
+    EXPECT_EQ(ct_security_parameters_add_alpn(src, "h2"), 0);
+
+    ct_security_parameters_free(shared);
+    ct_security_parameters_free(src);
+}
+
+TEST(SecurityParametersTest, WithAlpnSharesWhenAlpnAlreadyMatches) {
+    ct_security_parameters_t* src = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(src, "h3");
+    ct_security_parameters_t* shared = ct_security_parameters_share(src);
+
+    ct_security_parameters_t* same = ct_security_parameters_with_alpn(shared, "h3");
+    EXPECT_EQ(same, shared);
+
+    ct_security_parameters_t* none = ct_security_parameters_with_alpn(shared, nullptr);
+    ASSERT_NE(none, nullptr);
+    EXPECT_NE(none, shared);
+    EXPECT_TRUE(none->immutable);
+    size_t num_alpns = 1;
+    ct_security_parameters_get_alpns(none, &num_alpns);
+    EXPECT_EQ(num_alpns, 0);
+
+    ct_security_parameters_free(none);
+    ct_security_parameters_free(same);
+    ct_security_parameters_free(shared);
+    ct_security_parameters_free(src);
+}
+
+TEST(SecurityParametersTest, WithAlpnCopiesWhenOfferingSeveral) {
+    ct_security_parameters_t* src = ct_security_parameters_new();
+    ct_security_parameters_add_alpn(src, "h3");
+    ct_security_parameters_add_alpn(src, "h2");
+    ct_security_parameters_set_server_name_identification(src, "example.com");
+    ct_security_parameters_t* shared = ct_security_parameters_share(src);
+
+    ct_security_parameters_t* h2 = ct_security_parameters_with_alpn(shared, "h2");
+    ASSERT_NE(h2, nullptr);
+    EXPECT_NE(h2, shared);
+
+    size_t num_alpns = 0;
+    const char* const* alpns = ct_security_parameters_get_alpns(h2, &num_alpns);
+    ASSERT_EQ(num_alpns, 1);
+    EXPECT_STREQ(alpns[0], "h2");
+    EXPECT_STREQ(ct_security_parameters_get_server_name_identification(h2), "example.com");
+    // The source keeps all its ALPNs
+    ct_security_parameters_get_alpns(shared, &num_alpns);
+    EXPECT_EQ(num_alpns, 2);
+
+    ct_security_parameters_free(h2);
+    ct_security_parameters_free(shared);
+    ct_security_parameters_free(src);
+}
@@ -5,6 +5,9 @@
 extern "C" {
 #include "ctaps.h"
 #include "ctaps_internal.h"  // Needed to access selection_properties internals
+#include "protocol/quic/quic.h"
+#include "protocol/tcp/tcp.h"
+#include "transport_property/selection_properties/selection_properties.h"
 }
 
 TEST(SelectionPropertiesUnitTest, setsAdvertisesAltAddrCorrectly) {
@@ -250,3 +253,62 @@ TEST(SelectionPropertiesUnitTest, setsSetByUser) {
   }
   ct_transport_properties_free(props);
 }
+
+TEST(SelectionPropertiesUnitTest, compilesPreferencesIntoMasks) {
+  ct_transport_properties_t* props = ct_transport_properties_new();
+  ASSERT_NE(props, nullptr);
+  ct_transport_properties_set_multistreaming(props, PREFER);
+  ct_transport_properties_set_zero_rtt_msg(props, AVOID);
+
+  ct_selection_masks_t masks;
+  ct_selection_masks_compile(&props->selection_properties, &masks);
+
+  EXPECT_TRUE(masks.require & (UINT64_C(1) << RELIABILITY));
+  EXPECT_TRUE(masks.require & (UINT64_C(1) << PRESERVE_ORDER));
+  EXPECT_TRUE(masks.prohibit & (UINT64_C(1) << ADVERTISES_ALT_ADDRESS));
+  EXPECT_EQ(masks.prefer, UINT64_C(1) << MULTISTREAMING);
+  EXPECT_EQ(masks.avoid, UINT64_C(1) << ZERO_RTT_MSG);
+  // Preference sets and enums are not part of the masks
+  EXPECT_FALSE((masks.require | masks.prohibit | masks.prefer | masks.avoid) &
+               ((UINT64_C(1) << INTERFACE) | (UINT64_C(1) << DIRECTION)));
+  ct_transport_properties_free(props);
+}
+
+TEST(SelectionPropertiesUnitTest, masksRejectProtocolsProhibitingRequiredProperty) {
+  ct_transport_properties_t* props = ct_transport_properties_new();
+  ASSERT_NE(props, nullptr);
+  ct_transport_properties_set_multistreaming(props, REQUIRE);
+
+  ct_selection_masks_t desired;
+  ct_selection_masks_t tcp_capabilities;
+  ct_selection_masks_t quic_capabilities;
+  ct_selection_masks_compile(&props->selection_properties, &desired);
+  ct_selection_masks_compile(&tcp_protocol_interface.selection_properties, &tcp_capabilities);
+  ct_selection_masks_compile(&quic_protocol_interface.selection_properties, &quic_capabilities);
+
+  EXPECT_FALSE(ct_selection_masks_compatible(&desired, &tcp_capabilities));
+  EXPECT_TRUE(ct_selection_masks_compatible(&desired, &quic_capabilities));
+  ct_transport_properties_free(props);
+}
+
+TEST(SelectionPropertiesUnitTest, masksScorePreferAndAvoid) {
+  ct_transport_properties_t* props = ct_transport_properties_new();
+  ASSERT_NE(props, nullptr);
+  ct_transport_properties_set_multistreaming(props, PREFER);
+  ct_transport_properties_set_preserve_msg_boundaries(props, PREFER);
+  ct_transport_properties_set_congestion_control(props, AVOID);
+
+  ct_selection_masks_t desired;
+  ct_selection_masks_t tcp_capabilities;
+  ct_selection_masks_compile(&props->selection_properties, &desired);
+  ct_selection_masks_compile(&tcp_protocol_interface.selection_properties, &tcp_capabilities);
+
+  // TCP prohibits both preferred properties and requires congestion control
+  EXPECT_EQ(ct_selection_masks_prefer_score(&desired, &tcp_capabilities), 0);
+  EXPECT_EQ(ct_selection_masks_avoid_score(&desired, &tcp_capabilities), 0);
+
+  ct_selection_masks_t no_capabilities = {};
+  EXPECT_EQ(ct_selection_masks_prefer_score(&desired, &no_capabilities), 2);
+  EXPECT_EQ(ct_selection_masks_avoid_score(&desired, &no_capabilities), 1);
+  ct_transport_properties_free(props);
+}